@@ -0,0 +1,43 @@
+#version 440
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// one level of the pyramid: r nearest depth, g farthest depth
+layout (rg32f, binding = 0) uniform writeonly image2D outLevel;
+
+// the depth texture for level 0, the pyramid itself above
+uniform sampler2D source;
+uniform int sourceLevel;
+uniform bool fromDepth;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(outLevel);
+	if (texel.x >= size.x || texel.y >= size.y)
+		return;
+
+	if (fromDepth)
+	{
+		float depth = texelFetch(source, texel, 0).r;
+		imageStore(outLevel, texel, vec4(depth, depth, 0.0, 0.0));
+		return;
+	}
+
+	// 2x2 footprint, widened to 3 on the last row or column of an odd sized source
+	ivec2 sourceSize = textureSize(source, sourceLevel);
+	ivec2 footprint = ivec2(
+		(sourceSize.x & 1) != 0 && texel.x == size.x - 1 ? 3 : 2,
+		(sourceSize.y & 1) != 0 && texel.y == size.y - 1 ? 3 : 2);
+
+	vec2 range = vec2(1.0, 0.0);
+	for (int y = 0; y < footprint.y; y++)
+	{
+		for (int x = 0; x < footprint.x; x++)
+		{
+			vec2 depths = texelFetch(source, min(texel * 2 + ivec2(x, y), sourceSize - 1), sourceLevel).rg;
+			range = vec2(min(range.x, depths.r), max(range.y, depths.g));
+		}
+	}
+
+	imageStore(outLevel, texel, vec4(range, 0.0, 0.0));
+}
@@ -0,0 +1,138 @@
+#version 440
+layout (local_size_x = 256) in;
+
+struct DrawCommand {
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+// ModelInstanceLayout, 8 words per instance: position xyz, rotation as 4 snorm16, scale xyz
+layout (std430, binding = 0) readonly buffer Instances { uint transforms[]; };
+layout (std430, binding = 1) writeonly buffer Visible { uint visibleTransforms[]; };
+layout (std430, binding = 2) buffer Commands { DrawCommand commands[]; };
+// per instance: level in the top 4 bits, slot within the level below, or ~0 when culled
+layout (std430, binding = 3) buffer Slots { uint slots[]; };
+// per instance: 1 if it passed the occlusion test of the last late phase
+layout (std430, binding = 4) buffer Visibility { uint visibility[]; };
+layout (std430, binding = 5) buffer Stats {
+	uint frustumCulled;
+	uint occluded;
+};
+
+// PHASE_ALL: frustum only. PHASE_EARLY: instances visible last frame. PHASE_LATE: the rest,
+// tested against the pyramid built from the early phase's depth.
+const uint PHASE_ALL = 0;
+const uint PHASE_EARLY = 1;
+const uint PHASE_LATE = 2;
+
+uniform uint instanceCount;
+uniform uint lodCount;
+// distance from which each level is used, for an instance of scale 1 (see Mesh::GetLodDistance)
+uniform float lodDistances[8];
+uniform vec4 boundingSphere;
+uniform vec4 frustumPlanes[6];
+uniform mat4 viewProjection;
+uniform vec3 viewPos;
+uniform uint phase;
+// where this phase's commands and visible instances start
+uniform uint commandOffset;
+uniform uint outputOffset;
+// false: test and count the instances, true: copy the visible ones to their slots
+uniform bool scatter;
+
+const uint culled = 0xFFFFFFFFu;
+
+vec3 quatRotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// isOccluded and the pyramid's uniforms, see HiZPyramid
+#pragma compute_prelude
+
+void classify(uint instance)
+{
+	uint base = instance * 8;
+	vec3 position = uintBitsToFloat(uvec3(transforms[base], transforms[base + 1], transforms[base + 2]));
+	vec4 rotation = normalize(vec4(unpackSnorm2x16(transforms[base + 3]), unpackSnorm2x16(transforms[base + 4])));
+	vec3 scale = uintBitsToFloat(uvec3(transforms[base + 5], transforms[base + 6], transforms[base + 7]));
+
+	float maxScale = max(scale.x, max(scale.y, scale.z));
+	vec3 center = position + quatRotate(rotation, boundingSphere.xyz * scale);
+	float radius = boundingSphere.w * maxScale;
+
+	bool inside = true;
+	for (int i = 0; i < 6; i++)
+		inside = inside && dot(frustumPlanes[i].xyz, center) + frustumPlanes[i].w >= -radius;
+
+	bool draw = inside;
+	if (phase == PHASE_EARLY)
+		draw = inside && visibility[instance] != 0;
+	else if (phase == PHASE_LATE)
+	{
+		// whatever the early phase drew is done; remember what is visible for the next frame
+		bool visibleNow = inside && !isOccluded(center, radius);
+		draw = visibleNow && visibility[instance] == 0;
+		visibility[instance] = visibleNow ? 1 : 0;
+
+		if (inside && !visibleNow)
+			atomicAdd(occluded, 1);
+	}
+
+	if (!inside && phase != PHASE_EARLY)
+		atomicAdd(frustumCulled, 1);
+
+	if (!draw)
+	{
+		slots[instance] = culled;
+		return;
+	}
+
+	float distance = length(position - viewPos);
+	uint level = 0;
+	while (level + 1 < lodCount && lodDistances[level + 1] * maxScale <= distance)
+		level++;
+
+	slots[instance] = (level << 28) | atomicAdd(commands[commandOffset + level].instanceCount, 1);
+}
+
+void compact(uint instance)
+{
+	// the levels follow each other in this phase's part of the visible buffer
+	if (instance == 0)
+	{
+		uint first = outputOffset;
+		for (uint i = 0; i < lodCount; i++)
+		{
+			commands[commandOffset + i].baseInstance = first;
+			first += commands[commandOffset + i].instanceCount;
+		}
+	}
+
+	uint slot = slots[instance];
+	if (slot == culled)
+		return;
+
+	uint level = slot >> 28;
+	uint target = outputOffset + (slot & 0x0FFFFFFFu);
+	for (uint i = 0; i < level; i++)
+		target += commands[commandOffset + i].instanceCount;
+
+	for (uint i = 0; i < 8; i++)
+		visibleTransforms[target * 8 + i] = transforms[instance * 8 + i];
+}
+
+void main()
+{
+	uint instance = gl_GlobalInvocationID.x;
+	if (instance >= instanceCount)
+		return;
+
+	if (scatter)
+		compact(instance);
+	else
+		classify(instance);
+}
@@ -0,0 +1,44 @@
+// Occlusion test against a HiZPyramid, spliced into the culling shaders at their
+// "#pragma compute_prelude" line (see Shader::loadPreludeComputeProgram). The shader must
+// declare viewProjection before that line.
+
+uniform sampler2D hiZ;
+uniform vec2 hiZSize;
+uniform int hiZLevels;
+
+bool isOccluded(vec3 center, float radius)
+{
+	// screen rectangle and nearest depth of the sphere's bounding box
+	vec3 minNdc = vec3(1.0);
+	vec3 maxNdc = vec3(-1.0);
+	for (int i = 0; i < 8; i++)
+	{
+		vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+		vec4 clip = viewProjection * vec4(corner, 1.0);
+		if (clip.w <= 0.0)
+			return false;
+
+		minNdc = min(minNdc, clip.xyz / clip.w);
+		maxNdc = max(maxNdc, clip.xyz / clip.w);
+	}
+
+	vec2 uvMin = clamp(minNdc.xy * 0.5 + 0.5, 0.0, 1.0);
+	vec2 uvMax = clamp(maxNdc.xy * 0.5 + 0.5, 0.0, 1.0);
+	float nearest = minNdc.z * 0.5 + 0.5;
+
+	// the level at which the rectangle covers at most 2x2 texels
+	vec2 extent = (uvMax - uvMin) * hiZSize;
+	int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, hiZLevels - 1);
+
+	// Texels are found from level 0 by shifting, which is how the pyramid was reduced: with odd
+	// sizes the last texel of a level also covers the extra row or column below it, so scaling
+	// the uv by the level's size would land left of the texel that covers the rectangle.
+	ivec2 levelSize = textureSize(hiZ, level);
+	ivec2 first = min(ivec2(uvMin * hiZSize) >> level, levelSize - 1);
+	ivec2 last = min(ivec2(uvMax * hiZSize) >> level, levelSize - 1);
+
+	float farthest = max(
+		max(texelFetch(hiZ, first, level).g, texelFetch(hiZ, ivec2(last.x, first.y), level).g),
+		max(texelFetch(hiZ, ivec2(first.x, last.y), level).g, texelFetch(hiZ, last, level).g));
+	return nearest > farthest;
+}
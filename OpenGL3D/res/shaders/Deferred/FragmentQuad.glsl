@@ -20,6 +20,8 @@ in vec2 texCoords;
 out vec4 fragColor;
 
 uniform PointLight pointLights[COUNT_POUNT_LIGHT];
+// lights in view, assigned on the CPU
+uniform int pointLightCount;
 
 uniform vec3 viewPos;
 
@@ -43,7 +45,7 @@ void main()
 	vec3 result = vec3(0.0f);
 
 	// point light
-	for (int i = 0; i < COUNT_POUNT_LIGHT; i++)
+	for (int i = 0; i < pointLightCount; i++)
 	{
 		float dist = length(pointLights[i].position - fragPos);
 		if (dist < pointLights[i].radius)
@@ -1,7 +1,7 @@
 #version 440
 layout (location = 0) in vec3 aPos;
-layout (location = 3) in mat4 aModel;
-layout (location = 7) in vec3 aColor;
+// aInstancePosition, aInstanceScale and aColor, see LightInstanceLayout in TestDeferred.cpp
+#pragma vertex_inputs
 
 uniform mat4 view;
 uniform mat4 projection;
@@ -11,5 +11,5 @@ out vec3 color;
 void main()
 {
 	color = aColor;
-	gl_Position = projection * view * aModel * vec4(aPos, 1.0);
+	gl_Position = projection * view * vec4(aInstancePosition + aPos * aInstanceScale, 1.0);
 }
\ No newline at end of file
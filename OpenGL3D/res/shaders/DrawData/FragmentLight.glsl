@@ -1,10 +1,10 @@
 #version 440
 
-out vec4 fragColor;
+flat in vec3 lightColor;
 
-uniform vec3 lightColor;
+out vec4 fragColor;
 
 void main()
 {
 	fragColor = vec4(lightColor, 1.0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,26 @@
+#version 440
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+// the draw's index, see DrawDataBuffer
+layout (location = 15) in uint aDrawId;
+
+struct DrawData {
+	mat4 model;
+	mat4 normalMatrix;
+	vec4 color;
+	uint material;
+};
+
+layout (std430, binding = 7) readonly buffer Draws { DrawData draws[]; };
+
+out vec2 texCoords;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	gl_Position = projection * view * draws[aDrawId].model * vec4(aPos, 1.0f);
+	texCoords = aTexCoords;
+}
@@ -60,12 +60,30 @@ uniform DirLight dirLight;
 uniform PointLight pointLights[COUNT_POINT_LIGHT];
 uniform Spotlight spotlight;
 
+// distances over which the mesh fades out to its impostor (see Impostor/FragmentImpostor.glsl);
+// equal values, the default, disable the fade
+uniform vec2 fadeRange;
+
 vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 calcSpotlight(Spotlight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
+// 4x4 ordered dither threshold; the impostor keeps exactly the pixels the mesh drops
+float ditherThreshold()
+{
+	const float bayer[16] = float[](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+	ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+	return (bayer[pixel.y * 4 + pixel.x] + 0.5) / 16.0;
+}
+
 void main()
 {
+	if (fadeRange.y > fadeRange.x)
+	{
+		float fade = clamp((length(fragPos - viewPos) - fadeRange.x) / (fadeRange.y - fadeRange.x), 0.0, 1.0);
+		if (ditherThreshold() < fade)
+			discard;
+	}
 
 	// properties
 	vec3 norm = normalize(normal);
@@ -26,22 +26,32 @@ uniform vec3 camPos;
 uniform bool showNormal;
 uniform bool normalMapping;
 
+// Impostor/FragmentSphere.glsl, for spheres ray cast over quads
+#pragma fragment_prelude
+
 float distributionGGX(float nDotH, float roughness);
 float geometrySchlickGGX(float nDotV, float roughness);
 vec3 fresnelSchlick(float vDotH, vec3 F0);
 vec3 fresnelSchlickRoughness(float nDotV, vec3 F0, float roughness);
 
+#ifndef SPHERE_IMPOSTOR
 in VS_OUT {
 	vec3 worldPos;
 	vec3 normal;
 	mat3 TBN;
 	vec2 texCoords;
 } fs_in;
+#endif
 
 out vec4 fragColor;
 
 void main()
 {
+#ifdef SPHERE_IMPOSTOR
+	if (!traceSphere())
+		discard;
+#endif
+
 	vec3 albedo = texture(material.albedoMap, fs_in.texCoords).rgb;
 	float metallic = texture(material.metallicMap, fs_in.texCoords).r;
 	float roughness = texture(material.roughnessMap, fs_in.texCoords).r;
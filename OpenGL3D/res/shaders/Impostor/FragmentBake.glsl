@@ -0,0 +1,19 @@
+#version 440
+
+in vec3 normal;
+in vec2 texCoords;
+
+layout (location = 0) out vec4 albedo;
+layout (location = 1) out vec4 normalDepth;
+
+uniform sampler2D diffuseMap;
+
+void main()
+{
+	// Premultiplied by coverage, like the cleared background, which is 0 in every channel of
+	// both atlases. Mip levels then hold coverage weighted averages, and FragmentImpostor.glsl
+	// divides by alpha to get the surface back rather than a blend with the background.
+	albedo = vec4(texture(diffuseMap, texCoords).rgb, 1.0);
+	// depth runs from the front of the bounding sphere (0) to its back (1)
+	normalDepth = vec4(normalize(normal) * 0.5 + 0.5, gl_FragCoord.z);
+}
@@ -0,0 +1,195 @@
+#version 440
+#define COUNT_POINT_LIGHT 4
+
+// lit like FragmentCore.glsl, with the albedo standing in for both material maps
+struct PointLight {
+	vec3 position;
+
+	float constant;
+	float linear;
+	float quadratic;
+
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+struct DirLight {
+	vec3 direction;
+
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+struct Spotlight
+{
+	vec3 position;
+	vec3 direction;
+
+	float cutOff;
+	float outerCutOff;
+
+	float constant;
+	float linear;
+	float quadratic;
+
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+
+	bool on;
+};
+
+in vec3 fragPos;
+in vec2 frameLocals[4];
+flat in vec2 frameCells[4];
+flat in vec4 frameWeights;
+flat in vec4 rotation;
+flat in vec3 center;
+flat in vec3 toCamera;
+flat in float radius;
+
+out vec4 fragColor;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+
+uniform sampler2D albedoAtlas;
+uniform sampler2D normalDepthAtlas;
+uniform int framesPerSide;
+uniform float shininess;
+
+// distances over which the impostor fades in against the mesh (see FragmentCore.glsl)
+uniform vec2 fadeRange;
+
+uniform DirLight dirLight;
+uniform PointLight pointLights[COUNT_POINT_LIGHT];
+uniform Spotlight spotlight;
+
+vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo);
+vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo);
+vec3 calcSpotlight(Spotlight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo);
+
+vec3 quatRotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// 4x4 ordered dither threshold, the same pattern as FragmentCore.glsl
+float ditherThreshold()
+{
+	const float bayer[16] = float[](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+	ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+	return (bayer[pixel.y * 4 + pixel.x] + 0.5) / 16.0;
+}
+
+void main()
+{
+	// blend the frames by weight; the atlases are premultiplied by coverage (see FragmentBake.glsl),
+	// so where a frame has no surface it drops out, and the sums divide by the total coverage
+	vec3 albedo = vec3(0.0);
+	vec4 normalDepth = vec4(0.0);
+	float coverage = 0.0;
+	for (int i = 0; i < 4; i++)
+	{
+		vec2 local = frameLocals[i];
+		if (any(lessThan(local, vec2(0.0))) || any(greaterThan(local, vec2(1.0))))
+			continue;
+
+		vec2 uv = (frameCells[i] + local) / float(framesPerSide);
+		vec4 frameAlbedo = texture(albedoAtlas, uv);
+		vec4 frameNormalDepth = texture(normalDepthAtlas, uv);
+
+		albedo += frameWeights[i] * frameAlbedo.rgb;
+		normalDepth += frameWeights[i] * frameNormalDepth;
+		coverage += frameWeights[i] * frameAlbedo.a;
+	}
+
+	if (coverage < 0.5)
+		discard;
+
+	albedo /= coverage;
+	normalDepth /= coverage;
+	float depth = normalDepth.w;
+	vec3 norm = normalize(quatRotate(rotation, normalDepth.xyz * 2.0 - 1.0));
+
+	// move from the quad to the surface, so the depth test and the lighting see the mesh
+	vec3 surfacePos = fragPos + toCamera * radius * (1.0 - 2.0 * depth);
+	vec4 clip = projection * view * vec4(surfacePos, 1.0);
+	gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+	if (fadeRange.y > fadeRange.x)
+	{
+		float fade = clamp((length(surfacePos - viewPos) - fadeRange.x) / (fadeRange.y - fadeRange.x), 0.0, 1.0);
+		if (ditherThreshold() >= fade)
+			discard;
+	}
+
+	vec3 viewDir = normalize(viewPos - surfacePos);
+	vec3 result = calcDirLight(dirLight, norm, viewDir, albedo);
+
+	for (int i = 0; i < COUNT_POINT_LIGHT; i++)
+		result += calcPointLight(pointLights[i], norm, surfacePos, viewDir, albedo);
+
+	if (spotlight.on)
+		result += calcSpotlight(spotlight, norm, surfacePos, viewDir, albedo);
+
+	fragColor = vec4(result, 1.0);
+}
+
+vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo)
+{
+	vec3 ambient = light.ambient * albedo;
+
+	vec3 lightDir = normalize(-light.direction);
+	float diff = max(dot(normal, lightDir), 0.0);
+	vec3 diffuse = diff * light.diffuse * albedo;
+
+	vec3 reflectDir = reflect(-lightDir, normal);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+	vec3 specular = spec * light.specular * albedo;
+
+	return ambient + diffuse + specular;
+}
+
+vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo)
+{
+	vec3 ambient = light.ambient * albedo;
+
+	vec3 lightDir = normalize(light.position - fragPos);
+	float diff = max(dot(normal, lightDir), 0.0);
+	vec3 diffuse = diff * light.diffuse * albedo;
+
+	vec3 reflectDir = reflect(-lightDir, normal);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+	vec3 specular = spec * light.specular * albedo;
+
+	float dist = length(light.position - fragPos);
+	float attenuation = 1.0 / (light.constant + light.linear * dist + light.quadratic * dist * dist);
+
+	return attenuation * (ambient + diffuse + specular);
+}
+
+vec3 calcSpotlight(Spotlight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo)
+{
+	vec3 ambient = light.ambient * albedo;
+
+	vec3 lightDir = normalize(light.position - fragPos);
+	float diff = max(dot(normal, lightDir), 0.0);
+	vec3 diffuse = diff * light.diffuse * albedo;
+
+	vec3 reflectDir = reflect(-lightDir, normal);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+	vec3 specular = spec * light.specular * albedo;
+
+	float theta = max(dot(lightDir, normalize(-light.direction)), 0.0);
+	float epsilon = light.cutOff - light.outerCutOff;
+	float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+
+	float dist = length(light.position - fragPos);
+	float attenuation = 1.0 / (light.constant + light.linear * dist + light.quadratic * dist * dist);
+
+	return attenuation * intensity * (ambient + diffuse + specular);
+}
@@ -0,0 +1,73 @@
+// Fragment prelude (see Shader::loadPreludeProgram) for the PBR and IBL FragmentCore.glsl, drawn
+// over the quads of VertexSphere.glsl: in place of the interpolated VS_OUT it declares fs_in,
+// which traceSphere fills at the nearest hit of the view ray with the instance's sphere. The
+// surface matches PRIMITIVE_UV_SPHERE in src/Primitives.cpp: unit radius, texture coordinates
+// and tangents of its parametrisation. texture() takes its level of detail from screen space
+// derivatives, so the u seam and the silhouette show a line of the coarsest level where those
+// jump.
+#define SPHERE_IMPOSTOR
+
+in SPHERE_OUT {
+	vec3 quadPos;
+	flat vec3 position;
+	flat vec4 rotation;
+	flat vec3 scale;
+} sphere_in;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// the hit is never nearer than the quad, which keeps early depth testing
+layout (depth_greater) out float gl_FragDepth;
+
+struct SphereSurface {
+	vec3 worldPos;
+	vec3 normal;
+	mat3 TBN;
+	vec2 texCoords;
+};
+
+SphereSurface fs_in;
+
+vec3 sphereRotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// Fills fs_in and gl_FragDepth; false when the ray misses. Needs camPos and PI declared before the prelude.
+bool traceSphere()
+{
+	// in object space the instance is the unit sphere
+	vec4 inverseRotation = vec4(-sphere_in.rotation.xyz, sphere_in.rotation.w);
+	vec3 origin = sphereRotate(inverseRotation, camPos - sphere_in.position) / sphere_in.scale;
+	vec3 direction = normalize(sphereRotate(inverseRotation, sphere_in.quadPos - camPos) / sphere_in.scale);
+
+	// |origin + t direction| = 1, nearer root
+	float b = dot(origin, direction);
+	float discriminant = b * b - (dot(origin, origin) - 1.0);
+	if (discriminant < 0.0)
+		return false;
+	float t = -b - sqrt(discriminant);
+	if (t < 0.0)
+		return false;
+	vec3 p = origin + t * direction;
+
+	// (sin theta sin phi, cos theta, sin theta cos phi), u = phi / 2 pi, v = 1 - theta / pi
+	float phi = atan(p.x, p.z);
+	fs_in.texCoords = vec2(phi < 0.0 ? phi / (2.0 * PI) + 1.0 : phi / (2.0 * PI),
+		1.0 - acos(clamp(p.y, -1.0, 1.0)) / PI);
+	vec3 tangent = vec3(cos(phi), 0.0, -sin(phi));
+
+	// as PBR/VertexCore.glsl transforms the mesh's vertices; the bitangent sign is 1
+	vec4 rotation = sphere_in.rotation;
+	vec3 normal = normalize(sphereRotate(rotation, p / sphere_in.scale));
+	tangent = normalize(sphereRotate(rotation, tangent * sphere_in.scale));
+	tangent = normalize(tangent - dot(tangent, normal) * normal);
+	fs_in.TBN = mat3(tangent, cross(normal, tangent), normal);
+	fs_in.normal = normal;
+	fs_in.worldPos = sphere_in.position + sphereRotate(rotation, p * sphere_in.scale);
+
+	vec4 clip = projection * view * vec4(fs_in.worldPos, 1.0);
+	gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+	return true;
+}
@@ -0,0 +1,19 @@
+#version 440
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec3 normal;
+out vec2 texCoords;
+
+// orthographic view of the bounding sphere along one direction of the atlas
+uniform mat4 viewProjection;
+
+void main()
+{
+	// object space: the impostor rotates normals with the instance
+	normal = aNormal;
+	texCoords = aTexCoords;
+	gl_Position = viewProjection * vec4(aPos, 1.0);
+}
@@ -0,0 +1,95 @@
+#version 440
+
+// ModelInstanceLayout; the quad's corners come from gl_VertexID
+layout (location = 3) in vec3 aInstancePosition;
+layout (location = 4) in vec4 aInstanceRotation;
+layout (location = 5) in vec3 aInstanceScale;
+
+// billboard position, and where it lands in the four nearest frames of the atlas: the frame's
+// cell and the position within it, 0 to 1 across the bounding sphere
+out vec3 fragPos;
+out vec2 frameLocals[4];
+flat out vec2 frameCells[4];
+flat out vec4 frameWeights;
+flat out vec4 rotation;
+flat out vec3 center;
+flat out vec3 toCamera;
+flat out float radius;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+
+// object space bounding sphere of the baked mesh
+uniform vec4 boundingSphere;
+uniform int framesPerSide;
+
+const vec2 corners[4] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 1.0), vec2(1.0, 1.0));
+
+vec3 quatRotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// octahedronDecode must match the one in src/Impostor.cpp
+vec2 octahedronEncode(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.xy;
+	if (n.z < 0.0)
+		e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return e;
+}
+
+vec3 octahedronDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
+
+// the baking camera's right and up for a direction, as glm::lookAt builds them from frameUp in src/Impostor.cpp
+void frameBasis(vec3 direction, out vec3 right, out vec3 up)
+{
+	vec3 worldUp = abs(direction.y) > 0.99 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+	right = normalize(cross(worldUp, direction));
+	up = cross(direction, right);
+}
+
+void main()
+{
+	rotation = normalize(aInstanceRotation);
+	float maxScale = max(aInstanceScale.x, max(aInstanceScale.y, aInstanceScale.z));
+	center = aInstancePosition + quatRotate(rotation, boundingSphere.xyz * aInstanceScale);
+	radius = boundingSphere.w * maxScale;
+	toCamera = normalize(viewPos - center);
+
+	// quad through the centre, facing the camera
+	vec3 right, up;
+	frameBasis(toCamera, right, up);
+	vec2 corner = corners[gl_VertexID];
+	fragPos = center + (corner.x * right + corner.y * up) * radius;
+
+	// the view direction in object space picks a cell of the octahedral grid; blend its four nearest frames
+	vec4 inverseRotation = vec4(-rotation.xyz, rotation.w);
+	vec3 objectDirection = quatRotate(inverseRotation, toCamera);
+	vec2 grid = (octahedronEncode(objectDirection) * 0.5 + 0.5) * float(framesPerSide) - 0.5;
+	vec2 first = clamp(floor(grid), vec2(0.0), vec2(float(framesPerSide - 2)));
+	vec2 blend = clamp(grid - first, 0.0, 1.0);
+	frameWeights = vec4((1.0 - blend.x) * (1.0 - blend.y), blend.x * (1.0 - blend.y), (1.0 - blend.x) * blend.y, blend.x * blend.y);
+
+	// each frame sees the corner by orthographic projection along its own direction
+	vec3 objectCorner = quatRotate(inverseRotation, fragPos - center) / maxScale;
+	for (int i = 0; i < 4; i++)
+	{
+		vec2 frame = first + vec2(i & 1, i >> 1);
+		vec3 frameRight, frameUp;
+		frameBasis(octahedronDecode((frame + 0.5) / float(framesPerSide) * 2.0 - 1.0), frameRight, frameUp);
+
+		frameCells[i] = frame;
+		frameLocals[i] = vec2(dot(objectCorner, frameRight), dot(objectCorner, frameUp)) / boundingSphere.w * 0.5 + 0.5;
+	}
+
+	gl_Position = projection * view * vec4(fragPos, 1.0);
+}
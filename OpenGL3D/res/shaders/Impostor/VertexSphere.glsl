@@ -0,0 +1,52 @@
+#version 440
+
+// PbrInstanceLayout; the quad's corners come from gl_VertexID
+layout (location = 5) in vec3 aInstancePosition;
+layout (location = 6) in vec4 aInstanceRotation;
+layout (location = 7) in vec3 aInstanceScale;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 camPos;
+
+// the quad position, and the instance to intersect in FragmentSphere.glsl
+out SPHERE_OUT {
+	vec3 quadPos;
+	flat vec3 position;
+	flat vec4 rotation;
+	flat vec3 scale;
+} vs_out;
+
+const vec2 corners[4] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 1.0), vec2(1.0, 1.0));
+
+void main()
+{
+	vs_out.position = aInstancePosition;
+	vs_out.rotation = normalize(aInstanceRotation);
+	vs_out.scale = aInstanceScale;
+
+	// The unit sphere, scaled, fits in a sphere of the largest scale. The quad faces the camera on the
+	// near side of that bound and is just large enough to hold its silhouette, so every ray hit
+	// lies behind the quad (see depth_greater in FragmentSphere.glsl).
+	float radius = max(aInstanceScale.x, max(aInstanceScale.y, aInstanceScale.z));
+	vec3 toCamera = camPos - aInstancePosition;
+	float dist = length(toCamera);
+	if (dist <= radius * 1.001)
+	{
+		// the camera is inside; the sphere's inside is culled like a mesh's back faces
+		gl_Position = vec4(0.0);
+		return;
+	}
+	toCamera /= dist;
+
+	vec3 worldUp = abs(toCamera.y) > 0.99 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+	vec3 right = normalize(cross(worldUp, toCamera));
+	vec3 up = cross(toCamera, right);
+
+	// the tangent cone from the camera, cut by the quad's plane at dist - radius
+	float halfSize = (dist - radius) * radius / sqrt(dist * dist - radius * radius);
+	vec2 corner = corners[gl_VertexID];
+	vs_out.quadPos = aInstancePosition + toCamera * radius + (corner.x * right + corner.y * up) * halfSize;
+
+	gl_Position = projection * view * vec4(vs_out.quadPos, 1.0);
+}
@@ -0,0 +1,90 @@
+#version 440
+layout (local_size_x = 64) in;
+
+struct Meshlet {
+	vec4 sphere;
+	vec4 coneApex;
+	vec4 coneAxis;	// w: cutoff
+	uint indexOffset;
+	uint indexCount;
+	uint padding[2];
+};
+
+struct DrawCommand {
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Meshlets { Meshlet meshlets[]; };
+layout (std430, binding = 1) readonly buffer SourceIndices { uint sourceIndices[]; };
+layout (std430, binding = 2) writeonly buffer OutputIndices { uint outputIndices[]; };
+layout (std430, binding = 3) buffer Commands { DrawCommand commands[]; };
+// ModelInstanceLayout, 8 words per instance: position xyz, rotation as 4 snorm16, scale xyz
+layout (std430, binding = 4) readonly buffer Instances { uint transforms[]; };
+
+uniform vec4 frustumPlanes[6];
+uniform mat4 viewProjection;
+uniform vec3 viewPos;
+
+// test against a HiZPyramid of an earlier depth pass
+uniform bool occlusion;
+
+shared bool visible;
+shared uint writeOffset;
+
+vec3 quatRotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// isOccluded and the pyramid's uniforms, see HiZPyramid
+#pragma compute_prelude
+
+void main()
+{
+	uint meshletIndex = gl_WorkGroupID.x;
+	uint instance = gl_WorkGroupID.y;
+	Meshlet meshlet = meshlets[meshletIndex];
+
+	// The first invocation tests the meshlet and reserves space for its indices.
+	if (gl_LocalInvocationIndex == 0)
+	{
+		uint base = instance * 8;
+		vec3 position = uintBitsToFloat(uvec3(transforms[base], transforms[base + 1], transforms[base + 2]));
+		vec4 rotation = normalize(vec4(unpackSnorm2x16(transforms[base + 3]), unpackSnorm2x16(transforms[base + 4])));
+		vec3 scale = uintBitsToFloat(uvec3(transforms[base + 5], transforms[base + 6], transforms[base + 7]));
+
+		vec3 center = position + quatRotate(rotation, meshlet.sphere.xyz * scale);
+		float radius = meshlet.sphere.w * max(scale.x, max(scale.y, scale.z));
+
+		bool inside = true;
+		for (int i = 0; i < 6; i++)
+			inside = inside && dot(frustumPlanes[i].xyz, center) + frustumPlanes[i].w >= -radius;
+
+		if (inside && meshlet.coneAxis.w <= 1.0)
+		{
+			vec3 apex = position + quatRotate(rotation, meshlet.coneApex.xyz * scale);
+			// the axis is a normal direction: inverse scale, as for normals in VertexCore.glsl
+			vec3 axis = normalize(quatRotate(rotation, meshlet.coneAxis.xyz / scale));
+			inside = dot(normalize(apex - viewPos), axis) < meshlet.coneAxis.w;
+		}
+
+		if (inside && occlusion)
+			inside = !isOccluded(center, radius);
+
+		visible = inside;
+		if (inside)
+			writeOffset = commands[instance].firstIndex + atomicAdd(commands[instance].count, meshlet.indexCount);
+	}
+
+	barrier();
+
+	if (!visible)
+		return;
+
+	for (uint i = gl_LocalInvocationIndex; i < meshlet.indexCount; i += gl_WorkGroupSize.x)
+		outputIndices[writeOffset + i] = sourceIndices[meshlet.indexOffset + i];
+}
@@ -3,6 +3,7 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 7) in vec4 aTangent;	// w: bitangent sign
 
 out VS_OUT {
 	vec2 texCoords;
@@ -13,13 +14,11 @@ out VS_OUT {
 } vs_out;
 
 uniform mat4 model;
+// transpose(inverse(mat3(model))), from the application
+uniform mat3 normalMatrix;
 uniform mat4 view;
 uniform mat4 projection;
 
-uniform vec3 tangent;
-uniform vec3 bitangent;
-uniform vec3 normal;
-
 uniform vec3 lightPos;
 uniform vec3 viewPos;
 
@@ -27,9 +26,11 @@ uniform sampler2D normalMap;
 
 void main()
 {
-	vec3 T = normalize(vec3(model * vec4(tangent, 0.0)));
-	vec3 B = normalize(vec3(model * vec4(bitangent, 0.0)));
-	vec3 N = normalize(vec3(model * vec4(normal, 0.0)));
+	vec3 N = normalize(normalMatrix * aNormal);
+	vec3 T = normalize(mat3(model) * aTangent.xyz);
+	T = normalize(T - dot(T, N) * N);
+	// a mirroring model flips the handedness of the frame
+	vec3 B = cross(N, T) * aTangent.w * sign(determinant(mat3(model)));
 	mat3 TBN = transpose(mat3(T, B, N));
 
 	vs_out.tangentLightPos = TBN * lightPos;
@@ -1,10 +1,12 @@
 #version 440
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoords;
-layout (location = 2) in vec3 aTangent;
-layout (location = 3) in vec3 aBitangent;
+layout (location = 2) in vec4 aTangent;	// w: bitangent sign
 layout (location = 4) in vec3 aNormal;
-layout (location = 5) in mat4 model;
+// PbrInstanceLayout: scale, then rotation (unit quaternion), then translation
+layout (location = 5) in vec3 aInstancePosition;
+layout (location = 6) in vec4 aInstanceRotation;
+layout (location = 7) in vec3 aInstanceScale;
 
 
 uniform mat4 view;
@@ -17,16 +19,24 @@ out VS_OUT {
 	vec2 texCoords;
 } vs_out;
 
+vec3 quatRotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
 void main()
 {
-	mat3 normalMatrix = mat3(transpose(inverse(model)));
+	vec4 rotation = normalize(aInstanceRotation);
 
-	vec3 tangent = normalize(normalMatrix * aTangent);
-	vec3 bitangent = normalize(normalMatrix * aBitangent);
-	vec3 normal = normalize(normalMatrix * aNormal);
+	// the inverse transpose of rotation * scale is rotation * inverse scale
+	vec3 normal = normalize(quatRotate(rotation, aNormal / aInstanceScale));
+	vec3 tangent = normalize(quatRotate(rotation, aTangent.xyz * aInstanceScale));
+	tangent = normalize(tangent - dot(tangent, normal) * normal);
+	vec3 bitangent = cross(normal, tangent) * aTangent.w;
 	vs_out.TBN = mat3(tangent, bitangent, normal);
+	vs_out.normal = normal;
 
-	vs_out.worldPos = vec3(model * vec4(aPos, 1.0));
+	vs_out.worldPos = aInstancePosition + quatRotate(rotation, aPos * aInstanceScale);
 	vs_out.texCoords = aTexCoords;
 	gl_Position = projection * view * vec4(vs_out.worldPos, 1.0);
 }
\ No newline at end of file
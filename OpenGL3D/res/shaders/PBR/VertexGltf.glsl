@@ -0,0 +1,39 @@
+#version 440
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+layout (location = 2) in vec4 aTangent;	// w: bitangent sign
+layout (location = 4) in vec3 aNormal;
+layout (location = 5) in mat4 model;
+
+
+uniform mat4 view;
+uniform mat4 projection;
+
+out VS_OUT {
+	vec3 worldPos;
+	vec3 normal;
+	mat3 TBN;
+	vec2 texCoords;
+} vs_out;
+
+void main()
+{
+	// cofactor matrix: the inverse transpose scaled by the determinant, without the inverse;
+	// the sign of the determinant keeps normals of mirrored models pointing out
+	mat3 normalMatrix = mat3(cross(model[1].xyz, model[2].xyz), cross(model[2].xyz, model[0].xyz), cross(model[0].xyz, model[1].xyz))
+		* sign(determinant(mat3(model)));
+
+	vec3 normal = normalize(normalMatrix * aNormal);
+
+	// Primitives without tangents get an arbitrary basis around the normal.
+	vec3 tangent = dot(aTangent.xyz, aTangent.xyz) > 0.0 ? normalize(normalMatrix * aTangent.xyz)
+		: normalize(cross(abs(normal.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0), normal));
+	tangent = normalize(tangent - dot(tangent, normal) * normal);
+	vec3 bitangent = cross(normal, tangent) * (aTangent.w < 0.0 ? -1.0 : 1.0);
+	vs_out.TBN = mat3(tangent, bitangent, normal);
+	vs_out.normal = normal;
+
+	vs_out.worldPos = vec3(model * vec4(aPos, 1.0));
+	vs_out.texCoords = aTexCoords;
+	gl_Position = projection * view * vec4(vs_out.worldPos, 1.0);
+}
@@ -0,0 +1,150 @@
+#version 440
+layout (local_size_x = 256) in;
+
+// 48 bytes per body, see BeltSimulation
+struct Body {
+	// xyz position, w scale
+	vec4 positionScale;
+	// xyz velocity, w spin about the body's own y axis in radians per second
+	vec4 velocitySpin;
+	// unit quaternion (x, y, z, w)
+	vec4 rotation;
+};
+
+layout (std430, binding = 0) buffer Bodies { Body bodies[]; };
+// ModelInstanceLayout, 8 words per instance: position xyz, rotation as 4 snorm16, scale xyz
+layout (std430, binding = 1) writeonly buffer Instances { uint transforms[]; };
+
+uniform uint bodyCount;
+// true: seed every body from seed, false: advance them by deltaTime
+uniform bool initialize;
+uniform uint seed;
+uniform float deltaTime;
+
+// the belt orbits center, pulled by gravity (G times the central mass)
+uniform vec3 center;
+uniform float gravity;
+uniform float innerRadius;
+uniform float outerRadius;
+uniform float thickness;
+uniform float minScale;
+uniform float maxScale;
+uniform float maxSpin;
+// relative spread of the initial velocities around a circular orbit
+uniform float eccentricity;
+
+// bodies bounce off this sphere (xyz centre, w radius; w = 0 for none); bodyRadius is their
+// bounding radius at scale 1
+uniform vec4 collider;
+uniform float bodyRadius;
+uniform float restitution;
+
+const float PI = 3.14159265359;
+
+uint hash(uint x)
+{
+	// PCG output permutation
+	x = x * 747796405u + 2891336453u;
+	x = ((x >> ((x >> 28u) + 4u)) ^ x) * 277803737u;
+	return (x >> 22u) ^ x;
+}
+
+// uniform in [0, 1), advancing state
+float random(inout uint state)
+{
+	state = hash(state);
+	return float(state >> 8) / 16777216.0;
+}
+
+vec4 quatMultiply(vec4 a, vec4 b)
+{
+	return vec4(a.w * b.xyz + b.w * a.xyz + cross(a.xyz, b.xyz), a.w * b.w - dot(a.xyz, b.xyz));
+}
+
+Body seedBody(uint index)
+{
+	uint state = hash(index ^ hash(seed));
+
+	// uniform over the ring's area
+	float radius = sqrt(mix(innerRadius * innerRadius, outerRadius * outerRadius, random(state)));
+	float angle = 2.0 * PI * random(state);
+	vec3 radial = vec3(sin(angle), 0.0, cos(angle));
+	vec3 position = center + radius * radial + vec3(0.0, (random(state) * 2.0 - 1.0) * thickness, 0.0);
+
+	// circular speed, spread a little along and out of the orbit so that the rings precess
+	vec3 tangent = vec3(cos(angle), 0.0, -sin(angle));
+	float speed = sqrt(gravity / radius);
+	vec3 velocity = speed * (tangent * (1.0 + (random(state) * 2.0 - 1.0) * eccentricity)
+		+ vec3(0.0, (random(state) * 2.0 - 1.0) * eccentricity, 0.0));
+
+	// uniformly random orientation (Shoemake)
+	float u1 = random(state);
+	float u2 = 2.0 * PI * random(state);
+	float u3 = 2.0 * PI * random(state);
+	vec4 rotation = vec4(sqrt(1.0 - u1) * sin(u2), sqrt(1.0 - u1) * cos(u2), sqrt(u1) * sin(u3), sqrt(u1) * cos(u3));
+
+	Body body;
+	body.positionScale = vec4(position, mix(minScale, maxScale, random(state)));
+	body.velocitySpin = vec4(velocity, (random(state) * 2.0 - 1.0) * maxSpin);
+	body.rotation = rotation;
+	return body;
+}
+
+void advance(inout Body body)
+{
+	vec3 position = body.positionScale.xyz;
+	vec3 velocity = body.velocitySpin.xyz;
+
+	// semi-implicit Euler keeps the orbits from spiralling in or out
+	vec3 toCenter = center - position;
+	float distanceSquared = max(dot(toCenter, toCenter), 1e-4);
+	velocity += gravity * toCenter * inversesqrt(distanceSquared) / distanceSquared * deltaTime;
+	position += velocity * deltaTime;
+
+	if (collider.w > 0.0)
+	{
+		// push out of the collider and reflect the normal part of the velocity
+		vec3 offset = position - collider.xyz;
+		float minDistance = collider.w + bodyRadius * body.positionScale.w;
+		float dist = length(offset);
+		if (dist < minDistance && dist > 0.0)
+		{
+			vec3 normal = offset / dist;
+			position = collider.xyz + normal * minDistance;
+			float approach = dot(velocity, normal);
+			if (approach < 0.0)
+				velocity -= (1.0 + restitution) * approach * normal;
+		}
+	}
+
+	// spin about the local y axis
+	float halfAngle = 0.5 * body.velocitySpin.w * deltaTime;
+	body.rotation = normalize(quatMultiply(body.rotation, vec4(0.0, sin(halfAngle), 0.0, cos(halfAngle))));
+
+	body.positionScale.xyz = position;
+	body.velocitySpin.xyz = velocity;
+}
+
+void main()
+{
+	uint index = gl_GlobalInvocationID.x;
+	if (index >= bodyCount)
+		return;
+
+	Body body = initialize ? seedBody(index) : bodies[index];
+	if (!initialize)
+		advance(body);
+	bodies[index] = body;
+
+	uint base = index * 8;
+	vec3 position = body.positionScale.xyz;
+	float scale = body.positionScale.w;
+	transforms[base] = floatBitsToUint(position.x);
+	transforms[base + 1] = floatBitsToUint(position.y);
+	transforms[base + 2] = floatBitsToUint(position.z);
+	transforms[base + 3] = packSnorm2x16(body.rotation.xy);
+	transforms[base + 4] = packSnorm2x16(body.rotation.zw);
+	transforms[base + 5] = floatBitsToUint(scale);
+	transforms[base + 6] = floatBitsToUint(scale);
+	transforms[base + 7] = floatBitsToUint(scale);
+}
@@ -0,0 +1,20 @@
+#version 440
+struct Material {
+	sampler2D diffuse;
+};
+
+in vec3 fragPos;
+in vec3 normal;
+in vec2 texCoords;
+
+out vec4 fragColor;
+
+uniform Material material;
+uniform vec3 lightDirection;
+
+void main()
+{
+	vec3 albedo = texture(material.diffuse, texCoords).rgb;
+	float diffuse = max(dot(normalize(normal), -normalize(lightDirection)), 0.0);
+	fragColor = vec4(albedo * (0.2 + 0.8 * diffuse), 1.0);
+}
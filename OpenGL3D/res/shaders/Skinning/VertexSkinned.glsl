@@ -0,0 +1,39 @@
+#version 440
+// aPos, aNormal, aTexCoords, aJoints and aWeights, see SkinnedModel::GetVertexInputs
+#pragma vertex_inputs
+
+// boneCount matrices per instance
+layout (std430, binding = 0) readonly buffer Palettes
+{
+	mat4 palettes[];
+};
+
+layout (std430, binding = 1) readonly buffer Instances
+{
+	mat4 models[];
+};
+
+out vec3 fragPos;
+out vec3 normal;
+out vec2 texCoords;
+
+uniform int boneCount;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	int base = gl_InstanceID * boneCount;
+	mat4 skin = aWeights.x * palettes[base + int(aJoints.x)]
+		+ aWeights.y * palettes[base + int(aJoints.y)]
+		+ aWeights.z * palettes[base + int(aJoints.z)]
+		+ aWeights.w * palettes[base + int(aJoints.w)];
+
+	mat4 model = models[gl_InstanceID] * skin;
+
+	// bones are rigid and instances scale uniformly, so no inverse transpose is needed
+	fragPos = vec3(model * vec4(aPos, 1.0));
+	normal = mat3(model) * aNormal;
+	texCoords = aTexCoords;
+	gl_Position = projection * view * vec4(fragPos, 1.0);
+}
@@ -0,0 +1,27 @@
+#version 440
+struct Material {
+	sampler2D diffuse;
+};
+
+in vec3 fragPos;
+in vec3 normal;
+in vec2 texCoords;
+
+out vec4 fragColor;
+
+uniform Material material;
+uniform vec3 lightDirection;
+uniform vec3 camPos;
+// distance at which the fog fully hides the geometry, just inside the load radius
+uniform float fogDistance;
+
+void main()
+{
+	vec3 albedo = texture(material.diffuse, texCoords).rgb;
+	float diffuse = max(dot(normalize(normal), -normalize(lightDirection)), 0.0);
+	vec3 color = albedo * (0.2 + 0.8 * diffuse);
+
+	vec3 fogColor = vec3(0.6, 0.7, 0.8);
+	float fog = clamp(length(fragPos - camPos) / fogDistance, 0.0, 1.0);
+	fragColor = vec4(mix(color, fogColor, fog * fog), 1.0);
+}
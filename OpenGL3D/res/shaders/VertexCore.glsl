@@ -4,7 +4,10 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
-layout (location = 3) in mat4 instanceMatrix;
+// ModelInstanceLayout: scale, then rotation (unit quaternion), then translation
+layout (location = 3) in vec3 aInstancePosition;
+layout (location = 4) in vec4 aInstanceRotation;
+layout (location = 5) in vec3 aInstanceScale;
 
 out vec3 fragPos;
 out vec3 normal;
@@ -16,17 +19,30 @@ uniform mat4 projection;
 
 uniform bool instanced;
 
-void main()
+vec3 quatRotate(vec4 q, vec3 v)
 {
-	mat4 aModel;
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
 
+void main()
+{
 	if (instanced)
-		aModel = instanceMatrix;
+	{
+		vec4 rotation = normalize(aInstanceRotation);
+		fragPos = aInstancePosition + quatRotate(rotation, aPos * aInstanceScale);
+		// the inverse transpose of rotation * scale is rotation * inverse scale
+		normal = normalize(quatRotate(rotation, aNormal / aInstanceScale));
+	}
 	else
-		aModel = model;
+	{
+		fragPos = vec3(model * vec4(aPos, 1.0f));
+		// cofactor matrix: the inverse transpose scaled by the determinant, without the inverse;
+		// the sign of the determinant keeps normals of mirrored models pointing out
+		mat3 normalMatrix = mat3(cross(model[1].xyz, model[2].xyz), cross(model[2].xyz, model[0].xyz), cross(model[0].xyz, model[1].xyz))
+			* sign(determinant(mat3(model)));
+		normal = normalize(normalMatrix * aNormal);
+	}
 
-	fragPos = vec3(aModel * vec4(aPos, 1.0f));
 	gl_Position = projection * view * vec4(fragPos, 1.0f);
-	normal = mat3(transpose(inverse(aModel))) * aNormal;
 	texCoords = aTexCoords;
-}
\ No newline at end of file
+}
@@ -0,0 +1,469 @@
+#include "pch.h"
+#include "AabbTree.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <emmintrin.h>
+#include <limits>
+
+static const unsigned int nullNode = ~0u;
+
+static float surfaceArea(const glm::vec3& min, const glm::vec3& max)
+{
+	const glm::vec3 size = max - min;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static bool contains(const glm::vec3& outerMin, const glm::vec3& outerMax, const glm::vec3& min, const glm::vec3& max)
+{
+	return outerMin.x <= min.x && outerMin.y <= min.y && outerMin.z <= min.z
+		&& max.x <= outerMax.x && max.y <= outerMax.y && max.z <= outerMax.z;
+}
+
+// frustum planes as structure of arrays, the first four planes then the last two repeated
+struct FrustumPlanes
+{
+	__m128 x[2], y[2], z[2], w[2];
+
+	explicit FrustumPlanes(const Frustum& frustum)
+	{
+		const glm::vec4* p = frustum.planes;
+		x[0] = _mm_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x);
+		y[0] = _mm_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y);
+		z[0] = _mm_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z);
+		w[0] = _mm_setr_ps(p[0].w, p[1].w, p[2].w, p[3].w);
+		x[1] = _mm_setr_ps(p[4].x, p[5].x, p[4].x, p[5].x);
+		y[1] = _mm_setr_ps(p[4].y, p[5].y, p[4].y, p[5].y);
+		z[1] = _mm_setr_ps(p[4].z, p[5].z, p[4].z, p[5].z);
+		w[1] = _mm_setr_ps(p[4].w, p[5].w, p[4].w, p[5].w);
+	}
+};
+
+enum BoxClass
+{
+	BOX_OUTSIDE,
+	BOX_INTERSECTS,
+	BOX_INSIDE
+};
+
+static BoxClass classifyBox(const FrustumPlanes& planes, const glm::vec3& min, const glm::vec3& max)
+{
+	const __m128 minX = _mm_set1_ps(min.x), minY = _mm_set1_ps(min.y), minZ = _mm_set1_ps(min.z);
+	const __m128 maxX = _mm_set1_ps(max.x), maxY = _mm_set1_ps(max.y), maxZ = _mm_set1_ps(max.z);
+	const __m128 zero = _mm_setzero_ps();
+
+	int outside = 0;
+	int straddling = 0;
+	for (int i = 0; i < 2; i++)
+	{
+		// farthest and nearest corner along each plane's normal
+		const __m128 x0 = _mm_mul_ps(planes.x[i], minX), x1 = _mm_mul_ps(planes.x[i], maxX);
+		const __m128 y0 = _mm_mul_ps(planes.y[i], minY), y1 = _mm_mul_ps(planes.y[i], maxY);
+		const __m128 z0 = _mm_mul_ps(planes.z[i], minZ), z1 = _mm_mul_ps(planes.z[i], maxZ);
+		const __m128 farthest = _mm_add_ps(_mm_add_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_add_ps(_mm_max_ps(z0, z1), planes.w[i]));
+		const __m128 nearest = _mm_add_ps(_mm_add_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_add_ps(_mm_min_ps(z0, z1), planes.w[i]));
+
+		outside |= _mm_movemask_ps(_mm_cmplt_ps(farthest, zero));
+		straddling |= _mm_movemask_ps(_mm_cmplt_ps(nearest, zero));
+	}
+
+	if (outside)
+		return BOX_OUTSIDE;
+	return straddling ? BOX_INTERSECTS : BOX_INSIDE;
+}
+
+// distance at which the ray enters the box, or FLT_MAX when it misses within maxDistance
+static float rayBox(__m128 origin, __m128 inverseDirection, const glm::vec3& min, const glm::vec3& max, float maxDistance)
+{
+	const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_setr_ps(min.x, min.y, min.z, 0.0f), origin), inverseDirection);
+	const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_setr_ps(max.x, max.y, max.z, 0.0f), origin), inverseDirection);
+	// A zero direction component gives 0 * inf = NaN when the origin lies on that face's plane;
+	// the ray then runs within the slab, so the lane must not limit the entry or exit.
+	const __m128 ordered = _mm_cmpord_ps(t0, t1);
+	const __m128 infinity = _mm_set1_ps(std::numeric_limits<float>::infinity());
+	const __m128 negativeInfinity = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+	__m128 enter = _mm_or_ps(_mm_and_ps(ordered, _mm_min_ps(t0, t1)), _mm_andnot_ps(ordered, negativeInfinity));
+	__m128 exit = _mm_or_ps(_mm_and_ps(ordered, _mm_max_ps(t0, t1)), _mm_andnot_ps(ordered, infinity));
+
+	// the fourth lane is 0 * inverse; keep it out of the reduction
+	enter = _mm_max_ps(enter, _mm_shuffle_ps(enter, enter, _MM_SHUFFLE(2, 2, 2, 2)));
+	enter = _mm_max_ps(enter, _mm_shuffle_ps(enter, enter, _MM_SHUFFLE(1, 1, 1, 1)));
+	exit = _mm_min_ps(exit, _mm_shuffle_ps(exit, exit, _MM_SHUFFLE(2, 2, 2, 2)));
+	exit = _mm_min_ps(exit, _mm_shuffle_ps(exit, exit, _MM_SHUFFLE(1, 1, 1, 1)));
+
+	const float entry = std::max(_mm_cvtss_f32(enter), 0.0f);
+	const float leave = std::min(_mm_cvtss_f32(exit), maxDistance);
+	return entry <= leave ? entry : FLT_MAX;
+}
+
+AabbTree::AabbTree(float margin)
+	: margin(margin), root(nullNode), freeList(nullNode)
+{}
+
+AabbProxy AabbTree::Insert(const glm::vec3& min, const glm::vec3& max, unsigned int userData, unsigned int category)
+{
+	const unsigned int leaf = allocateNode();
+	Node& node = nodes[leaf];
+	node.min = min - glm::vec3(margin);
+	node.max = max + glm::vec3(margin);
+	node.userData = userData;
+	node.category = category;
+	node.height = 0;
+
+	insertLeaf(leaf);
+	proxyCount++;
+	return leaf;
+}
+
+void AabbTree::Remove(AabbProxy proxy)
+{
+	removeLeaf(proxy);
+	freeNode(proxy);
+	proxyCount--;
+}
+
+bool AabbTree::Move(AabbProxy proxy, const glm::vec3& min, const glm::vec3& max, const glm::vec3& displacement)
+{
+	if (contains(nodes[proxy].min, nodes[proxy].max, min, max))
+		return false;
+
+	// grown ahead along the motion, so the next few moves stay inside
+	const glm::vec3 ahead = displacement * 2.0f;
+	removeLeaf(proxy);
+	nodes[proxy].min = min - glm::vec3(margin) + glm::min(ahead, glm::vec3(0.0f));
+	nodes[proxy].max = max + glm::vec3(margin) + glm::max(ahead, glm::vec3(0.0f));
+	insertLeaf(proxy);
+	return true;
+}
+
+unsigned int AabbTree::GetUserData(AabbProxy proxy) const
+{
+	return nodes[proxy].userData;
+}
+
+size_t AabbTree::GetProxyCount() const
+{
+	return proxyCount;
+}
+
+int AabbTree::GetHeight() const
+{
+	return root == nullNode ? 0 : nodes[root].height;
+}
+
+void AabbTree::QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& outUserData, unsigned int categoryMask) const
+{
+	if (root == nullNode)
+		return;
+
+	const FrustumPlanes planes(frustum);
+	std::vector<unsigned int> stack;
+	stack.reserve(64);
+	stack.push_back(root);
+
+	while (!stack.empty())
+	{
+		const unsigned int index = stack.back();
+		stack.pop_back();
+
+		const Node& node = nodes[index];
+		if (!(node.category & categoryMask))
+			continue;
+
+		const BoxClass box = classifyBox(planes, node.min, node.max);
+		if (box == BOX_OUTSIDE)
+			continue;
+
+		if (box == BOX_INSIDE)
+			collectLeaves(index, outUserData, categoryMask);
+		else if (node.height == 0)
+			outUserData.push_back(node.userData);
+		else
+		{
+			stack.push_back(node.children[0]);
+			stack.push_back(node.children[1]);
+		}
+	}
+}
+
+void AabbTree::QuerySphere(const glm::vec3& center, float radius, std::vector<unsigned int>& outUserData, unsigned int categoryMask) const
+{
+	if (root == nullNode)
+		return;
+
+	std::vector<unsigned int> stack;
+	stack.reserve(64);
+	stack.push_back(root);
+
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+
+		if (!(node.category & categoryMask))
+			continue;
+
+		// squared distance from the centre to the box
+		const glm::vec3 offset = glm::max(glm::max(node.min - center, center - node.max), glm::vec3(0.0f));
+		if (glm::dot(offset, offset) > radius * radius)
+			continue;
+
+		if (node.height == 0)
+			outUserData.push_back(node.userData);
+		else
+		{
+			stack.push_back(node.children[0]);
+			stack.push_back(node.children[1]);
+		}
+	}
+}
+
+bool AabbTree::RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& outHit,
+	unsigned int categoryMask, const std::function<float(unsigned int, float)>& hitTest) const
+{
+	if (root == nullNode)
+		return false;
+
+	const __m128 rayOrigin = _mm_setr_ps(origin.x, origin.y, origin.z, 0.0f);
+	const __m128 inverseDirection = _mm_div_ps(_mm_set1_ps(1.0f), _mm_setr_ps(direction.x, direction.y, direction.z, 1.0f));
+
+	bool hit = false;
+	std::vector<unsigned int> stack;
+	stack.reserve(64);
+	if (rayBox(rayOrigin, inverseDirection, nodes[root].min, nodes[root].max, maxDistance) != FLT_MAX)
+		stack.push_back(root);
+
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+
+		if (!(node.category & categoryMask))
+			continue;
+
+		if (node.height == 0)
+		{
+			// an earlier hit may have cut the ray short of this box since it was pushed
+			const float boxDistance = rayBox(rayOrigin, inverseDirection, node.min, node.max, maxDistance);
+			if (boxDistance == FLT_MAX)
+				continue;
+
+			const float distance = hitTest ? hitTest(node.userData, maxDistance) : boxDistance;
+			if (distance >= 0.0f && distance <= maxDistance)
+			{
+				maxDistance = distance;
+				outHit.userData = node.userData;
+				outHit.distance = distance;
+				hit = true;
+			}
+			continue;
+		}
+
+		// the nearer child goes on top
+		const Node& first = nodes[node.children[0]];
+		const Node& second = nodes[node.children[1]];
+		const float firstDistance = rayBox(rayOrigin, inverseDirection, first.min, first.max, maxDistance);
+		const float secondDistance = rayBox(rayOrigin, inverseDirection, second.min, second.max, maxDistance);
+		const bool firstNearer = firstDistance <= secondDistance;
+		const float nearDistance = firstNearer ? firstDistance : secondDistance;
+		const float farDistance = firstNearer ? secondDistance : firstDistance;
+
+		if (farDistance != FLT_MAX)
+			stack.push_back(firstNearer ? node.children[1] : node.children[0]);
+		if (nearDistance != FLT_MAX)
+			stack.push_back(firstNearer ? node.children[0] : node.children[1]);
+	}
+
+	return hit;
+}
+
+unsigned int AabbTree::allocateNode()
+{
+	if (freeList == nullNode)
+	{
+		nodes.push_back(Node());
+		freeList = (unsigned int)nodes.size() - 1;
+		nodes[freeList].parent = nullNode;
+	}
+
+	const unsigned int index = freeList;
+	freeList = nodes[index].parent;
+
+	Node& node = nodes[index];
+	node.parent = nullNode;
+	node.children[0] = nullNode;
+	node.children[1] = nullNode;
+	node.userData = 0;
+	node.category = 0;
+	node.height = 0;
+	return index;
+}
+
+void AabbTree::freeNode(unsigned int node)
+{
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+}
+
+void AabbTree::insertLeaf(unsigned int leaf)
+{
+	if (root == nullNode)
+	{
+		root = leaf;
+		nodes[root].parent = nullNode;
+		return;
+	}
+
+	// walk down towards the sibling whose box grows the least, stopping where a new parent is cheaper
+	const glm::vec3 leafMin = nodes[leaf].min;
+	const glm::vec3 leafMax = nodes[leaf].max;
+	unsigned int index = root;
+	while (nodes[index].height > 0)
+	{
+		const Node& node = nodes[index];
+		const float area = surfaceArea(node.min, node.max);
+		const float combinedArea = surfaceArea(glm::min(node.min, leafMin), glm::max(node.max, leafMax));
+
+		// a new parent of this node and the leaf; every ancestor grows by the same amount either way
+		const float cost = 2.0f * combinedArea;
+		const float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		for (int i = 0; i < 2; i++)
+		{
+			const Node& child = nodes[node.children[i]];
+			const float grown = surfaceArea(glm::min(child.min, leafMin), glm::max(child.max, leafMax));
+			childCosts[i] = (child.height == 0 ? grown : grown - surfaceArea(child.min, child.max)) + inheritanceCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+			break;
+
+		index = childCosts[0] < childCosts[1] ? node.children[0] : node.children[1];
+	}
+
+	const unsigned int sibling = index;
+	const unsigned int oldParent = nodes[sibling].parent;
+	const unsigned int newParent = allocateNode();
+
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].children[0] = sibling;
+	nodes[newParent].children[1] = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent == nullNode)
+		root = newParent;
+	else if (nodes[oldParent].children[0] == sibling)
+		nodes[oldParent].children[0] = newParent;
+	else
+		nodes[oldParent].children[1] = newParent;
+
+	refit(newParent);
+}
+
+void AabbTree::removeLeaf(unsigned int leaf)
+{
+	if (leaf == root)
+	{
+		root = nullNode;
+		return;
+	}
+
+	const unsigned int parent = nodes[leaf].parent;
+	const unsigned int grandParent = nodes[parent].parent;
+	const unsigned int sibling = nodes[parent].children[0] == leaf ? nodes[parent].children[1] : nodes[parent].children[0];
+
+	// the sibling takes the parent's place
+	nodes[sibling].parent = grandParent;
+	freeNode(parent);
+
+	if (grandParent == nullNode)
+	{
+		root = sibling;
+		return;
+	}
+
+	if (nodes[grandParent].children[0] == parent)
+		nodes[grandParent].children[0] = sibling;
+	else
+		nodes[grandParent].children[1] = sibling;
+
+	refit(grandParent);
+}
+
+void AabbTree::refit(unsigned int index)
+{
+	while (index != nullNode)
+	{
+		index = rotate(index);
+
+		fit(index);
+		index = nodes[index].parent;
+	}
+}
+
+unsigned int AabbTree::rotate(unsigned int a)
+{
+	if (nodes[a].height < 2)
+		return a;
+
+	// the taller child b moves up into a's place; its shorter child moves down to a
+	const unsigned int children[2] = { nodes[a].children[0], nodes[a].children[1] };
+	const int balance = nodes[children[1]].height - nodes[children[0]].height;
+	if (balance >= -1 && balance <= 1)
+		return a;
+
+	const int up = balance > 1 ? 1 : 0;
+	const unsigned int b = children[up];
+	const unsigned int taller = nodes[nodes[b].children[0]].height > nodes[nodes[b].children[1]].height ? 0 : 1;
+	const unsigned int kept = nodes[b].children[taller];
+	const unsigned int moved = nodes[b].children[1 - taller];
+
+	nodes[b].parent = nodes[a].parent;
+	if (nodes[b].parent == nullNode)
+		root = b;
+	else if (nodes[nodes[b].parent].children[0] == a)
+		nodes[nodes[b].parent].children[0] = b;
+	else
+		nodes[nodes[b].parent].children[1] = b;
+
+	nodes[b].children[0] = a;
+	nodes[b].children[1] = kept;
+	nodes[a].parent = b;
+	nodes[a].children[up] = moved;
+	nodes[moved].parent = a;
+
+	// a is now below b, so it is refitted first
+	fit(a);
+	fit(b);
+	return b;
+}
+
+void AabbTree::fit(unsigned int index)
+{
+	Node& node = nodes[index];
+	const Node& first = nodes[node.children[0]];
+	const Node& second = nodes[node.children[1]];
+	node.min = glm::min(first.min, second.min);
+	node.max = glm::max(first.max, second.max);
+	node.category = first.category | second.category;
+	node.height = 1 + std::max(first.height, second.height);
+}
+
+void AabbTree::collectLeaves(unsigned int index, std::vector<unsigned int>& outUserData, unsigned int categoryMask) const
+{
+	const Node& node = nodes[index];
+	if (!(node.category & categoryMask))
+		return;
+
+	if (node.height == 0)
+	{
+		outUserData.push_back(node.userData);
+		return;
+	}
+
+	collectLeaves(node.children[0], outUserData, categoryMask);
+	collectLeaves(node.children[1], outUserData, categoryMask);
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <vec3.hpp>
+
+#include "Frustum.h"
+
+typedef unsigned int AabbProxy;
+constexpr AabbProxy invalidAabbProxy = ~0u;
+
+struct RayHit
+{
+	unsigned int userData = 0;
+	float distance = 0.0f;
+};
+
+/*
+	Dynamic bounding volume hierarchy over axis aligned boxes, for anything that needs to
+	ask what is near a point, inside the view or under a ray: culling, light assignment,
+	picking. Every proxy carries the caller's userData and a category bit set that queries
+	filter on, so one tree can hold instances, meshes and lights side by side.
+
+	Leaves store their box grown by a margin, and ahead along their motion. Move only touches
+	the tree when the new box leaves the grown one, so small per-frame motion of many objects
+	is mostly a comparison.
+	Otherwise the leaf is removed and reinserted where it adds the least surface area, and
+	the boxes and heights of its ancestors are refitted on the way up, rotating subtrees
+	whose children differ in height by more than one.
+
+	The frustum query tests a node against all six planes at once with SSE and takes whole
+	subtrees that are fully inside without further tests. Ray casts visit the nearer child
+	first and shrink the ray with every hit. Queries are const and may run on several threads.
+*/
+class AabbTree
+{
+public:
+	explicit AabbTree(float margin = 0.1f);
+
+	AabbProxy Insert(const glm::vec3& min, const glm::vec3& max, unsigned int userData, unsigned int category = 1);
+	void Remove(AabbProxy proxy);
+	// Returns true when the proxy had to be reinserted. displacement, the expected motion per
+	// move, stretches the grown box ahead of the object.
+	bool Move(AabbProxy proxy, const glm::vec3& min, const glm::vec3& max, const glm::vec3& displacement = glm::vec3(0.0f));
+
+	unsigned int GetUserData(AabbProxy proxy) const;
+	size_t GetProxyCount() const;
+	int GetHeight() const;
+
+	// The queries append the userData of the matching proxies whose category shares a bit with
+	// categoryMask. Boxes are the grown ones, so results may include near misses.
+	void QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& outUserData, unsigned int categoryMask = ~0u) const;
+	void QuerySphere(const glm::vec3& center, float radius, std::vector<unsigned int>& outUserData, unsigned int categoryMask = ~0u) const;
+
+	// Nearest hit along the ray within maxDistance; direction need not be normalised, distances
+	// are in units of its length. hitTest, if given, refines a leaf whose box the ray enters:
+	// it returns the distance of the real hit, below the current maximum, or a negative value.
+	// Without it the box itself is hit.
+	bool RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& outHit,
+		unsigned int categoryMask = ~0u, const std::function<float(unsigned int, float)>& hitTest = nullptr) const;
+
+private:
+	struct Node
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+		unsigned int userData;
+		unsigned int category;
+		// the next free node while on the free list
+		unsigned int parent;
+		unsigned int children[2];
+		// 0 for leaves, -1 for free nodes
+		int height;
+	};
+
+	float margin;
+	std::vector<Node> nodes;
+	unsigned int root;
+	unsigned int freeList;
+	size_t proxyCount = 0;
+
+	unsigned int allocateNode();
+	void freeNode(unsigned int node);
+	void insertLeaf(unsigned int leaf);
+	void removeLeaf(unsigned int leaf);
+	// refits boxes and heights from node up to the root, rotating where unbalanced
+	void refit(unsigned int node);
+	unsigned int rotate(unsigned int node);
+	// box, category and height from the children
+	void fit(unsigned int node);
+	void collectLeaves(unsigned int node, std::vector<unsigned int>& outUserData, unsigned int categoryMask) const;
+};
@@ -0,0 +1,204 @@
+#include "pch.h"
+#include "Animation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+static const float unorm16Max = 65535.0f;
+static const float snorm16Max = 32767.0f;
+
+static uint16_t quantizeUnorm16(float value)
+{
+	return (uint16_t)(std::min(std::max(value, 0.0f), 1.0f) * unorm16Max + 0.5f);
+}
+
+static int16_t quantizeSnorm16(float value)
+{
+	return (int16_t)std::lround(std::min(std::max(value, -1.0f), 1.0f) * snorm16Max);
+}
+
+static void quantizeTimes(const std::vector<float>& times, float duration, std::vector<uint16_t>& outTimes)
+{
+	outTimes.resize(times.size());
+	for (size_t i = 0; i < times.size(); i++)
+		outTimes[i] = duration > 0.0f ? quantizeUnorm16(times[i] / duration) : 0;
+}
+
+static void quantizeVectors(const std::vector<glm::vec3>& values, glm::vec3& outMin, glm::vec3& outExtent, std::vector<uint16_t>& outValues)
+{
+	if (values.empty())
+		return;
+
+	glm::vec3 max = values[0];
+	outMin = values[0];
+	for (const glm::vec3& value : values)
+	{
+		outMin = glm::min(outMin, value);
+		max = glm::max(max, value);
+	}
+	outExtent = max - outMin;
+
+	outValues.resize(values.size() * 3);
+	for (size_t i = 0; i < values.size(); i++)
+		for (int c = 0; c < 3; c++)
+			outValues[i * 3 + c] = outExtent[c] > 0.0f ? quantizeUnorm16((values[i][c] - outMin[c]) / outExtent[c]) : 0;
+}
+
+// Key at or before keyTime (in quantised units); outAlpha blends towards the key after it.
+static size_t findKey(const std::vector<uint16_t>& times, float keyTime, float& outAlpha)
+{
+	const size_t next = std::upper_bound(times.begin(), times.end(), keyTime,
+		[](float time, uint16_t key) { return time < (float)key; }) - times.begin();
+
+	outAlpha = 0.0f;
+	if (next == 0)
+		return 0;
+	if (next == times.size())
+		return next - 1;
+
+	const size_t key = next - 1;
+	outAlpha = (keyTime - times[key]) / (float)(times[next] - times[key]);
+	return key;
+}
+
+static inline __m128 loadVec3(const glm::vec3& v)
+{
+	return _mm_setr_ps(v.x, v.y, v.z, 0.0f);
+}
+
+static inline __m128 decodeUnorm16x3(const uint16_t* key)
+{
+	const __m128i packed = _mm_setr_epi32(key[0], key[1], key[2], 0);
+	return _mm_mul_ps(_mm_cvtepi32_ps(packed), _mm_set1_ps(1.0f / unorm16Max));
+}
+
+static inline __m128 decodeSnorm16x4(const int16_t* key)
+{
+	// sign extend the four int16 into the upper halves, then shift them back down
+	const __m128i packed = _mm_loadl_epi64((const __m128i*)key);
+	const __m128i widened = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+	return _mm_mul_ps(_mm_cvtepi32_ps(widened), _mm_set1_ps(1.0f / snorm16Max));
+}
+
+static inline __m128 lerp4(__m128 a, __m128 b, float alpha)
+{
+	return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(alpha)));
+}
+
+// dot product broadcast to all lanes
+static inline __m128 dot4(__m128 a, __m128 b)
+{
+	__m128 products = _mm_mul_ps(a, b);
+	products = _mm_add_ps(products, _mm_shuffle_ps(products, products, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_add_ps(products, _mm_shuffle_ps(products, products, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+static inline __m128 nlerp(__m128 a, __m128 b, float alpha)
+{
+	// shortest arc: flip b when the two rotations lie in opposite hemispheres
+	b = _mm_xor_ps(b, _mm_and_ps(dot4(a, b), _mm_set1_ps(-0.0f)));
+
+	const __m128 q = lerp4(a, b, alpha);
+	const __m128 lengthSquared = dot4(q, q);
+
+	// rsqrt estimate refined by one Newton-Raphson step
+	__m128 inverseLength = _mm_rsqrt_ps(lengthSquared);
+	inverseLength = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), inverseLength),
+		_mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_mul_ps(lengthSquared, inverseLength), inverseLength)));
+	return _mm_mul_ps(q, inverseLength);
+}
+
+void AnimationClip::AddTrack(unsigned int joint,
+	const std::vector<float>& translationTimes, const std::vector<glm::vec3>& translations,
+	const std::vector<float>& rotationTimes, const std::vector<glm::quat>& rotations,
+	const std::vector<float>& scaleTimes, const std::vector<glm::vec3>& scales)
+{
+	AnimationTrack track;
+	track.joint = joint;
+
+	quantizeTimes(translationTimes, duration, track.translationTimes);
+	quantizeVectors(translations, track.translationMin, track.translationExtent, track.translations);
+
+	quantizeTimes(scaleTimes, duration, track.scaleTimes);
+	quantizeVectors(scales, track.scaleMin, track.scaleExtent, track.scales);
+
+	quantizeTimes(rotationTimes, duration, track.rotationTimes);
+	track.rotations.resize(rotations.size() * 4);
+	glm::quat previous(1.0f, 0.0f, 0.0f, 0.0f);
+	for (size_t i = 0; i < rotations.size(); i++)
+	{
+		// keep neighbouring keys in one hemisphere so the blend never takes the long way
+		glm::quat q = glm::normalize(rotations[i]);
+		if (i > 0 && glm::dot(previous, q) < 0.0f)
+			q = -q;
+		previous = q;
+
+		track.rotations[i * 4 + 0] = quantizeSnorm16(q.x);
+		track.rotations[i * 4 + 1] = quantizeSnorm16(q.y);
+		track.rotations[i * 4 + 2] = quantizeSnorm16(q.z);
+		track.rotations[i * 4 + 3] = quantizeSnorm16(q.w);
+	}
+
+	tracks.push_back(std::move(track));
+}
+
+void AnimationClip::Sample(float time, JointPose* poses) const
+{
+	float keyTime = 0.0f;
+	if (duration > 0.0f)
+	{
+		float wrapped = std::fmod(time, duration);
+		if (wrapped < 0.0f)
+			wrapped += duration;
+		keyTime = wrapped / duration * unorm16Max;
+	}
+
+	alignas(16) float result[4];
+	for (const AnimationTrack& track : tracks)
+	{
+		JointPose& pose = poses[track.joint];
+		float alpha;
+
+		if (!track.translationTimes.empty())
+		{
+			const size_t key = findKey(track.translationTimes, keyTime, alpha);
+			const size_t next = std::min(key + 1, track.translationTimes.size() - 1);
+			const __m128 value = lerp4(decodeUnorm16x3(&track.translations[key * 3]), decodeUnorm16x3(&track.translations[next * 3]), alpha);
+
+			_mm_store_ps(result, _mm_add_ps(loadVec3(track.translationMin), _mm_mul_ps(value, loadVec3(track.translationExtent))));
+			pose.translation = glm::vec3(result[0], result[1], result[2]);
+		}
+
+		if (!track.rotationTimes.empty())
+		{
+			const size_t key = findKey(track.rotationTimes, keyTime, alpha);
+			const size_t next = std::min(key + 1, track.rotationTimes.size() - 1);
+
+			_mm_store_ps(result, nlerp(decodeSnorm16x4(&track.rotations[key * 4]), decodeSnorm16x4(&track.rotations[next * 4]), alpha));
+			pose.rotation = glm::quat(result[3], result[0], result[1], result[2]);
+		}
+
+		if (!track.scaleTimes.empty())
+		{
+			const size_t key = findKey(track.scaleTimes, keyTime, alpha);
+			const size_t next = std::min(key + 1, track.scaleTimes.size() - 1);
+			const __m128 value = lerp4(decodeUnorm16x3(&track.scales[key * 3]), decodeUnorm16x3(&track.scales[next * 3]), alpha);
+
+			_mm_store_ps(result, _mm_add_ps(loadVec3(track.scaleMin), _mm_mul_ps(value, loadVec3(track.scaleExtent))));
+			pose.scale = glm::vec3(result[0], result[1], result[2]);
+		}
+	}
+}
+
+size_t AnimationClip::GetKeyBytes() const
+{
+	size_t bytes = 0;
+	for (const AnimationTrack& track : tracks)
+	{
+		bytes += (track.translationTimes.size() + track.translations.size()) * sizeof(uint16_t);
+		bytes += track.rotationTimes.size() * sizeof(uint16_t) + track.rotations.size() * sizeof(int16_t);
+		bytes += (track.scaleTimes.size() + track.scales.size()) * sizeof(uint16_t);
+	}
+	return bytes;
+}
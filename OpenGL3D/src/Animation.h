@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vec3.hpp>
+#include <gtc\quaternion.hpp>
+
+// local transform of one joint
+struct JointPose
+{
+	glm::vec3 translation = glm::vec3(0.0f);
+	glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::vec3 scale = glm::vec3(1.0f);
+};
+
+/*
+	Keys of one joint in compressed form. Key times are quantised to 16 bits over the clip
+	duration, rotations to 4x snorm16 and translations/scales to 3x unorm16 within the
+	bounds of the track: 8 bytes per rotation key and 6 per vector key plus 2 for the time.
+*/
+struct AnimationTrack
+{
+	unsigned int joint = 0;
+
+	std::vector<uint16_t> translationTimes;
+	std::vector<uint16_t> translations;
+	glm::vec3 translationMin = glm::vec3(0.0f);
+	glm::vec3 translationExtent = glm::vec3(0.0f);
+
+	std::vector<uint16_t> rotationTimes;
+	std::vector<int16_t> rotations;
+
+	std::vector<uint16_t> scaleTimes;
+	std::vector<uint16_t> scales;
+	glm::vec3 scaleMin = glm::vec3(1.0f);
+	glm::vec3 scaleExtent = glm::vec3(0.0f);
+};
+
+/*
+	Keyframed joint animation. Sample finds the surrounding keys of every track with a binary
+	search over the quantised times and decodes/blends them with SSE (lerp for vectors,
+	shortest-arc nlerp for rotations). Sample is const and keeps no state, so any number of
+	instances can be sampled from worker threads at once.
+*/
+class AnimationClip
+{
+public:
+	std::string name;
+	// seconds, set before adding tracks
+	float duration = 0.0f;
+	std::vector<AnimationTrack> tracks;
+
+	// Compresses and adds the keys of one joint. Key times are in seconds.
+	void AddTrack(unsigned int joint,
+		const std::vector<float>& translationTimes, const std::vector<glm::vec3>& translations,
+		const std::vector<float>& rotationTimes, const std::vector<glm::quat>& rotations,
+		const std::vector<float>& scaleTimes, const std::vector<glm::vec3>& scales);
+
+	// Overwrites the poses of all animated joints at time (seconds, wrapped into the clip).
+	void Sample(float time, JointPose* poses) const;
+
+	// bytes of compressed key data
+	size_t GetKeyBytes() const;
+};
@@ -0,0 +1,116 @@
+#include "pch.h"
+#include "BeltSimulation.h"
+#include "Shader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <gtc\type_ptr.hpp>
+
+// must match local_size_x and the Body struct in res/shaders/Simulation/ComputeBelt.glsl
+static const unsigned int workGroupSize = 256;
+static const size_t bodySize = 3 * 4 * sizeof(float);
+// longer frames are split so that the orbits stay stable after a stall
+static const float maxStep = 1.0f / 30.0f;
+static const unsigned int maxStepsPerFrame = 4;
+
+BeltSimulation::~BeltSimulation()
+{
+	release();
+}
+
+bool BeltSimulation::Setup(InstanceBuffer& instances, unsigned int count, const BeltParameters& parameters)
+{
+	release();
+
+	if (!count)
+	{
+		std::cerr << "[Error: BeltSimulation::Setup] No bodies to simulate." << std::endl;
+		return false;
+	}
+
+	if (!Shader::loadComputeProgram(program, "res/shaders/Simulation/ComputeBelt.glsl"))
+	{
+		std::cerr << "[Error: BeltSimulation::Setup] Could not load simulation program." << std::endl;
+		return false;
+	}
+
+	this->instances = &instances;
+	this->count = count;
+	this->parameters = parameters;
+
+	glCreateBuffers(1, &stateBuffer);
+	glNamedBufferStorage(stateBuffer, (GLsizeiptr)count * bodySize, nullptr, 0);
+
+	instances.Reserve(count);
+	instances.SetCount(count);
+
+	dispatch(true, 0.0f);
+	return true;
+}
+
+void BeltSimulation::Step(float deltaTime)
+{
+	if (!program || deltaTime <= 0.0f)
+		return;
+
+	const unsigned int steps = std::min(maxStepsPerFrame, (unsigned int)std::ceil(deltaTime / maxStep));
+	const float step = std::min(deltaTime / steps, maxStep);
+	for (unsigned int i = 0; i < steps; i++)
+		dispatch(false, step);
+}
+
+void BeltSimulation::SetCollider(const glm::vec4& collider)
+{
+	parameters.collider = collider;
+}
+
+unsigned int BeltSimulation::GetCount() const
+{
+	return count;
+}
+
+GLuint BeltSimulation::GetStateBuffer() const
+{
+	return stateBuffer;
+}
+
+void BeltSimulation::dispatch(bool initialize, float deltaTime)
+{
+	glUseProgram(program);
+	glUniform1ui(glGetUniformLocation(program, "bodyCount"), count);
+	glUniform1i(glGetUniformLocation(program, "initialize"), initialize);
+	glUniform1ui(glGetUniformLocation(program, "seed"), parameters.seed);
+	glUniform1f(glGetUniformLocation(program, "deltaTime"), deltaTime);
+
+	glUniform3fv(glGetUniformLocation(program, "center"), 1, glm::value_ptr(parameters.center));
+	glUniform1f(glGetUniformLocation(program, "gravity"), parameters.gravity);
+	glUniform1f(glGetUniformLocation(program, "innerRadius"), parameters.innerRadius);
+	glUniform1f(glGetUniformLocation(program, "outerRadius"), parameters.outerRadius);
+	glUniform1f(glGetUniformLocation(program, "thickness"), parameters.thickness);
+	glUniform1f(glGetUniformLocation(program, "minScale"), parameters.minScale);
+	glUniform1f(glGetUniformLocation(program, "maxScale"), parameters.maxScale);
+	glUniform1f(glGetUniformLocation(program, "maxSpin"), parameters.maxSpin);
+	glUniform1f(glGetUniformLocation(program, "eccentricity"), parameters.eccentricity);
+
+	glUniform4fv(glGetUniformLocation(program, "collider"), 1, glm::value_ptr(parameters.collider));
+	glUniform1f(glGetUniformLocation(program, "bodyRadius"), parameters.bodyRadius);
+	glUniform1f(glGetUniformLocation(program, "restitution"), parameters.restitution);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, stateBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, instances->GetBuffer());
+	glDispatchCompute((count + workGroupSize - 1) / workGroupSize, 1, 1);
+
+	// the next step, the culler and instanced draws read what this one wrote
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void BeltSimulation::release()
+{
+	glDeleteBuffers(1, &stateBuffer);
+	glDeleteProgram(program);
+	stateBuffer = 0;
+	program = 0;
+	instances = nullptr;
+	count = 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <vec3.hpp>
+#include <vec4.hpp>
+
+#include "InstanceBuffer.h"
+
+struct BeltParameters
+{
+	// the belt orbits center, pulled by gravity (G times the central mass)
+	glm::vec3 center = glm::vec3(0.0f);
+	float gravity = 2500.0f;
+	float innerRadius = 70.0f;
+	float outerRadius = 130.0f;
+	// half the height of the belt
+	float thickness = 12.0f;
+	float minScale = 0.05f;
+	float maxScale = 0.25f;
+	// radians per second
+	float maxSpin = 1.0f;
+	// relative spread of the initial velocities around a circular orbit
+	float eccentricity = 0.05f;
+
+	// bodies bounce off this sphere (xyz centre, w radius; w = 0 for none), as spheres of
+	// bodyRadius at scale 1, keeping restitution of the velocity into it
+	glm::vec4 collider = glm::vec4(0.0f);
+	float bodyRadius = 1.0f;
+	float restitution = 0.5f;
+
+	unsigned int seed = 1;
+};
+
+/*
+	A belt of bodies in orbit, simulated entirely on the GPU. Each body keeps 48 bytes of state
+	(position, scale, velocity, spin and rotation) in a storage buffer that never leaves the GPU:
+	Setup seeds it from a hash of the body's index and Step integrates gravity towards the
+	centre, bounces off the collider and spins every body about its own axis, in
+	res/shaders/Simulation/ComputeBelt.glsl. The same pass writes the render transforms in
+	place into an InstanceBuffer (ModelInstanceLayout), which an InstanceCuller or a vertex array
+	reads directly, so nothing is uploaded per frame and the count is bounded by GPU memory only.
+
+	Bodies do not collide with each other.
+*/
+class BeltSimulation
+{
+public:
+	BeltSimulation() = default;
+	~BeltSimulation();
+
+	BeltSimulation(const BeltSimulation&) = delete;
+	BeltSimulation& operator=(const BeltSimulation&) = delete;
+
+	// Grows instances to count and fills both the state and the transforms. instances must
+	// outlive the simulation.
+	bool Setup(InstanceBuffer& instances, unsigned int count, const BeltParameters& parameters);
+	// Advances by deltaTime seconds, in a few steps when the frame was long.
+	void Step(float deltaTime);
+	void SetCollider(const glm::vec4& collider);
+
+	unsigned int GetCount() const;
+	GLuint GetStateBuffer() const;
+
+private:
+	GLuint program = 0;
+	GLuint stateBuffer = 0;
+	InstanceBuffer* instances = nullptr;
+	unsigned int count = 0;
+	BeltParameters parameters;
+
+	void dispatch(bool initialize, float deltaTime);
+	void release();
+};
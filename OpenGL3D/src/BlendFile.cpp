@@ -0,0 +1,426 @@
+#include "pch.h"
+#include "BlendFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+
+static const size_t headerSize = 12;
+
+// Cursor over the DNA1 block; every read is bounds checked.
+struct DnaReader
+{
+	const char* begin;
+	const char* end;
+	const char* at;
+
+	bool Tag(const char* tag)
+	{
+		if (end - at < 4 || memcmp(at, tag, 4) != 0)
+			return false;
+		at += 4;
+		return true;
+	}
+
+	template<typename T>
+	bool Read(T& outValue)
+	{
+		if (end - at < (ptrdiff_t)sizeof(T))
+			return false;
+		memcpy(&outValue, at, sizeof(T));
+		at += sizeof(T);
+		return true;
+	}
+
+	bool ReadString(std::string& outString)
+	{
+		const char* terminator = (const char*)memchr(at, 0, end - at);
+		if (!terminator)
+			return false;
+		outString.assign(at, terminator);
+		at = terminator + 1;
+		return true;
+	}
+
+	// sections start 4-byte aligned relative to the block
+	void Align()
+	{
+		at = begin + ((at - begin + 3) & ~(ptrdiff_t)3);
+		if (at > end)
+			at = end;
+	}
+};
+
+// "*next", "**mat", "co[3]", "obmat[4][4]", "(*func)()"
+static void parseFieldName(const std::string& declaration, BlendField& outField)
+{
+	outField.pointerLevel = 0;
+	outField.arrayLength = 1;
+
+	size_t i = 0;
+	for (; i < declaration.size() && !(std::isalnum((unsigned char)declaration[i]) || declaration[i] == '_'); i++)
+		if (declaration[i] == '*')
+			outField.pointerLevel++;
+
+	const size_t nameBegin = i;
+	while (i < declaration.size() && (std::isalnum((unsigned char)declaration[i]) || declaration[i] == '_'))
+		i++;
+	outField.name = declaration.substr(nameBegin, i - nameBegin);
+
+	for (size_t bracket = declaration.find('[', i); bracket != std::string::npos; bracket = declaration.find('[', bracket + 1))
+		outField.arrayLength *= std::max(1, atoi(declaration.c_str() + bracket + 1));
+}
+
+BlendFile::BlendFile(const std::string& path)
+	: file(path)
+{
+	if (!file.IsOpen())
+	{
+		std::cerr << "[Error: BlendFile] Could not open " << path << "." << std::endl;
+		return;
+	}
+
+	open = parseHeader(path) && parseBlocks(path);
+}
+
+bool BlendFile::parseHeader(const std::string& path)
+{
+	const unsigned char* data = (const unsigned char*)file.GetData();
+	const size_t size = file.GetSize();
+
+	if (size >= 4 && ((data[0] == 0x1F && data[1] == 0x8B) || (data[0] == 0x28 && data[1] == 0xB5 && data[2] == 0x2F && data[3] == 0xFD)))
+	{
+		std::cerr << "[Error: BlendFile] " << path << " is compressed; save it without compression." << std::endl;
+		return false;
+	}
+
+	if (size < headerSize || memcmp(data, "BLENDER", 7) != 0 || (data[7] != '_' && data[7] != '-'))
+	{
+		std::cerr << "[Error: BlendFile] " << path << " is not a .blend file." << std::endl;
+		return false;
+	}
+
+	if (data[8] != 'v')
+	{
+		std::cerr << "[Error: BlendFile] " << path << " is big-endian, which is not supported." << std::endl;
+		return false;
+	}
+
+	pointerSize = data[7] == '_' ? 4 : 8;
+	version = atoi(std::string((const char*)data + 9, 3).c_str());
+	return true;
+}
+
+bool BlendFile::parseBlocks(const std::string& path)
+{
+	const char* data = file.GetData();
+	const size_t size = file.GetSize();
+	const size_t blockHeaderSize = 16 + pointerSize;
+
+	const BlendBlock* dna = nullptr;
+	size_t offset = headerSize;
+	while (true)
+	{
+		if (offset + blockHeaderSize > size)
+		{
+			std::cerr << "[Error: BlendFile] " << path << " is truncated." << std::endl;
+			return false;
+		}
+
+		const char* header = data + offset;
+		if (memcmp(header, "ENDB", 4) == 0)
+			break;
+
+		BlendBlock block;
+		int32_t length, sdnaIndex, count;
+		memcpy(block.code, header, 4);
+		memcpy(&length, header + 4, 4);
+		block.address = ReadPointer(header + 8);
+		memcpy(&sdnaIndex, header + 8 + pointerSize, 4);
+		memcpy(&count, header + 12 + pointerSize, 4);
+
+		if (length < 0 || offset + blockHeaderSize + length > size)
+		{
+			std::cerr << "[Error: BlendFile] Block at " << offset << " in " << path << " is out of range." << std::endl;
+			return false;
+		}
+
+		block.size = (size_t)length;
+		block.sdnaIndex = (unsigned int)sdnaIndex;
+		block.count = (unsigned int)count;
+		block.data = header + blockHeaderSize;
+		blocks.push_back(block);
+
+		offset += blockHeaderSize + length;
+	}
+
+	for (const BlendBlock& block : blocks)
+		if (memcmp(block.code, "DNA1", 4) == 0)
+			dna = &block;
+
+	if (!dna || !parseDna(*dna))
+	{
+		std::cerr << "[Error: BlendFile] " << path << " has no valid SDNA." << std::endl;
+		return false;
+	}
+
+	// raw data blocks are written with struct 0; clamp broken indices the same way
+	for (BlendBlock& block : blocks)
+		if (block.sdnaIndex >= structs.size())
+			block.sdnaIndex = 0;
+
+	for (unsigned int i = 0; i < blocks.size(); i++)
+		if (blocks[i].address)
+			blocksByAddress.push_back(i);
+
+	std::sort(blocksByAddress.begin(), blocksByAddress.end(),
+		[this](unsigned int a, unsigned int b) { return blocks[a].address < blocks[b].address; });
+
+	return true;
+}
+
+bool BlendFile::parseDna(const BlendBlock& block)
+{
+	DnaReader reader = { block.data, block.data + block.size, block.data };
+
+	int32_t count;
+	if (!reader.Tag("SDNA") || !reader.Tag("NAME") || !reader.Read(count) || count < 0)
+		return false;
+
+	std::vector<std::string> names(count);
+	for (std::string& name : names)
+		if (!reader.ReadString(name))
+			return false;
+
+	reader.Align();
+	if (!reader.Tag("TYPE") || !reader.Read(count) || count < 0)
+		return false;
+
+	typeNames.resize(count);
+	for (std::string& type : typeNames)
+		if (!reader.ReadString(type))
+			return false;
+
+	reader.Align();
+	if (!reader.Tag("TLEN"))
+		return false;
+
+	typeLengths.resize(typeNames.size());
+	for (unsigned short& length : typeLengths)
+		if (!reader.Read(length))
+			return false;
+
+	reader.Align();
+	if (!reader.Tag("STRC") || !reader.Read(count) || count < 0)
+		return false;
+
+	structOfType.assign(typeNames.size(), -1);
+	structs.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		BlendStructLayout& layout = structs[i];
+		unsigned short fieldCount;
+		if (!reader.Read(layout.type) || !reader.Read(fieldCount) || layout.type >= typeNames.size())
+			return false;
+
+		layout.size = typeLengths[layout.type];
+		structOfType[layout.type] = i;
+
+		// SDNA structs carry explicit padding, so fields follow each other without gaps
+		size_t offset = 0;
+		layout.fields.resize(fieldCount);
+		for (BlendField& field : layout.fields)
+		{
+			unsigned short name;
+			if (!reader.Read(field.type) || !reader.Read(name) || field.type >= typeNames.size() || name >= names.size())
+				return false;
+
+			parseFieldName(names[name], field);
+			field.offset = offset;
+			field.size = (field.pointerLevel ? pointerSize : typeLengths[field.type]) * field.arrayLength;
+			offset += field.size;
+		}
+
+		if (offset != layout.size)
+			std::cerr << "[Warning: BlendFile] SDNA struct " << typeNames[layout.type] << " has " << offset
+				<< " bytes of fields but a length of " << layout.size << "." << std::endl;
+	}
+
+	return true;
+}
+
+bool BlendFile::IsOpen() const
+{
+	return open;
+}
+
+int BlendFile::GetVersion() const
+{
+	return version;
+}
+
+size_t BlendFile::GetPointerSize() const
+{
+	return pointerSize;
+}
+
+const std::vector<BlendBlock>& BlendFile::GetBlocks() const
+{
+	return blocks;
+}
+
+int BlendFile::FindStruct(const char* name) const
+{
+	for (size_t i = 0; i < structs.size(); i++)
+		if (typeNames[structs[i].type] == name)
+			return (int)i;
+
+	return -1;
+}
+
+int BlendFile::GetStructOfType(unsigned short type) const
+{
+	return type < structOfType.size() ? structOfType[type] : -1;
+}
+
+const BlendStructLayout& BlendFile::GetStruct(int index) const
+{
+	return structs[index];
+}
+
+const std::string& BlendFile::GetTypeName(unsigned short type) const
+{
+	return typeNames[type];
+}
+
+uint64_t BlendFile::ReadPointer(const char* at) const
+{
+	if (pointerSize == 4)
+	{
+		uint32_t address;
+		memcpy(&address, at, 4);
+		return address;
+	}
+
+	uint64_t address;
+	memcpy(&address, at, 8);
+	return address;
+}
+
+const BlendBlock* BlendFile::FindBlock(uint64_t address) const
+{
+	if (!address)
+		return nullptr;
+
+	// last block starting at or before the address
+	auto it = std::upper_bound(blocksByAddress.begin(), blocksByAddress.end(), address,
+		[this](uint64_t value, unsigned int block) { return value < blocks[block].address; });
+	if (it == blocksByAddress.begin())
+		return nullptr;
+
+	const BlendBlock& block = blocks[*(it - 1)];
+	return address - block.address < block.size ? &block : nullptr;
+}
+
+const char* BlendFile::Resolve(uint64_t address) const
+{
+	const BlendBlock* block = FindBlock(address);
+	return block ? block->data + (address - block->address) : nullptr;
+}
+
+BlendFileData BlendFile::GetBlockData(const BlendBlock& block, unsigned int element) const
+{
+	const size_t stride = structs[block.sdnaIndex].size;
+	if ((element + 1) * stride > block.size)
+		return BlendFileData();
+
+	return BlendFileData(this, (int)block.sdnaIndex, block.data + element * stride);
+}
+
+BlendFileData::BlendFileData(const BlendFile* file, int structIndex, const char* data)
+	: file(file), structIndex(structIndex), data(data)
+{
+}
+
+bool BlendFileData::IsValid() const
+{
+	return file && data && structIndex >= 0;
+}
+
+const char* BlendFileData::GetData() const
+{
+	return data;
+}
+
+int BlendFileData::GetStructIndex() const
+{
+	return structIndex;
+}
+
+const BlendField* BlendFileData::FindField(const char* name) const
+{
+	if (!IsValid())
+		return nullptr;
+
+	for (const BlendField& field : file->GetStruct(structIndex).fields)
+		if (field.name == name)
+			return &field;
+
+	return nullptr;
+}
+
+std::string BlendFileData::GetString(const char* name) const
+{
+	const BlendField* field = FindField(name);
+	if (!field || field->pointerLevel)
+		return std::string();
+
+	const char* text = data + field->offset;
+	return std::string(text, std::find(text, text + field->size, '\0'));
+}
+
+BlendFileData BlendFileData::GetMember(const char* name) const
+{
+	const BlendField* field = FindField(name);
+	if (!field || field->pointerLevel || file->GetStructOfType(field->type) < 0)
+		return BlendFileData();
+
+	return BlendFileData(file, file->GetStructOfType(field->type), data + field->offset);
+}
+
+BlendFileData BlendFileData::Follow(const char* name) const
+{
+	const BlendField* field = FindField(name);
+	if (!field || field->pointerLevel != 1)
+		return BlendFileData();
+
+	const uint64_t address = file->ReadPointer(data + field->offset);
+	const BlendBlock* block = file->FindBlock(address);
+	if (!block)
+		return BlendFileData();
+
+	int targetStruct = file->GetStructOfType(field->type);
+	if ((address == block->address && block->sdnaIndex != 0) || targetStruct < 0)
+		targetStruct = (int)block->sdnaIndex;
+
+	// the target has to fit in its block
+	const size_t offset = address - block->address;
+	if (offset + file->GetStruct(targetStruct).size > block->size)
+		return BlendFileData();
+
+	return BlendFileData(file, targetStruct, block->data + offset);
+}
+
+const char* BlendFileData::GetPointer(const char* name, size_t byteCount) const
+{
+	const BlendField* field = FindField(name);
+	if (!field || !field->pointerLevel)
+		return nullptr;
+
+	const uint64_t address = file->ReadPointer(data + field->offset);
+	const BlendBlock* block = file->FindBlock(address);
+	if (!block || address - block->address + byteCount > block->size)
+		return nullptr;
+
+	return block->data + (address - block->address);
+}
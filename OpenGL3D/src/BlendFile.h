@@ -0,0 +1,138 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+struct BlendField
+{
+	// bare name, "co" for "co[3]" and "mat" for "**mat"
+	std::string name;
+	// index into the SDNA type list
+	unsigned short type;
+	// 1 for "*next", 2 for "**mat", 0 for values
+	unsigned int pointerLevel;
+	size_t offset;
+	size_t size;
+	size_t arrayLength;
+};
+
+struct BlendStructLayout
+{
+	unsigned short type;
+	size_t size;
+	std::vector<BlendField> fields;
+};
+
+struct BlendBlock
+{
+	char code[4];
+	size_t size;
+	// address the block had when the file was saved; pointers in other blocks refer to it
+	uint64_t address;
+	unsigned int sdnaIndex;
+	unsigned int count;
+	const char* data;
+};
+
+class BlendFile;
+
+// Typed view of one SDNA struct inside the mapped file. Reads go straight to the mapping.
+class BlendFileData
+{
+public:
+	BlendFileData() = default;
+	BlendFileData(const BlendFile* file, int structIndex, const char* data);
+
+	bool IsValid() const;
+	const char* GetData() const;
+	int GetStructIndex() const;
+
+	// nullptr when the struct has no such field
+	const BlendField* FindField(const char* name) const;
+
+	// Scalar fields, or the first element of an array field. fallback when the field is missing.
+	template<typename T>
+	T Get(const char* name, T fallback = T()) const
+	{
+		const BlendField* field = FindField(name);
+		if (!field || field->pointerLevel || field->size < sizeof(T))
+			return fallback;
+
+		T value;
+		memcpy(&value, data + field->offset, sizeof(T));
+		return value;
+	}
+
+	std::string GetString(const char* name) const;
+	BlendFileData GetMember(const char* name) const;
+
+	// Resolves a pointer field. Pointers to the start of a typed block take the block's struct,
+	// so an ID* to an Image reads as Image; anything else takes the field's struct.
+	BlendFileData Follow(const char* name) const;
+	// Raw target of a pointer field, nullptr when fewer than byteCount bytes are left in its block.
+	const char* GetPointer(const char* name, size_t byteCount = 0) const;
+
+private:
+	const BlendFile* file = nullptr;
+	int structIndex = -1;
+	const char* data = nullptr;
+};
+
+/*
+	Memory mapped .blend file. The header, the file-block headers and the SDNA (the struct
+	layouts the file was written with, see dna.txt for a dump of 2.90) are parsed up front;
+	nothing else is touched until it is read. Pointers stay as the addresses stored in the file
+	and are resolved on access by a binary search over the block addresses, so there is no
+	relocation pass and no copy of the block data.
+
+	Only little-endian files are read in place; compressed files have to be saved
+	uncompressed first.
+*/
+class BlendFile
+{
+public:
+	BlendFile(const std::string& path);
+
+	BlendFile(const BlendFile&) = delete;
+	BlendFile& operator=(const BlendFile&) = delete;
+
+	bool IsOpen() const;
+	// 290 for Blender 2.90
+	int GetVersion() const;
+	size_t GetPointerSize() const;
+	const std::vector<BlendBlock>& GetBlocks() const;
+
+	// -1 when the SDNA has no such struct
+	int FindStruct(const char* name) const;
+	int GetStructOfType(unsigned short type) const;
+	const BlendStructLayout& GetStruct(int index) const;
+	const std::string& GetTypeName(unsigned short type) const;
+
+	uint64_t ReadPointer(const char* at) const;
+	// block containing the address (not only starting at it), nullptr when dangling
+	const BlendBlock* FindBlock(uint64_t address) const;
+	const char* Resolve(uint64_t address) const;
+	BlendFileData GetBlockData(const BlendBlock& block, unsigned int element = 0) const;
+
+private:
+	MappedFile file;
+	bool open = false;
+	int version = 0;
+	size_t pointerSize = 8;
+
+	std::vector<std::string> typeNames;
+	std::vector<unsigned short> typeLengths;
+	std::vector<int> structOfType;
+	std::vector<BlendStructLayout> structs;
+
+	std::vector<BlendBlock> blocks;
+	// block indices sorted by address
+	std::vector<unsigned int> blocksByAddress;
+
+	bool parseHeader(const std::string& path);
+	bool parseBlocks(const std::string& path);
+	bool parseDna(const BlendBlock& block);
+};
@@ -0,0 +1,376 @@
+#include "pch.h"
+#include "BlendLoader.h"
+#include "BlendFile.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+#include <geometric.hpp>
+#include <mat3x3.hpp>
+#include <mat4x4.hpp>
+#include <matrix.hpp>
+
+static const short objectTypeMesh = 1;	// OB_MESH
+static const char polySmooth = 1;		// ME_SMOOTH
+static const unsigned short invalidSlot = 0xFFFF;
+static const size_t polyGrainSize = 4096;
+
+// Element strides and field offsets, looked up once per file from its SDNA.
+struct MeshLayout
+{
+	size_t vertStride = 0, vertCo = 0, vertNo = 0;
+	size_t polyStride = 0, polyLoopStart = 0, polyTotLoop = 0, polyMatNr = 0, polyFlag = 0;
+	size_t loopStride = 0, loopV = 0;
+	size_t uvStride = 0, uvUv = 0;
+
+	// MVert.no was dropped in Blender 3.1
+	bool hasVertexNormals = false;
+};
+
+template<typename T>
+static T readAt(const char* at)
+{
+	T value;
+	memcpy(&value, at, sizeof(T));
+	return value;
+}
+
+static glm::vec3 safeNormalize(const glm::vec3& v)
+{
+	const float length = glm::length(v);
+	return length > 0.0f ? v / length : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+static bool findOffset(const BlendFile& file, int structIndex, const char* name, size_t& outOffset)
+{
+	if (structIndex < 0)
+		return false;
+
+	for (const BlendField& field : file.GetStruct(structIndex).fields)
+	{
+		if (field.name == name)
+		{
+			outOffset = field.offset;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool buildLayout(const BlendFile& file, MeshLayout& outLayout)
+{
+	const int vert = file.FindStruct("MVert");
+	const int poly = file.FindStruct("MPoly");
+	const int loop = file.FindStruct("MLoop");
+	const int uv = file.FindStruct("MLoopUV");
+
+	if (vert < 0 || poly < 0 || loop < 0)
+		return false;
+
+	outLayout.vertStride = file.GetStruct(vert).size;
+	outLayout.polyStride = file.GetStruct(poly).size;
+	outLayout.loopStride = file.GetStruct(loop).size;
+	outLayout.hasVertexNormals = findOffset(file, vert, "no", outLayout.vertNo);
+
+	if (uv >= 0 && findOffset(file, uv, "uv", outLayout.uvUv))
+		outLayout.uvStride = file.GetStruct(uv).size;
+
+	return findOffset(file, vert, "co", outLayout.vertCo)
+		&& findOffset(file, poly, "loopstart", outLayout.polyLoopStart)
+		&& findOffset(file, poly, "totloop", outLayout.polyTotLoop)
+		&& findOffset(file, poly, "mat_nr", outLayout.polyMatNr)
+		&& findOffset(file, poly, "flag", outLayout.polyFlag)
+		&& findOffset(file, loop, "v", outLayout.loopV);
+}
+
+static int loopVertex(const MeshLayout& layout, const char* loops, int loop, int vertCount)
+{
+	return std::max(0, std::min(readAt<int>(loops + loop * layout.loopStride + layout.loopV), vertCount - 1));
+}
+
+// Newell normal, scaled by twice the polygon area
+static glm::vec3 polyNormal(const MeshLayout& layout, const char* verts, const char* loops, int vertCount, int loopStart, int corners)
+{
+	glm::vec3 normal(0.0f);
+	for (int c = 0; c < corners; c++)
+	{
+		const int v0 = loopVertex(layout, loops, loopStart + c, vertCount);
+		const int v1 = loopVertex(layout, loops, loopStart + (c + 1) % corners, vertCount);
+		normal += glm::cross(readAt<glm::vec3>(verts + v0 * layout.vertStride + layout.vertCo), readAt<glm::vec3>(verts + v1 * layout.vertStride + layout.vertCo));
+	}
+	return normal;
+}
+
+static std::string getIdName(const BlendFileData& data)
+{
+	// ID names carry a two letter type code ("OBCube", "MAMaterial")
+	const std::string name = data.GetMember("id").GetString("name");
+	return name.size() > 2 ? name.substr(2) : name;
+}
+
+static std::string getImagePath(const BlendFileData& image)
+{
+	std::string path = image.GetString("name");
+	if (path.empty())
+		path = image.GetString("filepath");
+
+	// "//" marks paths relative to the .blend file
+	if (path.compare(0, 2, "//") == 0)
+		path = path.substr(2);
+	std::replace(path.begin(), path.end(), '\\', '/');
+	return path;
+}
+
+static void loadMaterial(const BlendFileData& material, BlendMaterial& outMaterial)
+{
+	outMaterial.name = getIdName(material);
+	outMaterial.diffuse = glm::vec3(material.Get<float>("r", 0.8f), material.Get<float>("g", 0.8f), material.Get<float>("b", 0.8f));
+	outMaterial.metallic = material.Get<float>("metallic", 0.0f);
+	outMaterial.roughness = material.Get<float>("roughness", 0.5f);
+
+	const BlendFileData tree = material.Follow("nodetree");
+	if (!material.Get<char>("use_nodes") || !tree.IsValid())
+		return;
+
+	// image textures by the socket they feed
+	for (BlendFileData link = tree.GetMember("links").Follow("first"); link.IsValid(); link = link.Follow("next"))
+	{
+		const BlendFileData from = link.Follow("fromnode");
+		if (from.GetString("idname") != "ShaderNodeTexImage")
+			continue;
+
+		const BlendFileData image = from.Follow("id");
+		const std::string socket = link.Follow("tosock").GetString("name");
+		if (!image.IsValid())
+			continue;
+
+		if ((socket == "Base Color" || socket == "Color") && outMaterial.diffuseMap.empty())
+			outMaterial.diffuseMap = getImagePath(image);
+		else if (socket == "Specular" && outMaterial.specularMap.empty())
+			outMaterial.specularMap = getImagePath(image);
+	}
+
+	// otherwise the first image node
+	for (BlendFileData node = tree.GetMember("nodes").Follow("first"); node.IsValid() && outMaterial.diffuseMap.empty(); node = node.Follow("next"))
+		if (node.GetString("idname") == "ShaderNodeTexImage" && node.Follow("id").IsValid())
+			outMaterial.diffuseMap = getImagePath(node.Follow("id"));
+}
+
+static void extractMesh(const MeshLayout& layout, const BlendFileData& mesh, const glm::mat4& world, const std::string& name,
+	const std::vector<int>& slotMaterials, std::vector<BlendMesh>& outMeshes)
+{
+	const int vertCount = mesh.Get<int>("totvert");
+	const int polyCount = mesh.Get<int>("totpoly");
+	const int loopCount = mesh.Get<int>("totloop");
+	if (vertCount <= 0 || polyCount <= 0 || loopCount <= 0)
+		return;
+
+	const char* verts = mesh.GetPointer("mvert", vertCount * layout.vertStride);
+	const char* polys = mesh.GetPointer("mpoly", polyCount * layout.polyStride);
+	const char* loops = mesh.GetPointer("mloop", loopCount * layout.loopStride);
+	const char* uvs = layout.uvStride ? mesh.GetPointer("mloopuv", loopCount * layout.uvStride) : nullptr;
+
+	if (!verts || !polys || !loops)
+	{
+		std::cerr << "[Error: BlendLoader::load] Mesh of " << name << " has no readable MVert/MPoly/MLoop arrays." << std::endl;
+		return;
+	}
+
+	// Place every polygon's corners and triangles within the arrays of its material slot.
+	const size_t slotCount = slotMaterials.size();
+	std::vector<unsigned int> vertexCounts(slotCount, 0);
+	std::vector<unsigned int> indexCounts(slotCount, 0);
+	std::vector<unsigned int> polyVertexStart(polyCount);
+	std::vector<unsigned int> polyIndexStart(polyCount);
+	std::vector<unsigned short> polySlot(polyCount, invalidSlot);
+
+	bool hasSmoothPolys = false;
+	for (int p = 0; p < polyCount; p++)
+	{
+		const char* poly = polys + p * layout.polyStride;
+		const int loopStart = readAt<int>(poly + layout.polyLoopStart);
+		const int corners = readAt<int>(poly + layout.polyTotLoop);
+		if (corners < 3 || loopStart < 0 || loopStart + corners > loopCount)
+			continue;
+
+		const unsigned short slot = (unsigned short)std::min<size_t>(std::max<short>(readAt<short>(poly + layout.polyMatNr), 0), slotCount - 1);
+		polySlot[p] = slot;
+		polyVertexStart[p] = vertexCounts[slot];
+		polyIndexStart[p] = indexCounts[slot];
+		vertexCounts[slot] += corners;
+		indexCounts[slot] += 3 * (corners - 2);
+
+		hasSmoothPolys |= (readAt<char>(poly + layout.polyFlag) & polySmooth) != 0;
+	}
+
+	// Smooth normals have to be accumulated when the file no longer stores them.
+	std::vector<glm::vec3> vertexNormals;
+	if (hasSmoothPolys && !layout.hasVertexNormals)
+	{
+		vertexNormals.assign(vertCount, glm::vec3(0.0f));
+		for (int p = 0; p < polyCount; p++)
+		{
+			if (polySlot[p] == invalidSlot)
+				continue;
+
+			const char* poly = polys + p * layout.polyStride;
+			const int loopStart = readAt<int>(poly + layout.polyLoopStart);
+			const int corners = readAt<int>(poly + layout.polyTotLoop);
+
+			const glm::vec3 faceNormal = polyNormal(layout, verts, loops, vertCount, loopStart, corners);
+			for (int c = 0; c < corners; c++)
+				vertexNormals[loopVertex(layout, loops, loopStart + c, vertCount)] += faceNormal;
+		}
+	}
+
+	std::vector<size_t> slotMesh(slotCount, 0);
+	for (size_t slot = 0; slot < slotCount; slot++)
+	{
+		if (!vertexCounts[slot])
+			continue;
+
+		slotMesh[slot] = outMeshes.size();
+		outMeshes.push_back(BlendMesh());
+
+		BlendMesh& outMesh = outMeshes.back();
+		outMesh.name = slotCount > 1 ? name + "." + std::to_string(slot) : name;
+		outMesh.material = slotMaterials[slot];
+		outMesh.vertices.assign(vertexCounts[slot], Vertex(glm::vec3(0.0f), glm::vec3(0.0f), glm::vec2(0.0f)));
+		outMesh.indices.resize(indexCounts[slot]);
+	}
+
+	const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+	// mirrored objects flip the winding
+	const bool mirrored = glm::determinant(glm::mat3(world)) < 0.0f;
+
+	ThreadPool::Global().ParallelFor(polyCount, polyGrainSize, [&](size_t begin, size_t end)
+	{
+		for (size_t p = begin; p < end; p++)
+		{
+			if (polySlot[p] == invalidSlot)
+				continue;
+
+			BlendMesh& outMesh = outMeshes[slotMesh[polySlot[p]]];
+			const char* poly = polys + p * layout.polyStride;
+			const int loopStart = readAt<int>(poly + layout.polyLoopStart);
+			const int corners = readAt<int>(poly + layout.polyTotLoop);
+			const bool smooth = (readAt<char>(poly + layout.polyFlag) & polySmooth) != 0;
+
+			const glm::vec3 faceNormal = smooth ? glm::vec3(0.0f) : polyNormal(layout, verts, loops, vertCount, loopStart, corners);
+
+			Vertex* vertices = outMesh.vertices.data() + polyVertexStart[p];
+			for (int c = 0; c < corners; c++)
+			{
+				const int loop = loopStart + c;
+				const int v = loopVertex(layout, loops, loop, vertCount);
+				const char* vert = verts + v * layout.vertStride;
+
+				glm::vec3 normal = faceNormal;
+				if (smooth && layout.hasVertexNormals)
+				{
+					short no[3];
+					memcpy(no, vert + layout.vertNo, sizeof(no));
+					normal = glm::vec3(no[0], no[1], no[2]) / 32767.0f;
+				}
+				else if (smooth)
+					normal = vertexNormals[v];
+
+				glm::vec2 texCoords(0.0f);
+				if (uvs)
+				{
+					texCoords = readAt<glm::vec2>(uvs + loop * layout.uvStride + layout.uvUv);
+					texCoords.y = 1.0f - texCoords.y;
+				}
+
+				vertices[c] = Vertex(
+					glm::vec3(world * glm::vec4(readAt<glm::vec3>(vert + layout.vertCo), 1.0f)),
+					safeNormalize(normalMatrix * normal),
+					texCoords
+				);
+			}
+
+			unsigned int* indices = outMesh.indices.data() + polyIndexStart[p];
+			const unsigned int base = polyVertexStart[p];
+			for (int t = 1; t + 1 < corners; t++)
+			{
+				*indices++ = base;
+				*indices++ = base + (mirrored ? t + 1 : t);
+				*indices++ = base + (mirrored ? t : t + 1);
+			}
+		}
+	});
+}
+
+bool BlendLoader::load(const std::string& path, std::vector<BlendMesh>& outMeshes, std::vector<BlendMaterial>& outMaterials)
+{
+	BlendFile file(path);
+	if (!file.IsOpen())
+		return false;
+
+	MeshLayout layout;
+	if (!buildLayout(file, layout))
+	{
+		std::cerr << "[Error: BlendLoader::load] " << path << " (Blender " << file.GetVersion() / 100 << "." << file.GetVersion() % 100
+			<< ") has no MVert/MPoly/MLoop layout." << std::endl;
+		return false;
+	}
+
+	const int meshStruct = file.FindStruct("Mesh");
+	const size_t pointerSize = file.GetPointerSize();
+
+	// Blender is Z-up: (x, y, z) -> (x, z, -y)
+	const glm::mat4 axisConversion(
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, -1.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	);
+
+	// materials are shared between objects, keyed by their place in the mapping
+	std::unordered_map<const char*, int> materialIndices;
+
+	for (const BlendBlock& block : file.GetBlocks())
+	{
+		if (memcmp(block.code, "OB\0\0", 4) != 0)
+			continue;
+
+		const BlendFileData object = file.GetBlockData(block);
+		if (object.Get<short>("type") != objectTypeMesh)
+			continue;
+
+		const BlendFileData mesh = object.Follow("data");
+		if (mesh.GetStructIndex() != meshStruct)
+			continue;
+
+		// material slots of the mesh data; per-object overrides are ignored
+		const short slotCount = std::max<short>(mesh.Get<short>("totcol"), 0);
+		const char* slots = mesh.GetPointer("mat", slotCount * pointerSize);
+		std::vector<int> slotMaterials(std::max<short>(slotCount, 1), -1);
+
+		for (short slot = 0; slots && slot < slotCount; slot++)
+		{
+			const uint64_t address = file.ReadPointer(slots + slot * pointerSize);
+			const BlendBlock* materialBlock = file.FindBlock(address);
+			if (!materialBlock)
+				continue;
+
+			const char* key = file.Resolve(address);
+			auto it = materialIndices.find(key);
+			if (it == materialIndices.end())
+			{
+				outMaterials.push_back(BlendMaterial());
+				loadMaterial(file.GetBlockData(*materialBlock), outMaterials.back());
+				it = materialIndices.emplace(key, (int)outMaterials.size() - 1).first;
+			}
+
+			slotMaterials[slot] = it->second;
+		}
+
+		const glm::mat4 world = axisConversion * object.Get<glm::mat4>("obmat", glm::mat4(1.0f));
+		extractMesh(layout, mesh, world, getIdName(object), slotMaterials, outMeshes);
+	}
+
+	return true;
+}
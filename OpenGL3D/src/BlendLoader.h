@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <vec3.hpp>
+
+#include "Mesh.h"
+
+struct BlendMaterial
+{
+	std::string name;
+
+	glm::vec3 diffuse = glm::vec3(0.8f);
+	float metallic = 0.0f;
+	float roughness = 0.5f;
+
+	// image files relative to the .blend file, taken from the node tree
+	std::string diffuseMap;
+	std::string specularMap;
+};
+
+struct BlendMesh
+{
+	std::string name;
+	// index into the material list, -1 for meshes without materials
+	int material = -1;
+
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+};
+
+/*
+	Reads mesh objects straight out of a .blend file (Blender 2.8-3.x Mesh/MPoly/MLoop/MVert
+	layout) through BlendFile. Element offsets come from the file's own SDNA, so small layout
+	changes between versions are handled. Every loop is written once into its final Vertex
+	slot on the thread pool; Model's weld pass then shares identical corners. One BlendMesh
+	is produced per object and material slot, with the object transform applied and Blender's
+	Z-up converted to Y-up. Polygons are fan triangulated and uvs are flipped like
+	aiProcess_FlipUVs.
+*/
+namespace BlendLoader
+{
+	bool load(const std::string& path, std::vector<BlendMesh>& outMeshes, std::vector<BlendMaterial>& outMaterials);
+}
@@ -19,6 +19,16 @@ glm::mat4 Camera::GetViewMatrix()
 	};
 }
 
+glm::mat4 Camera::GetProjectionMatrix(float aspect, float nearPlane, float farPlane) const
+{
+	return glm::perspective(glm::radians(fov), aspect, nearPlane, farPlane);
+}
+
+Frustum Camera::GetFrustum(float aspect, float nearPlane, float farPlane)
+{
+	return Frustum(GetProjectionMatrix(aspect, nearPlane, farPlane) * GetViewMatrix());
+}
+
 void Camera::MoveDirection(CameraMovement direction, float deltaTime)
 {
 	switch (direction)
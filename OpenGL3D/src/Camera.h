@@ -7,6 +7,8 @@
 #include <gtc\matrix_transform.hpp>
 #include <gtc\type_ptr.hpp>
 
+#include "Frustum.h"
+
 enum CameraMovement
 {
 	FORWARD,
@@ -36,6 +38,9 @@ public:
 	Camera(glm::vec3 pos, glm::vec3 worldUp, float yaw, float pitch);
 
 	glm::mat4 GetViewMatrix();
+	glm::mat4 GetProjectionMatrix(float aspect, float nearPlane, float farPlane) const;
+	// planes of the view volume in world space, for the same projection
+	Frustum GetFrustum(float aspect, float nearPlane, float farPlane);
 	
 	void MoveDirection(CameraMovement direction, float deltaTime);
 	void PanOffset(float xOffset, float yOffset, bool constrainPitch);
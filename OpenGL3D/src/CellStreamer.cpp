@@ -0,0 +1,664 @@
+#include "pch.h"
+#include "CellStreamer.h"
+#include "Frustum.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "VertexLayout.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+static const uint32_t cellMagic = 0x4C4C4543; // "CELL"
+static const uint32_t manifestMagic = 0x444C5743; // "CWLD"
+// 2: Vertex gained a tangent
+static const uint32_t cellVersion = 2;
+static const char* manifestName = "world.cells";
+
+using CellVertexLayout = VertexLayout<Position<float3>, Normal<float3>, TexCoords<float2>, Tangent<float4>>;
+static_assert(CellVertexLayout::GetStride() == sizeof(Vertex) && CellVertexLayout::GetOffset(3) == offsetof(Vertex, tangent),
+	"cell vertices are uploaded as cooked");
+
+// header: magic, version, vertex, index, submesh and texture counts
+static const size_t cellHeaderSize = 6 * sizeof(uint32_t);
+
+struct CellBuild
+{
+	int x = 0;
+	int z = 0;
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<CellSubmesh> submeshes;
+	std::vector<std::string> texturePaths;
+	glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+	glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+	size_t fileBytes = 0;
+};
+
+template<typename T>
+static void writeValue(std::ofstream& file, const T& value)
+{
+	file.write((const char*)&value, sizeof(T));
+}
+
+// Reads a T at offset and advances it; false when the data is truncated.
+template<typename T>
+static bool readValue(const char* data, size_t size, size_t& offset, T& outValue)
+{
+	if (offset + sizeof(T) > size)
+		return false;
+
+	memcpy(&outValue, data + offset, sizeof(T));
+	offset += sizeof(T);
+	return true;
+}
+
+static bool readBytes(const char* data, size_t size, size_t& offset, void* outBytes, size_t byteCount)
+{
+	if (byteCount > size - std::min(offset, size))
+		return false;
+
+	memcpy(outBytes, data + offset, byteCount);
+	offset += byteCount;
+	return true;
+}
+
+static std::string cellFileName(int x, int z)
+{
+	return "cell_" + std::to_string(x) + "_" + std::to_string(z) + ".bin";
+}
+
+// succeeds if the directory exists afterwards
+static bool createDirectory(const std::string& path)
+{
+#ifdef _WIN32
+	return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+	return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+static float distanceToBox(const glm::vec3& point, const glm::vec3& min, const glm::vec3& max)
+{
+	return glm::length(glm::max(glm::max(min - point, point - max), glm::vec3(0.0f)));
+}
+
+static bool writeCell(const std::string& path, CellBuild& cell)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	writeValue(file, cellMagic);
+	writeValue(file, cellVersion);
+	writeValue(file, (uint32_t)cell.vertices.size());
+	writeValue(file, (uint32_t)cell.indices.size());
+	writeValue(file, (uint32_t)cell.submeshes.size());
+	writeValue(file, (uint32_t)cell.texturePaths.size());
+
+	file.write((const char*)cell.vertices.data(), cell.vertices.size() * sizeof(Vertex));
+	file.write((const char*)cell.indices.data(), cell.indices.size() * sizeof(unsigned int));
+	for (const CellSubmesh& submesh : cell.submeshes)
+	{
+		writeValue(file, (uint32_t)submesh.indexOffset);
+		writeValue(file, (uint32_t)submesh.indexCount);
+		writeValue(file, (int32_t)submesh.texture);
+	}
+	for (const std::string& texturePath : cell.texturePaths)
+	{
+		writeValue(file, (uint32_t)texturePath.size());
+		file.write(texturePath.data(), texturePath.size());
+	}
+
+	cell.fileBytes = (size_t)file.tellp();
+	return (bool)file;
+}
+
+static void readCell(const std::string& path, CellData& outData)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	MappedFile file(path);
+	if (!file.IsOpen())
+	{
+		outData.error = "could not open " + path;
+		return;
+	}
+
+	const char* data = file.GetData();
+	const size_t size = file.GetSize();
+	size_t offset = 0;
+
+	uint32_t magic = 0, version = 0, vertexCount = 0, indexCount = 0, submeshCount = 0, textureCount = 0;
+	if (!readValue(data, size, offset, magic) || !readValue(data, size, offset, version) || magic != cellMagic || version != cellVersion)
+	{
+		outData.error = path + " is not a cell file";
+		return;
+	}
+
+	readValue(data, size, offset, vertexCount);
+	readValue(data, size, offset, indexCount);
+	readValue(data, size, offset, submeshCount);
+	readValue(data, size, offset, textureCount);
+
+	if ((size_t)vertexCount * sizeof(Vertex) + (size_t)indexCount * sizeof(unsigned int) > size)
+	{
+		outData.error = path + " is truncated";
+		return;
+	}
+
+	outData.vertices.resize((size_t)vertexCount * sizeof(Vertex));
+	outData.indices.resize(indexCount);
+	bool valid = offset == cellHeaderSize
+		&& readBytes(data, size, offset, outData.vertices.data(), outData.vertices.size())
+		&& readBytes(data, size, offset, outData.indices.data(), outData.indices.size() * sizeof(unsigned int));
+
+	for (uint32_t i = 0; valid && i < submeshCount; i++)
+	{
+		uint32_t indexOffset = 0, count = 0;
+		int32_t texture = -1;
+		valid = readValue(data, size, offset, indexOffset) && readValue(data, size, offset, count) && readValue(data, size, offset, texture)
+			&& (size_t)indexOffset + count <= indexCount && texture < (int32_t)textureCount;
+		outData.submeshes.push_back({ indexOffset, count, texture });
+	}
+
+	for (uint32_t i = 0; valid && i < textureCount; i++)
+	{
+		uint32_t length = 0;
+		valid = readValue(data, size, offset, length);
+		std::string texturePath(valid ? length : 0, '\0');
+		valid = valid && readBytes(data, size, offset, &texturePath[0], length);
+		outData.texturePaths.push_back(std::move(texturePath));
+	}
+
+	for (size_t i = 0; valid && i < outData.indices.size(); i++)
+		valid = outData.indices[i] < vertexCount;
+
+	if (!valid)
+		outData.error = path + " is truncated or corrupt";
+
+	outData.readMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool CellStreamer::Cook(const std::string& directory, float cellSize, const std::vector<CellMesh>& meshes)
+{
+	if (cellSize <= 0.0f)
+	{
+		std::cerr << "[Error: CellStreamer::Cook] The cell size must be positive." << std::endl;
+		return false;
+	}
+
+	if (!createDirectory(directory))
+	{
+		std::cerr << "[Error: CellStreamer::Cook] Could not create " << directory << "." << std::endl;
+		return false;
+	}
+
+	std::map<std::pair<int, int>, CellBuild> builds;
+
+	for (const CellMesh& mesh : meshes)
+	{
+		// per cell: mesh vertex -> cell vertex
+		std::map<std::pair<int, int>, std::unordered_map<unsigned int, unsigned int>> remaps;
+
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			const unsigned int* triangle = &mesh.indices[i];
+			if (triangle[0] >= mesh.vertices.size() || triangle[1] >= mesh.vertices.size() || triangle[2] >= mesh.vertices.size())
+				continue;
+
+			const glm::vec3 centroid = (mesh.vertices[triangle[0]].pos + mesh.vertices[triangle[1]].pos + mesh.vertices[triangle[2]].pos) / 3.0f;
+			const std::pair<int, int> key((int)std::floor(centroid.x / cellSize), (int)std::floor(centroid.z / cellSize));
+
+			CellBuild& cell = builds[key];
+			auto remap = remaps.find(key);
+			if (remap == remaps.end())
+			{
+				// first triangle of this mesh in the cell starts its submesh
+				cell.x = key.first;
+				cell.z = key.second;
+				remap = remaps.emplace(key, std::unordered_map<unsigned int, unsigned int>()).first;
+
+				int texture = -1;
+				if (!mesh.diffusePath.empty())
+				{
+					auto it = std::find(cell.texturePaths.begin(), cell.texturePaths.end(), mesh.diffusePath);
+					texture = (int)(it - cell.texturePaths.begin());
+					if (it == cell.texturePaths.end())
+						cell.texturePaths.push_back(mesh.diffusePath);
+				}
+				cell.submeshes.push_back({ (unsigned int)cell.indices.size(), 0, texture });
+			}
+
+			for (int corner = 0; corner < 3; corner++)
+			{
+				auto inserted = remap->second.emplace(triangle[corner], (unsigned int)cell.vertices.size());
+				if (inserted.second)
+				{
+					const Vertex& vertex = mesh.vertices[triangle[corner]];
+					cell.vertices.push_back(vertex);
+					cell.boundsMin = glm::min(cell.boundsMin, vertex.pos);
+					cell.boundsMax = glm::max(cell.boundsMax, vertex.pos);
+				}
+				cell.indices.push_back(inserted.first->second);
+			}
+			cell.submeshes.back().indexCount += 3;
+		}
+	}
+
+	std::vector<CellBuild*> cellList;
+	for (auto& build : builds)
+		cellList.push_back(&build.second);
+
+	// cells are independent files
+	std::vector<char> written(cellList.size(), 0);
+	ThreadPool::Global().ParallelFor(cellList.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			written[i] = writeCell(directory + "/" + cellFileName(cellList[i]->x, cellList[i]->z), *cellList[i]);
+	});
+
+	if (std::find(written.begin(), written.end(), 0) != written.end())
+	{
+		std::cerr << "[Error: CellStreamer::Cook] Could not write the cells to " << directory << "." << std::endl;
+		return false;
+	}
+
+	std::ofstream manifest(directory + "/" + manifestName, std::ios::binary);
+	writeValue(manifest, manifestMagic);
+	writeValue(manifest, cellVersion);
+	writeValue(manifest, cellSize);
+	writeValue(manifest, (uint32_t)cellList.size());
+	for (const CellBuild* cell : cellList)
+	{
+		writeValue(manifest, (int32_t)cell->x);
+		writeValue(manifest, (int32_t)cell->z);
+		writeValue(manifest, cell->boundsMin);
+		writeValue(manifest, cell->boundsMax);
+		writeValue(manifest, (uint64_t)cell->fileBytes);
+	}
+
+	if (!manifest)
+	{
+		std::cerr << "[Error: CellStreamer::Cook] Could not write the manifest to " << directory << "." << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+CellStreamer::CellStreamer(const std::string& directory, size_t budgetBytes)
+	: directory(directory), budgetBytes(budgetBytes)
+{
+	stats.budgetBytes = budgetBytes;
+	loaded = loadManifest();
+
+	const unsigned char white[4] = { 255, 255, 255, 255 };
+	glCreateTextures(GL_TEXTURE_2D, 1, &whiteTexture);
+	glTextureStorage2D(whiteTexture, 1, GL_RGBA8, 1, 1);
+	glTextureSubImage2D(whiteTexture, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, white);
+}
+
+CellStreamer::~CellStreamer()
+{
+	for (StreamCell& cell : cells)
+	{
+		// the workers hold no references into the cell, but its data must not outlive the wait
+		if (cell.loading.valid())
+			cell.loading.wait();
+		if (cell.state == CELL_RESIDENT)
+			evictCell(cell);
+	}
+
+	// textures still decoding are never uploaded
+	for (auto& texture : textures)
+		glDeleteTextures(1, &texture.second.id);
+	glDeleteTextures(1, &whiteTexture);
+}
+
+bool CellStreamer::loadManifest()
+{
+	const std::string path = directory + "/" + manifestName;
+	MappedFile file(path);
+	if (!file.IsOpen())
+	{
+		std::cerr << "[Error: CellStreamer] Could not open " << path << "." << std::endl;
+		return false;
+	}
+
+	const char* data = file.GetData();
+	const size_t size = file.GetSize();
+	size_t offset = 0;
+
+	uint32_t magic = 0, version = 0, cellCount = 0;
+	if (!readValue(data, size, offset, magic) || !readValue(data, size, offset, version) || magic != manifestMagic || version != cellVersion
+		|| !readValue(data, size, offset, cellSize) || !readValue(data, size, offset, cellCount))
+	{
+		std::cerr << "[Error: CellStreamer] " << path << " is not a cell manifest." << std::endl;
+		return false;
+	}
+
+	cells.resize(cellCount);
+	for (StreamCell& cell : cells)
+	{
+		int32_t x = 0, z = 0;
+		uint64_t fileBytes = 0;
+		if (!readValue(data, size, offset, x) || !readValue(data, size, offset, z)
+			|| !readValue(data, size, offset, cell.boundsMin) || !readValue(data, size, offset, cell.boundsMax)
+			|| !readValue(data, size, offset, fileBytes))
+		{
+			std::cerr << "[Error: CellStreamer] " << path << " is truncated." << std::endl;
+			cells.clear();
+			return false;
+		}
+
+		cell.x = x;
+		cell.z = z;
+		cell.fileBytes = (size_t)fileBytes;
+	}
+
+	return true;
+}
+
+size_t CellStreamer::getResidentBytes() const
+{
+	return geometryBytes + textureBytes;
+}
+
+bool CellStreamer::IsLoaded() const
+{
+	return loaded;
+}
+
+const StreamingStats& CellStreamer::GetStats() const
+{
+	return stats;
+}
+
+const std::vector<StreamCell>& CellStreamer::GetCells() const
+{
+	return cells;
+}
+
+void CellStreamer::Update(const glm::vec3& cameraPos, const glm::vec3& cameraVelocity, double time)
+{
+	textureLoader.Update(maxUploadsPerUpdate);
+
+	// cells near either the camera or where it is heading keep their priority
+	const glm::vec3 predicted = cameraPos + cameraVelocity * lookAheadSeconds;
+	for (StreamCell& cell : cells)
+		cell.distance = std::min(distanceToBox(cameraPos, cell.boundsMin, cell.boundsMax), distanceToBox(predicted, cell.boundsMin, cell.boundsMax));
+
+	const float unloadRadius = loadRadius + hysteresis;
+	unsigned int uploads = 0;
+	size_t loadingCount = 0;
+	for (StreamCell& cell : cells)
+	{
+		if (cell.state == CELL_LOADING && uploads < maxUploadsPerUpdate
+			&& cell.loading.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			if (cell.pending->error.empty() && cell.distance <= unloadRadius)
+				uploads++;
+			finishLoad(cell, time);
+		}
+
+		if (cell.state == CELL_LOADING)
+			loadingCount++;
+		else if (cell.state == CELL_RESIDENT && cell.distance > unloadRadius)
+			evictCell(cell);
+		else if (cell.state == CELL_FAILED && time - cell.requestTime >= retrySeconds)
+			cell.state = CELL_UNLOADED;
+	}
+
+	// textures only add to the total once decoded, so the budget can be overshot by them
+	while (getResidentBytes() > budgetBytes && evictFarthest(-1.0f))
+		;
+
+	std::vector<StreamCell*> wanted;
+	for (StreamCell& cell : cells)
+		if (cell.state == CELL_UNLOADED && cell.distance <= loadRadius)
+			wanted.push_back(&cell);
+
+	std::sort(wanted.begin(), wanted.end(), [](const StreamCell* a, const StreamCell* b) { return a->distance < b->distance; });
+
+	for (StreamCell* cell : wanted)
+	{
+		if (loadingCount >= maxConcurrentLoads)
+			break;
+
+		// nearer cells win the budget; if this one does not fit, farther ones will not either
+		if (!makeRoom(cell->fileBytes, cell->distance))
+			break;
+
+		requestCell(*cell, time);
+		loadingCount++;
+	}
+
+	updateStats(time);
+}
+
+void CellStreamer::requestCell(StreamCell& cell, double time)
+{
+	std::shared_ptr<CellData> data = std::make_shared<CellData>();
+	const std::string path = directory + "/" + cellFileName(cell.x, cell.z);
+
+	cell.pending = data;
+	cell.loading = ThreadPool::Global().Submit([data, path]()
+	{
+		readCell(path, *data);
+	});
+	cell.requestTime = time;
+	cell.state = CELL_LOADING;
+}
+
+void CellStreamer::finishLoad(StreamCell& cell, double time)
+{
+	std::shared_ptr<CellData> data = std::move(cell.pending);
+	cell.loading = std::future<void>();
+	cell.state = CELL_UNLOADED;
+
+	if (!data->error.empty())
+	{
+		std::cerr << "[Error: CellStreamer] " << data->error << "." << std::endl;
+		cell.state = CELL_FAILED;
+		stats.failedLoads++;
+		return;
+	}
+
+	stats.bytesRead += cell.fileBytes;
+	windowBytes += cell.fileBytes;
+
+	// the camera moved away while the file was read
+	if (cell.distance > loadRadius + hysteresis)
+	{
+		stats.discardedLoads++;
+		return;
+	}
+
+	uploadCell(cell, *data);
+	cell.state = CELL_RESIDENT;
+	cell.readMs = data->readMs;
+	cell.latencyMs = (time - cell.requestTime) * 1000.0;
+	cell.loadCount++;
+
+	stats.loads++;
+	windowLoads++;
+	windowLatencyMs += cell.latencyMs;
+	windowMaxLatencyMs = std::max(windowMaxLatencyMs, cell.latencyMs);
+}
+
+void CellStreamer::uploadCell(StreamCell& cell, CellData& data)
+{
+	glCreateBuffers(1, &cell.vbo);
+	glNamedBufferStorage(cell.vbo, data.vertices.size(), data.vertices.data(), 0);
+	glCreateBuffers(1, &cell.ebo);
+	glNamedBufferStorage(cell.ebo, data.indices.size() * sizeof(unsigned int), data.indices.data(), 0);
+
+	// cells are cooked as raw Vertex, so the layout mirrors the struct instead of packing it
+	glCreateVertexArrays(1, &cell.vao);
+	CellVertexLayout::Setup(cell.vao, cell.vbo);
+	glVertexArrayElementBuffer(cell.vao, cell.ebo);
+
+	cell.submeshes = std::move(data.submeshes);
+	cell.texturePaths = std::move(data.texturePaths);
+	cell.geometryBytes = data.vertices.size() + data.indices.size() * sizeof(unsigned int);
+	geometryBytes += cell.geometryBytes;
+
+	for (const std::string& path : cell.texturePaths)
+		acquireTexture(path);
+}
+
+void CellStreamer::evictCell(StreamCell& cell)
+{
+	glDeleteVertexArrays(1, &cell.vao);
+	glDeleteBuffers(1, &cell.vbo);
+	glDeleteBuffers(1, &cell.ebo);
+	cell.vao = cell.vbo = cell.ebo = 0;
+
+	for (const std::string& path : cell.texturePaths)
+		releaseTexture(path);
+
+	geometryBytes -= cell.geometryBytes;
+	cell.geometryBytes = 0;
+	cell.submeshes.clear();
+	cell.texturePaths.clear();
+	cell.state = CELL_UNLOADED;
+
+	stats.evictions++;
+}
+
+bool CellStreamer::makeRoom(size_t bytes, float distance)
+{
+	// reads in flight will need their share as well
+	size_t reserved = bytes;
+	for (const StreamCell& cell : cells)
+		if (cell.state == CELL_LOADING)
+			reserved += cell.fileBytes;
+
+	while (getResidentBytes() + reserved > budgetBytes)
+		if (!evictFarthest(distance))
+			return false;
+
+	return true;
+}
+
+bool CellStreamer::evictFarthest(float distance)
+{
+	StreamCell* farthest = nullptr;
+	for (StreamCell& cell : cells)
+		if (cell.state == CELL_RESIDENT && cell.distance > distance && (!farthest || cell.distance > farthest->distance))
+			farthest = &cell;
+
+	if (!farthest)
+		return false;
+
+	evictCell(*farthest);
+	return true;
+}
+
+void CellStreamer::acquireTexture(const std::string& path)
+{
+	StreamTexture& texture = textures[path];
+	if (texture.references++ > 0)
+		return;
+
+	textureLoader.Load(path, false, [this, path](GLuint id)
+	{
+		auto it = textures.find(path);
+		// every cell using it was evicted before the decode finished
+		if (it == textures.end() || it->second.id)
+		{
+			glDeleteTextures(1, &id);
+			return;
+		}
+
+		GLint width = 0, height = 0;
+		glGetTextureLevelParameteriv(id, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTextureLevelParameteriv(id, 0, GL_TEXTURE_HEIGHT, &height);
+
+		// RGBA8 with a full mip chain
+		it->second.id = id;
+		it->second.bytes = (size_t)width * height * 4 * 4 / 3;
+		textureBytes += it->second.bytes;
+	});
+}
+
+void CellStreamer::releaseTexture(const std::string& path)
+{
+	auto it = textures.find(path);
+	if (it == textures.end() || --it->second.references > 0)
+		return;
+
+	glDeleteTextures(1, &it->second.id);
+	textureBytes -= it->second.bytes;
+	textures.erase(it);
+}
+
+void CellStreamer::updateStats(double time)
+{
+	stats.residentCells = stats.loadingCells = 0;
+	for (const StreamCell& cell : cells)
+	{
+		stats.residentCells += cell.state == CELL_RESIDENT;
+		stats.loadingCells += cell.state == CELL_LOADING;
+	}
+	stats.residentBytes = getResidentBytes();
+
+	if (windowStart < 0.0)
+		windowStart = time;
+
+	const double elapsed = time - windowStart;
+	if (elapsed < 1.0)
+		return;
+
+	stats.readBandwidthMBs = windowBytes / (1024.0 * 1024.0) / elapsed;
+	stats.averageLatencyMs = windowLoads ? windowLatencyMs / windowLoads : 0.0;
+	stats.maxLatencyMs = windowMaxLatencyMs;
+
+	windowStart = time;
+	windowBytes = 0;
+	windowLatencyMs = windowMaxLatencyMs = 0.0;
+	windowLoads = 0;
+}
+
+void CellStreamer::Draw(GLuint shader, const Frustum& frustum)
+{
+	glUseProgram(shader);
+	glUniform1i(glGetUniformLocation(shader, "material.diffuse"), 0);
+
+	for (const StreamCell& cell : cells)
+	{
+		if (cell.state != CELL_RESIDENT || !frustum.IntersectsBox(cell.boundsMin, cell.boundsMax))
+			continue;
+
+		glBindVertexArray(cell.vao);
+		for (const CellSubmesh& submesh : cell.submeshes)
+		{
+			GLuint texture = whiteTexture;
+			if (submesh.texture >= 0)
+			{
+				auto it = textures.find(cell.texturePaths[submesh.texture]);
+				if (it != textures.end() && it->second.id)
+					texture = it->second.id;
+			}
+
+			glBindTextureUnit(0, texture);
+			glDrawElements(GL_TRIANGLES, submesh.indexCount, GL_UNSIGNED_INT, (void*)(submesh.indexOffset * sizeof(unsigned int)));
+		}
+	}
+
+	glBindVertexArray(0);
+}
@@ -0,0 +1,189 @@
+#pragma once
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vec3.hpp>
+
+#include "Mesh.h"
+#include "TextureLoader.h"
+
+struct Frustum;
+
+// input of CellStreamer::Cook: triangles in world space and an optional diffuse map path
+struct CellMesh
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::string diffusePath;
+};
+
+// draw range of one material inside a cell's element buffer
+struct CellSubmesh
+{
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	// index into the cell's texture paths, -1 for none
+	int texture;
+};
+
+// a cell file read by a worker, waiting for its GL upload
+struct CellData
+{
+	std::vector<unsigned char> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<CellSubmesh> submeshes;
+	std::vector<std::string> texturePaths;
+
+	std::string error;
+	double readMs = 0.0;
+};
+
+enum CellState
+{
+	CELL_UNLOADED,
+	CELL_LOADING,
+	CELL_RESIDENT,
+	// the last read failed; requested again once retrySeconds have passed since its request
+	CELL_FAILED
+};
+
+struct StreamCell
+{
+	int x = 0;
+	int z = 0;
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+	size_t fileBytes = 0;
+
+	CellState state = CELL_UNLOADED;
+	// distance from the predicted camera position, refreshed every Update
+	float distance = 0.0f;
+
+	GLuint vao = 0;
+	GLuint vbo = 0;
+	GLuint ebo = 0;
+	std::vector<CellSubmesh> submeshes;
+	std::vector<std::string> texturePaths;
+	// geometry bytes on the GPU; textures are shared and counted separately
+	size_t geometryBytes = 0;
+
+	std::shared_ptr<CellData> pending;
+	std::future<void> loading;
+	double requestTime = 0.0;
+
+	// last load: time spent reading and parsing on the worker, and from request to residency
+	double readMs = 0.0;
+	double latencyMs = 0.0;
+	unsigned int loadCount = 0;
+};
+
+struct StreamingStats
+{
+	size_t residentCells = 0;
+	size_t loadingCells = 0;
+	size_t residentBytes = 0;
+	size_t budgetBytes = 0;
+
+	// totals since construction
+	size_t bytesRead = 0;
+	unsigned int loads = 0;
+	unsigned int evictions = 0;
+	// loads whose result was dropped because the camera had moved away meanwhile
+	unsigned int discardedLoads = 0;
+	unsigned int failedLoads = 0;
+
+	// over the last statistics window (about a second)
+	double readBandwidthMBs = 0.0;
+	double averageLatencyMs = 0.0;
+	double maxLatencyMs = 0.0;
+};
+
+/*
+	Streams a world that was split into square cells on the XZ plane (see Cook) in and out
+	around the camera. Every cell is a self-contained file of cooked vertices, indices and
+	texture references, read and parsed on the thread pool; Update uploads finished cells
+	on the GL thread and loads their textures through a TextureLoader shared by all cells.
+
+	Cells are prioritised by their distance to the position the camera will reach after
+	lookAheadSeconds at its current velocity, so loads run ahead of the motion. Cells inside
+	loadRadius are requested (nearest first, at most maxConcurrentLoads at a time) and cells
+	beyond loadRadius + hysteresis become evictable; the gap keeps cells on the boundary from
+	being loaded and dropped every frame. A cell whose file cannot be read waits retrySeconds
+	before it is requested again, rather than failing and logging every frame. The budget covers GPU geometry and texture bytes:
+	evictable cells are released farthest first while it is exceeded, and a load only starts
+	if it fits or a farther resident cell can make room for it.
+*/
+class CellStreamer
+{
+public:
+	CellStreamer(const std::string& directory, size_t budgetBytes);
+	~CellStreamer();
+
+	CellStreamer(const CellStreamer&) = delete;
+	CellStreamer& operator=(const CellStreamer&) = delete;
+
+	// Splits the triangles of meshes into cells by their centroid and writes the cell files and the manifest.
+	static bool Cook(const std::string& directory, float cellSize, const std::vector<CellMesh>& meshes);
+
+	bool IsLoaded() const;
+
+	void Update(const glm::vec3& cameraPos, const glm::vec3& cameraVelocity, double time);
+	// Draws the resident cells that intersect frustum; cells whose textures are still loading use white.
+	void Draw(GLuint shader, const Frustum& frustum);
+
+	const StreamingStats& GetStats() const;
+	const std::vector<StreamCell>& GetCells() const;
+
+	float loadRadius = 60.0f;
+	float hysteresis = 20.0f;
+	float lookAheadSeconds = 1.0f;
+	unsigned int maxConcurrentLoads = 4;
+	// GL uploads per Update, to bound the frame time spent on them
+	unsigned int maxUploadsPerUpdate = 2;
+	float retrySeconds = 5.0f;
+
+private:
+	struct StreamTexture
+	{
+		GLuint id = 0;
+		unsigned int references = 0;
+		size_t bytes = 0;
+	};
+
+	std::string directory;
+	float cellSize = 0.0f;
+	bool loaded = false;
+
+	std::vector<StreamCell> cells;
+	size_t budgetBytes;
+	size_t geometryBytes = 0;
+	size_t textureBytes = 0;
+
+	TextureLoader textureLoader;
+	std::unordered_map<std::string, StreamTexture> textures;
+	GLuint whiteTexture = 0;
+
+	StreamingStats stats;
+	double windowStart = -1.0;
+	size_t windowBytes = 0;
+	double windowLatencyMs = 0.0;
+	double windowMaxLatencyMs = 0.0;
+	unsigned int windowLoads = 0;
+
+	bool loadManifest();
+	size_t getResidentBytes() const;
+
+	void requestCell(StreamCell& cell, double time);
+	void finishLoad(StreamCell& cell, double time);
+	void uploadCell(StreamCell& cell, CellData& data);
+	void evictCell(StreamCell& cell);
+	// Evicts resident cells farther than distance until bytes more fit next to the loads in flight.
+	bool makeRoom(size_t bytes, float distance);
+	bool evictFarthest(float distance);
+
+	void acquireTexture(const std::string& path);
+	void releaseTexture(const std::string& path);
+	void updateStats(double time);
+};
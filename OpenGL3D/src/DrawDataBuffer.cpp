@@ -0,0 +1,120 @@
+#include "pch.h"
+#include "DrawDataBuffer.h"
+
+#include <iostream>
+#include <numeric>
+#include <vector>
+#include <glm.hpp>
+
+static_assert(sizeof(DrawData) == 160, "DrawData must match the std430 layout in res/shaders/DrawData");
+
+DrawDataBuffer::DrawDataBuffer(size_t capacity)
+	: capacity(capacity)
+{
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	const size_t drawCount = regionCount * capacity;
+
+	glCreateBuffers(1, &dataBuffer);
+	glNamedBufferStorage(dataBuffer, drawCount * sizeof(DrawData), nullptr, flags);
+	mappedData = (DrawData*)glMapNamedBufferRange(dataBuffer, 0, drawCount * sizeof(DrawData), flags);
+
+	glCreateBuffers(1, &commandBuffer);
+	glNamedBufferStorage(commandBuffer, drawCount * sizeof(DrawElementsIndirectCommand), nullptr, flags);
+	mappedCommands = (DrawElementsIndirectCommand*)glMapNamedBufferRange(commandBuffer, 0, drawCount * sizeof(DrawElementsIndirectCommand), flags);
+
+	if (!mappedData || !mappedCommands)
+		std::cerr << "[Error: DrawDataBuffer] Could not map the buffers for " << capacity << " draws." << std::endl;
+
+	// instance i of the attribute is i, so a command's baseInstance comes out as its draw id
+	std::vector<GLuint> drawIds(drawCount);
+	std::iota(drawIds.begin(), drawIds.end(), 0u);
+	glCreateBuffers(1, &drawIdBuffer);
+	glNamedBufferStorage(drawIdBuffer, drawCount * sizeof(GLuint), drawIds.data(), 0);
+}
+
+DrawDataBuffer::~DrawDataBuffer()
+{
+	for (GLsync fence : fences)
+		if (fence)
+			glDeleteSync(fence);
+
+	// deleting the buffers unmaps them
+	glDeleteBuffers(1, &dataBuffer);
+	glDeleteBuffers(1, &commandBuffer);
+	glDeleteBuffers(1, &drawIdBuffer);
+}
+
+void DrawDataBuffer::Attach(GLuint vao, GLuint binding) const
+{
+	glVertexArrayVertexBuffer(vao, binding, drawIdBuffer, 0, sizeof(GLuint));
+	glVertexArrayBindingDivisor(vao, binding, 1);
+	glEnableVertexArrayAttrib(vao, drawIdLocation);
+	glVertexArrayAttribIFormat(vao, drawIdLocation, 1, GL_UNSIGNED_INT, 0);
+	glVertexArrayAttribBinding(vao, drawIdLocation, binding);
+}
+
+void DrawDataBuffer::Begin()
+{
+	region = (region + 1) % regionCount;
+	count = 0;
+	submitted = 0;
+
+	// the GPU may still be reading this region from three frames ago
+	GLsync& fence = fences[region];
+	if (fence)
+	{
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		glDeleteSync(fence);
+		fence = 0;
+	}
+}
+
+bool DrawDataBuffer::Add(GLsizei indexCount, GLuint firstIndex, GLint baseVertex, const glm::mat4& model,
+	const glm::vec4& color, GLuint material)
+{
+	if (!mappedData || !mappedCommands || count >= capacity)
+		return false;
+
+	const size_t draw = region * capacity + count++;
+	DrawData& data = mappedData[draw];
+	data.model = model;
+	data.normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(model))));
+	data.color = color;
+	data.material = material;
+
+	mappedCommands[draw] = { (GLuint)indexCount, 1, firstIndex, baseVertex, (GLuint)draw };
+	return true;
+}
+
+void DrawDataBuffer::Submit(GLuint shader, GLuint vao)
+{
+	if (count == submitted)
+		return;
+
+	glUseProgram(shader);
+	glBindVertexArray(vao);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, storageBinding, dataBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+		(const void*)((region * capacity + submitted) * sizeof(DrawElementsIndirectCommand)), (GLsizei)(count - submitted), 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	submitted = count;
+}
+
+void DrawDataBuffer::End()
+{
+	if (fences[region])
+		glDeleteSync(fences[region]);
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+size_t DrawDataBuffer::GetCapacity() const
+{
+	return capacity;
+}
+
+size_t DrawDataBuffer::GetCount() const
+{
+	return count;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <mat4x4.hpp>
+#include <vec4.hpp>
+
+#include "IndirectCommand.h"
+
+// one draw's entry in the DrawData block of res/shaders/DrawData/Vertex*.glsl, std430
+struct DrawData
+{
+	glm::mat4 model;
+	// inverse transpose of the model matrix in the upper 3x3
+	glm::mat4 normalMatrix;
+	glm::vec4 color;
+	GLuint material;
+	GLuint padding[3];
+};
+
+/*
+	Per-draw data for a frame, written once by the CPU and fetched by the shaders instead of
+	per-draw uniforms. Add writes a DrawData and queues an indirect command for it; Submit
+	draws everything queued since the last Submit with one glMultiDrawElementsIndirect, so a
+	draw costs a struct write and the GL calls are per group of draws sharing a vertex array
+	and a program.
+
+	Shaders find their draw through the baseInstance of its command: every command draws one
+	instance with baseInstance set to the draw's index, and Attach gives vertex arrays a
+	per-instance attribute (drawIdLocation) over the indices 0, 1, 2, ..., which therefore
+	reads as the draw's index. This needs no ARB_shader_draw_parameters; gl_InstanceID stays 0.
+
+	Both buffers are persistently mapped and split into three regions of capacity draws, like
+	MappedInstanceBuffer; Begin waits only when the GPU is three frames behind.
+
+		draws.Begin();
+		for (...)
+			draws.Add(36, 0, 0, model, color);
+		draws.Submit(shader, vao);
+		draws.End();
+*/
+class DrawDataBuffer
+{
+public:
+	// must match aDrawId and the DrawData binding in res/shaders/DrawData/Vertex*.glsl
+	static const GLuint drawIdLocation = 15;
+	static const GLuint storageBinding = 7;
+
+	explicit DrawDataBuffer(size_t capacity);
+	~DrawDataBuffer();
+
+	DrawDataBuffer(const DrawDataBuffer&) = delete;
+	DrawDataBuffer& operator=(const DrawDataBuffer&) = delete;
+
+	// Adds the draw id attribute to vao, on binding; once per vertex array.
+	void Attach(GLuint vao, GLuint binding = 2) const;
+
+	void Begin();
+	// Queues indexCount indices from firstIndex of the element buffer of the vertex array given
+	// to the next Submit. Returns false when this frame's region is full.
+	bool Add(GLsizei indexCount, GLuint firstIndex, GLint baseVertex, const glm::mat4& model,
+		const glm::vec4& color = glm::vec4(1.0f), GLuint material = 0);
+	// Draws the draws added since the last Submit with shader and vao in one call.
+	void Submit(GLuint shader, GLuint vao);
+	// Call once the frame's last Submit is issued.
+	void End();
+
+	size_t GetCapacity() const;
+	// draws added this frame
+	size_t GetCount() const;
+
+private:
+	static const unsigned int regionCount = 3;
+
+	size_t capacity = 0;
+	GLuint dataBuffer = 0;
+	GLuint commandBuffer = 0;
+	GLuint drawIdBuffer = 0;
+	DrawData* mappedData = nullptr;
+	DrawElementsIndirectCommand* mappedCommands = nullptr;
+
+	unsigned int region = regionCount - 1;
+	GLsync fences[regionCount] = {};
+	size_t count = 0;
+	size_t submitted = 0;
+};
@@ -0,0 +1,54 @@
+#include "pch.h"
+#include "Frustum.h"
+
+#include <geometric.hpp>
+
+Frustum::Frustum()
+	: planes()
+{}
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+	// Gribb/Hartmann: the planes are sums and differences of the rows of the clip matrix.
+	const glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+	const glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+	const glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+	const glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+	planes[PLANE_LEFT] = row3 + row0;
+	planes[PLANE_RIGHT] = row3 - row0;
+	planes[PLANE_BOTTOM] = row3 + row1;
+	planes[PLANE_TOP] = row3 - row1;
+	planes[PLANE_NEAR] = row3 + row2;
+	planes[PLANE_FAR] = row3 - row2;
+
+	for (glm::vec4& plane : planes)
+		plane /= glm::length(glm::vec3(plane));
+}
+
+bool Frustum::IntersectsSphere(const glm::vec3& center, float radius) const
+{
+	for (const glm::vec4& plane : planes)
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+			return false;
+
+	return true;
+}
+
+bool Frustum::IntersectsBox(const glm::vec3& min, const glm::vec3& max) const
+{
+	for (const glm::vec4& plane : planes)
+	{
+		// corner furthest along the plane normal
+		const glm::vec3 corner(
+			plane.x >= 0.0f ? max.x : min.x,
+			plane.y >= 0.0f ? max.y : min.y,
+			plane.z >= 0.0f ? max.z : min.z
+		);
+
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+			return false;
+	}
+
+	return true;
+}
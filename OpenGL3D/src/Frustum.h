@@ -0,0 +1,26 @@
+#pragma once
+#include <vec3.hpp>
+#include <vec4.hpp>
+#include <mat4x4.hpp>
+
+enum FrustumPlane
+{
+	PLANE_LEFT,
+	PLANE_RIGHT,
+	PLANE_BOTTOM,
+	PLANE_TOP,
+	PLANE_NEAR,
+	PLANE_FAR
+};
+
+struct Frustum
+{
+	// normalised planes with normals pointing inwards: dot(xyz, p) + w >= 0 inside
+	glm::vec4 planes[6];
+
+	Frustum();
+	Frustum(const glm::mat4& viewProjection);
+
+	bool IntersectsSphere(const glm::vec3& center, float radius) const;
+	bool IntersectsBox(const glm::vec3& min, const glm::vec3& max) const;
+};
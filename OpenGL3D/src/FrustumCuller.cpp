@@ -0,0 +1,325 @@
+#include "pch.h"
+#include "FrustumCuller.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AVX2_FUNCTION
+#else
+#include <cpuid.h>
+#define AVX2_FUNCTION __attribute__((target("avx2,fma")))
+#endif
+
+// bounds per thread pool task, a multiple of the widest group
+static const size_t chunkSize = 4096;
+
+void SphereBounds::Add(const glm::vec3& center, float radius)
+{
+	x.push_back(center.x);
+	y.push_back(center.y);
+	z.push_back(center.z);
+	this->radius.push_back(radius);
+}
+
+void SphereBounds::Clear()
+{
+	x.clear();
+	y.clear();
+	z.clear();
+	radius.clear();
+}
+
+size_t SphereBounds::GetCount() const
+{
+	return x.size();
+}
+
+void BoxBounds::Add(const glm::vec3& min, const glm::vec3& max)
+{
+	minX.push_back(min.x);
+	minY.push_back(min.y);
+	minZ.push_back(min.z);
+	maxX.push_back(max.x);
+	maxY.push_back(max.y);
+	maxZ.push_back(max.z);
+}
+
+void BoxBounds::Clear()
+{
+	minX.clear();
+	minY.clear();
+	minZ.clear();
+	maxX.clear();
+	maxY.clear();
+	maxZ.clear();
+}
+
+size_t BoxBounds::GetCount() const
+{
+	return minX.size();
+}
+
+static void cpuid(int leaf, int outInfo[4])
+{
+#if defined(_MSC_VER)
+	__cpuidex(outInfo, leaf, 0);
+#else
+	unsigned int a, b, c, d;
+	__cpuid_count(leaf, 0, a, b, c, d);
+	outInfo[0] = (int)a;
+	outInfo[1] = (int)b;
+	outInfo[2] = (int)c;
+	outInfo[3] = (int)d;
+#endif
+}
+
+static unsigned long long xgetbv0()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int low, high;
+	__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+	return ((unsigned long long)high << 32) | low;
+#endif
+}
+
+bool FrustumCuller::HasAvx2()
+{
+	static const bool avx2 = []()
+	{
+		int info[4];
+		cpuid(0, info);
+		if (info[0] < 7)
+			return false;
+
+		// FMA and OSXSAVE, then the OS saving the XMM and YMM registers
+		cpuid(1, info);
+		const bool fma = (info[2] & (1 << 12)) != 0;
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		if (!fma || !osxsave || (xgetbv0() & 0x6) != 0x6)
+			return false;
+
+		cpuid(7, info);
+		return (info[1] & (1 << 5)) != 0;
+	}();
+
+	return avx2;
+}
+
+// Appends begin + the set bits of mask (width bits) to out without branching; returns the new count.
+static inline size_t appendMask(unsigned int mask, unsigned int width, size_t index, unsigned int* out, size_t count)
+{
+	for (unsigned int bit = 0; bit < width; bit++)
+	{
+		out[count] = (unsigned int)(index + bit);
+		count += (mask >> bit) & 1;
+	}
+
+	return count;
+}
+
+// the planes are uniform across lanes; for boxes only the corner furthest along each normal matters
+struct BoxCorner
+{
+	const float* x;
+	const float* y;
+	const float* z;
+};
+
+static BoxCorner furthestCorner(const glm::vec4& plane, const BoxBounds& boxes)
+{
+	return {
+		plane.x >= 0.0f ? boxes.maxX.data() : boxes.minX.data(),
+		plane.y >= 0.0f ? boxes.maxY.data() : boxes.minY.data(),
+		plane.z >= 0.0f ? boxes.maxZ.data() : boxes.minZ.data()
+	};
+}
+
+static size_t spheresSse(const Frustum& frustum, const SphereBounds& spheres, size_t begin, size_t end, unsigned int* out)
+{
+	__m128 planes[6][4];
+	for (int p = 0; p < 6; p++)
+		for (int c = 0; c < 4; c++)
+			planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	size_t count = 0;
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(&spheres.x[i]);
+		const __m128 y = _mm_loadu_ps(&spheres.y[i]);
+		const __m128 z = _mm_loadu_ps(&spheres.z[i]);
+		const __m128 negRadius = _mm_xor_ps(_mm_loadu_ps(&spheres.radius[i]), signMask);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+				_mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+		}
+
+		count = appendMask((unsigned int)_mm_movemask_ps(inside), 4, i, out, count);
+	}
+
+	for (; i < end; i++)
+		if (frustum.IntersectsSphere(glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i]))
+			out[count++] = (unsigned int)i;
+
+	return count;
+}
+
+AVX2_FUNCTION static size_t spheresAvx2(const Frustum& frustum, const SphereBounds& spheres, size_t begin, size_t end, unsigned int* out)
+{
+	__m256 planes[6][4];
+	for (int p = 0; p < 6; p++)
+		for (int c = 0; c < 4; c++)
+			planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	size_t count = 0;
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		const __m256 x = _mm256_loadu_ps(&spheres.x[i]);
+		const __m256 y = _mm256_loadu_ps(&spheres.y[i]);
+		const __m256 z = _mm256_loadu_ps(&spheres.z[i]);
+		const __m256 negRadius = _mm256_xor_ps(_mm256_loadu_ps(&spheres.radius[i]), signMask);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			const __m256 distance = _mm256_fmadd_ps(planes[p][0], x,
+				_mm256_fmadd_ps(planes[p][1], y, _mm256_fmadd_ps(planes[p][2], z, planes[p][3])));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+		}
+
+		count = appendMask((unsigned int)_mm256_movemask_ps(inside), 8, i, out, count);
+	}
+
+	for (; i < end; i++)
+		if (frustum.IntersectsSphere(glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i]))
+			out[count++] = (unsigned int)i;
+
+	return count;
+}
+
+static size_t boxesSse(const Frustum& frustum, const BoxBounds& boxes, size_t begin, size_t end, unsigned int* out)
+{
+	BoxCorner corners[6];
+	__m128 planes[6][4];
+	for (int p = 0; p < 6; p++)
+	{
+		corners[p] = furthestCorner(frustum.planes[p], boxes);
+		for (int c = 0; c < 4; c++)
+			planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	size_t count = 0;
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			const __m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(planes[p][0], _mm_loadu_ps(corners[p].x + i)), _mm_mul_ps(planes[p][1], _mm_loadu_ps(corners[p].y + i))),
+				_mm_add_ps(_mm_mul_ps(planes[p][2], _mm_loadu_ps(corners[p].z + i)), planes[p][3]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+		}
+
+		count = appendMask((unsigned int)_mm_movemask_ps(inside), 4, i, out, count);
+	}
+
+	for (; i < end; i++)
+		if (frustum.IntersectsBox(glm::vec3(boxes.minX[i], boxes.minY[i], boxes.minZ[i]), glm::vec3(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i])))
+			out[count++] = (unsigned int)i;
+
+	return count;
+}
+
+AVX2_FUNCTION static size_t boxesAvx2(const Frustum& frustum, const BoxBounds& boxes, size_t begin, size_t end, unsigned int* out)
+{
+	BoxCorner corners[6];
+	__m256 planes[6][4];
+	for (int p = 0; p < 6; p++)
+	{
+		corners[p] = furthestCorner(frustum.planes[p], boxes);
+		for (int c = 0; c < 4; c++)
+			planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+	size_t count = 0;
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			const __m256 distance = _mm256_fmadd_ps(planes[p][0], _mm256_loadu_ps(corners[p].x + i),
+				_mm256_fmadd_ps(planes[p][1], _mm256_loadu_ps(corners[p].y + i),
+					_mm256_fmadd_ps(planes[p][2], _mm256_loadu_ps(corners[p].z + i), planes[p][3])));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+		}
+
+		count = appendMask((unsigned int)_mm256_movemask_ps(inside), 8, i, out, count);
+	}
+
+	for (; i < end; i++)
+		if (frustum.IntersectsBox(glm::vec3(boxes.minX[i], boxes.minY[i], boxes.minZ[i]), glm::vec3(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i])))
+			out[count++] = (unsigned int)i;
+
+	return count;
+}
+
+template<typename Test>
+size_t FrustumCuller::cull(size_t count, unsigned int* outIndices, const Test& test)
+{
+	const size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+	scratch.resize(count);
+	chunkCounts.resize(chunkCount);
+
+	ThreadPool::Global().ParallelFor(chunkCount, 1, [&](size_t first, size_t last)
+	{
+		for (size_t chunk = first; chunk < last; chunk++)
+		{
+			const size_t begin = chunk * chunkSize;
+			chunkCounts[chunk] = test(begin, std::min(begin + chunkSize, count), scratch.data() + begin);
+		}
+	});
+
+	size_t visible = 0;
+	for (size_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		std::memcpy(outIndices + visible, scratch.data() + chunk * chunkSize, chunkCounts[chunk] * sizeof(unsigned int));
+		visible += chunkCounts[chunk];
+	}
+
+	return visible;
+}
+
+size_t FrustumCuller::CullSpheres(const Frustum& frustum, const SphereBounds& spheres, unsigned int* outIndices)
+{
+	const bool avx2 = HasAvx2();
+	return cull(spheres.GetCount(), outIndices, [&](size_t begin, size_t end, unsigned int* out)
+	{
+		return avx2 ? spheresAvx2(frustum, spheres, begin, end, out) : spheresSse(frustum, spheres, begin, end, out);
+	});
+}
+
+size_t FrustumCuller::CullBoxes(const Frustum& frustum, const BoxBounds& boxes, unsigned int* outIndices)
+{
+	const bool avx2 = HasAvx2();
+	return cull(boxes.GetCount(), outIndices, [&](size_t begin, size_t end, unsigned int* out)
+	{
+		return avx2 ? boxesAvx2(frustum, boxes, begin, end, out) : boxesSse(frustum, boxes, begin, end, out);
+	});
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <vec3.hpp>
+
+#include "Frustum.h"
+
+// bounding spheres as structure of arrays, so eight of them load into one register per member
+struct SphereBounds
+{
+	std::vector<float> x, y, z;
+	std::vector<float> radius;
+
+	void Add(const glm::vec3& center, float radius);
+	void Clear();
+	size_t GetCount() const;
+};
+
+// axis aligned boxes as structure of arrays
+struct BoxBounds
+{
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+
+	void Add(const glm::vec3& min, const glm::vec3& max);
+	void Clear();
+	size_t GetCount() const;
+};
+
+/*
+	Frustum culling of flat arrays of bounds on the CPU, for paths without compute shaders.
+	The bounds are tested eight at a time with AVX2 when the processor has it and four at a
+	time with SSE otherwise, in chunks spread over the thread pool. Every chunk collects its
+	visible indices in a scratch array; the chunks are then concatenated into the caller's
+	output in index order, which may be a mapped buffer since it is only written, front to back.
+*/
+class FrustumCuller
+{
+public:
+	FrustumCuller() = default;
+
+	// Writes the indices of the bounds intersecting frustum to outIndices, which must hold
+	// GetCount() of them, and returns how many were written.
+	size_t CullSpheres(const Frustum& frustum, const SphereBounds& spheres, unsigned int* outIndices);
+	size_t CullBoxes(const Frustum& frustum, const BoxBounds& boxes, unsigned int* outIndices);
+
+	static bool HasAvx2();
+
+private:
+	std::vector<unsigned int> scratch;
+	std::vector<size_t> chunkCounts;
+
+	template<typename Test>
+	size_t cull(size_t count, unsigned int* outIndices, const Test& test);
+};
@@ -0,0 +1,630 @@
+#include "pch.h"
+#include "GltfModel.h"
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <gtc\matrix_transform.hpp>
+#include <gtc\quaternion.hpp>
+#include <gtc\type_ptr.hpp>
+
+static const uint32_t glbMagic = 0x46546C67;		// "glTF"
+static const uint32_t glbChunkJson = 0x4E4F534A;	// "JSON"
+static const uint32_t glbChunkBin = 0x004E4942;		// "BIN\0"
+
+// guards against cyclic node graphs
+static const unsigned int maxNodeDepth = 64;
+
+// texture units of the PBR material slots, as used by TestPBR/TestIBL
+static const unsigned int albedoUnit = 0;
+static const unsigned int metallicUnit = 1;
+static const unsigned int normalUnit = 2;
+static const unsigned int roughnessUnit = 3;
+
+// model matrix attribute of res/shaders/PBR/VertexGltf.glsl
+static const unsigned int modelAttribute = 5;
+
+struct GltfBufferSource
+{
+	const char* data = nullptr;
+	size_t size = 0;
+
+	// backing storage for data URIs or external .bin files
+	std::vector<char> decoded;
+	std::unique_ptr<MappedFile> file;
+};
+
+struct GltfAttribute
+{
+	const char* name;
+	GLuint location;
+};
+
+static const GltfAttribute vertexAttributes[] =
+{
+	{ "POSITION", 0 },
+	{ "TEXCOORD_0", 1 },
+	{ "TANGENT", 2 },
+	{ "NORMAL", 4 }
+};
+
+static unsigned int componentCount(const std::string& type)
+{
+	if (type == "SCALAR")
+		return 1;
+	if (type == "VEC2")
+		return 2;
+	if (type == "VEC3")
+		return 3;
+	if (type == "VEC4")
+		return 4;
+	return 0;
+}
+
+static unsigned int componentSize(int componentType)
+{
+	switch (componentType)
+	{
+	case GL_BYTE:
+	case GL_UNSIGNED_BYTE:
+		return 1;
+	case GL_SHORT:
+	case GL_UNSIGNED_SHORT:
+		return 2;
+	case GL_UNSIGNED_INT:
+	case GL_FLOAT:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+static bool decodeBase64(const std::string& text, size_t start, std::vector<char>& out)
+{
+	static const std::string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	unsigned int bits = 0;
+	int bitCount = 0;
+	for (size_t i = start; i < text.size() && text[i] != '='; i++)
+	{
+		const size_t value = alphabet.find(text[i]);
+		if (value == std::string::npos)
+			return false;
+
+		bits = (bits << 6) | (unsigned int)value;
+		bitCount += 6;
+		if (bitCount >= 8)
+		{
+			bitCount -= 8;
+			out.push_back((char)((bits >> bitCount) & 0xFF));
+		}
+	}
+
+	return true;
+}
+
+static bool decodeDataUri(const std::string& uri, std::vector<char>& out)
+{
+	const size_t comma = uri.find(',');
+	if (uri.compare(0, 5, "data:") != 0 || comma == std::string::npos || uri.find(";base64") > comma)
+		return false;
+
+	return decodeBase64(uri, comma + 1, out);
+}
+
+static std::string decodeUriPath(const std::string& uri)
+{
+	std::string path;
+	for (size_t i = 0; i < uri.size(); i++)
+	{
+		if (uri[i] == '%' && i + 2 < uri.size())
+		{
+			path += (char)std::stoi(uri.substr(i + 1, 2), nullptr, 16);
+			i += 2;
+		}
+		else
+			path += uri[i];
+	}
+	return path;
+}
+
+static int imageOfTexture(const JsonValue& document, const JsonValue& textureInfo)
+{
+	if (!textureInfo.Has("index"))
+		return -1;
+
+	const JsonValue& texture = document["textures"][textureInfo["index"].AsInt()];
+	return texture["source"].AsInt(-1);
+}
+
+GltfModel::GltfModel(const std::string& path)
+	: directory(path.substr(0, path.find_last_of("/\\") + 1))
+{
+	loaded = load(path);
+}
+
+GltfModel::~GltfModel()
+{
+	for (GltfMesh& mesh : meshes)
+		for (GltfPrimitive& primitive : mesh.primitives)
+			glDeleteVertexArrays(1, &primitive.vao);
+
+	for (GLuint buffer : bufferViews)
+		if (buffer)
+			glDeleteBuffers(1, &buffer);
+
+	if (!ownedTextures.empty())
+		glDeleteTextures((GLsizei)ownedTextures.size(), ownedTextures.data());
+}
+
+bool GltfModel::IsLoaded() const
+{
+	return loaded;
+}
+
+bool GltfModel::load(const std::string& path)
+{
+	MappedFile file(path);
+	if (!file.IsOpen())
+	{
+		std::cerr << "[Error: GltfModel] Could not open " << path << "." << std::endl;
+		return false;
+	}
+
+	const char* data = file.GetData();
+	const size_t size = file.GetSize();
+
+	// .glb: 12 byte header, then a JSON chunk and an optional binary chunk
+	const char* json = data;
+	size_t jsonSize = size;
+	const char* binChunk = nullptr;
+	size_t binSize = 0;
+
+	uint32_t magic = 0;
+	if (size >= 4)
+		memcpy(&magic, data, 4);
+
+	if (magic == glbMagic)
+	{
+		json = nullptr;
+		for (size_t offset = 12; offset + 8 <= size;)
+		{
+			uint32_t chunkLength, chunkType;
+			memcpy(&chunkLength, data + offset, 4);
+			memcpy(&chunkType, data + offset + 4, 4);
+			if (offset + 8 + chunkLength > size)
+				break;
+
+			if (chunkType == glbChunkJson && !json)
+			{
+				json = data + offset + 8;
+				jsonSize = chunkLength;
+			}
+			else if (chunkType == glbChunkBin && !binChunk)
+			{
+				binChunk = data + offset + 8;
+				binSize = chunkLength;
+			}
+
+			offset += 8 + ((chunkLength + 3) & ~3u);
+		}
+
+		if (!json)
+		{
+			std::cerr << "[Error: GltfModel] " << path << " has no JSON chunk." << std::endl;
+			return false;
+		}
+	}
+
+	JsonValue document;
+	if (!Json::parse(json, json + jsonSize, document))
+	{
+		std::cerr << "[Error: GltfModel] Could not parse " << path << "." << std::endl;
+		return false;
+	}
+
+	if (document["asset"]["version"].AsString().compare(0, 1, "2") != 0)
+	{
+		std::cerr << "[Error: GltfModel] " << path << " is not glTF 2.0." << std::endl;
+		return false;
+	}
+
+	// buffers
+	const JsonValue& buffers = document["buffers"];
+	std::vector<GltfBufferSource> sources(buffers.Size());
+	for (size_t i = 0; i < buffers.Size(); i++)
+	{
+		const JsonValue& buffer = buffers[i];
+		GltfBufferSource& source = sources[i];
+		const std::string& uri = buffer["uri"].AsString();
+
+		if (uri.empty())
+		{
+			source.data = binChunk;
+			source.size = binSize;
+		}
+		else if (uri.compare(0, 5, "data:") == 0)
+		{
+			if (!decodeDataUri(uri, source.decoded))
+				std::cerr << "[Error: GltfModel] Could not decode data URI of buffer " << i << "." << std::endl;
+			source.data = source.decoded.data();
+			source.size = source.decoded.size();
+		}
+		else
+		{
+			source.file.reset(new MappedFile(directory + decodeUriPath(uri)));
+			source.data = source.file->GetData();
+			source.size = source.file->GetSize();
+		}
+
+		if ((size_t)buffer["byteLength"].AsNumber() > source.size)
+		{
+			std::cerr << "[Error: GltfModel] Buffer " << i << " of " << path << " is truncated." << std::endl;
+			return false;
+		}
+	}
+
+	bufferViews.assign(document["bufferViews"].Size(), 0);
+	images.assign(document["images"].Size(), 0);
+
+	loadMeshes(document, sources);
+	loadMaterials(document);
+	loadImages(document, sources);
+	loadNodes(document);
+	sceneGraph.Update();
+
+	return true;
+}
+
+GLuint GltfModel::getBufferView(const JsonValue& document, int bufferView, const std::vector<GltfBufferSource>& sources)
+{
+	if (bufferView < 0 || bufferView >= (int)bufferViews.size())
+		return 0;
+
+	if (bufferViews[bufferView])
+		return bufferViews[bufferView];
+
+	const JsonValue& view = document["bufferViews"][bufferView];
+	const int buffer = view["buffer"].AsInt(-1);
+	const size_t offset = (size_t)view["byteOffset"].AsNumber();
+	const size_t length = (size_t)view["byteLength"].AsNumber();
+
+	if (buffer < 0 || buffer >= (int)sources.size() || !sources[buffer].data || offset + length > sources[buffer].size)
+	{
+		std::cerr << "[Error: GltfModel] Buffer view " << bufferView << " is out of range." << std::endl;
+		return 0;
+	}
+
+	// straight from the mapped file into GPU memory
+	GLuint glBuffer;
+	glCreateBuffers(1, &glBuffer);
+	glNamedBufferStorage(glBuffer, length, sources[buffer].data + offset, 0);
+
+	bufferViews[bufferView] = glBuffer;
+	return glBuffer;
+}
+
+bool GltfModel::bindAccessor(const JsonValue& document, GLuint vao, GLuint location, int accessorIndex, const std::vector<GltfBufferSource>& sources)
+{
+	const JsonValue& accessor = document["accessors"][accessorIndex];
+	if (accessor.Has("sparse") || !accessor.Has("bufferView"))
+	{
+		std::cerr << "[Error: GltfModel] Accessor " << accessorIndex << " is sparse or empty, which is not supported." << std::endl;
+		return false;
+	}
+
+	const int componentType = accessor["componentType"].AsInt();
+	const unsigned int components = componentCount(accessor["type"].AsString());
+	if (!components || !componentSize(componentType))
+	{
+		std::cerr << "[Error: GltfModel] Accessor " << accessorIndex << " has an unsupported type." << std::endl;
+		return false;
+	}
+
+	const int viewIndex = accessor["bufferView"].AsInt();
+	const GLuint buffer = getBufferView(document, viewIndex, sources);
+	if (!buffer)
+		return false;
+
+	const JsonValue& view = document["bufferViews"][viewIndex];
+	const GLsizei stride = view.Has("byteStride") ? view["byteStride"].AsInt() : (GLsizei)(components * componentSize(componentType));
+
+	glVertexArrayVertexBuffer(vao, location, buffer, (GLintptr)accessor["byteOffset"].AsNumber(), stride);
+	glVertexArrayAttribFormat(vao, location, components, componentType, accessor["normalized"].AsBool(), 0);
+	glVertexArrayAttribBinding(vao, location, location);
+	glEnableVertexArrayAttrib(vao, location);
+
+	return true;
+}
+
+void GltfModel::loadMeshes(const JsonValue& document, const std::vector<GltfBufferSource>& sources)
+{
+	const JsonValue& jsonMeshes = document["meshes"];
+	meshes.resize(jsonMeshes.Size());
+
+	for (size_t m = 0; m < jsonMeshes.Size(); m++)
+	{
+		const JsonValue& jsonPrimitives = jsonMeshes[m]["primitives"];
+		for (size_t p = 0; p < jsonPrimitives.Size(); p++)
+		{
+			const JsonValue& jsonPrimitive = jsonPrimitives[p];
+			const JsonValue& attributes = jsonPrimitive["attributes"];
+			if (!attributes.Has("POSITION"))
+				continue;
+
+			GltfPrimitive primitive;
+			primitive.mode = (GLenum)jsonPrimitive["mode"].AsInt(GL_TRIANGLES);
+			primitive.material = jsonPrimitive["material"].AsInt(-1);
+			glCreateVertexArrays(1, &primitive.vao);
+
+			bool valid = true;
+			for (const GltfAttribute& attribute : vertexAttributes)
+				if (attributes.Has(attribute.name))
+					valid &= bindAccessor(document, primitive.vao, attribute.location, attributes[attribute.name].AsInt(), sources) || attribute.location != 0;
+
+			primitive.count = (GLsizei)document["accessors"][attributes["POSITION"].AsInt()]["count"].AsNumber();
+
+			if (jsonPrimitive.Has("indices"))
+			{
+				const JsonValue& accessor = document["accessors"][jsonPrimitive["indices"].AsInt()];
+				const int viewIndex = accessor["bufferView"].AsInt(-1);
+				const GLuint buffer = getBufferView(document, viewIndex, sources);
+
+				valid &= buffer != 0 && !accessor.Has("sparse");
+				glVertexArrayElementBuffer(primitive.vao, buffer);
+
+				primitive.indexed = true;
+				primitive.indexType = (GLenum)accessor["componentType"].AsInt(GL_UNSIGNED_INT);
+				primitive.indexOffset = (size_t)accessor["byteOffset"].AsNumber();
+				primitive.count = (GLsizei)accessor["count"].AsNumber();
+			}
+
+			if (!valid)
+			{
+				std::cerr << "[Error: GltfModel] Skipping primitive " << p << " of mesh " << m << "." << std::endl;
+				glDeleteVertexArrays(1, &primitive.vao);
+				continue;
+			}
+
+			meshes[m].primitives.push_back(primitive);
+		}
+	}
+}
+
+void GltfModel::loadMaterials(const JsonValue& document)
+{
+	defaultNormal = createSolidTexture(glm::vec4(0.5f, 0.5f, 1.0f, 1.0f));
+
+	const JsonValue& jsonMaterials = document["materials"];
+	materials.resize(jsonMaterials.Size() + 1);
+
+	// The last entry serves primitives without a material.
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		const JsonValue& jsonMaterial = jsonMaterials[i];
+		const JsonValue& pbr = jsonMaterial["pbrMetallicRoughness"];
+		GltfMaterial& material = materials[i];
+
+		glm::vec4 baseColor(1.0f);
+		for (int c = 0; c < 4; c++)
+			baseColor[c] = (float)pbr["baseColorFactor"][c].AsNumber(1.0);
+
+		material.albedoMap = createSolidTexture(baseColor);
+		material.metallicMap = createSolidTexture(glm::vec4((float)pbr["metallicFactor"].AsNumber(1.0)));
+		material.roughnessMap = createSolidTexture(glm::vec4((float)pbr["roughnessFactor"].AsNumber(1.0)));
+		material.normalMap = defaultNormal;
+
+		material.baseColorImage = imageOfTexture(document, pbr["baseColorTexture"]);
+		material.metallicRoughnessImage = imageOfTexture(document, pbr["metallicRoughnessTexture"]);
+		material.normalImage = imageOfTexture(document, jsonMaterial["normalTexture"]);
+	}
+}
+
+void GltfModel::loadImages(const JsonValue& document, const std::vector<GltfBufferSource>& sources)
+{
+	const JsonValue& jsonImages = document["images"];
+
+	for (size_t i = 0; i < jsonImages.Size(); i++)
+	{
+		// Colour images are stored as sRGB, data images (normal, metallic-roughness) as linear.
+		bool used = false;
+		bool srgb = false;
+		for (const GltfMaterial& material : materials)
+		{
+			srgb |= material.baseColorImage == (int)i;
+			used |= material.baseColorImage == (int)i || material.metallicRoughnessImage == (int)i || material.normalImage == (int)i;
+		}
+
+		if (!used)
+			continue;
+
+		const JsonValue& image = jsonImages[i];
+		const int index = (int)i;
+		auto onReady = [this, index](GLuint texture) { onImageReady(index, texture); };
+
+		if (image.Has("bufferView"))
+		{
+			const JsonValue& view = document["bufferViews"][image["bufferView"].AsInt()];
+			const int buffer = view["buffer"].AsInt(-1);
+			const size_t offset = (size_t)view["byteOffset"].AsNumber();
+			const size_t length = (size_t)view["byteLength"].AsNumber();
+
+			if (buffer < 0 || buffer >= (int)sources.size() || offset + length > sources[buffer].size)
+			{
+				std::cerr << "[Error: GltfModel] Image " << i << " is out of range." << std::endl;
+				continue;
+			}
+
+			const unsigned char* bytes = (const unsigned char*)sources[buffer].data + offset;
+			textureLoader.Load(std::vector<unsigned char>(bytes, bytes + length), srgb, onReady);
+		}
+		else if (image["uri"].AsString().compare(0, 5, "data:") == 0)
+		{
+			std::vector<char> bytes;
+			if (decodeDataUri(image["uri"].AsString(), bytes))
+				textureLoader.Load(std::vector<unsigned char>(bytes.begin(), bytes.end()), srgb, onReady);
+		}
+		else if (image.Has("uri"))
+			textureLoader.Load(directory + decodeUriPath(image["uri"].AsString()), srgb, onReady);
+	}
+}
+
+void GltfModel::loadNodes(const JsonValue& document)
+{
+	const JsonValue& nodes = document["nodes"];
+	const JsonValue& scenes = document["scenes"];
+
+	if (scenes.Size())
+	{
+		const JsonValue& roots = scenes[document["scene"].AsInt(0)]["nodes"];
+		for (size_t i = 0; i < roots.Size(); i++)
+			addNode(document, roots[i].AsInt(), invalidSceneNode, 0);
+		return;
+	}
+
+	// without scenes every node that is nobody's child is a root
+	std::vector<bool> isChild(nodes.Size(), false);
+	for (size_t i = 0; i < nodes.Size(); i++)
+		for (size_t c = 0; c < nodes[i]["children"].Size(); c++)
+			if ((size_t)nodes[i]["children"][c].AsInt() < isChild.size())
+				isChild[nodes[i]["children"][c].AsInt()] = true;
+
+	for (size_t i = 0; i < nodes.Size(); i++)
+		if (!isChild[i])
+			addNode(document, (int)i, invalidSceneNode, 0);
+}
+
+void GltfModel::addNode(const JsonValue& document, int nodeIndex, SceneNode parent, unsigned int depth)
+{
+	const JsonValue& node = document["nodes"][nodeIndex];
+	if (node.type != JsonType::OBJECT || depth > maxNodeDepth)
+		return;
+
+	glm::mat4 local(1.0f);
+	if (node.Has("matrix"))
+	{
+		for (int i = 0; i < 16; i++)
+			glm::value_ptr(local)[i] = (float)node["matrix"][i].AsNumber();
+	}
+	else
+	{
+		const JsonValue& t = node["translation"];
+		const JsonValue& r = node["rotation"];
+		const JsonValue& s = node["scale"];
+
+		const glm::vec3 translation((float)t[0].AsNumber(), (float)t[1].AsNumber(), (float)t[2].AsNumber());
+		const glm::quat rotation((float)r[3].AsNumber(1.0), (float)r[0].AsNumber(), (float)r[1].AsNumber(), (float)r[2].AsNumber());
+		const glm::vec3 scale((float)s[0].AsNumber(1.0), (float)s[1].AsNumber(1.0), (float)s[2].AsNumber(1.0));
+
+		local = glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale);
+	}
+
+	const SceneNode sceneNode = sceneGraph.CreateNode(parent, local, node["name"].AsString());
+
+	const int mesh = node["mesh"].AsInt(-1);
+	if (mesh >= 0 && mesh < (int)meshes.size())
+		drawItems.push_back({ (unsigned int)mesh, sceneNode });
+
+	const JsonValue& children = node["children"];
+	for (size_t i = 0; i < children.Size(); i++)
+		addNode(document, children[i].AsInt(), sceneNode, depth + 1);
+}
+
+void GltfModel::onImageReady(int image, GLuint texture)
+{
+	images[image] = texture;
+	ownedTextures.push_back(texture);
+
+	for (GltfMaterial& material : materials)
+	{
+		if (material.baseColorImage == image)
+			material.albedoMap = texture;
+		if (material.normalImage == image)
+			material.normalMap = texture;
+		if (material.metallicRoughnessImage == image)
+		{
+			material.metallicMap = createSwizzledView(texture, GL_BLUE);
+			material.roughnessMap = createSwizzledView(texture, GL_GREEN);
+		}
+	}
+}
+
+GLuint GltfModel::createSolidTexture(const glm::vec4& color)
+{
+	const unsigned char pixel[4] =
+	{
+		(unsigned char)(glm::clamp(color.r, 0.0f, 1.0f) * 255.0f + 0.5f),
+		(unsigned char)(glm::clamp(color.g, 0.0f, 1.0f) * 255.0f + 0.5f),
+		(unsigned char)(glm::clamp(color.b, 0.0f, 1.0f) * 255.0f + 0.5f),
+		(unsigned char)(glm::clamp(color.a, 0.0f, 1.0f) * 255.0f + 0.5f)
+	};
+
+	GLuint texture;
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureStorage2D(texture, 1, GL_RGBA8, 1, 1);
+	glTextureSubImage2D(texture, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+
+	ownedTextures.push_back(texture);
+	return texture;
+}
+
+GLuint GltfModel::createSwizzledView(GLuint texture, GLenum source)
+{
+	GLint internalFormat = 0, levels = 0;
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+	glGetTextureParameteriv(texture, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+
+	// texture views need a name that has never been bound
+	GLuint view;
+	glGenTextures(1, &view);
+	glTextureView(view, GL_TEXTURE_2D, texture, internalFormat, 0, levels, 0, 1);
+	glTextureParameteri(view, GL_TEXTURE_SWIZZLE_R, source);
+	glTextureParameteri(view, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+
+	ownedTextures.push_back(view);
+	return view;
+}
+
+void GltfModel::Update()
+{
+	textureLoader.Update();
+	sceneGraph.Update();
+}
+
+void GltfModel::Draw(GLuint shader)
+{
+	glUseProgram(shader);
+	glUniform1i(glGetUniformLocation(shader, "material.albedoMap"), albedoUnit);
+	glUniform1i(glGetUniformLocation(shader, "material.metallicMap"), metallicUnit);
+	glUniform1i(glGetUniformLocation(shader, "material.normalMap"), normalUnit);
+	glUniform1i(glGetUniformLocation(shader, "material.roughnessMap"), roughnessUnit);
+
+	for (const GltfDrawItem& item : drawItems)
+	{
+		// constant per draw: the attribute arrays for 5-8 are disabled
+		for (unsigned int column = 0; column < 4; column++)
+			glVertexAttrib4fv(modelAttribute + column, glm::value_ptr(sceneGraph.GetWorld(item.node)[column]));
+
+		for (const GltfPrimitive& primitive : meshes[item.mesh].primitives)
+		{
+			const bool hasMaterial = primitive.material >= 0 && primitive.material + 1 < (int)materials.size();
+			const GltfMaterial& material = materials[hasMaterial ? primitive.material : materials.size() - 1];
+
+			glBindTextureUnit(albedoUnit, material.albedoMap);
+			glBindTextureUnit(metallicUnit, material.metallicMap);
+			glBindTextureUnit(normalUnit, material.normalMap);
+			glBindTextureUnit(roughnessUnit, material.roughnessMap);
+			glUniform1f(glGetUniformLocation(shader, "material.ao"), material.ao);
+
+			glBindVertexArray(primitive.vao);
+			if (primitive.indexed)
+				glDrawElements(primitive.mode, primitive.count, primitive.indexType, (void*)primitive.indexOffset);
+			else
+				glDrawArrays(primitive.mode, 0, primitive.count);
+		}
+	}
+
+	glBindVertexArray(0);
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <vec4.hpp>
+#include <mat4x4.hpp>
+
+#include "Json.h"
+#include "SceneGraph.h"
+#include "TextureLoader.h"
+
+// raw bytes of one glTF buffer while loading
+struct GltfBufferSource;
+
+struct GltfMaterial
+{
+	// textures for the Material struct of the PBR and IBL shaders
+	GLuint albedoMap = 0;
+	GLuint metallicMap = 0;
+	GLuint normalMap = 0;
+	GLuint roughnessMap = 0;
+	float ao = 1.0f;
+
+	// glTF images, -1 when absent
+	int baseColorImage = -1;
+	int metallicRoughnessImage = -1;
+	int normalImage = -1;
+};
+
+struct GltfPrimitive
+{
+	GLuint vao = 0;
+	GLenum mode = GL_TRIANGLES;
+	GLsizei count = 0;
+	bool indexed = false;
+	GLenum indexType = GL_UNSIGNED_INT;
+	size_t indexOffset = 0;
+	int material = -1;
+};
+
+struct GltfMesh
+{
+	std::vector<GltfPrimitive> primitives;
+};
+
+struct GltfDrawItem
+{
+	unsigned int mesh;
+	SceneNode node;
+};
+
+/*
+	Native glTF 2.0 (.gltf/.glb) reader. Buffers are memory mapped and each buffer view used by
+	vertex or index accessors is uploaded straight from the mapping into its own GL buffer;
+	accessors become vertex array bindings/formats without any conversion. Attributes use the
+	locations of res/shaders/PBR/VertexGltf.glsl. Nodes go into sceneGraph and each world
+	matrix is passed through the instanced model matrix slot (5-8) as a constant attribute.
+
+	Metallic-roughness materials map onto the PBR slots: baseColor -> albedoMap, and two
+	swizzled views of the metallicRoughness texture (blue -> metallicMap, green -> roughnessMap),
+	so the existing shaders read both through .r. Factors are used when a texture is missing.
+	Images (PNG/JPEG/KTX2, external, data URI or embedded) load asynchronously through
+	TextureLoader; call Update every frame, it also refreshes moved nodes.
+
+	Not supported: sparse accessors, skins, morph targets, cameras and samplers.
+*/
+class GltfModel
+{
+public:
+	GltfModel(const std::string& path);
+	~GltfModel();
+
+	GltfModel(const GltfModel&) = delete;
+	GltfModel& operator=(const GltfModel&) = delete;
+
+	bool IsLoaded() const;
+	void Update();
+	void Draw(GLuint shader);
+
+	std::vector<GltfMesh> meshes;
+	std::vector<GltfMaterial> materials;
+	std::vector<GltfDrawItem> drawItems;
+	// the file's node hierarchy
+	SceneGraph sceneGraph;
+
+private:
+	bool loaded = false;
+	std::string directory;
+
+	// GL buffer per glTF buffer view, 0 for views that are not vertex or index data
+	std::vector<GLuint> bufferViews;
+	std::vector<GLuint> images;
+	std::vector<GLuint> ownedTextures;
+	TextureLoader textureLoader;
+
+	GLuint defaultNormal = 0;
+
+	bool load(const std::string& path);
+	GLuint getBufferView(const JsonValue& document, int bufferView, const std::vector<GltfBufferSource>& sources);
+	bool bindAccessor(const JsonValue& document, GLuint vao, GLuint location, int accessor, const std::vector<GltfBufferSource>& sources);
+	void loadMeshes(const JsonValue& document, const std::vector<GltfBufferSource>& sources);
+	void loadMaterials(const JsonValue& document);
+	void loadImages(const JsonValue& document, const std::vector<GltfBufferSource>& sources);
+	void loadNodes(const JsonValue& document);
+	void addNode(const JsonValue& document, int node, SceneNode parent, unsigned int depth);
+
+	void onImageReady(int image, GLuint texture);
+	GLuint createSolidTexture(const glm::vec4& color);
+	GLuint createSwizzledView(GLuint texture, GLenum source);
+};
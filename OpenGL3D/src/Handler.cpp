@@ -20,6 +20,11 @@ Handler::~Handler()
 	delete m_State;
 }
 
+void Handler::SetToggle(bool& toggle)
+{
+	m_State->toggle = &toggle;
+}
+
 WindowState* Handler::GetWindowState(GLFWwindow* window)
 {
 	return (WindowState*)glfwGetWindowUserPointer(window);
@@ -93,6 +98,9 @@ void Handler::HandleKeyboard(GLFWwindow* window, int key, int scancode, int acti
 		else if (key == GLFW_KEY_F)
 			state->spotlightOn = !(state->spotlightOn);
 
+		else if (key == GLFW_KEY_G && state->toggle)
+			*state->toggle = !*state->toggle;
+
 		else if (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS)
 		{
 			unsigned int& lightIndex = state->lightIndex;
@@ -17,6 +17,9 @@ struct WindowState
 
 	bool& spotlightOn;
 	bool cursorOn = false;
+
+	// flipped by G, when a test has one; see Handler::SetToggle
+	bool* toggle = nullptr;
 };
 
 class Handler
@@ -25,6 +28,9 @@ public:
 	Handler(GLFWwindow* window, Camera& camera, bool& spotlightOn);
 	~Handler();
 
+	// Lets G flip toggle, for a test that switches between two ways of drawing at runtime.
+	void SetToggle(bool& toggle);
+
 	static void MaintainKeyboard(GLFWwindow* window);
 	static void HandleKeyboard(GLFWwindow* window, int key, int scancode, int action, int mods);
 	static void HandleCursorPos(GLFWwindow* window, double xPos, double yPos);
@@ -0,0 +1,111 @@
+#include "pch.h"
+#include "HiZPyramid.h"
+#include "Shader.h"
+
+#include <algorithm>
+#include <iostream>
+
+// must match local_size_x and local_size_y in res/shaders/Culling/ComputeHiZ.glsl
+static const int workGroupSize = 8;
+
+HiZPyramid::~HiZPyramid()
+{
+	release();
+}
+
+bool HiZPyramid::Create(int width, int height)
+{
+	release();
+
+	if (width <= 0 || height <= 0)
+	{
+		std::cerr << "[Error: HiZPyramid::Create] Invalid size " << width << "x" << height << "." << std::endl;
+		return false;
+	}
+
+	if (!Shader::loadComputeProgram(program, "res/shaders/Culling/ComputeHiZ.glsl"))
+	{
+		std::cerr << "[Error: HiZPyramid::Create] Could not load reduction program." << std::endl;
+		return false;
+	}
+
+	this->width = width;
+	this->height = height;
+	levelCount = 1;
+	while ((std::max(width, height) >> levelCount) > 0)
+		levelCount++;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureStorage2D(texture, levelCount, GL_RG32F, width, height);
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	return true;
+}
+
+void HiZPyramid::Build(GLuint depthTexture)
+{
+	if (!program)
+		return;
+
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "source"), 0);
+
+	for (int level = 0; level < levelCount; level++)
+	{
+		const int levelWidth = std::max(width >> level, 1);
+		const int levelHeight = std::max(height >> level, 1);
+
+		// level 0 from the depth buffer, every other one from the level below
+		glBindTextureUnit(0, level ? texture : depthTexture);
+		glUniform1i(glGetUniformLocation(program, "fromDepth"), level == 0);
+		glUniform1i(glGetUniformLocation(program, "sourceLevel"), level - 1);
+		glBindImageTexture(0, texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+
+		glDispatchCompute((levelWidth + workGroupSize - 1) / workGroupSize, (levelHeight + workGroupSize - 1) / workGroupSize, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+
+	glBindTextureUnit(0, 0);
+}
+
+void HiZPyramid::Bind(GLuint program, GLuint unit) const
+{
+	glBindTextureUnit(unit, texture);
+	glUniform1i(glGetUniformLocation(program, "hiZ"), unit);
+	glUniform2f(glGetUniformLocation(program, "hiZSize"), (float)width, (float)height);
+	glUniform1i(glGetUniformLocation(program, "hiZLevels"), levelCount);
+}
+
+GLuint HiZPyramid::GetTexture() const
+{
+	return texture;
+}
+
+int HiZPyramid::GetWidth() const
+{
+	return width;
+}
+
+int HiZPyramid::GetHeight() const
+{
+	return height;
+}
+
+int HiZPyramid::GetLevelCount() const
+{
+	return levelCount;
+}
+
+void HiZPyramid::release()
+{
+	glDeleteTextures(1, &texture);
+	glDeleteProgram(program);
+	texture = 0;
+	program = 0;
+	width = 0;
+	height = 0;
+	levelCount = 0;
+}
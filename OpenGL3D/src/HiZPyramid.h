@@ -0,0 +1,43 @@
+#pragma once
+
+/*
+	Hierarchical depth: a mip chain over a depth buffer where every texel holds the nearest (r)
+	and farthest (g) depth of the texels it covers, built by res/shaders/Culling/ComputeHiZ.glsl.
+	Level 0 copies the depth texture; each further level halves the size, taking in a third
+	row or column where the level below is odd so that nothing is skipped.
+
+	A culler projects an object's bounds to a screen rectangle, picks the level at which that
+	rectangle covers at most 2x2 texels and compares the object's nearest depth with their
+	farthest depth (see ComputeInstances.glsl and Meshlet/ComputeCull.glsl).
+*/
+class HiZPyramid
+{
+public:
+	HiZPyramid() = default;
+	~HiZPyramid();
+
+	HiZPyramid(const HiZPyramid&) = delete;
+	HiZPyramid& operator=(const HiZPyramid&) = delete;
+
+	// Allocates the levels for a depth buffer of the given size.
+	bool Create(int width, int height);
+	// Rebuilds every level from depthTexture, a depth texture of the size given to Create.
+	void Build(GLuint depthTexture);
+
+	// Binds the pyramid to unit and sets hiZ, hiZSize and hiZLevels of the bound program.
+	void Bind(GLuint program, GLuint unit) const;
+
+	GLuint GetTexture() const;
+	int GetWidth() const;
+	int GetHeight() const;
+	int GetLevelCount() const;
+
+private:
+	GLuint program = 0;
+	GLuint texture = 0;
+	int width = 0;
+	int height = 0;
+	int levelCount = 0;
+
+	void release();
+};
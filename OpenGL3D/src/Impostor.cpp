@@ -0,0 +1,229 @@
+#include "pch.h"
+#include "Impostor.h"
+#include "Shader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <gtc\matrix_transform.hpp>
+#include <gtc\type_ptr.hpp>
+
+// above the units Mesh::DrawInstanced binds the mesh's own textures to
+static const GLuint bakeTextureUnit = 8;
+
+// must match octahedronDecode in res/shaders/Impostor/VertexImpostor.glsl
+static glm::vec3 octahedronDecode(const glm::vec2& e)
+{
+	glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+	if (n.z < 0.0f)
+	{
+		const float x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+		const float y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+		n.x = x;
+		n.y = y;
+	}
+	return glm::normalize(n);
+}
+
+// must match frameBasis in res/shaders/Impostor/VertexImpostor.glsl
+static glm::vec3 frameUp(const glm::vec3& direction)
+{
+	return std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+Impostor::~Impostor()
+{
+	release();
+}
+
+bool Impostor::Bake(Mesh& mesh, GLuint diffuseTexture, int framesPerSide, int frameSize)
+{
+	release();
+
+	if (mesh.lods.empty() || mesh.boundingSphere.w <= 0.0f || framesPerSide < 2 || frameSize <= 0)
+	{
+		std::cerr << "[Error: Impostor::Bake] Invalid mesh or atlas size." << std::endl;
+		return false;
+	}
+
+	GLuint bakeProgram;
+	if (!Shader::loadProgram(bakeProgram, "res/shaders/Impostor/VertexBake.glsl", "res/shaders/Impostor/FragmentBake.glsl"))
+	{
+		std::cerr << "[Error: Impostor::Bake] Could not load bake program." << std::endl;
+		return false;
+	}
+
+	if (!Shader::loadProgram(program, "res/shaders/Impostor/VertexImpostor.glsl", "res/shaders/Impostor/FragmentImpostor.glsl"))
+	{
+		std::cerr << "[Error: Impostor::Bake] Could not load impostor program." << std::endl;
+		glDeleteProgram(bakeProgram);
+		return false;
+	}
+
+	this->framesPerSide = framesPerSide;
+	boundingSphere = mesh.boundingSphere;
+
+	// Mip levels stop at one texel per frame; below that a level would average neighbouring
+	// frames together. frameSize should be a power of two, or frames will bleed earlier.
+	const int size = framesPerSide * frameSize;
+	int levelCount = 1;
+	while ((frameSize >> levelCount) > 0)
+		levelCount++;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &albedoAtlas);
+	glTextureStorage2D(albedoAtlas, levelCount, GL_RGBA8, size, size);
+	glCreateTextures(GL_TEXTURE_2D, 1, &normalDepthAtlas);
+	glTextureStorage2D(normalDepthAtlas, levelCount, GL_RGBA16F, size, size);
+	for (GLuint atlas : { albedoAtlas, normalDepthAtlas })
+	{
+		glTextureParameteri(atlas, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+		glTextureParameteri(atlas, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTextureParameteri(atlas, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(atlas, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(atlas, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	GLuint depthBuffer;
+	glCreateRenderbuffers(1, &depthBuffer);
+	glNamedRenderbufferStorage(depthBuffer, GL_DEPTH_COMPONENT24, size, size);
+
+	GLuint framebuffer;
+	glCreateFramebuffers(1, &framebuffer);
+	glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, albedoAtlas, 0);
+	glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT1, normalDepthAtlas, 0);
+	glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glNamedFramebufferDrawBuffers(framebuffer, 2, drawBuffers);
+
+	const bool complete = glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	if (complete)
+	{
+		GLint viewport[4];
+		GLint previousFramebuffer;
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+		const GLboolean blend = glIsEnabled(GL_BLEND);
+		const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+
+		// alpha 0 wherever the mesh does not cover a frame; not const, GLEW declares the value pointer without it
+		GLfloat clearColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		GLfloat clearDepth = 1.0f;
+		glClearNamedFramebufferfv(framebuffer, GL_COLOR, 0, clearColor);
+		glClearNamedFramebufferfv(framebuffer, GL_COLOR, 1, clearColor);
+		glClearNamedFramebufferfv(framebuffer, GL_DEPTH, 0, &clearDepth);
+
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+		glDisable(GL_BLEND);
+		glEnable(GL_DEPTH_TEST);
+
+		glUseProgram(bakeProgram);
+		glBindTextureUnit(bakeTextureUnit, diffuseTexture);
+		glUniform1i(glGetUniformLocation(bakeProgram, "diffuseMap"), bakeTextureUnit);
+
+		// one orthographic view per cell, from the surface of the bounding sphere through its centre
+		const glm::vec3 center(boundingSphere);
+		const float radius = boundingSphere.w;
+		const glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius);
+		for (int y = 0; y < framesPerSide; y++)
+		{
+			for (int x = 0; x < framesPerSide; x++)
+			{
+				const glm::vec2 cell((x + 0.5f) / framesPerSide, (y + 0.5f) / framesPerSide);
+				const glm::vec3 direction = octahedronDecode(cell * 2.0f - 1.0f);
+				const glm::mat4 viewProjection = projection * glm::lookAt(center + direction * radius, center, frameUp(direction));
+
+				glViewport(x * frameSize, y * frameSize, frameSize, frameSize);
+				glUniformMatrix4fv(glGetUniformLocation(bakeProgram, "viewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+				mesh.DrawInstanced(bakeProgram, 1, 0, 0);
+			}
+		}
+
+		glBindTextureUnit(bakeTextureUnit, 0);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebuffer);
+		if (blend)
+			glEnable(GL_BLEND);
+		if (!depthTest)
+			glDisable(GL_DEPTH_TEST);
+
+		glGenerateTextureMipmap(albedoAtlas);
+		glGenerateTextureMipmap(normalDepthAtlas);
+	}
+	else
+		std::cerr << "[Error: Impostor::Bake] Framebuffer is not complete!" << std::endl;
+
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &depthBuffer);
+	glDeleteProgram(bakeProgram);
+
+	if (!complete)
+	{
+		release();
+		return false;
+	}
+
+	// no vertex attributes: the quad comes from gl_VertexID, the instances from the caller's buffer
+	glCreateVertexArrays(1, &vao);
+
+	return true;
+}
+
+void Impostor::Draw(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos,
+	GLsizei instanceCount, GLuint baseInstance, GLuint unit) const
+{
+	if (!program || instanceCount <= 0)
+		return;
+
+	glUseProgram(program);
+	glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, glm::value_ptr(view));
+	glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+	glUniform3fv(glGetUniformLocation(program, "viewPos"), 1, glm::value_ptr(viewPos));
+	glUniform4fv(glGetUniformLocation(program, "boundingSphere"), 1, glm::value_ptr(boundingSphere));
+	glUniform1i(glGetUniformLocation(program, "framesPerSide"), framesPerSide);
+
+	glBindTextureUnit(unit, albedoAtlas);
+	glBindTextureUnit(unit + 1, normalDepthAtlas);
+	glUniform1i(glGetUniformLocation(program, "albedoAtlas"), unit);
+	glUniform1i(glGetUniformLocation(program, "normalDepthAtlas"), unit + 1);
+
+	glBindVertexArray(vao);
+	glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, instanceCount, baseInstance);
+}
+
+GLuint Impostor::GetProgram() const
+{
+	return program;
+}
+
+GLuint Impostor::GetVertexArray() const
+{
+	return vao;
+}
+
+GLuint Impostor::GetAlbedoAtlas() const
+{
+	return albedoAtlas;
+}
+
+GLuint Impostor::GetNormalDepthAtlas() const
+{
+	return normalDepthAtlas;
+}
+
+int Impostor::GetFramesPerSide() const
+{
+	return framesPerSide;
+}
+
+void Impostor::release()
+{
+	glDeleteVertexArrays(1, &vao);
+	glDeleteTextures(1, &albedoAtlas);
+	glDeleteTextures(1, &normalDepthAtlas);
+	glDeleteProgram(program);
+	vao = 0;
+	albedoAtlas = 0;
+	normalDepthAtlas = 0;
+	program = 0;
+	framesPerSide = 0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <mat4x4.hpp>
+#include <vec3.hpp>
+#include <vec4.hpp>
+
+#include "Mesh.h"
+
+/*
+	Stand-in for a mesh far from the camera: a camera facing quad that samples pictures of the
+	mesh taken beforehand. Bake renders the mesh orthographically from framesPerSide^2
+	directions spread over the sphere by an octahedral map into two atlases, one cell per
+	direction: albedo (alpha marks coverage) and object space normal with depth through the
+	bounding sphere.
+
+	Draw expands every instance of the attached instance buffer (ModelInstanceLayout) to a quad
+	around its bounding sphere. res/shaders/Impostor/FragmentImpostor.glsl blends the four
+	frames nearest the view direction, rotates the baked normal with the instance and moves
+	gl_FragDepth to the baked surface, so impostors intersect each other and the scene like
+	meshes. Over fadeRange the mesh (FragmentCore.glsl) and the impostor dither into each
+	other with the same pattern, so that a crossfading instance drawn both ways covers each
+	pixel once.
+*/
+class Impostor
+{
+public:
+	Impostor() = default;
+	~Impostor();
+
+	Impostor(const Impostor&) = delete;
+	Impostor& operator=(const Impostor&) = delete;
+
+	// Renders the full resolution level of mesh, textured with diffuseTexture, into atlases of
+	// framesPerSide x framesPerSide frames of frameSize pixels.
+	bool Bake(Mesh& mesh, GLuint diffuseTexture, int framesPerSide = 12, int frameSize = 64);
+
+	// Draws instances [baseInstance, baseInstance + instanceCount) of the instance buffer attached
+	// to GetVertexArray(), with the atlases bound to unit and unit + 1. Lights, shininess and
+	// fadeRange are the caller's to set on GetProgram().
+	void Draw(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos,
+		GLsizei instanceCount, GLuint baseInstance = 0, GLuint unit = 3) const;
+
+	GLuint GetProgram() const;
+	GLuint GetVertexArray() const;
+	GLuint GetAlbedoAtlas() const;
+	GLuint GetNormalDepthAtlas() const;
+	int GetFramesPerSide() const;
+
+private:
+	GLuint program = 0;
+	GLuint vao = 0;
+	GLuint albedoAtlas = 0;
+	GLuint normalDepthAtlas = 0;
+	glm::vec4 boundingSphere = glm::vec4(0.0f);
+	int framesPerSide = 0;
+
+	void release();
+};
@@ -0,0 +1,95 @@
+#include "pch.h"
+#include "InstanceBuffer.h"
+
+#include <algorithm>
+#include <iostream>
+
+static_assert(ModelInstanceLayout::GetStride() == 32, "compact instance transforms take 32 bytes");
+
+InstanceBuffer::~InstanceBuffer()
+{
+	glDeleteBuffers(1, &buffer);
+}
+
+void InstanceBuffer::Attach(GLuint vao, GLuint binding)
+{
+	// another buffer may have been attached to vao since, so the binding is always re-pointed
+	glVertexArrayVertexBuffer(vao, binding, buffer, 0, stride);
+
+	std::vector<std::pair<GLuint, GLuint>>::iterator entry = std::find_if(attached.begin(), attached.end(),
+		[vao](const std::pair<GLuint, GLuint>& entry) { return entry.first == vao; });
+	if (entry == attached.end())
+		attached.push_back({ vao, binding });
+	else if (entry->second != binding)
+		entry->second = binding;
+	else
+		return;
+
+	glVertexArrayBindingDivisor(vao, binding, 1);
+	for (const VertexAttribute& attribute : attributes)
+		VertexEncoding::setupAttribute(vao, attribute, binding);
+}
+
+void InstanceBuffer::Update(const void* instances, size_t first, size_t count)
+{
+	if (!count)
+		return;
+
+	Reserve(first + count);
+	glNamedBufferSubData(buffer, first * stride, count * stride, instances);
+	this->count = std::max(this->count, first + count);
+}
+
+void InstanceBuffer::SetCount(size_t count)
+{
+	if (count > capacity)
+	{
+		std::cerr << "[Error: InstanceBuffer] Count " << count << " exceeds the capacity of " << capacity << "." << std::endl;
+		count = capacity;
+	}
+
+	this->count = count;
+}
+
+size_t InstanceBuffer::GetCount() const
+{
+	return count;
+}
+
+size_t InstanceBuffer::GetCapacity() const
+{
+	return capacity;
+}
+
+GLuint InstanceBuffer::GetBuffer() const
+{
+	return buffer;
+}
+
+const std::string& InstanceBuffer::GetGlslInputs() const
+{
+	return glslInputs;
+}
+
+void InstanceBuffer::Reserve(size_t instanceCount)
+{
+	if (instanceCount <= capacity && buffer)
+		return;
+
+	// immutable storage: grow into a new buffer and carry the instances written so far over
+	const size_t newCapacity = std::max(std::max(instanceCount, capacity * 2), (size_t)1);
+	GLuint newBuffer;
+	glCreateBuffers(1, &newBuffer);
+	glNamedBufferStorage(newBuffer, newCapacity * stride, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	if (buffer)
+	{
+		if (count)
+			glCopyNamedBufferSubData(buffer, newBuffer, 0, 0, count * stride);
+		glDeleteBuffers(1, &buffer);
+	}
+
+	buffer = newBuffer;
+	capacity = newCapacity;
+	for (const std::pair<GLuint, GLuint>& entry : attached)
+		glVertexArrayVertexBuffer(entry.first, entry.second, buffer, 0, stride);
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "VertexLayout.h"
+
+// scale, then rotation, then translation; half the size of a matrix once packed
+struct InstanceTransform
+{
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::vec3 scale = glm::vec3(1.0f);
+};
+
+// InstanceTransform in 32 bytes, at the VertexCore.glsl locations
+using ModelInstanceLayout = VertexLayout<InstancePosition<float3>, InstanceRotation<quat16>, InstanceScale<float3>>;
+// the same after the tangent and normal of the PBR shaders
+using PbrInstanceLayout = VertexLayout<InstancePosition<float3, 5>, InstanceRotation<quat16, 6>, InstanceScale<float3, 7>>;
+
+/*
+	Per-instance vertex data owned on the GPU. The instance format is a VertexLayout of
+	instance semantics, given once at construction:
+
+		InstanceBuffer instances(ModelInstanceLayout(), count);
+		instances.Update(ModelInstanceLayout::Pack(transforms).data(), 0, count);
+		model.DrawInstanced(shader, instances);
+
+	Attach points a vertex array at the buffer with a divisor of 1; Model::DrawInstanced
+	attaches every mesh of a model on first use. Update writes a range of instances in place
+	and grows the storage (doubling, contents kept) when the range ends past the capacity;
+	attached vertex arrays are re-pointed at the new buffer. GetGlslInputs returns the matching
+	shader declarations for Shader::loadLayoutProgram.
+*/
+class InstanceBuffer
+{
+public:
+	template<typename Layout>
+	InstanceBuffer(Layout, size_t capacity = 0)
+		: stride(Layout::GetStride()), glslInputs(Layout::GetGlslInputs())
+	{
+		static_assert(Layout::GetStride() % 4 == 0, "instance stride must be a multiple of 4 bytes");
+		static_assert(Layout::HasUniqueLocations(), "two attributes share a location");
+
+		for (size_t i = 0; i < Layout::GetAttributeCount(); i++)
+			attributes.push_back(Layout::GetAttribute(i));
+		Reserve(capacity);
+	}
+	~InstanceBuffer();
+
+	InstanceBuffer(const InstanceBuffer&) = delete;
+	InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+	// Uses binding for the instance attributes of vao; attaching the same vao again only re-points the binding.
+	void Attach(GLuint vao, GLuint binding = 1);
+	// Writes count instances (stride bytes each, in the layout's formats) starting at first.
+	void Update(const void* instances, size_t first, size_t count);
+	// Instances drawn by default; Update extends it, SetCount sets it (within the capacity).
+	void SetCount(size_t count);
+	// Grows the storage to hold instanceCount instances, for buffers written on the GPU.
+	void Reserve(size_t instanceCount);
+
+	size_t GetCount() const;
+	size_t GetCapacity() const;
+	GLuint GetBuffer() const;
+	const std::string& GetGlslInputs() const;
+
+private:
+	GLsizei stride;
+	std::vector<VertexAttribute> attributes;
+	std::string glslInputs;
+
+	GLuint buffer = 0;
+	size_t capacity = 0;
+	size_t count = 0;
+	// vertex arrays and the bindings they use
+	std::vector<std::pair<GLuint, GLuint>> attached;
+};
@@ -0,0 +1,289 @@
+#include "pch.h"
+#include "InstanceCuller.h"
+#include "Frustum.h"
+#include "HiZPyramid.h"
+#include "Mesh.h"
+#include "Shader.h"
+
+#include <algorithm>
+#include <iostream>
+#include <gtc\type_ptr.hpp>
+
+// must match local_size_x and lodDistances[] in res/shaders/Culling/ComputeInstances.glsl
+static const unsigned int workGroupSize = 256;
+static const unsigned int maxLods = 8;
+// must match the PHASE_ constants in res/shaders/Culling/ComputeInstances.glsl
+static const GLuint phaseAll = 0;
+static const GLuint phaseEarly = 1;
+static const GLuint phaseLate = 2;
+// frustumCulled, occluded
+static const size_t statsSize = 2 * sizeof(GLuint);
+
+InstanceCuller::InstanceCuller()
+	: visible(ModelInstanceLayout())
+{}
+
+InstanceCuller::~InstanceCuller()
+{
+	release();
+}
+
+bool InstanceCuller::Setup(Mesh& mesh, const InstanceBuffer& instances, float pixelError)
+{
+	release();
+
+	if (!Shader::loadPreludeComputeProgram(program, "res/shaders/Culling/ComputeInstances.glsl", "res/shaders/Culling/HiZOcclusion.glsl"))
+	{
+		std::cerr << "[Error: InstanceCuller::Setup] Could not load cull program." << std::endl;
+		return false;
+	}
+
+	if (mesh.vertices.empty())
+	{
+		std::cerr << "[Error: InstanceCuller::Setup] Mesh has no vertices." << std::endl;
+		return false;
+	}
+
+	this->mesh = &mesh;
+	this->instances = &instances;
+	this->pixelError = pixelError;
+
+	boundingSphere = mesh.boundingSphere;
+
+	const unsigned int lodCount = (unsigned int)std::min<size_t>(mesh.lods.size(), maxLods);
+	lodDistances.resize(lodCount);
+	// early (or single phase) commands first, late ones after them
+	resetCommands.resize(2 * lodCount);
+	for (unsigned int i = 0; i < lodCount; i++)
+		resetCommands[i] = resetCommands[lodCount + i] = { mesh.lods[i].indexCount, 0, mesh.lods[i].indexOffset, 0, 0 };
+	visibleCounts.assign(lodCount, 0);
+	stats = OcclusionStats();
+
+	const GLsizeiptr commandSize = resetCommands.size() * sizeof(DrawElementsIndirectCommand);
+	glCreateBuffers(1, &commandBuffer);
+	glNamedBufferStorage(commandBuffer, commandSize, resetCommands.data(), GL_DYNAMIC_STORAGE_BIT);
+	glCreateBuffers(1, &statsBuffer);
+	glNamedBufferStorage(statsBuffer, statsSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	// the commands, then the stats
+	const GLbitfield mapFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(readbackCount, readbackBuffers);
+	for (unsigned int i = 0; i < readbackCount; i++)
+	{
+		glNamedBufferStorage(readbackBuffers[i], commandSize + statsSize, nullptr, mapFlags | GL_CLIENT_STORAGE_BIT);
+		readbackCommands[i] = (const DrawElementsIndirectCommand*)glMapNamedBufferRange(readbackBuffers[i], 0, commandSize + statsSize, mapFlags);
+	}
+
+	return true;
+}
+
+void InstanceCuller::Cull(const glm::mat4& viewProjection, const glm::vec3& viewPos, float fovY, float screenHeight)
+{
+	if (!program)
+		return;
+
+	begin(viewProjection, viewPos, fovY, screenHeight);
+	dispatch(phaseAll, 0, 0);
+	queueReadback();
+}
+
+void InstanceCuller::CullEarly(const glm::mat4& viewProjection, const glm::vec3& viewPos, float fovY, float screenHeight)
+{
+	if (!program)
+		return;
+
+	begin(viewProjection, viewPos, fovY, screenHeight);
+	dispatch(phaseEarly, 0, 0);
+}
+
+void InstanceCuller::CullLate(const HiZPyramid& occluders)
+{
+	if (!program)
+		return;
+
+	glUseProgram(program);
+	occluders.Bind(program, 0);
+	dispatch(phaseLate, (GLuint)(resetCommands.size() / 2), (GLuint)instances->GetCount());
+	glBindTextureUnit(0, 0);
+	queueReadback();
+}
+
+void InstanceCuller::Draw(GLuint shader)
+{
+	if (!program)
+		return;
+
+	visible.Attach(mesh->vao);
+	mesh->DrawIndirect(shader, commandBuffer, (GLsizei)(resetCommands.size() / 2), drawCommand);
+}
+
+const std::vector<unsigned int>& InstanceCuller::GetVisibleCounts() const
+{
+	return visibleCounts;
+}
+
+unsigned int InstanceCuller::GetVisibleCount() const
+{
+	unsigned int count = 0;
+	for (unsigned int levelCount : visibleCounts)
+		count += levelCount;
+
+	return count;
+}
+
+const OcclusionStats& InstanceCuller::GetStats() const
+{
+	return stats;
+}
+
+void InstanceCuller::begin(const glm::mat4& viewProjection, const glm::vec3& viewPos, float fovY, float screenHeight)
+{
+	collectCounts();
+
+	// room for both phases
+	const unsigned int instanceCount = (unsigned int)instances->GetCount();
+	visible.Reserve(2 * (size_t)instanceCount);
+	reserveSlots(instanceCount);
+
+	glNamedBufferSubData(commandBuffer, 0, resetCommands.size() * sizeof(DrawElementsIndirectCommand), resetCommands.data());
+	glClearNamedBufferData(statsBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+	// at unit scale; the shader scales them per instance
+	for (unsigned int i = 0; i < lodDistances.size(); i++)
+		lodDistances[i] = mesh->GetLodDistance(i, fovY, screenHeight, pixelError);
+
+	const Frustum frustum(viewProjection);
+
+	glUseProgram(program);
+	glUniform1ui(glGetUniformLocation(program, "instanceCount"), instanceCount);
+	glUniform1ui(glGetUniformLocation(program, "lodCount"), (GLuint)lodDistances.size());
+	glUniform1fv(glGetUniformLocation(program, "lodDistances"), (GLsizei)lodDistances.size(), lodDistances.data());
+	glUniform4fv(glGetUniformLocation(program, "boundingSphere"), 1, glm::value_ptr(boundingSphere));
+	glUniform4fv(glGetUniformLocation(program, "frustumPlanes"), 6, glm::value_ptr(frustum.planes[0]));
+	glUniform3fv(glGetUniformLocation(program, "viewPos"), 1, glm::value_ptr(viewPos));
+	glUniformMatrix4fv(glGetUniformLocation(program, "viewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+}
+
+void InstanceCuller::dispatch(GLuint phase, GLuint firstCommand, GLuint firstOutput)
+{
+	const GLuint instanceCount = (GLuint)instances->GetCount();
+
+	glUseProgram(program);
+	glUniform1ui(glGetUniformLocation(program, "phase"), phase);
+	glUniform1ui(glGetUniformLocation(program, "commandOffset"), firstCommand);
+	glUniform1ui(glGetUniformLocation(program, "outputOffset"), firstOutput);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instances->GetBuffer());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visible.GetBuffer());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, slotBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, visibilityBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, statsBuffer);
+
+	// first the tests and per level counts, then the copies once every count is known
+	const GLuint groupCount = (instanceCount + workGroupSize - 1) / workGroupSize;
+	glUniform1i(glGetUniformLocation(program, "scatter"), GL_FALSE);
+	glDispatchCompute(groupCount, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	glUniform1i(glGetUniformLocation(program, "scatter"), GL_TRUE);
+	glDispatchCompute(groupCount, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	drawCommand = firstCommand;
+}
+
+void InstanceCuller::queueReadback()
+{
+	// counts and stats for a later frame
+	const GLsizeiptr commandSize = resetCommands.size() * sizeof(DrawElementsIndirectCommand);
+	if (readbackFences[readbackIndex])
+		glDeleteSync(readbackFences[readbackIndex]);
+	glCopyNamedBufferSubData(commandBuffer, readbackBuffers[readbackIndex], 0, 0, commandSize);
+	glCopyNamedBufferSubData(statsBuffer, readbackBuffers[readbackIndex], 0, commandSize, statsSize);
+	readbackFences[readbackIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	readbackIndex = (readbackIndex + 1) % readbackCount;
+}
+
+void InstanceCuller::reserveSlots(size_t instanceCount)
+{
+	if (instanceCount <= slotCapacity && slotBuffer)
+		return;
+
+	glDeleteBuffers(1, &slotBuffer);
+	glDeleteBuffers(1, &visibilityBuffer);
+	slotCapacity = std::max(std::max(instanceCount, slotCapacity * 2), (size_t)1);
+	glCreateBuffers(1, &slotBuffer);
+	glNamedBufferStorage(slotBuffer, slotCapacity * sizeof(unsigned int), nullptr, 0);
+
+	// nothing counts as visible last frame, so the next late phase tests and draws everything
+	glCreateBuffers(1, &visibilityBuffer);
+	glNamedBufferStorage(visibilityBuffer, slotCapacity * sizeof(unsigned int), nullptr, 0);
+	glClearNamedBufferData(visibilityBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+}
+
+void InstanceCuller::collectCounts()
+{
+	// newest readback whose copy has completed, checked without waiting; older ones are dropped
+	bool found = false;
+	for (unsigned int i = 1; i <= readbackCount; i++)
+	{
+		const unsigned int index = (readbackIndex + readbackCount - i) % readbackCount;
+		if (!readbackFences[index])
+			continue;
+
+		if (!found)
+		{
+			const GLenum status = glClientWaitSync(readbackFences[index], 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				continue;
+
+			const DrawElementsIndirectCommand* commands = readbackCommands[index];
+			const size_t lodCount = visibleCounts.size();
+			stats.drawnEarly = 0;
+			stats.drawnLate = 0;
+			for (size_t level = 0; level < lodCount; level++)
+			{
+				visibleCounts[level] = commands[level].instanceCount + commands[lodCount + level].instanceCount;
+				stats.drawnEarly += commands[level].instanceCount;
+				stats.drawnLate += commands[lodCount + level].instanceCount;
+			}
+
+			const GLuint* counters = (const GLuint*)(commands + resetCommands.size());
+			stats.frustumCulled = counters[0];
+			stats.occluded = counters[1];
+			found = true;
+		}
+
+		glDeleteSync(readbackFences[index]);
+		readbackFences[index] = 0;
+	}
+}
+
+void InstanceCuller::release()
+{
+	for (unsigned int i = 0; i < readbackCount; i++)
+	{
+		if (readbackFences[i])
+			glDeleteSync(readbackFences[i]);
+		readbackFences[i] = 0;
+		readbackCommands[i] = nullptr;
+	}
+
+	// deleting a buffer unmaps it
+	glDeleteBuffers(readbackCount, readbackBuffers);
+	glDeleteBuffers(1, &commandBuffer);
+	glDeleteBuffers(1, &statsBuffer);
+	glDeleteBuffers(1, &slotBuffer);
+	glDeleteBuffers(1, &visibilityBuffer);
+	glDeleteProgram(program);
+
+	for (unsigned int i = 0; i < readbackCount; i++)
+		readbackBuffers[i] = 0;
+	commandBuffer = 0;
+	statsBuffer = 0;
+	slotBuffer = 0;
+	visibilityBuffer = 0;
+	slotCapacity = 0;
+	program = 0;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <vector>
+#include <vec3.hpp>
+#include <vec4.hpp>
+#include <mat4x4.hpp>
+
+#include "IndirectCommand.h"
+#include "InstanceBuffer.h"
+
+class HiZPyramid;
+class Mesh;
+
+struct OcclusionStats
+{
+	unsigned int frustumCulled = 0;
+	unsigned int occluded = 0;
+	unsigned int drawnEarly = 0;
+	unsigned int drawnLate = 0;
+};
+
+/*
+	Frustum culling and level of detail selection for the instances of one mesh, on the GPU.
+	Cull runs res/shaders/Culling/ComputeInstances.glsl over the packed transforms of an
+	InstanceBuffer (ModelInstanceLayout): every instance tests the mesh's bounding sphere
+	against the frustum and picks its level with the rule of Mesh::SelectLod, then the visible
+	transforms are compacted, grouped by level, into the culler's own instance buffer and one
+	DrawElementsIndirectCommand per level is filled in. Draw is a single
+	glMultiDrawElementsIndirect; nothing is read back on the way.
+
+	Occlusion culling takes two phases around a HiZPyramid. CullEarly draws the instances that
+	were visible at the end of the last frame, without an occlusion test; the caller builds the
+	pyramid from the resulting depth and CullLate tests every instance in the frustum against it.
+	It keeps the visibility for the next frame and draws those that are visible now but were
+	not drawn early. Each phase writes its own commands and its own half of the visible buffer,
+	so the early draws are never overwritten while in flight.
+
+	The visible counts and stats are copied into a small ring of mapped buffers and picked up
+	once their fence has passed, so GetVisibleCounts lags the frame by up to two culls without
+	stalling.
+*/
+class InstanceCuller
+{
+public:
+	InstanceCuller();
+	~InstanceCuller();
+
+	InstanceCuller(const InstanceCuller&) = delete;
+	InstanceCuller& operator=(const InstanceCuller&) = delete;
+
+	// mesh and instances must outlive the culler; the instance count is read at every Cull.
+	bool Setup(Mesh& mesh, const InstanceBuffer& instances, float pixelError);
+	// Levels keep their error below pixelError pixels for the given projection (fovY in radians).
+	void Cull(const glm::mat4& viewProjection, const glm::vec3& viewPos, float fovY, float screenHeight);
+	// Two phase occlusion culling; see above. CullLate uses the arguments of the last CullEarly.
+	void CullEarly(const glm::mat4& viewProjection, const glm::vec3& viewPos, float fovY, float screenHeight);
+	void CullLate(const HiZPyramid& occluders);
+	// Attaches the visible instances to the mesh's vertex array and draws every level of the
+	// last cull or phase.
+	void Draw(GLuint shader);
+
+	// visible instances per level, both phases together, as of a recent cull
+	const std::vector<unsigned int>& GetVisibleCounts() const;
+	unsigned int GetVisibleCount() const;
+	const OcclusionStats& GetStats() const;
+
+private:
+	static const unsigned int readbackCount = 3;
+
+	GLuint program = 0;
+	Mesh* mesh = nullptr;
+	const InstanceBuffer* instances = nullptr;
+	float pixelError = 1.0f;
+	InstanceBuffer visible;
+
+	glm::vec4 boundingSphere;
+	std::vector<float> lodDistances;
+	// one command per level for each phase, with a zero instance count, uploaded before every cull
+	std::vector<DrawElementsIndirectCommand> resetCommands;
+	GLuint commandBuffer = 0;
+	// first command of the last cull or phase
+	size_t drawCommand = 0;
+	// frustum culled and occluded counters
+	GLuint statsBuffer = 0;
+
+	// per instance slots and visibility, grown together
+	GLuint slotBuffer = 0;
+	GLuint visibilityBuffer = 0;
+	size_t slotCapacity = 0;
+
+	GLuint readbackBuffers[readbackCount] = {};
+	const DrawElementsIndirectCommand* readbackCommands[readbackCount] = {};
+	GLsync readbackFences[readbackCount] = {};
+	unsigned int readbackIndex = 0;
+	std::vector<unsigned int> visibleCounts;
+	OcclusionStats stats;
+
+	void begin(const glm::mat4& viewProjection, const glm::vec3& viewPos, float fovY, float screenHeight);
+	void dispatch(GLuint phase, GLuint firstCommand, GLuint firstOutput);
+	void queueReadback();
+	void reserveSlots(size_t instanceCount);
+	void collectCounts();
+	void release();
+};
@@ -0,0 +1,314 @@
+#include "pch.h"
+#include "Json.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static const JsonValue nullValue;
+
+// nesting limit so that malformed files cannot exhaust the stack
+static const unsigned int maxDepth = 128;
+
+const JsonValue& JsonValue::operator[](const char* key) const
+{
+	if (type == JsonType::OBJECT)
+		for (const std::pair<std::string, JsonValue>& member : object)
+			if (member.first == key)
+				return member.second;
+
+	return nullValue;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+	if (type == JsonType::ARRAY && index < array.size())
+		return array[index];
+
+	return nullValue;
+}
+
+const JsonValue& JsonValue::operator[](int index) const
+{
+	return index < 0 ? nullValue : (*this)[(size_t)index];
+}
+
+bool JsonValue::Has(const char* key) const
+{
+	return &(*this)[key] != &nullValue;
+}
+
+size_t JsonValue::Size() const
+{
+	return type == JsonType::ARRAY ? array.size() : type == JsonType::OBJECT ? object.size() : 0;
+}
+
+double JsonValue::AsNumber(double fallback) const
+{
+	return type == JsonType::NUMBER ? number : fallback;
+}
+
+int JsonValue::AsInt(int fallback) const
+{
+	return type == JsonType::NUMBER ? (int)number : fallback;
+}
+
+bool JsonValue::AsBool(bool fallback) const
+{
+	return type == JsonType::BOOLEAN ? boolean : fallback;
+}
+
+const std::string& JsonValue::AsString() const
+{
+	return string;
+}
+
+static void skipWhitespace(const char*& p, const char* end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+		p++;
+}
+
+static void appendUtf8(std::string& out, unsigned int codePoint)
+{
+	if (codePoint < 0x80)
+		out += (char)codePoint;
+	else if (codePoint < 0x800)
+	{
+		out += (char)(0xC0 | (codePoint >> 6));
+		out += (char)(0x80 | (codePoint & 0x3F));
+	}
+	else if (codePoint < 0x10000)
+	{
+		out += (char)(0xE0 | (codePoint >> 12));
+		out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+		out += (char)(0x80 | (codePoint & 0x3F));
+	}
+	else
+	{
+		out += (char)(0xF0 | (codePoint >> 18));
+		out += (char)(0x80 | ((codePoint >> 12) & 0x3F));
+		out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+		out += (char)(0x80 | (codePoint & 0x3F));
+	}
+}
+
+static bool parseHex4(const char*& p, const char* end, unsigned int& outValue)
+{
+	if (end - p < 4)
+		return false;
+
+	outValue = 0;
+	for (int i = 0; i < 4; i++, p++)
+	{
+		const char c = *p;
+		outValue <<= 4;
+		if (c >= '0' && c <= '9')
+			outValue |= c - '0';
+		else if (c >= 'a' && c <= 'f')
+			outValue |= c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F')
+			outValue |= c - 'A' + 10;
+		else
+			return false;
+	}
+
+	return true;
+}
+
+static bool parseString(const char*& p, const char* end, std::string& out)
+{
+	// p is on the opening quote
+	p++;
+	while (p < end && *p != '"')
+	{
+		if (*p != '\\')
+		{
+			out += *p++;
+			continue;
+		}
+
+		if (++p >= end)
+			return false;
+
+		switch (*p++)
+		{
+		case '"': out += '"'; break;
+		case '\\': out += '\\'; break;
+		case '/': out += '/'; break;
+		case 'b': out += '\b'; break;
+		case 'f': out += '\f'; break;
+		case 'n': out += '\n'; break;
+		case 'r': out += '\r'; break;
+		case 't': out += '\t'; break;
+		case 'u':
+		{
+			unsigned int codePoint;
+			if (!parseHex4(p, end, codePoint))
+				return false;
+
+			// surrogate pair
+			if (codePoint >= 0xD800 && codePoint < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+			{
+				p += 2;
+				unsigned int low;
+				if (!parseHex4(p, end, low))
+					return false;
+				codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+			}
+
+			appendUtf8(out, codePoint);
+			break;
+		}
+		default:
+			return false;
+		}
+	}
+
+	if (p >= end)
+		return false;
+
+	p++;
+	return true;
+}
+
+static bool parseValue(const char*& p, const char* end, JsonValue& out, unsigned int depth)
+{
+	skipWhitespace(p, end);
+	if (p >= end || depth > maxDepth)
+		return false;
+
+	switch (*p)
+	{
+	case '{':
+	{
+		out.type = JsonType::OBJECT;
+		p++;
+		skipWhitespace(p, end);
+		if (p < end && *p == '}')
+		{
+			p++;
+			return true;
+		}
+
+		while (p < end)
+		{
+			skipWhitespace(p, end);
+			if (p >= end || *p != '"')
+				return false;
+
+			out.object.emplace_back();
+			if (!parseString(p, end, out.object.back().first))
+				return false;
+
+			skipWhitespace(p, end);
+			if (p >= end || *p++ != ':')
+				return false;
+
+			if (!parseValue(p, end, out.object.back().second, depth + 1))
+				return false;
+
+			skipWhitespace(p, end);
+			if (p < end && *p == ',')
+			{
+				p++;
+				continue;
+			}
+			if (p < end && *p == '}')
+			{
+				p++;
+				return true;
+			}
+			return false;
+		}
+		return false;
+	}
+	case '[':
+	{
+		out.type = JsonType::ARRAY;
+		p++;
+		skipWhitespace(p, end);
+		if (p < end && *p == ']')
+		{
+			p++;
+			return true;
+		}
+
+		while (p < end)
+		{
+			out.array.emplace_back();
+			if (!parseValue(p, end, out.array.back(), depth + 1))
+				return false;
+
+			skipWhitespace(p, end);
+			if (p < end && *p == ',')
+			{
+				p++;
+				continue;
+			}
+			if (p < end && *p == ']')
+			{
+				p++;
+				return true;
+			}
+			return false;
+		}
+		return false;
+	}
+	case '"':
+		out.type = JsonType::STRING;
+		return parseString(p, end, out.string);
+	case 't':
+		out.type = JsonType::BOOLEAN;
+		out.boolean = true;
+		if (end - p < 4 || memcmp(p, "true", 4) != 0)
+			return false;
+		p += 4;
+		return true;
+	case 'f':
+		out.type = JsonType::BOOLEAN;
+		out.boolean = false;
+		if (end - p < 5 || memcmp(p, "false", 5) != 0)
+			return false;
+		p += 5;
+		return true;
+	case 'n':
+		out.type = JsonType::NUL;
+		if (end - p < 4 || memcmp(p, "null", 4) != 0)
+			return false;
+		p += 4;
+		return true;
+	default:
+	{
+		// strtod needs a terminated string
+		char buffer[64];
+		size_t length = 0;
+		while (p + length < end && length < sizeof(buffer) - 1 && strchr("+-0123456789.eE", p[length]))
+			length++;
+		if (!length)
+			return false;
+
+		memcpy(buffer, p, length);
+		buffer[length] = '\0';
+
+		out.type = JsonType::NUMBER;
+		out.number = strtod(buffer, nullptr);
+		p += length;
+		return true;
+	}
+	}
+}
+
+bool Json::parse(const char* begin, const char* end, JsonValue& outValue)
+{
+	outValue = JsonValue();
+	const char* p = begin;
+
+	if (!parseValue(p, end, outValue, 0))
+	{
+		std::cerr << "[Error: Json::parse] Syntax error at offset " << (p - begin) << "." << std::endl;
+		return false;
+	}
+
+	return true;
+}
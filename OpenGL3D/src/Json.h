@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+
+enum class JsonType
+{
+	NUL,
+	BOOLEAN,
+	NUMBER,
+	STRING,
+	ARRAY,
+	OBJECT
+};
+
+// Minimal JSON document tree, enough for glTF. Missing members and elements read as null.
+class JsonValue
+{
+public:
+	JsonType type = JsonType::NUL;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::vector<std::pair<std::string, JsonValue>> object;
+
+	const JsonValue& operator[](const char* key) const;
+	const JsonValue& operator[](size_t index) const;
+	// negative indices read as null, so parsed "-1" fallbacks can be passed straight through
+	const JsonValue& operator[](int index) const;
+
+	bool Has(const char* key) const;
+	size_t Size() const;
+
+	double AsNumber(double fallback = 0.0) const;
+	int AsInt(int fallback = 0) const;
+	bool AsBool(bool fallback = false) const;
+	const std::string& AsString() const;
+};
+
+namespace Json
+{
+	bool parse(const char* begin, const char* end, JsonValue& outValue);
+}
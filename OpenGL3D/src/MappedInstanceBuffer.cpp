@@ -0,0 +1,77 @@
+#include "pch.h"
+#include "MappedInstanceBuffer.h"
+
+#include <iostream>
+
+MappedInstanceBuffer::~MappedInstanceBuffer()
+{
+	for (GLsync fence : fences)
+		if (fence)
+			glDeleteSync(fence);
+
+	// deleting the buffer unmaps it
+	glDeleteBuffers(1, &buffer);
+}
+
+void MappedInstanceBuffer::Attach(GLuint vao, GLuint binding)
+{
+	glVertexArrayVertexBuffer(vao, binding, buffer, 0, stride);
+	glVertexArrayBindingDivisor(vao, binding, 1);
+	for (const VertexAttribute& attribute : attributes)
+		VertexEncoding::setupAttribute(vao, attribute, binding);
+}
+
+unsigned char* MappedInstanceBuffer::Map()
+{
+	if (!mapped)
+		return nullptr;
+
+	region = (region + 1) % regionCount;
+
+	// the GPU may still be reading this region from three frames ago
+	GLsync& fence = fences[region];
+	if (fence)
+	{
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		glDeleteSync(fence);
+		fence = 0;
+	}
+
+	return mapped + region * capacity * stride;
+}
+
+void MappedInstanceBuffer::Fence()
+{
+	if (fences[region])
+		glDeleteSync(fences[region]);
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLuint MappedInstanceBuffer::GetBaseInstance() const
+{
+	return (GLuint)(region * capacity);
+}
+
+size_t MappedInstanceBuffer::GetCapacity() const
+{
+	return capacity;
+}
+
+GLsizei MappedInstanceBuffer::GetStride() const
+{
+	return stride;
+}
+
+void MappedInstanceBuffer::create(size_t capacity)
+{
+	this->capacity = capacity;
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	const GLsizeiptr size = regionCount * capacity * stride;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, size, nullptr, flags);
+	mapped = (unsigned char*)glMapNamedBufferRange(buffer, 0, size, flags);
+
+	if (!mapped)
+		std::cerr << "[Error: MappedInstanceBuffer] Could not map " << size << " bytes." << std::endl;
+}
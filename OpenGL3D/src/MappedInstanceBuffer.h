@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+
+#include "VertexLayout.h"
+
+/*
+	Instance data rewritten by the CPU every frame, in one persistently and coherently mapped
+	buffer split into three regions of capacity instances. Map hands out the next region,
+	waiting on its fence only when the GPU is still three frames behind; after the draws that
+	read it, Fence marks it in use. Vertex arrays are attached once and draw the current
+	region through baseInstance:
+
+		unsigned char* out = instances.Map();
+		... write count instances in the layout's formats ...
+		mesh.DrawInstanced(shader, count, instances.GetBaseInstance());
+		instances.Fence();
+*/
+class MappedInstanceBuffer
+{
+public:
+	template<typename Layout>
+	MappedInstanceBuffer(Layout, size_t capacity)
+		: stride(Layout::GetStride())
+	{
+		static_assert(Layout::GetStride() % 4 == 0, "instance stride must be a multiple of 4 bytes");
+		static_assert(Layout::HasUniqueLocations(), "two attributes share a location");
+
+		for (size_t i = 0; i < Layout::GetAttributeCount(); i++)
+			attributes.push_back(Layout::GetAttribute(i));
+		create(capacity);
+	}
+	~MappedInstanceBuffer();
+
+	MappedInstanceBuffer(const MappedInstanceBuffer&) = delete;
+	MappedInstanceBuffer& operator=(const MappedInstanceBuffer&) = delete;
+
+	void Attach(GLuint vao, GLuint binding = 1);
+	// Start of this frame's region, room for GetCapacity() instances of stride bytes.
+	unsigned char* Map();
+	// Call once the draws reading the region returned by Map are issued.
+	void Fence();
+
+	// first instance of the current region, to pass as baseInstance
+	GLuint GetBaseInstance() const;
+	size_t GetCapacity() const;
+	GLsizei GetStride() const;
+
+private:
+	static const unsigned int regionCount = 3;
+
+	GLsizei stride;
+	std::vector<VertexAttribute> attributes;
+
+	GLuint buffer = 0;
+	unsigned char* mapped = nullptr;
+	size_t capacity = 0;
+	unsigned int region = regionCount - 1;
+	GLsync fences[regionCount] = {};
+
+	void create(size_t capacity);
+};
@@ -1,42 +1,70 @@
 #include "pch.h"
 #include "Mesh.h"
+#include "IndirectCommand.h"
+#include "VertexLayout.h"
+
+#include <algorithm>
+#include <cmath>
+
+// GPU copy of Vertex: the unit normal and tangent fit 10-10-10-2, which VertexCore.glsl reads unchanged
+using MeshVertexLayout = VertexLayout<Position<float3>, Normal<snorm1010102>, TexCoords<float2>, Tangent<snorm1010102>>;
 
 Vertex::Vertex(glm::vec3 pos, glm::vec3 normal, glm::vec2 texCoords)
-	: pos(pos), normal(normal), texCoords(texCoords)
+	: pos(pos), normal(normal), texCoords(texCoords), tangent(0.0f)
 {}
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
-	: vertices(vertices), indices(indices), textures(textures)
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures,
+	std::vector<unsigned int> lodIndices, std::vector<MeshLod> lods)
+	: vertices(vertices), indices(indices), textures(textures), lodIndices(lodIndices), lods(lods)
 {
+	if (this->lods.empty())
+		this->lods.push_back({ 0, (unsigned int)this->indices.size(), 0.0f });
+
+	Meshlets::build(this->indices.data(), this->indices.size(), this->vertices.data(), this->vertices.size(),
+		sizeof(Vertex), offsetof(Vertex, pos), meshlets);
+
+	computeBounds();
 	setupMesh();
 }
 
-void Mesh::setupMesh()
+void Mesh::computeBounds()
 {
-	// vertex buffer
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	if (vertices.empty())
+		return;
 
-	//vertex array
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
-	glEnableVertexAttribArray(0);
+	// sphere around the centre of the box
+	glm::vec3 min = vertices[0].pos;
+	glm::vec3 max = min;
+	for (const Vertex& vertex : vertices)
+	{
+		min = glm::min(min, vertex.pos);
+		max = glm::max(max, vertex.pos);
+	}
 
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-	glEnableVertexAttribArray(1);
+	const glm::vec3 center = (min + max) * 0.5f;
+	float radius = 0.0f;
+	for (const Vertex& vertex : vertices)
+		radius = std::max(radius, glm::length(vertex.pos - center));
+	boundingSphere = glm::vec4(center, radius);
+}
 
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
-	glEnableVertexAttribArray(2);
+void Mesh::setupMesh()
+{
+	// vertex buffer, packed from 48 to 28 bytes per vertex
+	const std::vector<unsigned char> packed = MeshVertexLayout::Pack(vertices);
+	glCreateBuffers(1, &vbo);
+	glNamedBufferData(vbo, packed.size(), packed.data(), GL_STATIC_DRAW);
 
 	// element buffer
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+	glCreateBuffers(1, &ebo);
+	glNamedBufferData(ebo, (indices.size() + lodIndices.size()) * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+	glNamedBufferSubData(ebo, 0, indices.size() * sizeof(unsigned int), indices.data());
+	glNamedBufferSubData(ebo, indices.size() * sizeof(unsigned int), lodIndices.size() * sizeof(unsigned int), lodIndices.data());
 
-	glBindVertexArray(0);
+	//vertex array
+	glCreateVertexArrays(1, &vao);
+	MeshVertexLayout::Setup(vao, vbo);
+	glVertexArrayElementBuffer(vao, ebo);
 }
 
 
@@ -52,25 +80,8 @@ void Mesh::Draw(GLuint shader)
 		Texture whiteSpecMap(TextureType::SPECULAR, 1, "res/textures/white.png", false);
 		glUniform1i(glGetUniformLocation(shader, "material.specular"), 1);
 	}
-	else 
-	{
-		for (unsigned int i = 0; i < textures.size(); i++)
-		{
-			std::string label("");
-			switch (textures[i].type)
-			{
-			case TextureType::DIFFUSE:
-				label = "material.diffuse";
-				break;
-			case TextureType::SPECULAR:
-				label = "material.specular";
-				break;
-			}
-
-			textures[i].changeUnit(i);
-			glUniform1i(glGetUniformLocation(shader, label.c_str()), i);
-		}
-	}
+	else
+		bindTextures(shader);
 	glUniform1f(glGetUniformLocation(shader, "material.shininess"), 32.0f);
 
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
@@ -79,6 +90,26 @@ void Mesh::Draw(GLuint shader)
 	glBindVertexArray(0);
 }
 
+void Mesh::bindTextures(GLuint shader)
+{
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		std::string label("");
+		switch (textures[i].type)
+		{
+		case TextureType::DIFFUSE:
+			label = "material.diffuse";
+			break;
+		case TextureType::SPECULAR:
+			label = "material.specular";
+			break;
+		}
+
+		textures[i].changeUnit(i);
+		glUniform1i(glGetUniformLocation(shader, label.c_str()), i);
+	}
+}
+
 void Mesh::Draw(GLuint shader, Texture& diffMap, Texture& specMap)
 {
 
@@ -97,4 +128,49 @@ void Mesh::Draw(GLuint shader, Texture& diffMap, Texture& specMap)
 	glBindVertexArray(0);
 }
 
+void Mesh::DrawInstanced(GLuint shader, GLsizei instanceCount, GLuint baseInstance, unsigned int lod)
+{
+	if (instanceCount <= 0)
+		return;
+
+	glUseProgram(shader);
+	bindTextures(shader);
+
+	const MeshLod& level = lods[std::min<size_t>(lod, lods.size() - 1)];
+	glBindVertexArray(vao);
+	glDrawElementsInstancedBaseInstance(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT,
+		(void*)(level.indexOffset * sizeof(unsigned int)), instanceCount, baseInstance);
+}
+
+void Mesh::DrawIndirect(GLuint shader, GLuint commandBuffer, GLsizei drawCount, size_t firstCommand)
+{
+	if (drawCount <= 0)
+		return;
+
+	glUseProgram(shader);
+	bindTextures(shader);
+
+	glBindVertexArray(vao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)(firstCommand * sizeof(DrawElementsIndirectCommand)), drawCount, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+float Mesh::GetLodDistance(unsigned int level, float fovY, float screenHeight, float pixelError, float scale) const
+{
+	if (level >= lods.size())
+		return 0.0f;
+
+	// pixels per world unit at distance d: screenHeight / (2 d tan(fovY / 2))
+	const float pixelsPerUnit = screenHeight / (2.0f * tanf(fovY * 0.5f));
+	return lods[level].error * scale * pixelsPerUnit / pixelError;
+}
 
+unsigned int Mesh::SelectLod(float distance, float fovY, float screenHeight, float pixelError, float scale) const
+{
+	unsigned int level = 0;
+	while (level + 1 < lods.size() && GetLodDistance(level + 1, fovY, screenHeight, pixelError, scale) <= distance)
+		level++;
+
+	return level;
+}
@@ -3,8 +3,10 @@
 #include <vector>
 #include <vec2.hpp>
 #include <vec3.hpp>
+#include <vec4.hpp>
 
 #include "Texture.h"
+#include "Meshlet.h"
 
 struct Vertex
 {
@@ -13,6 +15,17 @@ struct Vertex
 	glm::vec3 pos;
 	glm::vec3 normal;
 	glm::vec2 texCoords;
+	// w: bitangent sign, see TangentSpace; zero until generated
+	glm::vec4 tangent;
+};
+
+struct MeshLod
+{
+	// range in the element buffer
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	// object space deviation from the full resolution mesh
+	float error;
 };
 
 class Mesh
@@ -22,11 +35,34 @@ public:
 	std::vector<unsigned int> indices;
 	std::vector<Texture> textures;
 
+	// Level 0 is the full index buffer; coarser levels index the same vertices
+	// and are stored after it in the element buffer.
+	std::vector<unsigned int> lodIndices;
+	std::vector<MeshLod> lods;
+
+	// clusters of the full resolution index buffer, see MeshletCuller
+	std::vector<Meshlet> meshlets;
+	// object space sphere around every vertex: xyz centre, w radius
+	glm::vec4 boundingSphere = glm::vec4(0.0f);
+
 	GLuint vao = 0;
 
-	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
+	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures,
+		std::vector<unsigned int> lodIndices = {}, std::vector<MeshLod> lods = {});
 	void Draw(GLuint shader);
 	void Draw(GLuint shader, Texture& diffMap, Texture& specMap);
+	// Draws instances [baseInstance, baseInstance + instanceCount) of the vertex array's instance
+	// attributes at the given level. Binds the mesh's own textures, if it has any.
+	void DrawInstanced(GLuint shader, GLsizei instanceCount, GLuint baseInstance = 0, unsigned int lod = 0);
+	// Draws drawCount DrawElementsIndirectCommands from commandBuffer, starting at firstCommand,
+	// whose firstIndex selects a level (see lods), with the vertex array's instance attributes.
+	void DrawIndirect(GLuint shader, GLuint commandBuffer, GLsizei drawCount, size_t firstCommand = 0);
+
+	// Distance beyond which the error of the given level projects to less than pixelError pixels
+	// for an instance of the given scale. fovY is in radians.
+	float GetLodDistance(unsigned int level, float fovY, float screenHeight, float pixelError, float scale = 1.0f) const;
+	// Coarsest level whose error stays below pixelError pixels at the given distance.
+	unsigned int SelectLod(float distance, float fovY, float screenHeight, float pixelError, float scale = 1.0f) const;
 
 private:
 	
@@ -34,4 +70,6 @@ private:
 	GLuint ebo = 0;
 	
 	void setupMesh();
+	void computeBounds();
+	void bindTextures(GLuint shader);
 };
\ No newline at end of file
@@ -0,0 +1,468 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vec3.hpp>
+#include <geometric.hpp>
+
+// Forsyth scoring parameters (see "Linear-Speed Vertex Cache Optimisation", Tom Forsyth 2006).
+static const unsigned int scoreCacheSize = 32;
+static const float cacheDecayPower = 1.5f;
+static const float lastTriScore = 0.75f;
+static const float valenceBoostScale = 2.0f;
+static const float valenceBoostPower = 0.5f;
+static const unsigned int maxValence = 32;
+
+// size of the FIFO cache used for analysis and overdraw clustering
+static const unsigned int fifoCacheSize = 16;
+
+static float vertexScore(int cachePosition, unsigned int valence)
+{
+	if (valence == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// The three vertices of the last triangle get a fixed score so that
+		// the next triangle does not simply reuse the same edge.
+		if (cachePosition < 3)
+			score = lastTriScore;
+		else
+		{
+			const float scaler = 1.0f / (float)(scoreCacheSize - 3);
+			score = powf(1.0f - (float)(cachePosition - 3) * scaler, cacheDecayPower);
+		}
+	}
+
+	// Boost vertices with few remaining triangles so that lone triangles are not left behind.
+	score += valenceBoostScale * powf((float)valence, -valenceBoostPower);
+	return score;
+}
+
+static unsigned int hashBytes(const unsigned char* data, size_t size)
+{
+	// FNV-1a
+	unsigned int hash = 2166136261u;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static glm::vec3 readPosition(const void* vertices, size_t vertexSize, size_t positionOffset, unsigned int index)
+{
+	glm::vec3 pos;
+	memcpy(&pos, (const char*)vertices + index * vertexSize + positionOffset, sizeof(glm::vec3));
+	return pos;
+}
+
+static unsigned int updateFifoCache(unsigned int a, unsigned int b, unsigned int c,
+	std::vector<unsigned int>& cacheTimestamps, unsigned int& timestamp)
+{
+	const unsigned int triangle[3] = { a, b, c };
+	unsigned int misses = 0;
+
+	for (unsigned int v : triangle)
+	{
+		if (timestamp - cacheTimestamps[v] > fifoCacheSize)
+		{
+			cacheTimestamps[v] = timestamp++;
+			misses++;
+		}
+	}
+
+	return misses;
+}
+
+size_t MeshOptimizer::generateVertexRemap(const void* vertices, size_t vertexCount, size_t vertexSize, std::vector<unsigned int>& outRemap)
+{
+	outRemap.assign(vertexCount, 0);
+
+	// open addressing table of vertex indices, at most half full
+	size_t tableSize = 1;
+	while (tableSize < vertexCount * 2)
+		tableSize *= 2;
+
+	const unsigned int empty = ~0u;
+	std::vector<unsigned int> table(tableSize, empty);
+
+	const unsigned char* bytes = (const unsigned char*)vertices;
+	unsigned int uniqueCount = 0;
+
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		const unsigned char* vertex = bytes + v * vertexSize;
+		size_t slot = hashBytes(vertex, vertexSize) & (tableSize - 1);
+
+		while (table[slot] != empty && memcmp(bytes + table[slot] * vertexSize, vertex, vertexSize) != 0)
+			slot = (slot + 1) & (tableSize - 1);
+
+		if (table[slot] == empty)
+		{
+			table[slot] = (unsigned int)v;
+			outRemap[v] = uniqueCount++;
+		}
+		else
+			outRemap[v] = outRemap[table[slot]];
+	}
+
+	return uniqueCount;
+}
+
+size_t MeshOptimizer::weldVertices(void* vertices, size_t vertexCount, size_t vertexSize, unsigned int* indices, size_t indexCount)
+{
+	std::vector<unsigned int> remap;
+	const size_t uniqueCount = generateVertexRemap(vertices, vertexCount, vertexSize, remap);
+
+	// First occurrences appear in increasing remap order, so the array can be compacted in place.
+	char* bytes = (char*)vertices;
+	unsigned int written = 0;
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] == written)
+		{
+			if (written != v)
+				memmove(bytes + written * vertexSize, bytes + v * vertexSize, vertexSize);
+			written++;
+		}
+	}
+
+	for (size_t i = 0; i < indexCount; i++)
+		indices[i] = remap[indices[i]];
+
+	return uniqueCount;
+}
+
+void MeshOptimizer::optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount)
+{
+	const size_t triCount = indexCount / 3;
+	if (triCount == 0)
+		return;
+
+	// score lookup by [cache position + 1][valence]
+	static float scoreTable[scoreCacheSize + 1][maxValence + 1];
+	static bool tableReady = false;
+	if (!tableReady)
+	{
+		for (unsigned int pos = 0; pos <= scoreCacheSize; pos++)
+			for (unsigned int valence = 0; valence <= maxValence; valence++)
+				scoreTable[pos][valence] = vertexScore((int)pos - 1, valence);
+		tableReady = true;
+	}
+
+	auto score = [](int cachePosition, unsigned int valence)
+	{
+		return scoreTable[cachePosition + 1][std::min(valence, maxValence)];
+	};
+
+	// vertex -> triangle adjacency, stored as one array with per-vertex offsets
+	std::vector<unsigned int> valence(vertexCount, 0);
+	for (size_t i = 0; i < indexCount; i++)
+		valence[indices[i]]++;
+
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + valence[v];
+
+	std::vector<unsigned int> adjacency(indexCount);
+	std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t t = 0; t < triCount; t++)
+		for (unsigned int k = 0; k < 3; k++)
+			adjacency[fill[indices[3 * t + k]]++] = (unsigned int)t;
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		vertexScores[v] = score(-1, valence[v]);
+
+	std::vector<float> triScores(triCount);
+	std::vector<char> emitted(triCount, 0);
+	for (size_t t = 0; t < triCount; t++)
+		triScores[t] = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t + 1]] + vertexScores[indices[3 * t + 2]];
+
+	const std::vector<unsigned int> input(indices, indices + indexCount);
+
+	unsigned int cache[scoreCacheSize + 3];
+	unsigned int cacheCount = 0;
+
+	int bestTri = (int)(std::max_element(triScores.begin(), triScores.end()) - triScores.begin());
+	size_t inputCursor = 0;
+
+	for (size_t outTri = 0; outTri < triCount; outTri++)
+	{
+		// Dead end: nothing in the cache touches an unemitted triangle, so take the next one in input order.
+		if (bestTri < 0)
+		{
+			while (emitted[inputCursor])
+				inputCursor++;
+			bestTri = (int)inputCursor;
+		}
+
+		const unsigned int* tri = &input[3 * bestTri];
+		indices[3 * outTri + 0] = tri[0];
+		indices[3 * outTri + 1] = tri[1];
+		indices[3 * outTri + 2] = tri[2];
+		emitted[bestTri] = 1;
+
+		// Remove the triangle from the adjacency of its vertices.
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			const unsigned int v = tri[k];
+			unsigned int* begin = &adjacency[adjacencyOffsets[v]];
+			unsigned int* end = begin + valence[v];
+			unsigned int* it = std::find(begin, end, (unsigned int)bestTri);
+			*it = *(end - 1);
+			valence[v]--;
+		}
+
+		// Move the triangle's vertices to the front of the cache.
+		unsigned int newCache[scoreCacheSize + 3];
+		unsigned int newCount = 0;
+		for (unsigned int k = 0; k < 3; k++)
+			newCache[newCount++] = tri[k];
+		for (unsigned int i = 0; i < cacheCount; i++)
+		{
+			const unsigned int v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache[newCount++] = v;
+		}
+
+		// Rescore every vertex that was touched, including those that just fell out.
+		for (unsigned int i = 0; i < newCount; i++)
+		{
+			const unsigned int v = newCache[i];
+			cachePosition[v] = i < scoreCacheSize ? (int)i : -1;
+			vertexScores[v] = score(cachePosition[v], valence[v]);
+		}
+
+		cacheCount = std::min(newCount, scoreCacheSize);
+		memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+
+		// Rescore the triangles that use those vertices and pick the best.
+		bestTri = -1;
+		float bestScore = -1.0f;
+		for (unsigned int i = 0; i < newCount; i++)
+		{
+			const unsigned int v = newCache[i];
+			for (unsigned int a = 0; a < valence[v]; a++)
+			{
+				const unsigned int t = adjacency[adjacencyOffsets[v] + a];
+				const float triScore = vertexScores[input[3 * t]] + vertexScores[input[3 * t + 1]] + vertexScores[input[3 * t + 2]];
+				triScores[t] = triScore;
+
+				if (triScore > bestScore)
+				{
+					bestScore = triScore;
+					bestTri = (int)t;
+				}
+			}
+		}
+	}
+}
+
+void MeshOptimizer::optimizeOverdraw(unsigned int* indices, size_t indexCount, const void* vertices, size_t vertexCount,
+	size_t vertexSize, size_t positionOffset, float threshold)
+{
+	const size_t triCount = indexCount / 3;
+	if (triCount == 0)
+		return;
+
+	// 1) Hard boundaries: triangles where all three vertices miss the cache start a new strip of locality.
+	std::vector<unsigned int> hardClusters;
+	{
+		std::vector<unsigned int> cacheTimestamps(vertexCount, 0);
+		unsigned int timestamp = fifoCacheSize + 1;
+
+		for (size_t t = 0; t < triCount; t++)
+		{
+			const unsigned int misses = updateFifoCache(indices[3 * t], indices[3 * t + 1], indices[3 * t + 2], cacheTimestamps, timestamp);
+			if (t == 0 || misses == 3)
+				hardClusters.push_back((unsigned int)t);
+		}
+	}
+
+	// 2) Soft boundaries: split each hard cluster further while its local ACMR stays within the threshold.
+	// Advancing the timestamp past the cache size flushes the cache without touching every vertex.
+	std::vector<unsigned int> clusters;
+	std::vector<unsigned int> cacheTimestamps(vertexCount, 0);
+	unsigned int timestamp = fifoCacheSize + 1;
+
+	for (size_t c = 0; c < hardClusters.size(); c++)
+	{
+		const unsigned int start = hardClusters[c];
+		const unsigned int end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : (unsigned int)triCount;
+
+		timestamp += fifoCacheSize + 1;
+
+		unsigned int clusterMisses = 0;
+		for (unsigned int t = start; t < end; t++)
+			clusterMisses += updateFifoCache(indices[3 * t], indices[3 * t + 1], indices[3 * t + 2], cacheTimestamps, timestamp);
+
+		const float clusterThreshold = threshold * (float)clusterMisses / (float)(end - start);
+
+		clusters.push_back(start);
+		timestamp += fifoCacheSize + 1;
+
+		unsigned int runningMisses = 0;
+		unsigned int runningTris = 0;
+		for (unsigned int t = start; t < end; t++)
+		{
+			runningMisses += updateFifoCache(indices[3 * t], indices[3 * t + 1], indices[3 * t + 2], cacheTimestamps, timestamp);
+			runningTris++;
+
+			if ((float)runningMisses / (float)runningTris <= clusterThreshold)
+			{
+				clusters.push_back(t + 1);
+				timestamp += fifoCacheSize + 1;
+				runningMisses = 0;
+				runningTris = 0;
+			}
+		}
+
+		if (clusters.back() == end)
+			clusters.pop_back();
+	}
+
+	// 3) Sort clusters so that those facing away from the mesh centre (likely occluders) are drawn first.
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+
+	const size_t clusterCount = clusters.size();
+	std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+	std::vector<float> clusterAreas(clusterCount, 0.0f);
+
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		const unsigned int start = clusters[c];
+		const unsigned int end = c + 1 < clusterCount ? clusters[c + 1] : (unsigned int)triCount;
+
+		for (unsigned int t = start; t < end; t++)
+		{
+			const glm::vec3 p0 = readPosition(vertices, vertexSize, positionOffset, indices[3 * t]);
+			const glm::vec3 p1 = readPosition(vertices, vertexSize, positionOffset, indices[3 * t + 1]);
+			const glm::vec3 p2 = readPosition(vertices, vertexSize, positionOffset, indices[3 * t + 2]);
+
+			const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const float area = glm::length(normal);
+			const glm::vec3 centroid = (p0 + p1 + p2) / 3.0f;
+
+			clusterCentroids[c] += centroid * area;
+			clusterNormals[c] += normal;
+			clusterAreas[c] += area;
+
+			meshCentroid += centroid * area;
+			meshArea += area;
+		}
+	}
+
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		const glm::vec3 centroid = clusterAreas[c] > 0.0f ? clusterCentroids[c] / clusterAreas[c] : meshCentroid;
+		const float normalLength = glm::length(clusterNormals[c]);
+		const glm::vec3 normal = normalLength > 0.0f ? clusterNormals[c] / normalLength : glm::vec3(0.0f);
+
+		sortKeys[c] = glm::dot(centroid - meshCentroid, normal);
+	}
+
+	std::vector<unsigned int> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+		order[c] = (unsigned int)c;
+
+	std::stable_sort(order.begin(), order.end(),
+		[&sortKeys](unsigned int a, unsigned int b) { return sortKeys[a] > sortKeys[b]; });
+
+	const std::vector<unsigned int> input(indices, indices + indexCount);
+	size_t outIdx = 0;
+	for (unsigned int c : order)
+	{
+		const unsigned int start = clusters[c];
+		const unsigned int end = c + 1 < clusterCount ? clusters[c + 1] : (unsigned int)triCount;
+
+		memcpy(indices + outIdx, &input[3 * start], 3 * (end - start) * sizeof(unsigned int));
+		outIdx += 3 * (end - start);
+	}
+}
+
+void MeshOptimizer::optimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexSize, unsigned int* indices, size_t indexCount)
+{
+	const unsigned int unused = ~0u;
+	std::vector<unsigned int> remap(vertexCount, unused);
+	unsigned int next = 0;
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		unsigned int& target = remap[indices[i]];
+		if (target == unused)
+			target = next++;
+		indices[i] = target;
+	}
+
+	// Unreferenced vertices are kept at the end so the vertex count does not change.
+	for (size_t v = 0; v < vertexCount; v++)
+		if (remap[v] == unused)
+			remap[v] = next++;
+
+	const std::vector<char> input((const char*)vertices, (const char*)vertices + vertexCount * vertexSize);
+	for (size_t v = 0; v < vertexCount; v++)
+		memcpy((char*)vertices + remap[v] * vertexSize, &input[v * vertexSize], vertexSize);
+}
+
+VertexCacheStats MeshOptimizer::analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats;
+	if (indexCount < 3)
+		return stats;
+
+	std::vector<unsigned int> cacheTimestamps(vertexCount, 0);
+	std::vector<char> referenced(vertexCount, 0);
+	unsigned int timestamp = cacheSize + 1;
+	unsigned int misses = 0;
+	unsigned int uniqueCount = 0;
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		const unsigned int v = indices[i];
+		if (timestamp - cacheTimestamps[v] > cacheSize)
+		{
+			cacheTimestamps[v] = timestamp++;
+			misses++;
+		}
+
+		if (!referenced[v])
+		{
+			referenced[v] = 1;
+			uniqueCount++;
+		}
+	}
+
+	stats.acmr = (float)misses / (float)(indexCount / 3);
+	stats.atvr = (float)misses / (float)uniqueCount;
+	return stats;
+}
+
+void MeshOptimizer::optimize(const std::string& label, void* vertices, size_t vertexCount, size_t vertexSize,
+	size_t positionOffset, unsigned int* indices, size_t indexCount)
+{
+	const VertexCacheStats before = analyzeVertexCache(indices, indexCount, vertexCount);
+
+	optimizeVertexCache(indices, indexCount, vertexCount);
+	optimizeOverdraw(indices, indexCount, vertices, vertexCount, vertexSize, positionOffset);
+	optimizeVertexFetch(vertices, vertexCount, vertexSize, indices, indexCount);
+
+	const VertexCacheStats after = analyzeVertexCache(indices, indexCount, vertexCount);
+
+	std::cout << "[Info: MeshOptimizer] " << label << " (" << vertexCount << " vertices, " << indexCount / 3 << " triangles)"
+		<< " ACMR " << before.acmr << " -> " << after.acmr
+		<< ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+#include <string>
+
+struct VertexCacheStats
+{
+	// average cache miss ratio (transformed vertices per triangle, 0.5 - 3.0)
+	float acmr = 0.0f;
+	// average transformed vertex ratio (transformed vertices per unique vertex, 1.0 is ideal)
+	float atvr = 0.0f;
+};
+
+/*
+	Index/vertex buffer optimisation for imported and generated meshes.
+	All functions work on raw arrays so that both std::vectors (Model) and
+	the new[] buffers of the procedural meshes in the tests can be passed in.
+	Vertices are treated as opaque blocks of vertexSize bytes; the overdraw pass
+	additionally reads a float3 position at positionOffset within each vertex.
+*/
+namespace MeshOptimizer
+{
+	// Builds a remap table that maps every vertex onto the first bitwise identical vertex
+	// and returns the number of unique vertices.
+	size_t generateVertexRemap(const void* vertices, size_t vertexCount, size_t vertexSize, std::vector<unsigned int>& outRemap);
+
+	// Welds identical vertices in place (compacting the vertex array) and rewrites the indices.
+	size_t weldVertices(void* vertices, size_t vertexCount, size_t vertexSize, unsigned int* indices, size_t indexCount);
+
+	// Forsyth's linear-speed triangle reordering for the post-transform vertex cache.
+	void optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+	// View-independent overdraw reordering (Sander et al.), run after optimizeVertexCache.
+	// threshold bounds how much the cache efficiency may degrade (1.05 = 5% worse ACMR).
+	void optimizeOverdraw(unsigned int* indices, size_t indexCount, const void* vertices, size_t vertexCount,
+		size_t vertexSize, size_t positionOffset, float threshold = 1.05f);
+
+	// Reorders vertices into first-use order of the index buffer and rewrites the indices.
+	void optimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexSize, unsigned int* indices, size_t indexCount);
+
+	// Simulates a FIFO post-transform cache of the given size.
+	VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = 16);
+
+	// Runs the cache, overdraw and fetch passes and prints ACMR/ATVR before and after.
+	void optimize(const std::string& label, void* vertices, size_t vertexCount, size_t vertexSize,
+		size_t positionOffset, unsigned int* indices, size_t indexCount);
+
+	// Welds first (shrinking vertices) and then runs optimize. Meant for imported meshes.
+	template<typename V>
+	void optimize(const std::string& label, std::vector<V>& vertices, std::vector<unsigned int>& indices)
+	{
+		if (vertices.empty() || indices.empty())
+			return;
+
+		const size_t positionOffset = (const char*)&vertices[0].pos - (const char*)&vertices[0];
+		const size_t uniqueCount = weldVertices(vertices.data(), vertices.size(), sizeof(V), indices.data(), indices.size());
+		vertices.erase(vertices.begin() + uniqueCount, vertices.end());
+
+		optimize(label, vertices.data(), vertices.size(), sizeof(V), positionOffset, indices.data(), indices.size());
+	}
+}
@@ -0,0 +1,342 @@
+#include "pch.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_set>
+#include <geometric.hpp>
+
+// attribute weights for Vertex: normal xyz, texCoords uv
+static const float vertexAttributeWeights[5] = { 0.005f, 0.005f, 0.005f, 0.5f, 0.5f };
+
+// cosine limit between a triangle normal before and after a collapse
+static const float flipThreshold = 0.25f;
+
+struct Quadric
+{
+	// symmetric 3x3 matrix A, vector b and constant c of the error p'Ap + 2b'p + c
+	float a00 = 0.0f, a01 = 0.0f, a02 = 0.0f, a11 = 0.0f, a12 = 0.0f, a22 = 0.0f;
+	float b0 = 0.0f, b1 = 0.0f, b2 = 0.0f;
+	float c = 0.0f;
+	float weight = 0.0f;
+
+	void addPlane(const glm::vec3& n, float d, float w)
+	{
+		a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+		a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+		b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+		c += w * d * d;
+		weight += w;
+	}
+
+	void add(const Quadric& q)
+	{
+		a00 += q.a00; a01 += q.a01; a02 += q.a02;
+		a11 += q.a11; a12 += q.a12; a22 += q.a22;
+		b0 += q.b0; b1 += q.b1; b2 += q.b2;
+		c += q.c;
+		weight += q.weight;
+	}
+
+	float evaluate(const glm::vec3& p) const
+	{
+		const float rx = a00 * p.x + a01 * p.y + a02 * p.z;
+		const float ry = a01 * p.x + a11 * p.y + a12 * p.z;
+		const float rz = a02 * p.x + a12 * p.y + a22 * p.z;
+		const float e = p.x * rx + p.y * ry + p.z * rz + 2.0f * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+		return e > 0.0f ? e : 0.0f;
+	}
+};
+
+struct Collapse
+{
+	unsigned int from;
+	unsigned int to;
+	float cost;
+	float error;
+};
+
+static glm::vec3 readPosition(const void* vertices, size_t vertexSize, size_t positionOffset, size_t index)
+{
+	glm::vec3 pos;
+	memcpy(&pos, (const char*)vertices + index * vertexSize + positionOffset, sizeof(glm::vec3));
+	return pos;
+}
+
+static unsigned long long edgeKey(unsigned int a, unsigned int b)
+{
+	return ((unsigned long long)a << 32) | b;
+}
+
+float MeshSimplifier::getExtent(const void* vertices, size_t vertexCount, size_t vertexSize, size_t positionOffset)
+{
+	if (!vertexCount)
+		return 0.0f;
+
+	glm::vec3 minPos = readPosition(vertices, vertexSize, positionOffset, 0);
+	glm::vec3 maxPos = minPos;
+	for (size_t v = 1; v < vertexCount; v++)
+	{
+		const glm::vec3 pos = readPosition(vertices, vertexSize, positionOffset, v);
+		minPos = glm::min(minPos, pos);
+		maxPos = glm::max(maxPos, pos);
+	}
+
+	const glm::vec3 size = maxPos - minPos;
+	return std::max(size.x, std::max(size.y, size.z));
+}
+
+size_t MeshSimplifier::simplify(unsigned int* outIndices, const unsigned int* indices, size_t indexCount,
+	const void* vertices, size_t vertexCount, size_t vertexSize, size_t positionOffset,
+	size_t attributeOffset, size_t attributeCount, const float* attributeWeights,
+	size_t targetIndexCount, float targetError, float* outError)
+{
+	memmove(outIndices, indices, indexCount * sizeof(unsigned int));
+	if (outError)
+		*outError = 0.0f;
+
+	if (indexCount <= targetIndexCount || !vertexCount)
+		return indexCount;
+
+	// Work in a unit box so that errors are relative to the mesh size.
+	const float extent = getExtent(vertices, vertexCount, vertexSize, positionOffset);
+	const float invExtent = extent > 0.0f ? 1.0f / extent : 0.0f;
+	const glm::vec3 origin = readPosition(vertices, vertexSize, positionOffset, 0);
+
+	std::vector<glm::vec3> positions(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		positions[v] = (readPosition(vertices, vertexSize, positionOffset, v) - origin) * invExtent;
+
+	std::vector<float> attributes(vertexCount * attributeCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		memcpy(&attributes[v * attributeCount], (const char*)vertices + v * vertexSize + attributeOffset, attributeCount * sizeof(float));
+
+	// Vertices that share a position are wedges of the same corner (uv or normal seams).
+	std::vector<unsigned int> positionRemap;
+	const size_t positionCount = MeshOptimizer::generateVertexRemap(positions.data(), vertexCount, sizeof(glm::vec3), positionRemap);
+
+	std::vector<unsigned int> wedgeCount(positionCount, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		wedgeCount[positionRemap[v]]++;
+
+	// Lock seams and open borders, i.e. positional edges without an opposite half edge.
+	std::vector<char> locked(vertexCount, 0);
+	{
+		std::unordered_set<unsigned long long> halfEdges;
+		halfEdges.reserve(indexCount);
+		for (size_t i = 0; i < indexCount; i += 3)
+			for (unsigned int k = 0; k < 3; k++)
+				halfEdges.insert(edgeKey(positionRemap[indices[i + k]], positionRemap[indices[i + (k + 1) % 3]]));
+
+		std::vector<char> borderPosition(positionCount, 0);
+		for (size_t i = 0; i < indexCount; i += 3)
+		{
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				const unsigned int a = positionRemap[indices[i + k]];
+				const unsigned int b = positionRemap[indices[i + (k + 1) % 3]];
+				if (!halfEdges.count(edgeKey(b, a)))
+					borderPosition[a] = borderPosition[b] = 1;
+			}
+		}
+
+		for (size_t v = 0; v < vertexCount; v++)
+			locked[v] = borderPosition[positionRemap[v]] || wedgeCount[positionRemap[v]] > 1;
+	}
+
+	// area weighted plane quadrics, shared between wedges
+	std::vector<Quadric> quadrics(positionCount);
+	for (size_t i = 0; i < indexCount; i += 3)
+	{
+		const glm::vec3& p0 = positions[indices[i]];
+		const glm::vec3& p1 = positions[indices[i + 1]];
+		const glm::vec3& p2 = positions[indices[i + 2]];
+
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		const float area = glm::length(normal);
+		if (area <= 0.0f)
+			continue;
+
+		normal /= area;
+		const float d = -glm::dot(normal, p0);
+		for (unsigned int k = 0; k < 3; k++)
+			quadrics[positionRemap[indices[i + k]]].addPlane(normal, d, area);
+	}
+
+	const float targetErrorSq = targetError * targetError;
+	float resultErrorSq = 0.0f;
+	size_t resultCount = indexCount;
+
+	std::vector<unsigned int> triangleOffsets(vertexCount + 1);
+	std::vector<unsigned int> triangles;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<char> touched(vertexCount);
+
+	while (resultCount > targetIndexCount)
+	{
+		// vertex -> triangle adjacency of the current index buffer
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (size_t i = 0; i < resultCount; i++)
+			triangleOffsets[outIndices[i] + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			triangleOffsets[v + 1] += triangleOffsets[v];
+
+		triangles.resize(resultCount);
+		std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (size_t i = 0; i < resultCount; i++)
+			triangles[fill[outIndices[i]]++] = (unsigned int)(i / 3);
+
+		// Price both directions of every edge.
+		collapses.clear();
+		for (size_t i = 0; i < resultCount; i += 3)
+		{
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				const unsigned int from = outIndices[i + k];
+				const unsigned int to = outIndices[i + (k + 1) % 3];
+				if (locked[from])
+					continue;
+
+				Quadric q = quadrics[positionRemap[from]];
+				q.add(quadrics[positionRemap[to]]);
+				const float error = q.weight > 0.0f ? q.evaluate(positions[to]) / q.weight : 0.0f;
+
+				float attributeError = 0.0f;
+				for (size_t a = 0; a < attributeCount; a++)
+				{
+					const float diff = attributes[from * attributeCount + a] - attributes[to * attributeCount + a];
+					attributeError += attributeWeights[a] * diff * diff;
+				}
+
+				collapses.push_back({ from, to, error + attributeError, error });
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(),
+			[](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		for (size_t v = 0; v < vertexCount; v++)
+			remap[v] = (unsigned int)v;
+		std::fill(touched.begin(), touched.end(), 0);
+
+		// Each collapse of an interior edge removes two triangles.
+		const size_t trianglesToRemove = (resultCount - targetIndexCount) / 3;
+		size_t removed = 0;
+		size_t collapseCount = 0;
+
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.cost > targetErrorSq || removed >= trianglesToRemove)
+				break;
+
+			const unsigned int from = collapse.from;
+			const unsigned int to = collapse.to;
+			if (touched[from] || touched[to])
+				continue;
+
+			// Reject collapses that flip or squash any triangle around the source vertex.
+			bool valid = true;
+			size_t lost = 0;
+			for (unsigned int t = triangleOffsets[from]; t < triangleOffsets[from + 1] && valid; t++)
+			{
+				const unsigned int* tri = &outIndices[3 * triangles[t]];
+				if (tri[0] == to || tri[1] == to || tri[2] == to)
+				{
+					lost++;
+					continue;
+				}
+
+				const glm::vec3 before = glm::cross(positions[tri[1]] - positions[tri[0]], positions[tri[2]] - positions[tri[0]]);
+
+				glm::vec3 corners[3];
+				for (unsigned int k = 0; k < 3; k++)
+					corners[k] = positions[tri[k] == from ? to : tri[k]];
+				const glm::vec3 after = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+
+				valid = glm::dot(before, after) > flipThreshold * glm::length(before) * glm::length(after);
+			}
+
+			if (!valid || !lost)
+				continue;
+
+			remap[from] = to;
+			quadrics[positionRemap[to]].add(quadrics[positionRemap[from]]);
+
+			// Neighbours are locked for the rest of the pass so that the flip tests above stay valid.
+			for (unsigned int t = triangleOffsets[from]; t < triangleOffsets[from + 1]; t++)
+				for (unsigned int k = 0; k < 3; k++)
+					touched[outIndices[3 * triangles[t] + k]] = 1;
+
+			resultErrorSq = std::max(resultErrorSq, collapse.error);
+			removed += lost;
+			collapseCount++;
+		}
+
+		if (!collapseCount)
+			break;
+
+		// Apply the collapses and drop the triangles that became degenerate.
+		size_t written = 0;
+		for (size_t i = 0; i < resultCount; i += 3)
+		{
+			const unsigned int a = remap[outIndices[i]];
+			const unsigned int b = remap[outIndices[i + 1]];
+			const unsigned int c = remap[outIndices[i + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+
+			outIndices[written++] = a;
+			outIndices[written++] = b;
+			outIndices[written++] = c;
+		}
+		resultCount = written;
+	}
+
+	if (outError)
+		*outError = sqrtf(resultErrorSq);
+
+	return resultCount;
+}
+
+void MeshSimplifier::buildLods(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, unsigned int lodCount,
+	std::vector<unsigned int>& outLodIndices, std::vector<MeshLod>& outLods, float ratio, float targetError)
+{
+	outLodIndices.clear();
+	outLods.clear();
+	outLods.push_back({ 0, (unsigned int)indices.size(), 0.0f });
+
+	if (vertices.empty() || indices.empty())
+		return;
+
+	const float extent = getExtent(vertices.data(), vertices.size(), sizeof(Vertex), offsetof(Vertex, pos));
+
+	std::vector<unsigned int> source(indices);
+	std::vector<unsigned int> lod(indices.size());
+	float error = 0.0f;
+
+	for (unsigned int level = 1; level < lodCount; level++)
+	{
+		const size_t targetIndexCount = (size_t)(source.size() / 3 * ratio) * 3;
+
+		// Each level is simplified from the previous one, so its error builds on the last.
+		float levelError = 0.0f;
+		const size_t lodIndexCount = simplify(lod.data(), source.data(), source.size(),
+			vertices.data(), vertices.size(), sizeof(Vertex), offsetof(Vertex, pos),
+			offsetof(Vertex, normal), 5, vertexAttributeWeights, targetIndexCount, targetError, &levelError);
+
+		// stop once the error budget does not allow any further reduction
+		if (lodIndexCount == 0 || lodIndexCount >= source.size())
+			break;
+
+		MeshOptimizer::optimizeVertexCache(lod.data(), lodIndexCount, vertices.size());
+
+		error += levelError * extent;
+		outLods.push_back({ (unsigned int)(indices.size() + outLodIndices.size()), (unsigned int)lodIndexCount, error });
+		outLodIndices.insert(outLodIndices.end(), lod.begin(), lod.begin() + lodIndexCount);
+
+		source.assign(lod.begin(), lod.begin() + lodIndexCount);
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <vector>
+
+#include "Mesh.h"
+
+/*
+	Quadric error metric simplification (Garland & Heckbert) by half-edge collapse.
+	Vertices are never moved or created, so every LOD indexes the original vertex
+	buffer and only needs its own index range. Vertices on open borders and on
+	attribute seams (several vertices sharing a position) are locked.
+*/
+namespace MeshSimplifier
+{
+	// Collapses edges until the index count reaches targetIndexCount or the next collapse would
+	// exceed targetError (relative to the mesh extent). attributeCount floats starting at
+	// attributeOffset in each vertex are added to the collapse cost, scaled by attributeWeights.
+	// Returns the new index count; outError receives the reached error relative to the extent.
+	size_t simplify(unsigned int* outIndices, const unsigned int* indices, size_t indexCount,
+		const void* vertices, size_t vertexCount, size_t vertexSize, size_t positionOffset,
+		size_t attributeOffset, size_t attributeCount, const float* attributeWeights,
+		size_t targetIndexCount, float targetError, float* outError);
+
+	// Largest axis of the bounding box, used to turn relative errors into object space.
+	float getExtent(const void* vertices, size_t vertexCount, size_t vertexSize, size_t positionOffset);
+
+	// Builds lodCount levels (including the full resolution one) where each level keeps about
+	// ratio of the triangles of the previous one. Levels 1+ are appended to outLodIndices.
+	void buildLods(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, unsigned int lodCount,
+		std::vector<unsigned int>& outLodIndices, std::vector<MeshLod>& outLods, float ratio = 0.5f, float targetError = 0.05f);
+}
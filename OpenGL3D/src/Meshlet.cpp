@@ -0,0 +1,134 @@
+#include "pch.h"
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <geometric.hpp>
+
+// cones wider than this (dot of a triangle normal with the axis) are not worth testing
+static const float minConeDot = 0.1f;
+
+static glm::vec3 readPosition(const void* vertices, size_t vertexSize, size_t positionOffset, unsigned int index)
+{
+	glm::vec3 pos;
+	memcpy(&pos, (const char*)vertices + index * vertexSize + positionOffset, sizeof(glm::vec3));
+	return pos;
+}
+
+static void computeBounds(Meshlet& meshlet, const unsigned int* indices, const void* vertices, size_t vertexSize, size_t positionOffset)
+{
+	const unsigned int* first = indices + meshlet.indexOffset;
+	const unsigned int triangleCount = meshlet.indexCount / 3;
+
+	// sphere around the box centre
+	glm::vec3 minPos = readPosition(vertices, vertexSize, positionOffset, first[0]);
+	glm::vec3 maxPos = minPos;
+	for (unsigned int i = 1; i < meshlet.indexCount; i++)
+	{
+		const glm::vec3 pos = readPosition(vertices, vertexSize, positionOffset, first[i]);
+		minPos = glm::min(minPos, pos);
+		maxPos = glm::max(maxPos, pos);
+	}
+
+	meshlet.center = 0.5f * (minPos + maxPos);
+	meshlet.radius = 0.0f;
+	for (unsigned int i = 0; i < meshlet.indexCount; i++)
+	{
+		const glm::vec3 pos = readPosition(vertices, vertexSize, positionOffset, first[i]);
+		meshlet.radius = std::max(meshlet.radius, glm::length(pos - meshlet.center));
+	}
+
+	// normal cone around the average triangle normal
+	std::vector<glm::vec3> normals(triangleCount);
+	glm::vec3 axis(0.0f);
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		const glm::vec3 p0 = readPosition(vertices, vertexSize, positionOffset, first[3 * t]);
+		const glm::vec3 p1 = readPosition(vertices, vertexSize, positionOffset, first[3 * t + 1]);
+		const glm::vec3 p2 = readPosition(vertices, vertexSize, positionOffset, first[3 * t + 2]);
+
+		const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		const float area = glm::length(normal);
+		normals[t] = area > 0.0f ? normal / area : glm::vec3(0.0f);
+		axis += normals[t];
+	}
+
+	meshlet.coneApex = meshlet.center;
+	meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet.coneCutoff = 2.0f;
+
+	const float axisLength = glm::length(axis);
+	if (axisLength <= 0.0f)
+		return;
+	axis /= axisLength;
+
+	float minDot = 1.0f;
+	for (unsigned int t = 0; t < triangleCount; t++)
+		if (normals[t] != glm::vec3(0.0f))
+			minDot = std::min(minDot, glm::dot(normals[t], axis));
+
+	if (minDot <= minConeDot)
+		return;
+
+	// Move the apex back along the axis until it lies behind every triangle plane.
+	float maxT = 0.0f;
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		if (normals[t] == glm::vec3(0.0f))
+			continue;
+
+		const glm::vec3 p0 = readPosition(vertices, vertexSize, positionOffset, first[3 * t]);
+		const float distance = glm::dot(meshlet.center - p0, normals[t]);
+		maxT = std::max(maxT, distance / glm::dot(axis, normals[t]));
+	}
+
+	meshlet.coneApex = meshlet.center - axis * maxT;
+	meshlet.coneAxis = axis;
+	meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+void Meshlets::build(const unsigned int* indices, size_t indexCount, const void* vertices, size_t vertexCount,
+	size_t vertexSize, size_t positionOffset, std::vector<Meshlet>& outMeshlets)
+{
+	outMeshlets.clear();
+
+	// id of the last meshlet that referenced each vertex
+	std::vector<unsigned int> lastMeshlet(vertexCount, ~0u);
+
+	Meshlet meshlet = {};
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		const unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+
+		unsigned int id = (unsigned int)outMeshlets.size();
+		unsigned int newVertices = (lastMeshlet[a] != id) + (lastMeshlet[b] != id && b != a) + (lastMeshlet[c] != id && c != a && c != b);
+
+		// Start a new meshlet when this triangle does not fit.
+		if (meshlet.vertexCount + newVertices > maxVertices || meshlet.indexCount / 3 + 1 > maxTriangles)
+		{
+			computeBounds(meshlet, indices, vertices, vertexSize, positionOffset);
+			outMeshlets.push_back(meshlet);
+
+			meshlet = {};
+			meshlet.indexOffset = (unsigned int)i;
+			id++;
+		}
+
+		for (unsigned int v : { a, b, c })
+		{
+			if (lastMeshlet[v] != id)
+			{
+				lastMeshlet[v] = id;
+				meshlet.vertexCount++;
+			}
+		}
+		meshlet.indexCount += 3;
+	}
+
+	if (meshlet.indexCount)
+	{
+		computeBounds(meshlet, indices, vertices, vertexSize, positionOffset);
+		outMeshlets.push_back(meshlet);
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include <vec3.hpp>
+
+struct Meshlet
+{
+	// triangles are a contiguous range of the mesh's index buffer
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	unsigned int vertexCount;
+
+	// bounding sphere
+	glm::vec3 center;
+	float radius;
+
+	// normal cone: every triangle faces away from a viewer at v if
+	// dot(normalize(coneApex - v), coneAxis) >= coneCutoff (a cutoff above 1 disables the test)
+	glm::vec3 coneApex;
+	glm::vec3 coneAxis;
+	float coneCutoff;
+};
+
+namespace Meshlets
+{
+	const unsigned int maxVertices = 64;
+	const unsigned int maxTriangles = 124;
+
+	// Splits the index buffer in order into meshlets of at most maxVertices unique vertices and
+	// maxTriangles triangles. Works best on indices already sorted for the vertex cache.
+	void build(const unsigned int* indices, size_t indexCount, const void* vertices, size_t vertexCount,
+		size_t vertexSize, size_t positionOffset, std::vector<Meshlet>& outMeshlets);
+}
@@ -0,0 +1,114 @@
+#include "pch.h"
+#include "MeshletCuller.h"
+#include "Frustum.h"
+#include "HiZPyramid.h"
+#include "Shader.h"
+
+#include <gtc\type_ptr.hpp>
+
+// std430 layout of a meshlet in the compute shader
+struct GpuMeshlet
+{
+	glm::vec4 sphere;
+	glm::vec4 coneApex;
+	glm::vec4 coneAxis;
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	unsigned int padding[2];
+};
+
+// must match local_size_x in res/shaders/Meshlet/ComputeCull.glsl
+static const unsigned int workGroupSize = 64;
+
+MeshletCuller::MeshletCuller()
+{}
+
+bool MeshletCuller::Setup(const std::vector<Meshlet>& meshlets, const unsigned int* indices, size_t indexCount,
+	GLuint instanceBuffer, unsigned int instanceCount)
+{
+	if (!Shader::loadPreludeComputeProgram(program, "res/shaders/Meshlet/ComputeCull.glsl", "res/shaders/Culling/HiZOcclusion.glsl"))
+	{
+		std::cerr << "[Error: MeshletCuller::Setup] Could not load cull program." << std::endl;
+		return false;
+	}
+
+	this->instanceBuffer = instanceBuffer;
+	this->instanceCount = instanceCount;
+	meshletCount = (unsigned int)meshlets.size();
+
+	std::vector<GpuMeshlet> gpuMeshlets(meshletCount);
+	for (unsigned int i = 0; i < meshletCount; i++)
+	{
+		const Meshlet& meshlet = meshlets[i];
+		gpuMeshlets[i].sphere = glm::vec4(meshlet.center, meshlet.radius);
+		gpuMeshlets[i].coneApex = glm::vec4(meshlet.coneApex, 0.0f);
+		gpuMeshlets[i].coneAxis = glm::vec4(meshlet.coneAxis, meshlet.coneCutoff);
+		gpuMeshlets[i].indexOffset = meshlet.indexOffset;
+		gpuMeshlets[i].indexCount = meshlet.indexCount;
+	}
+
+	glCreateBuffers(1, &meshletBuffer);
+	glNamedBufferStorage(meshletBuffer, gpuMeshlets.size() * sizeof(GpuMeshlet), gpuMeshlets.data(), 0);
+
+	glCreateBuffers(1, &sourceIndexBuffer);
+	glNamedBufferStorage(sourceIndexBuffer, indexCount * sizeof(unsigned int), indices, 0);
+
+	// worst case every meshlet of every instance survives
+	glCreateBuffers(1, &outputIndexBuffer);
+	glNamedBufferStorage(outputIndexBuffer, instanceCount * indexCount * sizeof(unsigned int), nullptr, 0);
+
+	resetCommands.resize(instanceCount);
+	for (unsigned int i = 0; i < instanceCount; i++)
+		resetCommands[i] = { 0, 1, (unsigned int)(i * indexCount), 0, i };
+
+	glCreateBuffers(1, &commandBuffer);
+	glNamedBufferStorage(commandBuffer, resetCommands.size() * sizeof(DrawElementsIndirectCommand),
+		resetCommands.data(), GL_DYNAMIC_STORAGE_BIT);
+
+	return true;
+}
+
+void MeshletCuller::Cull(const glm::mat4& viewProjection, const glm::vec3& viewPos, const HiZPyramid* occluders)
+{
+	if (!program)
+		return;
+
+	glNamedBufferSubData(commandBuffer, 0, resetCommands.size() * sizeof(DrawElementsIndirectCommand), resetCommands.data());
+
+	const Frustum frustum(viewProjection);
+
+	glUseProgram(program);
+	glUniform4fv(glGetUniformLocation(program, "frustumPlanes"), 6, glm::value_ptr(frustum.planes[0]));
+	glUniform3fv(glGetUniformLocation(program, "viewPos"), 1, glm::value_ptr(viewPos));
+	glUniformMatrix4fv(glGetUniformLocation(program, "viewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+	glUniform1i(glGetUniformLocation(program, "occlusion"), occluders != nullptr);
+	if (occluders)
+		occluders->Bind(program, 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, meshletBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, sourceIndexBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, outputIndexBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, instanceBuffer);
+
+	// one work group per meshlet and instance
+	glDispatchCompute(meshletCount, instanceCount, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT);
+}
+
+void MeshletCuller::Draw(GLuint vao)
+{
+	glBindVertexArray(vao);
+
+	// The element buffer is part of the vertex array state, so put the mesh's own one back afterwards.
+	GLint meshIndexBuffer = 0;
+	glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &meshIndexBuffer);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, outputIndexBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, instanceCount, 0);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshIndexBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <vec3.hpp>
+#include <mat4x4.hpp>
+
+#include "Meshlet.h"
+#include "IndirectCommand.h"
+
+class HiZPyramid;
+
+/*
+	Culls the meshlets of one mesh against the frustum and their normal cones on the GPU.
+	Every instance gets its own draw command and index range; the compute pass appends the
+	indices of its surviving meshlets there and the whole set is drawn with one
+	glMultiDrawElementsIndirect, with baseInstance selecting the instance attributes.
+
+	Given a HiZPyramid, meshlets that lie behind its depth are dropped as well. This is a single
+	test against whatever depth the pyramid was built from, e.g. the occluders drawn so far.
+*/
+class MeshletCuller
+{
+public:
+	MeshletCuller();
+
+	// instanceBuffer holds instanceCount transforms packed as ModelInstanceLayout (or PbrInstanceLayout),
+	// usually the InstanceBuffer behind the instanced attributes.
+	bool Setup(const std::vector<Meshlet>& meshlets, const unsigned int* indices, size_t indexCount,
+		GLuint instanceBuffer, unsigned int instanceCount);
+	// occluders is optional and must be built from a depth buffer of the same viewProjection.
+	void Cull(const glm::mat4& viewProjection, const glm::vec3& viewPos, const HiZPyramid* occluders = nullptr);
+	void Draw(GLuint vao);
+
+private:
+	GLuint program = 0;
+	GLuint meshletBuffer = 0;
+	GLuint sourceIndexBuffer = 0;
+	GLuint outputIndexBuffer = 0;
+	GLuint commandBuffer = 0;
+	GLuint instanceBuffer = 0;
+
+	unsigned int meshletCount = 0;
+	unsigned int instanceCount = 0;
+
+	// commands with a zero count, uploaded before every cull
+	std::vector<DrawElementsIndirectCommand> resetCommands;
+};
@@ -1,10 +1,20 @@
 #include "pch.h"
 #include "Model.h"
-
-Model::Model(std::string&& path)
-	: directory(path.substr(0, path.find_last_of('/')))
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ObjLoader.h"
+#include "BlendLoader.h"
+#include "TangentSpace.h"
+
+#include <algorithm>
+#include <cctype>
+#include <gtc\type_ptr.hpp>
+
+Model::Model(std::string&& path, unsigned int lodCount)
+	: directory(path.substr(0, path.find_last_of('/'))), lodCount(lodCount)
 {
 	loadModel(std::move(path));
+	sceneGraph.Update();
 }
 
 void Model::Draw(GLuint shader)
@@ -19,8 +29,46 @@ void Model::Draw(GLuint shader, Texture& diffMap, Texture& specMap)
 		meshes[i].Draw(shader, diffMap, specMap);
 }
 
+void Model::Draw(GLuint shader, const glm::mat4& model)
+{
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		const glm::mat4 world = model * sceneGraph.GetWorld(meshNodes[i]);
+		glUseProgram(shader);
+		glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(world));
+		meshes[i].Draw(shader);
+	}
+}
+
+void Model::DrawInstanced(GLuint shader, InstanceBuffer& instances, unsigned int lod, size_t first, size_t count)
+{
+	if (first >= instances.GetCount())
+		return;
+
+	count = std::min(count, instances.GetCount() - first);
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		instances.Attach(meshes[i].vao);
+		meshes[i].DrawInstanced(shader, (GLsizei)count, (GLuint)first, lod);
+	}
+}
+
+void Model::Update()
+{
+	sceneGraph.Update();
+}
+
 void Model::loadModel(std::string&& path)
 {
+	// Plain OBJ and .blend files go through the dedicated loaders; Assimp handles everything
+	// else and any file the fast paths reject.
+	std::string extension = path.substr(path.find_last_of('.') + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	if (extension == "obj" && loadObj(path))
+		return;
+	if (extension == "blend" && loadBlend(path))
+		return;
+
 	Assimp::Importer importer;
 	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
 
@@ -30,27 +78,32 @@ void Model::loadModel(std::string&& path)
 		return;
 	}
 	
-	processNode(scene->mRootNode, scene);
+	processNode(scene->mRootNode, scene, invalidSceneNode);
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene)
+void Model::processNode(aiNode* node, const aiScene* scene, SceneNode parent)
 {
+	// aiMatrix4x4 is row major
+	const aiMatrix4x4& m = node->mTransformation;
+	const glm::mat4 local(
+		m.a1, m.b1, m.c1, m.d1,
+		m.a2, m.b2, m.c2, m.d2,
+		m.a3, m.b3, m.c3, m.d3,
+		m.a4, m.b4, m.c4, m.d4
+	);
+	const SceneNode sceneNode = sceneGraph.CreateNode(parent, local, node->mName.C_Str());
+
 	// Process each of the node's meshes.
 	for (unsigned int i = 0; i < node->mNumMeshes; i++)
 	{
 		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
 		meshes.push_back(processMesh(mesh, scene));
+		meshNodes.push_back(sceneNode);
 	}
 
 	// Process each of the node's children.
-	int x = 0;
 	for (unsigned int i = 0; i < node->mNumChildren; i++)
-	{
-		
-		processNode(node->mChildren[i], scene);
-		float percent = x++ * 100.0f / 79.0f;
-
-	}
+		processNode(node->mChildren[i], scene, sceneNode);
 }
 
 
@@ -79,7 +132,6 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
 		for (unsigned int j = 0; j < face.mNumIndices; j++)
 			indices.emplace_back(face.mIndices[j]);
 	}
-
 	// texture data
 	std::vector<Texture> textures;
 	int matIndex = mesh->mMaterialIndex;
@@ -90,7 +142,79 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
 		emplaceMaterialTextures(material, aiTextureType_SPECULAR, TextureType::SPECULAR, textures);
 	}
 
-	return Mesh(vertices, indices, textures);
+	return createMesh(mesh->mName.C_Str(), vertices, indices, textures);
+}
+
+bool Model::loadObj(const std::string& path)
+{
+	std::vector<ObjMesh> objMeshes;
+	std::vector<ObjMaterial> objMaterials;
+	if (!ObjLoader::load(path, objMeshes, objMaterials))
+		return false;
+
+	// flat files hang every mesh from a single root
+	const SceneNode root = sceneGraph.CreateNode(invalidSceneNode, glm::mat4(1.0f), path);
+
+	for (ObjMesh& objMesh : objMeshes)
+	{
+		std::vector<Texture> textures;
+		if (objMesh.material >= 0)
+		{
+			const ObjMaterial& material = objMaterials[objMesh.material];
+			if (!material.diffuseMap.empty())
+				emplaceTexture(material.diffuseMap, TextureType::DIFFUSE, textures);
+			if (!material.specularMap.empty())
+				emplaceTexture(material.specularMap, TextureType::SPECULAR, textures);
+		}
+
+		meshes.push_back(createMesh(objMesh.name, objMesh.vertices, objMesh.indices, textures));
+		meshNodes.push_back(root);
+	}
+
+	return true;
+}
+
+bool Model::loadBlend(const std::string& path)
+{
+	std::vector<BlendMesh> blendMeshes;
+	std::vector<BlendMaterial> blendMaterials;
+	if (!BlendLoader::load(path, blendMeshes, blendMaterials))
+		return false;
+
+	// flat files hang every mesh from a single root
+	const SceneNode root = sceneGraph.CreateNode(invalidSceneNode, glm::mat4(1.0f), path);
+
+	for (BlendMesh& blendMesh : blendMeshes)
+	{
+		std::vector<Texture> textures;
+		if (blendMesh.material >= 0)
+		{
+			const BlendMaterial& material = blendMaterials[blendMesh.material];
+			if (!material.diffuseMap.empty())
+				emplaceTexture(material.diffuseMap, TextureType::DIFFUSE, textures);
+			if (!material.specularMap.empty())
+				emplaceTexture(material.specularMap, TextureType::SPECULAR, textures);
+		}
+
+		meshes.push_back(createMesh(blendMesh.name, blendMesh.vertices, blendMesh.indices, textures));
+		meshNodes.push_back(root);
+	}
+
+	return true;
+}
+
+Mesh Model::createMesh(const std::string& name, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, std::vector<Texture>& textures)
+{
+	MeshOptimizer::optimize(name, vertices, indices);
+	// after welding, so split copies of a vertex share one frame
+	TangentSpace::generate(vertices, indices);
+
+	// levels of detail
+	std::vector<unsigned int> lodIndices;
+	std::vector<MeshLod> lods;
+	MeshSimplifier::buildLods(vertices, indices, lodCount, lodIndices, lods);
+
+	return Mesh(vertices, indices, textures, lodIndices, lods);
 }
 
 void Model::emplaceMaterialTextures(aiMaterial* mat, aiTextureType type, TextureType myType, std::vector<Texture>& outTextures)
@@ -99,24 +223,27 @@ void Model::emplaceMaterialTextures(aiMaterial* mat, aiTextureType type, Texture
 	{
 		aiString aTexName;
 		mat->GetTexture(type, i, &aTexName);
-		std::string texName = aTexName.C_Str();
+		emplaceTexture(aTexName.C_Str(), myType, outTextures);
+	}
+}
 
-		bool skip = false;
-		for (const std::string& otherTexName : loadedTexNames)
+void Model::emplaceTexture(const std::string& texName, TextureType myType, std::vector<Texture>& outTextures)
+{
+	bool skip = false;
+	for (const std::string& otherTexName : loadedTexNames)
+	{
+		if (texName == otherTexName)
 		{
-			if (texName == otherTexName)
-			{
-				loadedTexNames.emplace_back(texName);
-				skip = true;
-				break;
-			}
+			loadedTexNames.emplace_back(texName);
+			skip = true;
+			break;
 		}
+	}
 
-		if (!skip)
-		{
-			bool hasAlpha = texName.substr(texName.find_last_of(".")) == ".png";
-			std::string path = directory + "/" + texName;
-			outTextures.emplace_back(myType, 0, std::move(path), hasAlpha );
-		}
+	if (!skip)
+	{
+		bool hasAlpha = texName.substr(texName.find_last_of(".")) == ".png";
+		std::string path = directory + "/" + texName;
+		outTextures.emplace_back(myType, 0, std::move(path), hasAlpha );
 	}
-}
+}
\ No newline at end of file
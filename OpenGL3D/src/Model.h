@@ -3,26 +3,48 @@
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <cstdint>
 #include <iostream>
 
+#include "InstanceBuffer.h"
 #include "Mesh.h"
+#include "SceneGraph.h"
 
 class Model
 {
 public:
-	Model(std::string&& path);
+	// lodCount levels of detail (including the full mesh) are generated for every mesh.
+	Model(std::string&& path, unsigned int lodCount = 1);
 	void Draw(GLuint shader);
 	void Draw(GLuint shader, Texture& diffMap, Texture& specMap);
+	// Sets the "model" uniform of every mesh to model * its node's world matrix.
+	void Draw(GLuint shader, const glm::mat4& model);
+	// Draws count instances of instances from first (all of them by default) at the given level,
+	// attaching the buffer to every mesh on first use. Node transforms are not applied: the
+	// instance transforms place the whole model.
+	void DrawInstanced(GLuint shader, InstanceBuffer& instances, unsigned int lod = 0, size_t first = 0, size_t count = SIZE_MAX);
+
+	// Recomputes the world matrices after nodes were moved through sceneGraph.
+	void Update();
 
 	std::string directory;
 	std::vector<Mesh> meshes;
 
+	// imported node hierarchy; meshNodes[i] is the node meshes[i] hangs from
+	SceneGraph sceneGraph;
+	std::vector<SceneNode> meshNodes;
+
 private:
 	
 	std::vector<std::string> loadedTexNames;
+	unsigned int lodCount;
 
 	void loadModel(std::string&& path);
-	void processNode(aiNode* node, const aiScene* scene);
+	void processNode(aiNode* node, const aiScene* scene, SceneNode parent);
 	Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+	bool loadObj(const std::string& path);
+	bool loadBlend(const std::string& path);
+	Mesh createMesh(const std::string& name, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, std::vector<Texture>& textures);
 	void emplaceMaterialTextures(aiMaterial* mat, aiTextureType type, TextureType myType, std::vector<Texture>& outTextures);
+	void emplaceTexture(const std::string& texName, TextureType myType, std::vector<Texture>& outTextures);
 };
\ No newline at end of file
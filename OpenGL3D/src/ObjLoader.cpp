@@ -0,0 +1,616 @@
+#include "pch.h"
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <vec2.hpp>
+#include <geometric.hpp>
+
+// smallest piece of the file handed to one task
+static const size_t minChunkSize = 256 * 1024;
+
+// Negative (relative) face indices are stored as chunk local indices plus this bias
+// until the chunk's global vertex offsets are known.
+static const int relativeBias = 1 << 30;
+static const int missingIndex = -1;
+
+static const double powersOfTen[] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+struct ObjChunk
+{
+	const char* begin;
+	const char* end;
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> texCoords;
+	std::vector<glm::vec3> normals;
+
+	// position/uv/normal index triples, three corners per triangle
+	std::vector<int> corners;
+
+	// usemtl statements as (first triangle, material name)
+	std::vector<std::pair<size_t, std::string>> materialSwitches;
+	std::vector<std::string> materialLibraries;
+};
+
+// triangles of one chunk that share a material
+struct TriangleRange
+{
+	size_t chunk;
+	size_t first;
+	size_t last;
+};
+
+static bool isDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static bool isBlank(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+static const char* skipBlanks(const char* p, const char* end)
+{
+	while (p < end && isBlank(*p))
+		p++;
+	return p;
+}
+
+static const char* skipLine(const char* p, const char* end)
+{
+	const char* newline = (const char*)memchr(p, '\n', end - p);
+	return newline ? newline + 1 : end;
+}
+
+// SWAR digit handling: eight ASCII digits are validated and converted in a single 64-bit register.
+static bool isEightDigits(uint64_t value)
+{
+	return (((value & 0xF0F0F0F0F0F0F0F0ull) | (((value + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4))
+		== 0x3333333333333333ull);
+}
+
+static uint32_t parseEightDigits(uint64_t value)
+{
+	const uint64_t mask = 0x000000FF000000FFull;
+	const uint64_t mul1 = 0x000F424000000064ull;	// 100 + (1000000 << 32)
+	const uint64_t mul2 = 0x0000271000000001ull;	// 1 + (10000 << 32)
+
+	value -= 0x3030303030303030ull;
+	value = (value * 10) + (value >> 8);
+	value = (((value & mask) * mul1) + (((value >> 16) & mask) * mul2)) >> 32;
+	return (uint32_t)value;
+}
+
+// Accumulates digits into mantissa, eight at a time while possible. Digits that no longer fit
+// are skipped. Returns the number of digits read; outAccumulated receives those kept.
+static int parseDigits(const char*& p, const char* end, uint64_t& mantissa, int& outAccumulated)
+{
+	const char* start = p;
+	outAccumulated = 0;
+
+	while (end - p >= 8 && mantissa < 10000000000ull)
+	{
+		uint64_t chunk;
+		memcpy(&chunk, p, sizeof(chunk));
+		if (!isEightDigits(chunk))
+			break;
+
+		mantissa = mantissa * 100000000ull + parseEightDigits(chunk);
+		outAccumulated += 8;
+		p += 8;
+	}
+
+	while (p < end && isDigit(*p))
+	{
+		if (mantissa < 1000000000000000000ull)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			outAccumulated++;
+		}
+		p++;
+	}
+
+	return (int)(p - start);
+}
+
+static bool parseFloat(const char*& p, const char* end, float& outValue)
+{
+	p = skipBlanks(p, end);
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+
+	uint64_t mantissa = 0;
+	int accumulated = 0;
+
+	// integer digits that did not fit scale the value up, kept fraction digits scale it down
+	const int integerDigits = parseDigits(p, end, mantissa, accumulated);
+	int exponent = integerDigits - accumulated;
+
+	int fractionDigits = 0;
+	if (p < end && *p == '.')
+	{
+		p++;
+		fractionDigits = parseDigits(p, end, mantissa, accumulated);
+		exponent -= accumulated;
+	}
+
+	if (!integerDigits && !fractionDigits)
+		return false;
+
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negativeExponent = *p++ == '-';
+
+		int value = 0;
+		while (p < end && isDigit(*p))
+			value = std::min(value * 10 + (*p++ - '0'), 10000);
+		exponent += negativeExponent ? -value : value;
+	}
+
+	double value = (double)mantissa;
+	if (exponent < 0)
+		value = -exponent <= 22 ? value / powersOfTen[-exponent] : value * pow(10.0, exponent);
+	else if (exponent > 0)
+		value = exponent <= 22 ? value * powersOfTen[exponent] : value * pow(10.0, exponent);
+
+	outValue = (float)(negative ? -value : value);
+	return true;
+}
+
+static bool parseInt(const char*& p, const char* end, int& outValue)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+
+	if (p >= end || !isDigit(*p))
+		return false;
+
+	int value = 0;
+	while (p < end && isDigit(*p))
+		value = value * 10 + (*p++ - '0');
+
+	outValue = negative ? -value : value;
+	return true;
+}
+
+static int encodeIndex(int index, size_t localCount)
+{
+	// OBJ indices are one based; negative ones count back from the last element read
+	if (index > 0)
+		return index - 1;
+	if (index < 0)
+		return (int)localCount + index + relativeBias;
+	return missingIndex;
+}
+
+static std::string readName(const char* p, const char* end)
+{
+	p = skipBlanks(p, end);
+	const char* last = p;
+	while (last < end && *last != '\n' && *last != '\r')
+		last++;
+	while (last > p && isBlank(last[-1]))
+		last--;
+	return std::string(p, last);
+}
+
+static bool startsWith(const char* p, const char* end, const char* keyword)
+{
+	const size_t length = strlen(keyword);
+	return (size_t)(end - p) > length && memcmp(p, keyword, length) == 0 && isBlank(p[length]);
+}
+
+static bool parseChunk(ObjChunk& chunk)
+{
+	const char* p = chunk.begin;
+	const char* end = chunk.end;
+	int face[3 * 64];
+
+	while (p < end)
+	{
+		p = skipBlanks(p, end);
+		if (p >= end)
+			break;
+
+		const char* lineEnd = skipLine(p, end);
+
+		if (p[0] == 'v' && p + 1 < end && isBlank(p[1]))
+		{
+			glm::vec3 pos(0.0f);
+			p += 1;
+			if (!parseFloat(p, lineEnd, pos.x) || !parseFloat(p, lineEnd, pos.y) || !parseFloat(p, lineEnd, pos.z))
+				return false;
+			chunk.positions.push_back(pos);
+		}
+		else if (p[0] == 'v' && p + 2 < end && p[1] == 't' && isBlank(p[2]))
+		{
+			glm::vec2 texCoords(0.0f);
+			p += 2;
+			if (!parseFloat(p, lineEnd, texCoords.x))
+				return false;
+			parseFloat(p, lineEnd, texCoords.y);
+			chunk.texCoords.emplace_back(texCoords.x, 1.0f - texCoords.y);
+		}
+		else if (p[0] == 'v' && p + 2 < end && p[1] == 'n' && isBlank(p[2]))
+		{
+			glm::vec3 normal(0.0f);
+			p += 2;
+			if (!parseFloat(p, lineEnd, normal.x) || !parseFloat(p, lineEnd, normal.y) || !parseFloat(p, lineEnd, normal.z))
+				return false;
+			chunk.normals.push_back(normal);
+		}
+		else if (p[0] == 'f' && p + 1 < end && isBlank(p[1]))
+		{
+			p += 1;
+			unsigned int cornerCount = 0;
+
+			while (true)
+			{
+				p = skipBlanks(p, lineEnd);
+				int pos = 0, uv = 0, normal = 0;
+				if (!parseInt(p, lineEnd, pos))
+					break;
+
+				if (p < lineEnd && *p == '/')
+				{
+					p++;
+					if (p < lineEnd && *p != '/')
+						parseInt(p, lineEnd, uv);
+					if (p < lineEnd && *p == '/')
+					{
+						p++;
+						parseInt(p, lineEnd, normal);
+					}
+				}
+
+				if (cornerCount < 64)
+				{
+					face[3 * cornerCount + 0] = encodeIndex(pos, chunk.positions.size());
+					face[3 * cornerCount + 1] = encodeIndex(uv, chunk.texCoords.size());
+					face[3 * cornerCount + 2] = encodeIndex(normal, chunk.normals.size());
+					cornerCount++;
+				}
+			}
+
+			// fan triangulation
+			for (unsigned int c = 1; c + 1 < cornerCount; c++)
+			{
+				chunk.corners.insert(chunk.corners.end(), face, face + 3);
+				chunk.corners.insert(chunk.corners.end(), face + 3 * c, face + 3 * c + 6);
+			}
+		}
+		else if (startsWith(p, lineEnd, "usemtl"))
+			chunk.materialSwitches.emplace_back(chunk.corners.size() / 9, readName(p + 6, lineEnd));
+		else if (startsWith(p, lineEnd, "mtllib"))
+			chunk.materialLibraries.push_back(readName(p + 6, lineEnd));
+
+		// comments, groups, objects and smoothing groups are skipped
+		p = lineEnd;
+	}
+
+	return true;
+}
+
+static int resolveIndex(int index, size_t base, size_t count, bool& valid)
+{
+	if (index == missingIndex)
+		return missingIndex;
+
+	const long long resolved = index >= relativeBias / 2 ? (long long)base + index - relativeBias : index;
+	if (resolved < 0 || resolved >= (long long)count)
+	{
+		valid = false;
+		return missingIndex;
+	}
+
+	return (int)resolved;
+}
+
+static void buildMesh(ObjMesh& mesh, const std::vector<TriangleRange>& ranges, const std::vector<ObjChunk>& chunks,
+	const std::vector<glm::vec3>& positions, const std::vector<glm::vec2>& texCoords, const std::vector<glm::vec3>& normals,
+	const std::vector<glm::vec3>& smoothNormals)
+{
+	size_t cornerCount = 0;
+	for (const TriangleRange& range : ranges)
+		cornerCount += 3 * (range.last - range.first);
+
+	// open addressing table from (position, uv, normal) to vertex index
+	size_t tableSize = 1;
+	while (tableSize < cornerCount * 2)
+		tableSize *= 2;
+
+	const unsigned int empty = ~0u;
+	std::vector<unsigned int> table(tableSize, empty);
+	std::vector<int> keys;
+	keys.reserve(cornerCount);
+
+	mesh.indices.reserve(cornerCount);
+
+	for (const TriangleRange& range : ranges)
+	{
+		const int* corners = chunks[range.chunk].corners.data();
+		for (size_t c = 3 * range.first; c < 3 * range.last; c++)
+		{
+			const int* key = corners + 3 * c;
+			const unsigned int hash = (unsigned int)key[0] * 73856093u ^ (unsigned int)key[1] * 19349663u ^ (unsigned int)key[2] * 83492791u;
+
+			size_t slot = hash & (tableSize - 1);
+			while (table[slot] != empty && memcmp(&keys[3 * table[slot]], key, 3 * sizeof(int)) != 0)
+				slot = (slot + 1) & (tableSize - 1);
+
+			if (table[slot] == empty)
+			{
+				table[slot] = (unsigned int)mesh.vertices.size();
+				keys.insert(keys.end(), key, key + 3);
+
+				mesh.vertices.emplace_back(
+					positions[key[0]],
+					key[2] != missingIndex ? normals[key[2]] : smoothNormals[key[0]],
+					key[1] != missingIndex ? texCoords[key[1]] : glm::vec2(0.0f)
+				);
+			}
+
+			mesh.indices.push_back(table[slot]);
+		}
+	}
+}
+
+bool ObjLoader::load(const std::string& path, std::vector<ObjMesh>& outMeshes, std::vector<ObjMaterial>& outMaterials)
+{
+	outMeshes.clear();
+	outMaterials.clear();
+
+	MappedFile file(path);
+	if (!file.IsOpen())
+		return false;
+
+	ThreadPool& pool = ThreadPool::Global();
+
+	// Cut the file into line aligned chunks.
+	const char* data = file.GetData();
+	const char* dataEnd = data + file.GetSize();
+	const size_t chunkSize = std::max(minChunkSize, file.GetSize() / (pool.GetThreadCount() * 4) + 1);
+
+	std::vector<ObjChunk> chunks;
+	for (const char* p = data; p < dataEnd;)
+	{
+		const char* end = p + std::min<size_t>(chunkSize, dataEnd - p);
+		end = end < dataEnd ? skipLine(end, dataEnd) : end;
+
+		chunks.emplace_back();
+		chunks.back().begin = p;
+		chunks.back().end = end;
+		p = end;
+	}
+
+	std::atomic<bool> valid(true);
+	pool.ParallelFor(chunks.size(), 1, [&chunks, &valid](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			if (!parseChunk(chunks[i]))
+				valid = false;
+	});
+
+	if (!valid)
+	{
+		std::cerr << "[Error: ObjLoader::load] Malformed vertex data in " << path << "." << std::endl;
+		return false;
+	}
+
+	// global offsets of every chunk's attributes
+	const size_t chunkCount = chunks.size();
+	std::vector<size_t> positionBase(chunkCount + 1, 0), texCoordBase(chunkCount + 1, 0), normalBase(chunkCount + 1, 0);
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		positionBase[i + 1] = positionBase[i] + chunks[i].positions.size();
+		texCoordBase[i + 1] = texCoordBase[i] + chunks[i].texCoords.size();
+		normalBase[i + 1] = normalBase[i] + chunks[i].normals.size();
+	}
+
+	std::vector<glm::vec3> positions(positionBase[chunkCount]);
+	std::vector<glm::vec2> texCoords(texCoordBase[chunkCount]);
+	std::vector<glm::vec3> normals(normalBase[chunkCount]);
+	std::atomic<bool> hasMissingNormals(false);
+
+	pool.ParallelFor(chunkCount, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			ObjChunk& chunk = chunks[i];
+			std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionBase[i]);
+			std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + texCoordBase[i]);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalBase[i]);
+
+			bool chunkValid = true;
+			bool missingNormal = false;
+			for (size_t c = 0; c < chunk.corners.size(); c += 3)
+			{
+				chunk.corners[c + 0] = resolveIndex(chunk.corners[c + 0], positionBase[i], positions.size(), chunkValid);
+				chunk.corners[c + 1] = resolveIndex(chunk.corners[c + 1], texCoordBase[i], texCoords.size(), chunkValid);
+				chunk.corners[c + 2] = resolveIndex(chunk.corners[c + 2], normalBase[i], normals.size(), chunkValid);
+				missingNormal |= chunk.corners[c + 2] == missingIndex;
+			}
+
+			// a face without a position is unusable
+			for (size_t c = 0; c < chunk.corners.size(); c += 3)
+				chunkValid &= chunk.corners[c] != missingIndex;
+
+			if (!chunkValid)
+				valid = false;
+			if (missingNormal)
+				hasMissingNormals = true;
+		}
+	});
+
+	if (!valid)
+	{
+		std::cerr << "[Error: ObjLoader::load] Face index out of range in " << path << "." << std::endl;
+		return false;
+	}
+
+	// materials
+	const std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+	for (const ObjChunk& chunk : chunks)
+		for (const std::string& library : chunk.materialLibraries)
+			loadMaterials(directory + library, outMaterials);
+
+	std::unordered_map<std::string, int> materialIndices;
+	for (size_t i = 0; i < outMaterials.size(); i++)
+		materialIndices.emplace(outMaterials[i].name, (int)i);
+
+	// Group triangle ranges by material; the current material carries over chunk boundaries.
+	std::vector<std::vector<TriangleRange>> groups;
+	std::vector<int> groupMaterials;
+	std::unordered_map<int, size_t> groupOfMaterial;
+
+	int material = -1;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		const ObjChunk& chunk = chunks[i];
+		const size_t triangleCount = chunk.corners.size() / 9;
+
+		size_t first = 0;
+		for (size_t s = 0; s <= chunk.materialSwitches.size(); s++)
+		{
+			const size_t last = s < chunk.materialSwitches.size() ? chunk.materialSwitches[s].first : triangleCount;
+			if (last > first)
+			{
+				auto group = groupOfMaterial.find(material);
+				if (group == groupOfMaterial.end())
+				{
+					group = groupOfMaterial.emplace(material, groups.size()).first;
+					groups.emplace_back();
+					groupMaterials.push_back(material);
+				}
+				groups[group->second].push_back({ i, first, last });
+			}
+
+			if (s < chunk.materialSwitches.size())
+			{
+				auto found = materialIndices.find(chunk.materialSwitches[s].second);
+				material = found != materialIndices.end() ? found->second : -1;
+				first = last;
+			}
+		}
+	}
+
+	// Area weighted smooth normals for faces that have none.
+	std::vector<glm::vec3> smoothNormals;
+	if (hasMissingNormals)
+	{
+		smoothNormals.assign(positions.size(), glm::vec3(0.0f));
+		for (const ObjChunk& chunk : chunks)
+		{
+			for (size_t c = 0; c < chunk.corners.size(); c += 9)
+			{
+				const int a = chunk.corners[c], b = chunk.corners[c + 3], d = chunk.corners[c + 6];
+				const glm::vec3 normal = glm::cross(positions[b] - positions[a], positions[d] - positions[a]);
+				smoothNormals[a] += normal;
+				smoothNormals[b] += normal;
+				smoothNormals[d] += normal;
+			}
+		}
+
+		for (glm::vec3& normal : smoothNormals)
+			if (glm::length(normal) > 0.0f)
+				normal = glm::normalize(normal);
+	}
+
+	outMeshes.resize(groups.size());
+	pool.ParallelFor(groups.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t g = begin; g < end; g++)
+		{
+			ObjMesh& mesh = outMeshes[g];
+			mesh.material = groupMaterials[g];
+			mesh.name = mesh.material >= 0 ? outMaterials[mesh.material].name : path.substr(directory.size());
+			buildMesh(mesh, groups[g], chunks, positions, texCoords, normals, smoothNormals);
+		}
+	});
+
+	return true;
+}
+
+bool ObjLoader::loadMaterials(const std::string& path, std::vector<ObjMaterial>& outMaterials)
+{
+	MappedFile file(path);
+	if (!file.IsOpen())
+	{
+		std::cerr << "[Error: ObjLoader::loadMaterials] Could not open " << path << "." << std::endl;
+		return false;
+	}
+
+	std::istringstream stream(std::string(file.GetData(), file.GetSize()));
+	std::string line;
+	ObjMaterial* material = nullptr;
+
+	while (std::getline(stream, line))
+	{
+		std::istringstream tokens(line);
+		std::string keyword;
+		tokens >> keyword;
+
+		if (keyword == "newmtl")
+		{
+			outMaterials.emplace_back();
+			material = &outMaterials.back();
+			material->name = readName(line.c_str() + line.find("newmtl") + 6, line.c_str() + line.size());
+			continue;
+		}
+
+		if (!material)
+			continue;
+
+		// texture statements may carry options before the file name, which is the last token
+		std::string lastToken;
+		for (std::string token; tokens >> token;)
+			lastToken = token;
+		tokens.clear();
+		tokens.seekg(0);
+		tokens >> keyword;
+
+		if (keyword == "Ka")
+			tokens >> material->ambient.x >> material->ambient.y >> material->ambient.z;
+		else if (keyword == "Kd")
+			tokens >> material->diffuse.x >> material->diffuse.y >> material->diffuse.z;
+		else if (keyword == "Ks")
+			tokens >> material->specular.x >> material->specular.y >> material->specular.z;
+		else if (keyword == "Ns")
+			tokens >> material->shininess;
+		else if (keyword == "d")
+			tokens >> material->opacity;
+		else if (keyword == "Tr")
+		{
+			tokens >> material->opacity;
+			material->opacity = 1.0f - material->opacity;
+		}
+		else if (keyword == "map_Kd")
+			material->diffuseMap = lastToken;
+		else if (keyword == "map_Ks")
+			material->specularMap = lastToken;
+		else if (keyword == "map_Bump" || keyword == "map_bump" || keyword == "bump" || keyword == "norm")
+			material->normalMap = lastToken;
+	}
+
+	return true;
+}
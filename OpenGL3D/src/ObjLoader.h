@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <vec3.hpp>
+
+#include "Mesh.h"
+
+struct ObjMaterial
+{
+	std::string name;
+
+	glm::vec3 ambient = glm::vec3(0.0f);
+	glm::vec3 diffuse = glm::vec3(1.0f);
+	glm::vec3 specular = glm::vec3(0.0f);
+	float shininess = 32.0f;
+	float opacity = 1.0f;
+
+	// texture file names relative to the .mtl file
+	std::string diffuseMap;
+	std::string specularMap;
+	std::string normalMap;
+};
+
+struct ObjMesh
+{
+	std::string name;
+	// index into the material list, -1 without usemtl
+	int material = -1;
+
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+};
+
+/*
+	Wavefront OBJ/MTL reader that writes Vertex/index arrays directly.
+	The file is memory mapped and cut into line aligned chunks that are parsed on the
+	thread pool; vertices are then deduplicated per material with a hash of their
+	position/uv/normal indices. One ObjMesh is produced per material, matching how
+	Assimp splits OBJ files. Polygons are fan triangulated and uvs are flipped like
+	aiProcess_FlipUVs.
+*/
+namespace ObjLoader
+{
+	bool load(const std::string& path, std::vector<ObjMesh>& outMeshes, std::vector<ObjMaterial>& outMaterials);
+	bool loadMaterials(const std::string& path, std::vector<ObjMaterial>& outMaterials);
+}
@@ -0,0 +1,290 @@
+#include "pch.h"
+#include "OcclusionRasterizer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <emmintrin.h>
+
+static const int tileWidth = 32;
+static const int tileHeight = 16;
+static const int blockWidth = 8;
+static const int blockHeight = 4;
+
+// boxes per thread pool task
+static const size_t boxGrain = 256;
+
+static float horizontalMax(__m128 v)
+{
+	v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(v);
+}
+
+OcclusionRasterizer::OcclusionRasterizer(int width, int height)
+	: tilesX((std::max(width, 1) + tileWidth - 1) / tileWidth), tilesY((std::max(height, 1) + tileHeight - 1) / tileHeight),
+	viewProjection(1.0f)
+{
+	this->width = tilesX * tileWidth;
+	this->height = tilesY * tileHeight;
+
+	depth.assign(this->width * this->height, 1.0f);
+	blockDepth.assign((this->width / blockWidth) * (this->height / blockHeight), 1.0f);
+	bins.resize(tilesX * tilesY);
+}
+
+void OcclusionRasterizer::Begin(const glm::mat4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+
+	std::fill(depth.begin(), depth.end(), 1.0f);
+	std::fill(blockDepth.begin(), blockDepth.end(), 1.0f);
+	triangles.clear();
+	for (std::vector<unsigned int>& bin : bins)
+		bin.clear();
+}
+
+void OcclusionRasterizer::AddOccluder(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, const glm::mat4& model)
+{
+	const glm::mat4 transform = viewProjection * model;
+	clipPositions.resize(positions.size());
+	for (size_t i = 0; i < positions.size(); i++)
+		clipPositions[i] = transform * glm::vec4(positions[i], 1.0f);
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		Triangle triangle;
+		bool inside = true;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			// dropping a triangle only ever loses occlusion, so anything outside the depth range goes
+			const glm::vec4& clip = clipPositions[indices[i + corner]];
+			inside = inside && clip.w > 0.0f && clip.z >= -clip.w && clip.z <= clip.w;
+			if (!inside)
+				break;
+
+			triangle.x[corner] = (clip.x / clip.w * 0.5f + 0.5f) * width;
+			triangle.y[corner] = (clip.y / clip.w * 0.5f + 0.5f) * height;
+			triangle.z[corner] = clip.z / clip.w * 0.5f + 0.5f;
+		}
+
+		if (!inside)
+			continue;
+
+		// counter-clockwise is front facing
+		const float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0])
+			- (triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+		if (area <= 0.0f)
+			continue;
+
+		const float minX = std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]));
+		const float maxX = std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]));
+		const float minY = std::min(triangle.y[0], std::min(triangle.y[1], triangle.y[2]));
+		const float maxY = std::max(triangle.y[0], std::max(triangle.y[1], triangle.y[2]));
+		if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+			continue;
+
+		const int firstTileX = std::max((int)minX, 0) / tileWidth;
+		const int lastTileX = std::min((int)maxX, width - 1) / tileWidth;
+		const int firstTileY = std::max((int)minY, 0) / tileHeight;
+		const int lastTileY = std::min((int)maxY, height - 1) / tileHeight;
+
+		const unsigned int index = (unsigned int)triangles.size();
+		triangles.push_back(triangle);
+		for (int tileY = firstTileY; tileY <= lastTileY; tileY++)
+			for (int tileX = firstTileX; tileX <= lastTileX; tileX++)
+				bins[tileY * tilesX + tileX].push_back(index);
+	}
+}
+
+void OcclusionRasterizer::Rasterize()
+{
+	ThreadPool::Global().ParallelFor(bins.size(), 1, [this](size_t first, size_t last)
+	{
+		for (size_t tile = first; tile < last; tile++)
+			rasterizeTile((int)tile % tilesX, (int)tile / tilesX);
+	});
+}
+
+void OcclusionRasterizer::rasterizeTile(int tileX, int tileY)
+{
+	const int left = tileX * tileWidth;
+	const int bottom = tileY * tileHeight;
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 pixelOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+	for (unsigned int index : bins[tileY * tilesX + tileX])
+	{
+		const Triangle& triangle = triangles[index];
+
+		// edge e runs from corner e to e + 1 and is a x + b y + c, positive on the inside
+		float a[3], b[3], c[3];
+		for (int e = 0; e < 3; e++)
+		{
+			const int next = (e + 1) % 3;
+			a[e] = triangle.y[e] - triangle.y[next];
+			b[e] = triangle.x[next] - triangle.x[e];
+			c[e] = triangle.x[e] * triangle.y[next] - triangle.x[next] * triangle.y[e];
+		}
+
+		// depth as a plane over the screen, from the barycentric weights (edge e weighs the opposite corner)
+		const float area = a[0] * triangle.x[2] + b[0] * triangle.y[2] + c[0];
+		const float zA = (a[1] * triangle.z[0] + a[2] * triangle.z[1] + a[0] * triangle.z[2]) / area;
+		const float zB = (b[1] * triangle.z[0] + b[2] * triangle.z[1] + b[0] * triangle.z[2]) / area;
+		const float zC = (c[1] * triangle.z[0] + c[2] * triangle.z[1] + c[0] * triangle.z[2]) / area;
+
+		const float minX = std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]));
+		const float maxX = std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]));
+		const float minY = std::min(triangle.y[0], std::min(triangle.y[1], triangle.y[2]));
+		const float maxY = std::max(triangle.y[0], std::max(triangle.y[1], triangle.y[2]));
+
+		// groups of four pixels, aligned within the tile
+		const int firstX = std::max((int)minX, left) & ~3;
+		const int lastX = std::min((int)maxX, left + tileWidth - 1);
+		const int firstY = std::max((int)minY, bottom);
+		const int lastY = std::min((int)maxY, bottom + tileHeight - 1);
+
+		const __m128 edgeA0 = _mm_set1_ps(a[0]), edgeA1 = _mm_set1_ps(a[1]), edgeA2 = _mm_set1_ps(a[2]);
+		const __m128 depthA = _mm_set1_ps(zA);
+
+		for (int y = firstY; y <= lastY; y++)
+		{
+			const float pixelY = y + 0.5f;
+			const __m128 row0 = _mm_set1_ps(b[0] * pixelY + c[0]);
+			const __m128 row1 = _mm_set1_ps(b[1] * pixelY + c[1]);
+			const __m128 row2 = _mm_set1_ps(b[2] * pixelY + c[2]);
+			const __m128 rowDepth = _mm_set1_ps(zB * pixelY + zC);
+			float* row = depth.data() + y * width;
+
+			for (int x = firstX; x <= lastX; x += 4)
+			{
+				const __m128 pixelX = _mm_add_ps(_mm_set1_ps((float)x), pixelOffsets);
+				const __m128 edge0 = _mm_add_ps(_mm_mul_ps(edgeA0, pixelX), row0);
+				const __m128 edge1 = _mm_add_ps(_mm_mul_ps(edgeA1, pixelX), row1);
+				const __m128 edge2 = _mm_add_ps(_mm_mul_ps(edgeA2, pixelX), row2);
+				const __m128 covered = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge0, zero), _mm_cmpge_ps(edge1, zero)), _mm_cmpge_ps(edge2, zero));
+				if (!_mm_movemask_ps(covered))
+					continue;
+
+				const __m128 z = _mm_add_ps(_mm_mul_ps(depthA, pixelX), rowDepth);
+				const __m128 old = _mm_loadu_ps(row + x);
+				const __m128 candidate = _mm_or_ps(_mm_and_ps(covered, z), _mm_andnot_ps(covered, old));
+				_mm_storeu_ps(row + x, _mm_min_ps(old, candidate));
+			}
+		}
+	}
+
+	// farthest depth of every block in the tile
+	const int blocksPerRow = width / blockWidth;
+	for (int blockY = bottom; blockY < bottom + tileHeight; blockY += blockHeight)
+	{
+		for (int blockX = left; blockX < left + tileWidth; blockX += blockWidth)
+		{
+			__m128 farthest = _mm_setzero_ps();
+			for (int y = blockY; y < blockY + blockHeight; y++)
+			{
+				const float* row = depth.data() + y * width + blockX;
+				farthest = _mm_max_ps(farthest, _mm_max_ps(_mm_loadu_ps(row), _mm_loadu_ps(row + 4)));
+			}
+
+			blockDepth[(blockY / blockHeight) * blocksPerRow + blockX / blockWidth] = horizontalMax(farthest);
+		}
+	}
+}
+
+bool OcclusionRasterizer::IsOccluded(const glm::vec3& min, const glm::vec3& max) const
+{
+	// screen rectangle and nearest depth of the box
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float nearest = FLT_MAX;
+
+	// the corners are the min corner plus any of the edges along x, y and z
+	const glm::vec4 base = viewProjection * glm::vec4(min, 1.0f);
+	const glm::vec4 edgeX = viewProjection[0] * (max.x - min.x);
+	const glm::vec4 edgeY = viewProjection[1] * (max.y - min.y);
+	const glm::vec4 edgeZ = viewProjection[2] * (max.z - min.z);
+	for (int i = 0; i < 8; i++)
+	{
+		const glm::vec4 clip = base + ((i & 1) ? edgeX : glm::vec4(0.0f)) + ((i & 2) ? edgeY : glm::vec4(0.0f)) + ((i & 4) ? edgeZ : glm::vec4(0.0f));
+		if (clip.w <= 0.0f)
+			return false;
+
+		const float x = (clip.x / clip.w * 0.5f + 0.5f) * width;
+		const float y = (clip.y / clip.w * 0.5f + 0.5f) * height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip.z / clip.w * 0.5f + 0.5f);
+	}
+
+	// outside the screen is the frustum culler's business
+	if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+		return false;
+
+	const int firstX = std::max((int)std::floor(minX), 0);
+	const int lastX = std::min((int)std::ceil(maxX), width - 1);
+	const int firstY = std::max((int)std::floor(minY), 0);
+	const int lastY = std::min((int)std::ceil(maxY), height - 1);
+
+	const int blocksPerRow = width / blockWidth;
+	for (int blockY = firstY / blockHeight; blockY <= lastY / blockHeight; blockY++)
+	{
+		for (int blockX = firstX / blockWidth; blockX <= lastX / blockWidth; blockX++)
+		{
+			if (blockDepth[blockY * blocksPerRow + blockX] < nearest)
+				continue;
+
+			// the block as a whole does not hide the box; its pixels within the rectangle may
+			const int rowBegin = std::max(blockY * blockHeight, firstY);
+			const int rowEnd = std::min((blockY + 1) * blockHeight - 1, lastY);
+			const int columnBegin = std::max(blockX * blockWidth, firstX);
+			const int columnEnd = std::min((blockX + 1) * blockWidth - 1, lastX);
+			for (int y = rowBegin; y <= rowEnd; y++)
+				for (int x = columnBegin; x <= columnEnd; x++)
+					if (depth[y * width + x] >= nearest)
+						return false;
+		}
+	}
+
+	return true;
+}
+
+size_t OcclusionRasterizer::CullBoxes(const BoxBounds& boxes, const unsigned int* indices, size_t count, unsigned int* outIndices)
+{
+	occludedFlags.resize(count);
+	ThreadPool::Global().ParallelFor(count, boxGrain, [&](size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			const unsigned int box = indices[i];
+			occludedFlags[i] = IsOccluded(
+				glm::vec3(boxes.minX[box], boxes.minY[box], boxes.minZ[box]),
+				glm::vec3(boxes.maxX[box], boxes.maxY[box], boxes.maxZ[box]));
+		}
+	});
+
+	// front to back, so outIndices may alias indices
+	size_t visible = 0;
+	for (size_t i = 0; i < count; i++)
+		if (!occludedFlags[i])
+			outIndices[visible++] = indices[i];
+
+	return visible;
+}
+
+size_t OcclusionRasterizer::GetTriangleCount() const
+{
+	return triangles.size();
+}
+
+int OcclusionRasterizer::GetWidth() const
+{
+	return width;
+}
+
+int OcclusionRasterizer::GetHeight() const
+{
+	return height;
+}
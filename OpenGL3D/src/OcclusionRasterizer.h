@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <vec3.hpp>
+#include <vec4.hpp>
+#include <mat4x4.hpp>
+
+#include "FrustumCuller.h"
+
+/*
+	Occlusion culling on the CPU, for paths that cannot wait a frame for the GPU. A few large
+	occluders are rasterized into a small depth buffer, then bounding boxes are tested against
+	it before anything is drawn.
+
+	The buffer is split into tiles of 32x16 pixels. AddOccluder transforms the triangles,
+	drops the back facing ones and bins the rest into the tiles they touch; Rasterize then
+	gives every tile to the thread pool, which walks four pixels at a time with SSE and keeps
+	the nearest depth. Each tile ends with the farthest depth of every 8x4 block. A box's
+	screen rectangle is checked against those blocks first, and only the blocks that do not
+	hide it are checked per pixel.
+
+	Triangles that cross the near plane are dropped rather than clipped, and coverage is
+	sampled at pixel centres. The occluder meshes must therefore be conservative: inside the
+	real geometry, a little smaller rather than larger.
+*/
+class OcclusionRasterizer
+{
+public:
+	// width and height are rounded up to whole tiles
+	OcclusionRasterizer(int width = 320, int height = 240);
+
+	// Clears the depth and the binned occluders.
+	void Begin(const glm::mat4& viewProjection);
+	void AddOccluder(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, const glm::mat4& model);
+	void Rasterize();
+
+	// True if the box lies entirely behind the rasterized occluders.
+	bool IsOccluded(const glm::vec3& min, const glm::vec3& max) const;
+	// Writes the entries of indices whose box is not occluded to outIndices, which may be
+	// indices itself, and returns how many were written. Order is kept.
+	size_t CullBoxes(const BoxBounds& boxes, const unsigned int* indices, size_t count, unsigned int* outIndices);
+
+	size_t GetTriangleCount() const;
+	int GetWidth() const;
+	int GetHeight() const;
+
+private:
+	// screen space position and depth of the corners
+	struct Triangle
+	{
+		float x[3], y[3], z[3];
+	};
+
+	int width;
+	int height;
+	int tilesX;
+	int tilesY;
+
+	glm::mat4 viewProjection;
+	std::vector<glm::vec4> clipPositions;
+	std::vector<float> depth;
+	// farthest depth per 8x4 block
+	std::vector<float> blockDepth;
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<unsigned int>> bins;
+	std::vector<unsigned char> occludedFlags;
+
+	void rasterizeTile(int tileX, int tileY);
+};
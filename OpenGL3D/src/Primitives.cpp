@@ -0,0 +1,362 @@
+#include "pch.h"
+#include "Primitives.h"
+#include "MeshOptimizer.h"
+#include "TangentSpace.h"
+#include "ThreadPool.h"
+#include "VertexLayout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <glm.hpp>
+
+static const float pi = 3.14159265f;
+// vertices per generation task
+static const size_t generateGrainSize = 4096;
+
+static std::map<std::pair<PrimitiveType, unsigned int>, PrimitiveGeometry> cache;
+
+// primitive UVs stay within [0, 1], so half precision is exact enough
+using PrimitivePbrLayout = VertexLayout<Position<float3>, TexCoords<half2, 1>, Tangent<snorm1010102, 2>, Normal<snorm1010102, 4>>;
+using PrimitiveMeshLayout = VertexLayout<Position<float3>, TexCoords<half2>, Tangent<snorm1010102>, Normal<snorm1010102>>;
+static_assert(PrimitivePbrLayout::GetStride() == PrimitiveMeshLayout::GetStride(), "primitive layouts must share one vertex buffer");
+
+static void fillTrigTable(unsigned int steps, float range, std::vector<float>& outSin, std::vector<float>& outCos)
+{
+	outSin.resize(steps + 1);
+	outCos.resize(steps + 1);
+	for (unsigned int i = 0; i <= steps; i++)
+	{
+		outSin[i] = std::sin(range * i / steps);
+		outCos[i] = std::cos(range * i / steps);
+	}
+}
+
+static void generateUvSphere(unsigned int resolution, PrimitiveMesh& outMesh)
+{
+	const unsigned int segments = std::max(3u, resolution);
+	const unsigned int rings = std::max(2u, resolution / 2);
+	const unsigned int rowSize = segments + 1;
+
+	std::vector<float> sinTheta, cosTheta, sinPhi, cosPhi;
+	fillTrigTable(rings, pi, sinTheta, cosTheta);
+	fillTrigTable(segments, 2.0f * pi, sinPhi, cosPhi);
+	// the seam column must match the first one exactly, and the poles must be single points
+	sinPhi[segments] = sinPhi[0];
+	cosPhi[segments] = cosPhi[0];
+	sinTheta[0] = sinTheta[rings] = 0.0f;
+
+	outMesh.vertices.resize((size_t)(rings + 1) * rowSize);
+	ThreadPool::Global().ParallelFor(rings + 1, std::max<size_t>(1, generateGrainSize / rowSize), [&](size_t begin, size_t end)
+	{
+		for (size_t ring = begin; ring < end; ring++)
+		{
+			const float st = sinTheta[ring], ct = cosTheta[ring];
+			const float v = 1.0f - (float)ring / rings;
+			PrimitiveVertex* row = &outMesh.vertices[ring * rowSize];
+
+			for (unsigned int segment = 0; segment <= segments; segment++)
+			{
+				const float sp = sinPhi[segment], cp = cosPhi[segment];
+				PrimitiveVertex& vertex = row[segment];
+				vertex.pos = glm::vec3(st * sp, ct, st * cp);
+				vertex.normal = vertex.pos;
+				vertex.texCoords = glm::vec2((float)segment / segments, v);
+				// d/du along the ring; d/dv towards the north pole is cross(normal, tangent)
+				vertex.tangent = glm::vec4(cp, 0.0f, -sp, 1.0f);
+			}
+		}
+	});
+
+	// one triangle per segment in the polar rings, two elsewhere
+	const size_t capIndexCount = 3 * (size_t)segments;
+	const size_t rowIndexCount = 6 * (size_t)segments;
+	outMesh.indices.resize(2 * capIndexCount + (rings - 2) * rowIndexCount);
+
+	ThreadPool::Global().ParallelFor(rings, std::max<size_t>(1, generateGrainSize / rowSize), [&](size_t begin, size_t end)
+	{
+		for (size_t ring = begin; ring < end; ring++)
+		{
+			unsigned int* out = &outMesh.indices[ring == 0 ? 0 : capIndexCount + (ring - 1) * rowIndexCount];
+			for (unsigned int segment = 0; segment < segments; segment++)
+			{
+				const unsigned int upper = (unsigned int)ring * rowSize + segment;
+				const unsigned int lower = upper + rowSize;
+
+				if (ring != 0)
+				{
+					*out++ = upper;
+					*out++ = lower;
+					*out++ = upper + 1;
+				}
+				if (ring != rings - 1)
+				{
+					*out++ = upper + 1;
+					*out++ = lower;
+					*out++ = lower + 1;
+				}
+			}
+		}
+	});
+}
+
+static void generateIcosphere(unsigned int level, PrimitiveMesh& outMesh)
+{
+	const float t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+	const glm::vec3 corners[12] =
+	{
+		{ -1.0f, t, 0.0f }, { 1.0f, t, 0.0f }, { -1.0f, -t, 0.0f }, { 1.0f, -t, 0.0f },
+		{ 0.0f, -1.0f, t }, { 0.0f, 1.0f, t }, { 0.0f, -1.0f, -t }, { 0.0f, 1.0f, -t },
+		{ t, 0.0f, -1.0f }, { t, 0.0f, 1.0f }, { -t, 0.0f, -1.0f }, { -t, 0.0f, 1.0f }
+	};
+	static const unsigned int faces[20][3] =
+	{
+		{ 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+		{ 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+		{ 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+		{ 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 }
+	};
+
+	// every face is subdivided on its own into a triangular grid of n segments per edge
+	const unsigned int n = 1u << std::min(level, 10u);
+	const size_t faceVertexCount = (size_t)(n + 1) * (n + 2) / 2;
+	const size_t faceIndexCount = 3 * (size_t)n * n;
+	auto gridIndex = [n](unsigned int i, unsigned int j) { return i * (n + 1) - i * (i - 1) / 2 + j; };
+
+	outMesh.vertices.resize(20 * faceVertexCount, PrimitiveVertex());
+	outMesh.indices.resize(20 * faceIndexCount);
+
+	ThreadPool::Global().ParallelFor(20, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t face = begin; face < end; face++)
+		{
+			PrimitiveVertex* vertices = &outMesh.vertices[face * faceVertexCount];
+			unsigned int* indices = &outMesh.indices[face * faceIndexCount];
+			const unsigned int base = (unsigned int)(face * faceVertexCount);
+
+			for (unsigned int i = 0; i <= n; i++)
+				for (unsigned int j = 0; i + j <= n; j++)
+				{
+					// sum the corners in index order so points on shared edges come out bitwise identical and weld
+					std::pair<unsigned int, unsigned int> weights[3] =
+					{
+						{ faces[face][0], n - i - j }, { faces[face][1], i }, { faces[face][2], j }
+					};
+					std::sort(weights, weights + 3);
+
+					glm::vec3 point(0.0f);
+					for (const std::pair<unsigned int, unsigned int>& weight : weights)
+						point += corners[weight.first] * (float)weight.second;
+
+					PrimitiveVertex& vertex = vertices[gridIndex(i, j)];
+					vertex.pos = glm::normalize(point);
+					vertex.normal = vertex.pos;
+					vertex.texCoords = glm::vec2(0.5f + std::atan2(vertex.pos.x, vertex.pos.z) / (2.0f * pi), 0.5f + std::asin(vertex.pos.y) / pi);
+
+					const glm::vec3 around(vertex.pos.z, 0.0f, -vertex.pos.x);
+					vertex.tangent = glm::vec4(glm::dot(around, around) > 1e-12f ? glm::normalize(around) : glm::vec3(1.0f, 0.0f, 0.0f), 1.0f);
+				}
+
+			for (unsigned int i = 0; i < n; i++)
+				for (unsigned int j = 0; i + j < n; j++)
+				{
+					*indices++ = base + gridIndex(i, j);
+					*indices++ = base + gridIndex(i + 1, j);
+					*indices++ = base + gridIndex(i, j + 1);
+
+					if (i + j + 1 < n)
+					{
+						*indices++ = base + gridIndex(i + 1, j);
+						*indices++ = base + gridIndex(i + 1, j + 1);
+						*indices++ = base + gridIndex(i, j + 1);
+					}
+				}
+		}
+	});
+
+	const size_t uniqueCount = MeshOptimizer::weldVertices(outMesh.vertices.data(), outMesh.vertices.size(), sizeof(PrimitiveVertex),
+		outMesh.indices.data(), outMesh.indices.size());
+	outMesh.vertices.resize(uniqueCount);
+}
+
+// (n + 1)^2 vertices from center - (u + v) / 2 to center + (u + v) / 2; u x v must point along normal
+static void emplaceGrid(const glm::vec3& center, const glm::vec3& u, const glm::vec3& v, const glm::vec3& normal, unsigned int n,
+	PrimitiveVertex* outVertices, unsigned int baseVertex, unsigned int* outIndices)
+{
+	for (unsigned int row = 0; row <= n; row++)
+		for (unsigned int column = 0; column <= n; column++)
+		{
+			const glm::vec2 uv((float)column / n, (float)row / n);
+			PrimitiveVertex& vertex = outVertices[row * (n + 1) + column];
+			vertex.pos = center + u * (uv.x - 0.5f) + v * (uv.y - 0.5f);
+			vertex.texCoords = uv;
+			vertex.normal = normal;
+		}
+
+	for (unsigned int row = 0; row < n; row++)
+		for (unsigned int column = 0; column < n; column++)
+		{
+			const unsigned int corner = baseVertex + row * (n + 1) + column;
+			const unsigned int quad[6] = { corner, corner + 1, corner + n + 2, corner, corner + n + 2, corner + n + 1 };
+			outIndices = std::copy(quad, quad + 6, outIndices);
+		}
+}
+
+static void generateGrids(const glm::vec3 (*faces)[3], unsigned int faceCount, float offset, float size, unsigned int n, PrimitiveMesh& outMesh)
+{
+	const size_t faceVertexCount = (size_t)(n + 1) * (n + 1);
+	const size_t faceIndexCount = 6 * (size_t)n * n;
+	outMesh.vertices.resize(faceCount * faceVertexCount, PrimitiveVertex());
+	outMesh.indices.resize(faceCount * faceIndexCount);
+
+	ThreadPool::Global().ParallelFor(faceCount, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t face = begin; face < end; face++)
+		{
+			const glm::vec3& normal = faces[face][0];
+			emplaceGrid(normal * offset, faces[face][1] * size, faces[face][2] * size, normal, n,
+				&outMesh.vertices[face * faceVertexCount], (unsigned int)(face * faceVertexCount), &outMesh.indices[face * faceIndexCount]);
+		}
+	});
+
+	TangentSpace::generate(outMesh.vertices, outMesh.indices);
+}
+
+void Primitives::generate(PrimitiveType type, unsigned int resolution, PrimitiveMesh& outMesh)
+{
+	// normal, u and v of every face
+	static const glm::vec3 cubeFaces[6][3] =
+	{
+		{ { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { -1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f } },
+		{ { 0.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } },
+		{ { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { 0.0f, 0.0f, -1.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } }
+	};
+	static const glm::vec3 planeFace[1][3] = { { { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f } } };
+	static const glm::vec3 quadFace[1][3] = { { { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } } };
+
+	outMesh.vertices.clear();
+	outMesh.indices.clear();
+
+	switch (type)
+	{
+	case PRIMITIVE_UV_SPHERE:
+		generateUvSphere(resolution, outMesh);
+		break;
+	case PRIMITIVE_ICOSPHERE:
+		generateIcosphere(resolution, outMesh);
+		break;
+	case PRIMITIVE_CUBE:
+		generateGrids(cubeFaces, 6, 0.5f, 1.0f, std::max(1u, resolution), outMesh);
+		break;
+	case PRIMITIVE_PLANE:
+		generateGrids(planeFace, 1, 0.0f, 1.0f, std::max(1u, resolution), outMesh);
+		break;
+	case PRIMITIVE_QUAD:
+		generateGrids(quadFace, 1, 0.0f, 2.0f, 1, outMesh);
+		break;
+	}
+}
+
+const PrimitiveGeometry& Primitives::get(PrimitiveType type, unsigned int resolution)
+{
+	if (type == PRIMITIVE_QUAD)
+		resolution = 1;
+
+	auto it = cache.find({ type, resolution });
+	if (it != cache.end())
+		return it->second;
+
+	PrimitiveGeometry& geometry = cache[{ type, resolution }];
+	geometry.type = type;
+	geometry.resolution = resolution;
+
+	generate(type, resolution, geometry.mesh);
+	static const char* names[] = { "uv sphere", "icosphere", "cube", "plane", "quad" };
+	MeshOptimizer::optimize(std::string(names[type]) + " " + std::to_string(resolution), geometry.mesh.vertices, geometry.mesh.indices);
+
+	for (const PrimitiveVertex& vertex : geometry.mesh.vertices)
+		geometry.radius = std::max(geometry.radius, glm::length(vertex.pos));
+
+	// both layouts store the same 24 byte vertex, only the attribute locations differ
+	const std::vector<unsigned char> packed = PrimitivePbrLayout::Pack(geometry.mesh.vertices);
+	glCreateBuffers(1, &geometry.vbo);
+	glNamedBufferStorage(geometry.vbo, packed.size(), packed.data(), 0);
+	glCreateBuffers(1, &geometry.ebo);
+	glNamedBufferStorage(geometry.ebo, geometry.mesh.indices.size() * sizeof(unsigned int), geometry.mesh.indices.data(), 0);
+
+	return geometry;
+}
+
+GLuint Primitives::createVertexArray(const PrimitiveGeometry& geometry, PrimitiveLayout layout)
+{
+	GLuint vao;
+	glCreateVertexArrays(1, &vao);
+	if (layout == PRIMITIVE_LAYOUT_PBR)
+		PrimitivePbrLayout::Setup(vao, geometry.vbo);
+	else
+		PrimitiveMeshLayout::Setup(vao, geometry.vbo);
+	glVertexArrayElementBuffer(vao, geometry.ebo);
+
+	return vao;
+}
+
+void Primitives::draw(const PrimitiveGeometry& geometry, GLuint vao, GLsizei instanceCount)
+{
+	glBindVertexArray(vao);
+	glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)geometry.mesh.indices.size(), GL_UNSIGNED_INT, 0, instanceCount);
+}
+
+unsigned int Primitives::selectResolution(PrimitiveType type, unsigned int maxResolution, float radius, float distance,
+	float fovY, float screenHeight, float pixelsPerEdge)
+{
+	if (type == PRIMITIVE_QUAD)
+		return 1;
+	if (distance <= radius)
+		return maxResolution;
+
+	const float diameterPixels = screenHeight * radius / (distance * std::tan(fovY * 0.5f));
+	float edges = 0.0f;
+	unsigned int minResolution = 1;
+
+	switch (type)
+	{
+	case PRIMITIVE_UV_SPHERE:
+		edges = pi * diameterPixels / pixelsPerEdge;
+		minResolution = 8;
+		break;
+	case PRIMITIVE_ICOSPHERE:
+		// a great circle crosses about five edges of the base icosahedron, doubled per level
+		edges = pi * diameterPixels / pixelsPerEdge / 5.0f;
+		break;
+	default:
+		edges = diameterPixels / pixelsPerEdge;
+		break;
+	}
+
+	unsigned int resolution = minResolution;
+	if (type == PRIMITIVE_ICOSPHERE)
+	{
+		resolution = 0;
+		while ((float)(1u << resolution) < edges && resolution < maxResolution)
+			resolution++;
+		return resolution;
+	}
+
+	while ((float)resolution < edges && resolution < maxResolution)
+		resolution *= 2;
+	return std::min(resolution, maxResolution);
+}
+
+void Primitives::release()
+{
+	for (auto& entry : cache)
+	{
+		glDeleteBuffers(1, &entry.second.vbo);
+		glDeleteBuffers(1, &entry.second.ebo);
+	}
+	cache.clear();
+}
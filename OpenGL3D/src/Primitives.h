@@ -0,0 +1,83 @@
+#pragma once
+#include <vector>
+#include <vec2.hpp>
+#include <vec3.hpp>
+#include <vec4.hpp>
+
+enum PrimitiveType
+{
+	PRIMITIVE_UV_SPHERE,
+	PRIMITIVE_ICOSPHERE,
+	PRIMITIVE_CUBE,
+	PRIMITIVE_PLANE,
+	PRIMITIVE_QUAD
+};
+
+// attribute locations a vertex array is set up for
+enum PrimitiveLayout
+{
+	// 0 pos, 1 uv, 2 tangent with sign, 4 normal (PBR and IBL shaders, screen quads)
+	PRIMITIVE_LAYOUT_PBR,
+	// 0 pos, 1 normal, 2 uv, 7 tangent with sign (Mesh and CubeData)
+	PRIMITIVE_LAYOUT_MESH
+};
+
+struct PrimitiveVertex
+{
+	glm::vec3 pos;
+	glm::vec2 texCoords;
+	// w: bitangent sign, see TangentSpace
+	glm::vec4 tangent;
+	glm::vec3 normal;
+};
+
+struct PrimitiveMesh
+{
+	std::vector<PrimitiveVertex> vertices;
+	std::vector<unsigned int> indices;
+};
+
+// GPU buffers of one (type, resolution), shared by everyone asking for it; the CPU copy stays for meshlets and culling.
+struct PrimitiveGeometry
+{
+	PrimitiveType type;
+	unsigned int resolution;
+	PrimitiveMesh mesh;
+	GLuint vbo = 0;
+	GLuint ebo = 0;
+	// bounding sphere around the origin
+	float radius = 0.0f;
+};
+
+/*
+	Procedural meshes with analytic normals, all CCW and centred on the origin. Spheres get
+	analytic tangents; the flat primitives go through TangentSpace like imported meshes.
+	- UV sphere of radius 1: resolution segments around and resolution / 2 rings, with a
+	  duplicated seam column so the UVs do not wrap.
+	- Icosphere of radius 1: resolution is the subdivision level (4^level * 20 triangles).
+	  The UVs are spherical and wrap at the seam, so prefer the UV sphere for textures.
+	- Cube with edges of 1: resolution quads per face edge.
+	- Plane of 1x1 on XZ facing +Y: resolution quads per edge.
+	- Quad from -1 to 1 on XY facing +Z, for full screen passes: resolution is ignored.
+
+	Rows and faces are generated on the thread pool. Spheres read sine/cosine tables with one
+	entry per row and column, rather than evaluating them for every vertex.
+*/
+namespace Primitives
+{
+	void generate(PrimitiveType type, unsigned int resolution, PrimitiveMesh& outMesh);
+
+	// Generates, optimises and uploads the mesh on first use; later calls return the cached buffers.
+	const PrimitiveGeometry& get(PrimitiveType type, unsigned int resolution);
+	// Vertex array over the shared buffers of geometry. Owned by the caller, who may add instance attributes.
+	GLuint createVertexArray(const PrimitiveGeometry& geometry, PrimitiveLayout layout);
+	void draw(const PrimitiveGeometry& geometry, GLuint vao, GLsizei instanceCount = 1);
+
+	// Lowest resolution (a power of two up to maxResolution) whose edges project to at most
+	// pixelsPerEdge pixels for a primitive of the given radius at distance. fovY is in radians.
+	unsigned int selectResolution(PrimitiveType type, unsigned int maxResolution, float radius, float distance,
+		float fovY, float screenHeight, float pixelsPerEdge = 8.0f);
+
+	// Deletes the cached buffers; call before the context that created them is destroyed.
+	void release();
+}
@@ -0,0 +1,275 @@
+#include "pch.h"
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <glm.hpp>
+
+#include "DrawDataBuffer.h"
+#include "ThreadPool.h"
+
+// key fields, see RenderQueue.h
+static const unsigned int programBits = 8;
+static const unsigned int materialBits = 10;
+static const unsigned int vertexArrayBits = 11;
+static const unsigned int layerLimit = 4;
+static const unsigned int programLimit = 1u << programBits;
+static const unsigned int materialLimit = 1u << materialBits;
+static const unsigned int vertexArrayLimit = 1u << vertexArrayBits;
+
+// one byte of the key per pass; chunks below minChunkSize keys are not worth a thread
+static const unsigned int radixBits = 8;
+static const unsigned int bucketCount = 1u << radixBits;
+static const size_t minChunkSize = 1024;
+
+static uint32_t distanceBits(float distance)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &distance, sizeof(bits));
+	return bits;
+}
+
+static void setTranslucent(bool translucent, GLboolean blend, GLboolean cullFace, GLboolean depthMask)
+{
+	if (translucent || blend)
+		glEnable(GL_BLEND);
+	else
+		glDisable(GL_BLEND);
+
+	if (!translucent && cullFace)
+		glEnable(GL_CULL_FACE);
+	else
+		glDisable(GL_CULL_FACE);
+
+	glDepthMask(translucent ? GL_FALSE : depthMask);
+}
+
+size_t RenderQueueStats::GetSavedDrawCalls() const
+{
+	return unsortedDrawCalls > drawCalls ? unsortedDrawCalls - drawCalls : 0;
+}
+
+size_t RenderQueueStats::GetSavedMaterialBinds() const
+{
+	return unsortedMaterialBinds > materialBinds ? unsortedMaterialBinds - materialBinds : 0;
+}
+
+unsigned int RenderQueue::AddMaterial(const RenderMaterial& material)
+{
+	materials.push_back(material);
+	return (unsigned int)materials.size() - 1;
+}
+
+void RenderQueue::Begin(const glm::vec3& viewPos)
+{
+	this->viewPos = viewPos;
+	packets.clear();
+	entries.clear();
+}
+
+bool RenderQueue::Add(const RenderPacket& packet)
+{
+	if (packet.layer >= layerLimit)
+	{
+		std::cerr << "[Error: RenderQueue::Add] Layer " << packet.layer << " is not below " << layerLimit << "." << std::endl;
+		return false;
+	}
+
+	const unsigned int program = slotOf(programs, packet.program, programLimit);
+	const unsigned int vertexArray = slotOf(vertexArrays, packet.vao, vertexArrayLimit);
+	if (program == programLimit || vertexArray == vertexArrayLimit || packet.material >= materialLimit)
+	{
+		std::cerr << "[Error: RenderQueue::Add] More than " << programLimit << " programs, " << vertexArrayLimit
+			<< " vertex arrays or " << materialLimit << " materials." << std::endl;
+		return false;
+	}
+
+	const uint64_t distance = distanceBits(glm::length(glm::vec3(packet.model[3]) - viewPos));
+	const uint64_t state = ((uint64_t)program << (materialBits + vertexArrayBits))
+		| ((uint64_t)packet.material << vertexArrayBits) | vertexArray;
+
+	uint64_t key = (uint64_t)packet.layer << 62;
+	if (packet.translucent)
+		key |= (1ull << 61) | ((~distance & 0xFFFFFFFFull) << 29) | state;
+	else
+		key |= (state << 32) | distance;
+
+	entries.push_back({ key, (unsigned int)packets.size() });
+	packets.push_back(packet);
+	return true;
+}
+
+void RenderQueue::Flush(DrawDataBuffer& draws)
+{
+	stats = RenderQueueStats();
+	stats.packets = packets.size();
+	if (packets.empty())
+		return;
+
+	countUnsorted();
+
+	const auto sortStart = std::chrono::high_resolution_clock::now();
+	sortEntries();
+	stats.sortMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - sortStart).count();
+
+	const GLboolean blend = glIsEnabled(GL_BLEND);
+	const GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+	GLboolean depthMask;
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+
+	const RenderPacket* current = nullptr;
+	size_t drawn = 0;
+	for (const SortEntry& entry : entries)
+	{
+		const RenderPacket& packet = packets[entry.packet];
+		const bool programChanged = !current || packet.program != current->program;
+		const bool materialChanged = !current || packet.material != current->material;
+		const bool vertexArrayChanged = !current || packet.vao != current->vao;
+		const bool translucencyChanged = !current || packet.translucent != current->translucent;
+
+		if (programChanged || materialChanged || vertexArrayChanged || translucencyChanged)
+		{
+			// the run so far draws with the textures and state it was added under
+			if (current)
+				draws.Submit(current->program, current->vao);
+
+			stats.drawCalls++;
+			if (materialChanged)
+			{
+				stats.materialBinds++;
+				if (packet.material < materials.size())
+				{
+					for (unsigned int i = 0; i < RenderMaterial::maxTextures; i++)
+						if (materials[packet.material].textures[i])
+							glBindTextureUnit(i, materials[packet.material].textures[i]);
+				}
+			}
+
+			if (translucencyChanged)
+				setTranslucent(packet.translucent, blend, cullFace, depthMask);
+
+			current = &packet;
+		}
+
+		if (!draws.Add(packet.indexCount, packet.firstIndex, packet.baseVertex, packet.model, packet.color, packet.material))
+		{
+			std::cerr << "[Error: RenderQueue::Flush] The draw data buffer is full, " << packets.size() - drawn
+				<< " packets were not drawn." << std::endl;
+			break;
+		}
+		drawn++;
+	}
+
+	draws.Submit(current->program, current->vao);
+
+	if (blend)
+		glEnable(GL_BLEND);
+	else
+		glDisable(GL_BLEND);
+
+	if (cullFace)
+		glEnable(GL_CULL_FACE);
+	else
+		glDisable(GL_CULL_FACE);
+
+	glDepthMask(depthMask);
+}
+
+size_t RenderQueue::GetCount() const
+{
+	return packets.size();
+}
+
+const RenderQueueStats& RenderQueue::GetStats() const
+{
+	return stats;
+}
+
+unsigned int RenderQueue::slotOf(std::vector<GLuint>& names, GLuint name, unsigned int limit)
+{
+	const std::vector<GLuint>::const_iterator it = std::find(names.begin(), names.end(), name);
+	if (it != names.end())
+		return (unsigned int)(it - names.begin());
+
+	if (names.size() >= limit)
+		return limit;
+
+	names.push_back(name);
+	return (unsigned int)names.size() - 1;
+}
+
+void RenderQueue::sortEntries()
+{
+	const size_t count = entries.size();
+	ThreadPool& pool = ThreadPool::Global();
+	const size_t chunkCount = std::max<size_t>(1, std::min<size_t>(pool.GetThreadCount() + 1, count / minChunkSize));
+	const size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+	scratch.resize(count);
+	histograms.resize(chunkCount * bucketCount);
+
+	for (unsigned int shift = 0; shift < 64; shift += radixBits)
+	{
+		std::fill(histograms.begin(), histograms.end(), 0);
+		pool.ParallelFor(chunkCount, 1, [&](size_t firstChunk, size_t lastChunk)
+		{
+			for (size_t chunk = firstChunk; chunk < lastChunk; chunk++)
+			{
+				size_t* histogram = &histograms[chunk * bucketCount];
+				const size_t end = std::min(count, (chunk + 1) * chunkSize);
+				for (size_t i = chunk * chunkSize; i < end; i++)
+					histogram[(entries[i].key >> shift) & (bucketCount - 1)]++;
+			}
+		});
+
+		// Counts become where each chunk writes each digit: digit by digit, and chunk by chunk
+		// within a digit, which keeps equal digits in their previous order.
+		size_t offset = 0;
+		bool uniform = false;
+		for (unsigned int digit = 0; digit < bucketCount; digit++)
+		{
+			size_t digitCount = 0;
+			for (size_t chunk = 0; chunk < chunkCount; chunk++)
+			{
+				size_t& slot = histograms[chunk * bucketCount + digit];
+				const size_t chunkDigitCount = slot;
+				slot = offset;
+				offset += chunkDigitCount;
+				digitCount += chunkDigitCount;
+			}
+			uniform |= digitCount == count;
+		}
+
+		// every key has the same byte here, the pass would not move anything
+		if (uniform)
+			continue;
+
+		pool.ParallelFor(chunkCount, 1, [&](size_t firstChunk, size_t lastChunk)
+		{
+			for (size_t chunk = firstChunk; chunk < lastChunk; chunk++)
+			{
+				size_t* histogram = &histograms[chunk * bucketCount];
+				const size_t end = std::min(count, (chunk + 1) * chunkSize);
+				for (size_t i = chunk * chunkSize; i < end; i++)
+					scratch[histogram[(entries[i].key >> shift) & (bucketCount - 1)]++] = entries[i];
+			}
+		});
+
+		entries.swap(scratch);
+	}
+}
+
+void RenderQueue::countUnsorted()
+{
+	const RenderPacket* previous = nullptr;
+	for (const RenderPacket& packet : packets)
+	{
+		const bool materialChanged = !previous || packet.material != previous->material;
+		stats.unsortedMaterialBinds += materialChanged;
+		stats.unsortedDrawCalls += materialChanged || packet.program != previous->program
+			|| packet.vao != previous->vao || packet.translucent != previous->translucent;
+		previous = &packet;
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <mat4x4.hpp>
+#include <vec3.hpp>
+#include <vec4.hpp>
+
+class DrawDataBuffer;
+
+// textures bound together for a packet, texture i on unit i; 0 leaves a unit alone
+struct RenderMaterial
+{
+	static const unsigned int maxTextures = 4;
+	GLuint textures[maxTextures] = {};
+};
+
+// one indexed draw for the queue; the program must read its model and color from DrawData
+struct RenderPacket
+{
+	GLuint program = 0;
+	GLuint vao = 0;
+	// from RenderQueue::AddMaterial; any other value binds no textures
+	unsigned int material = 0;
+	GLsizei indexCount = 0;
+	GLuint firstIndex = 0;
+	GLint baseVertex = 0;
+	glm::mat4 model = glm::mat4(1.0f);
+	glm::vec4 color = glm::vec4(1.0f);
+	// 0 to 3, drawn in order: scene, sky, overlays, ...
+	unsigned int layer = 0;
+	bool translucent = false;
+};
+
+// What the last Flush cost, and what the same packets would have cost in the order they were
+// added. Every draw call binds its program and vertex array, so sorting saves draw calls and
+// material binds.
+struct RenderQueueStats
+{
+	size_t packets = 0;
+	size_t drawCalls = 0;
+	size_t materialBinds = 0;
+	size_t unsortedDrawCalls = 0;
+	size_t unsortedMaterialBinds = 0;
+	double sortMs = 0.0;
+
+	size_t GetSavedDrawCalls() const;
+	size_t GetSavedMaterialBinds() const;
+};
+
+/*
+	Collects a frame's draws as packets and issues them in an order that changes as little GL
+	state as possible. Each packet gets a 64 bit key, most significant first:
+
+		opaque       layer:2 | 0 | program:8 | material:10 | vertex array:11 | distance:32
+		translucent  layer:2 | 1 | ~distance:32 | program:8 | material:10 | vertex array:11
+
+	so layers draw in order and opaque before translucent within a layer. Opaque packets are
+	grouped by state and then go front to back, for early depth rejection; translucent ones go
+	back to front, as blending needs, and only share state where the distances allow. The
+	distance is from the view position to the model's origin, as float bits, which sort like
+	unsigned integers for positive values. Programs and vertex arrays are numbered in the order
+	the queue first sees them.
+
+	Flush sorts the keys with a least significant digit radix sort, eight passes of a byte, each
+	one histogrammed and scattered in parallel on the thread pool; passes whose byte is the same
+	for every key are skipped. The packets are then written to a DrawDataBuffer, and every run
+	sharing program, material and vertex array is submitted as one multi-draw. Translucent runs
+	blend, do not write depth and are not culled; the caller's state comes back afterwards.
+
+		queue.Begin(camera.pos);
+		queue.Add(packet);
+		draws.Begin();
+		queue.Flush(draws);
+		draws.End();
+*/
+class RenderQueue
+{
+public:
+	RenderQueue() = default;
+
+	unsigned int AddMaterial(const RenderMaterial& material);
+
+	void Begin(const glm::vec3& viewPos);
+	// false when the layer, program, material or vertex array does not fit in its bits of the key
+	bool Add(const RenderPacket& packet);
+	// Sorts and draws the packets added since Begin; draws must be between its Begin and End.
+	void Flush(DrawDataBuffer& draws);
+
+	size_t GetCount() const;
+	const RenderQueueStats& GetStats() const;
+
+private:
+	struct SortEntry
+	{
+		uint64_t key;
+		unsigned int packet;
+	};
+
+	glm::vec3 viewPos = glm::vec3(0.0f);
+	std::vector<RenderMaterial> materials;
+	std::vector<GLuint> programs;
+	std::vector<GLuint> vertexArrays;
+
+	std::vector<RenderPacket> packets;
+	std::vector<SortEntry> entries;
+	std::vector<SortEntry> scratch;
+	std::vector<size_t> histograms;
+	RenderQueueStats stats;
+
+	// dense index of name in names, adding it if there is room below limit; limit if there is not
+	static unsigned int slotOf(std::vector<GLuint>& names, GLuint name, unsigned int limit);
+	void sortEntries();
+	void countUnsorted();
+};
@@ -0,0 +1,117 @@
+#include "pch.h"
+#include "SceneGraph.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <gtc\matrix_transform.hpp>
+
+// matrix products per task; levels smaller than this run on the calling thread
+static const size_t updateGrainSize = 512;
+
+SceneNode SceneGraph::CreateNode(SceneNode parent, const glm::mat4& local, const std::string& name)
+{
+	if (parent != invalidSceneNode && parent >= parents.size())
+		parent = invalidSceneNode;
+
+	const SceneNode node = (SceneNode)parents.size();
+	parents.push_back(parent);
+	depths.push_back(parent == invalidSceneNode ? 0 : depths[parent] + 1);
+	locals.push_back(local);
+	worlds.push_back(parent == invalidSceneNode ? local : worlds[parent] * local);
+	dirty.push_back(1);
+	names.push_back(name);
+
+	anyDirty = true;
+	return node;
+}
+
+void SceneGraph::SetLocal(SceneNode node, const glm::mat4& local)
+{
+	locals[node] = local;
+	dirty[node] = 1;
+	anyDirty = true;
+}
+
+void SceneGraph::SetLocal(SceneNode node, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+	SetLocal(node, glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale));
+}
+
+const glm::mat4& SceneGraph::GetLocal(SceneNode node) const
+{
+	return locals[node];
+}
+
+const glm::mat4& SceneGraph::GetWorld(SceneNode node) const
+{
+	return worlds[node];
+}
+
+SceneNode SceneGraph::GetParent(SceneNode node) const
+{
+	return parents[node];
+}
+
+const std::string& SceneGraph::GetName(SceneNode node) const
+{
+	return names[node];
+}
+
+SceneNode SceneGraph::FindNode(const std::string& name) const
+{
+	auto it = std::find(names.begin(), names.end(), name);
+	return it == names.end() ? invalidSceneNode : (SceneNode)(it - names.begin());
+}
+
+size_t SceneGraph::GetNodeCount() const
+{
+	return parents.size();
+}
+
+void SceneGraph::Update()
+{
+	updatedNodes.clear();
+	if (!anyDirty)
+		return;
+
+	for (std::vector<SceneNode>& level : dirtyLevels)
+		level.clear();
+
+	// Parents come first, so one forward pass pushes the flags into whole subtrees.
+	for (SceneNode node = 0; node < parents.size(); node++)
+	{
+		if (!dirty[node] && parents[node] != invalidSceneNode && dirty[parents[node]])
+			dirty[node] = 1;
+
+		if (dirty[node])
+		{
+			if (depths[node] >= dirtyLevels.size())
+				dirtyLevels.resize(depths[node] + 1);
+			dirtyLevels[depths[node]].push_back(node);
+		}
+	}
+
+	// Nodes of one level only read the (finished) level above.
+	for (const std::vector<SceneNode>& level : dirtyLevels)
+	{
+		ThreadPool::Global().ParallelFor(level.size(), updateGrainSize, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				const SceneNode node = level[i];
+				const SceneNode parent = parents[node];
+				worlds[node] = parent == invalidSceneNode ? locals[node] : worlds[parent] * locals[node];
+			}
+		});
+
+		updatedNodes.insert(updatedNodes.end(), level.begin(), level.end());
+	}
+
+	std::fill(dirty.begin(), dirty.end(), 0);
+	anyDirty = false;
+}
+
+const std::vector<SceneNode>& SceneGraph::GetUpdatedNodes() const
+{
+	return updatedNodes;
+}
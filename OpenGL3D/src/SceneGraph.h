@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <vec3.hpp>
+#include <mat4x4.hpp>
+#include <gtc\quaternion.hpp>
+
+typedef unsigned int SceneNode;
+constexpr SceneNode invalidSceneNode = ~0u;
+
+/*
+	Transform hierarchy stored as structure of arrays. Nodes can only be created below
+	existing nodes, so index order is always a topological order (parents before children).
+	Setting a local transform only marks the node dirty; Update propagates the flags down in
+	one pass over the parent array and recomputes the world matrices of the changed subtrees
+	depth level by depth level, each level in parallel on the thread pool.
+*/
+class SceneGraph
+{
+public:
+	SceneNode CreateNode(SceneNode parent = invalidSceneNode, const glm::mat4& local = glm::mat4(1.0f), const std::string& name = "");
+
+	void SetLocal(SceneNode node, const glm::mat4& local);
+	void SetLocal(SceneNode node, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+	const glm::mat4& GetLocal(SceneNode node) const;
+	// as of the last Update
+	const glm::mat4& GetWorld(SceneNode node) const;
+
+	SceneNode GetParent(SceneNode node) const;
+	const std::string& GetName(SceneNode node) const;
+	// first node with the given name, invalidSceneNode when there is none
+	SceneNode FindNode(const std::string& name) const;
+	size_t GetNodeCount() const;
+
+	void Update();
+	// nodes whose world matrix was recomputed by the last Update
+	const std::vector<SceneNode>& GetUpdatedNodes() const;
+
+private:
+	std::vector<SceneNode> parents;
+	std::vector<unsigned int> depths;
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> worlds;
+	std::vector<unsigned char> dirty;
+	std::vector<std::string> names;
+
+	bool anyDirty = false;
+	// dirty nodes per depth, reused between updates
+	std::vector<std::vector<SceneNode>> dirtyLevels;
+	std::vector<SceneNode> updatedNodes;
+};
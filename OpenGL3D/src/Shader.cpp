@@ -1,6 +1,19 @@
 #include "pch.h"
 #include "Shader.h"
 
+// text replaces the pragma line, or follows the #version line when there is none
+static void insertAtPragma(std::string& source, const std::string& pragma, const std::string& text)
+{
+	size_t position = source.find(pragma);
+	if (position != std::string::npos)
+		source.replace(position, pragma.size(), text);
+	else
+	{
+		position = source.find('\n', source.find("#version"));
+		source.insert(position == std::string::npos ? 0 : position + 1, text);
+	}
+}
+
 bool Shader::loadSource(const std::string& fileName, std::string& outSource)
 {
 	outSource = "";
@@ -31,6 +44,13 @@ bool Shader::loadShader(const std::string&& fileName, GLenum type, const std::st
 		loadSuccess = false;
 	}
 
+	return compileShader(source, type, typeString, outShader) && loadSuccess;
+}
+
+bool Shader::compileShader(const std::string& source, GLenum type, const std::string& typeString, GLuint& outShader)
+{
+	bool loadSuccess = true;
+
 	// Create shader object and compile its source.
 	outShader = glCreateShader(type);
 	const GLchar* sourceString = source.c_str();
@@ -127,3 +147,170 @@ bool Shader::loadProgram(GLuint& outProgram, std::string&& VertexShaderPath, std
 
 	return loadSuccess;
 }
+
+bool Shader::loadLayoutProgram(GLuint& outProgram, std::string&& VertexShaderPath, std::string&& FragShaderPath, const std::string& vertexInputs)
+{
+	std::string source = "";
+	if (!loadSource(VertexShaderPath, source))
+	{
+		std::cerr << "[Error: loadLayoutProgram] Could not open vertex shader source file." << std::endl;
+		return false;
+	}
+
+	insertAtPragma(source, "#pragma vertex_inputs", vertexInputs);
+
+	bool loadSuccess = true;
+	GLuint vertexShader, fragmentShader = 0;
+
+	if (compileShader(source, GL_VERTEX_SHADER, "vertex", vertexShader) &&
+		loadShader(std::move(FragShaderPath), GL_FRAGMENT_SHADER, "fragment", fragmentShader))
+	{
+		// Create program and link shaders.
+		outProgram = glCreateProgram();
+		glAttachShader(outProgram, vertexShader);
+		glAttachShader(outProgram, fragmentShader);
+		glLinkProgram(outProgram);
+
+		// Check for linking errors.
+		GLint success;
+		glGetProgramiv(outProgram, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			char infoLog[512] = {};
+			glGetProgramInfoLog(outProgram, 512, nullptr, infoLog);
+			std::cerr << "[Error: loadLayoutProgram] Could not link program." << std::endl;
+			std::cerr << infoLog << std::endl;
+			loadSuccess = false;
+		}
+	}
+	else
+		loadSuccess = false;
+
+	glUseProgram(0);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	return loadSuccess;
+}
+
+bool Shader::loadPreludeProgram(GLuint& outProgram, std::string&& VertexShaderPath, std::string&& FragShaderPath, std::string&& FragPreludePath)
+{
+	std::string source = "";
+	std::string prelude = "";
+	if (!loadSource(FragShaderPath, source) || !loadSource(FragPreludePath, prelude))
+	{
+		std::cerr << "[Error: loadPreludeProgram] Could not open fragment shader or prelude source file." << std::endl;
+		return false;
+	}
+
+	insertAtPragma(source, "#pragma fragment_prelude", prelude);
+
+	bool loadSuccess = true;
+	GLuint vertexShader, fragmentShader = 0;
+
+	if (loadShader(std::move(VertexShaderPath), GL_VERTEX_SHADER, "vertex", vertexShader) &&
+		compileShader(source, GL_FRAGMENT_SHADER, "fragment", fragmentShader))
+	{
+		// Create program and link shaders.
+		outProgram = glCreateProgram();
+		glAttachShader(outProgram, vertexShader);
+		glAttachShader(outProgram, fragmentShader);
+		glLinkProgram(outProgram);
+
+		// Check for linking errors.
+		GLint success;
+		glGetProgramiv(outProgram, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			char infoLog[512] = {};
+			glGetProgramInfoLog(outProgram, 512, nullptr, infoLog);
+			std::cerr << "[Error: loadPreludeProgram] Could not link program." << std::endl;
+			std::cerr << infoLog << std::endl;
+			loadSuccess = false;
+		}
+	}
+	else
+		loadSuccess = false;
+
+	glUseProgram(0);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	return loadSuccess;
+}
+
+bool Shader::loadComputeProgram(GLuint& outProgram, std::string&& ComputeShaderPath)
+{
+	bool loadSuccess = true;
+	GLuint computeShader = 0;
+
+	if (loadShader(std::move(ComputeShaderPath), GL_COMPUTE_SHADER, "compute", computeShader))
+	{
+		// Create program and link shader.
+		outProgram = glCreateProgram();
+		glAttachShader(outProgram, computeShader);
+		glLinkProgram(outProgram);
+
+		// Check for linking errors.
+		GLint success;
+		glGetProgramiv(outProgram, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			char infoLog[512] = {};
+			glGetProgramInfoLog(outProgram, 512, nullptr, infoLog);
+			std::cerr << "[Error: loadComputeProgram] Could not link program." << std::endl;
+			std::cerr << infoLog << std::endl;
+			loadSuccess = false;
+		}
+	}
+	else
+		loadSuccess = false;
+
+	glUseProgram(0);
+	glDeleteShader(computeShader);
+
+	return loadSuccess;
+}
+
+bool Shader::loadPreludeComputeProgram(GLuint& outProgram, std::string&& ComputeShaderPath, std::string&& PreludePath)
+{
+	std::string source = "";
+	std::string prelude = "";
+	if (!loadSource(ComputeShaderPath, source) || !loadSource(PreludePath, prelude))
+	{
+		std::cerr << "[Error: loadPreludeComputeProgram] Could not open compute shader or prelude source file." << std::endl;
+		return false;
+	}
+
+	insertAtPragma(source, "#pragma compute_prelude", prelude);
+
+	bool loadSuccess = true;
+	GLuint computeShader = 0;
+
+	if (compileShader(source, GL_COMPUTE_SHADER, "compute", computeShader))
+	{
+		// Create program and link shader.
+		outProgram = glCreateProgram();
+		glAttachShader(outProgram, computeShader);
+		glLinkProgram(outProgram);
+
+		// Check for linking errors.
+		GLint success;
+		glGetProgramiv(outProgram, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			char infoLog[512] = {};
+			glGetProgramInfoLog(outProgram, 512, nullptr, infoLog);
+			std::cerr << "[Error: loadPreludeComputeProgram] Could not link program." << std::endl;
+			std::cerr << infoLog << std::endl;
+			loadSuccess = false;
+		}
+	}
+	else
+		loadSuccess = false;
+
+	glUseProgram(0);
+	glDeleteShader(computeShader);
+
+	return loadSuccess;
+}
@@ -9,6 +9,18 @@ namespace Shader
 {
 bool loadSource(const std::string & fileName, std::string & outSource);
 bool loadShader(const std::string&& fileName, GLenum type, const std::string&& typeString, GLuint& outShader);
+bool compileShader(const std::string& source, GLenum type, const std::string& typeString, GLuint& outShader);
 bool loadProgram(GLuint& outProgram, std::string&& VertexShaderPath, std::string&& FragShaderPath);
 bool loadProgram(GLuint& outProgram, std::string&& VertexShaderPath, std::string&& GeoShaderPath, std::string&& FragShaderPath);
+// Vertex and fragment program whose vertex shader gets vertexInputs (see VertexLayout::GetGlslInputs)
+// in place of its "#pragma vertex_inputs" line, or right after #version.
+bool loadLayoutProgram(GLuint& outProgram, std::string&& VertexShaderPath, std::string&& FragShaderPath, const std::string& vertexInputs);
+// Vertex and fragment program whose fragment shader gets the source of FragPreludePath in place of
+// its "#pragma fragment_prelude" line, or right after #version. A prelude can replace the inputs of a
+// fragment shader, see Impostor/FragmentSphere.glsl.
+bool loadPreludeProgram(GLuint& outProgram, std::string&& VertexShaderPath, std::string&& FragShaderPath, std::string&& FragPreludePath);
+bool loadComputeProgram(GLuint& outProgram, std::string&& ComputeShaderPath);
+// Compute program that gets the source of PreludePath in place of its "#pragma compute_prelude" line,
+// or right after #version, for functions shared between compute shaders (see Culling/HiZOcclusion.glsl).
+bool loadPreludeComputeProgram(GLuint& outProgram, std::string&& ComputeShaderPath, std::string&& PreludePath);
 }
\ No newline at end of file
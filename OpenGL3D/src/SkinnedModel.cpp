@@ -0,0 +1,414 @@
+#include "pch.h"
+#include "SkinnedModel.h"
+#include "ThreadPool.h"
+#include "VertexLayout.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+#include <gtc\type_ptr.hpp>
+
+static const unsigned int maxBones = 256;
+static const unsigned int influencesPerVertex = 4;
+// instances per palette task
+static const size_t paletteGrainSize = 4;
+
+using SkinnedVertexLayout = VertexLayout<Position<float3>, Normal<oct16>, TexCoords<float2>, Joints<uint8x4>, Weights<unorm8x4>>;
+
+static glm::mat4 toGlm(const aiMatrix4x4& m)
+{
+	// aiMatrix4x4 is row major
+	return glm::mat4(
+		m.a1, m.b1, m.c1, m.d1,
+		m.a2, m.b2, m.c2, m.d2,
+		m.a3, m.b3, m.c3, m.d3,
+		m.a4, m.b4, m.c4, m.d4
+	);
+}
+
+static glm::mat4 compose(const JointPose& pose)
+{
+	const glm::mat3 rotation = glm::mat3_cast(pose.rotation);
+	return glm::mat4(
+		glm::vec4(rotation[0] * pose.scale.x, 0.0f),
+		glm::vec4(rotation[1] * pose.scale.y, 0.0f),
+		glm::vec4(rotation[2] * pose.scale.z, 0.0f),
+		glm::vec4(pose.translation, 1.0f)
+	);
+}
+
+static void collectMeshNodes(const aiNode* node, std::vector<std::pair<unsigned int, std::string>>& outMeshNodes)
+{
+	for (unsigned int i = 0; i < node->mNumMeshes; i++)
+		outMeshNodes.emplace_back(node->mMeshes[i], node->mName.C_Str());
+
+	for (unsigned int i = 0; i < node->mNumChildren; i++)
+		collectMeshNodes(node->mChildren[i], outMeshNodes);
+}
+
+// Keeps the four strongest influences of a vertex.
+static void addInfluence(unsigned int bone, float weight, glm::uvec4& bones, glm::vec4& weights)
+{
+	int weakest = 0;
+	for (int i = 1; i < (int)influencesPerVertex; i++)
+		if (weights[i] < weights[weakest])
+			weakest = i;
+
+	if (weight > weights[weakest])
+	{
+		bones[weakest] = bone;
+		weights[weakest] = weight;
+	}
+}
+
+// unorm8 weights that sum to exactly 255; false when a bone does not fit in a uint8 joint index
+static bool quantizeInfluences(const glm::uvec4& bones, const glm::vec4& weights, SkinnedVertex& outVertex)
+{
+	for (int i = 0; i < (int)influencesPerVertex; i++)
+		if (bones[i] >= maxBones)
+			return false;
+
+	const float sum = weights.x + weights.y + weights.z + weights.w;
+
+	int total = 0, strongest = 0;
+	for (int i = 0; i < (int)influencesPerVertex; i++)
+	{
+		outVertex.joints[i] = (uint8_t)bones[i];
+		outVertex.weights[i] = (uint8_t)(weights[i] / sum * 255.0f + 0.5f);
+		total += outVertex.weights[i];
+		if (weights[i] > weights[strongest])
+			strongest = i;
+	}
+
+	outVertex.weights[strongest] = (uint8_t)(outVertex.weights[strongest] + 255 - total);
+	return true;
+}
+
+SkinnedModel::SkinnedModel(const std::string& path)
+	: directory(path.substr(0, path.find_last_of('/')))
+{
+	loaded = load(path);
+}
+
+SkinnedModel::~SkinnedModel()
+{
+	for (SkinnedMesh& mesh : meshes)
+	{
+		glDeleteVertexArrays(1, &mesh.vao);
+		glDeleteBuffers(1, &mesh.vbo);
+		glDeleteBuffers(1, &mesh.ebo);
+	}
+
+	glDeleteBuffers(1, &paletteBuffer);
+	glDeleteBuffers(1, &instanceBuffer);
+}
+
+bool SkinnedModel::IsLoaded() const
+{
+	return loaded;
+}
+
+size_t SkinnedModel::GetBoneCount() const
+{
+	return skeleton.boneJoints.size();
+}
+
+std::string SkinnedModel::GetVertexInputs()
+{
+	return SkinnedVertexLayout::GetGlslInputs();
+}
+
+bool SkinnedModel::load(const std::string& path)
+{
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path,
+		aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenSmoothNormals | aiProcess_JoinIdenticalVertices | aiProcess_LimitBoneWeights);
+
+	if (!scene || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) || !scene->mRootNode)
+	{
+		std::cerr << "[Error: SkinnedModel] (Assimp)" << importer.GetErrorString() << std::endl;
+		return false;
+	}
+
+	skeleton.globalInverse = glm::inverse(toGlm(scene->mRootNode->mTransformation));
+	addJoints(scene->mRootNode, -1);
+
+	if (!loadMeshes(scene))
+		return false;
+
+	loadClips(scene);
+	return true;
+}
+
+void SkinnedModel::addJoints(const aiNode* node, int parent)
+{
+	// every node is a joint, so animated nodes without bones still move their children
+	JointPose pose;
+	aiVector3D scale, translation;
+	aiQuaternion rotation;
+	node->mTransformation.Decompose(scale, rotation, translation);
+	pose.translation = glm::vec3(translation.x, translation.y, translation.z);
+	pose.rotation = glm::quat(rotation.w, rotation.x, rotation.y, rotation.z);
+	pose.scale = glm::vec3(scale.x, scale.y, scale.z);
+
+	const int joint = (int)skeleton.parents.size();
+	skeleton.jointNames.push_back(node->mName.C_Str());
+	skeleton.parents.push_back(parent);
+	skeleton.bindPoses.push_back(pose);
+
+	for (unsigned int i = 0; i < node->mNumChildren; i++)
+		addJoints(node->mChildren[i], joint);
+}
+
+unsigned int SkinnedModel::getBone(unsigned int joint, const glm::mat4& inverseBind)
+{
+	for (unsigned int bone = 0; bone < skeleton.boneJoints.size(); bone++)
+		if (skeleton.boneJoints[bone] == joint && skeleton.inverseBinds[bone] == inverseBind)
+			return bone;
+
+	skeleton.boneJoints.push_back(joint);
+	skeleton.inverseBinds.push_back(inverseBind);
+	return (unsigned int)skeleton.boneJoints.size() - 1;
+}
+
+bool SkinnedModel::loadMeshes(const aiScene* scene)
+{
+	std::unordered_map<std::string, unsigned int> jointIndices;
+	for (unsigned int joint = 0; joint < skeleton.jointNames.size(); joint++)
+		jointIndices.emplace(skeleton.jointNames[joint], joint);
+
+	std::vector<std::pair<unsigned int, std::string>> meshNodes;
+	collectMeshNodes(scene->mRootNode, meshNodes);
+
+	std::vector<bool> skinnedLoaded(scene->mNumMeshes, false);
+	for (const std::pair<unsigned int, std::string>& meshNode : meshNodes)
+	{
+		const aiMesh* mesh = scene->mMeshes[meshNode.first];
+
+		// skinned meshes are placed by their bones, so instancing them from several nodes changes nothing
+		if (mesh->HasBones() && skinnedLoaded[meshNode.first])
+			continue;
+		skinnedLoaded[meshNode.first] = mesh->HasBones();
+
+		std::vector<glm::uvec4> influenceBones(mesh->mNumVertices, glm::uvec4(0));
+		std::vector<glm::vec4> influenceWeights(mesh->mNumVertices, glm::vec4(0.0f));
+
+		for (unsigned int b = 0; b < mesh->mNumBones; b++)
+		{
+			const aiBone* bone = mesh->mBones[b];
+			auto joint = jointIndices.find(bone->mName.C_Str());
+			if (joint == jointIndices.end())
+			{
+				std::cerr << "[Error: SkinnedModel] Bone " << bone->mName.C_Str() << " has no node." << std::endl;
+				continue;
+			}
+
+			const unsigned int boneIndex = getBone(joint->second, toGlm(bone->mOffsetMatrix));
+			for (unsigned int w = 0; w < bone->mNumWeights; w++)
+			{
+				const aiVertexWeight& weight = bone->mWeights[w];
+				if (weight.mVertexId < mesh->mNumVertices)
+					addInfluence(boneIndex, weight.mWeight, influenceBones[weight.mVertexId], influenceWeights[weight.mVertexId]);
+			}
+		}
+
+		if (skeleton.boneJoints.size() > maxBones)
+		{
+			std::cerr << "[Error: SkinnedModel] More than " << maxBones << " bones are not supported." << std::endl;
+			return false;
+		}
+
+		std::vector<SkinnedVertex> vertices(mesh->mNumVertices);
+		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+		{
+			SkinnedVertex& vertex = vertices[i];
+			vertex.pos = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+			vertex.normal = mesh->mNormals ? glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z) : glm::vec3(0.0f, 1.0f, 0.0f);
+			vertex.texCoords = mesh->mTextureCoords[0] ? glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y) : glm::vec2(0.0f);
+
+			// rigid meshes, and vertices no bone reaches, follow the mesh's node
+			if (influenceWeights[i] == glm::vec4(0.0f))
+			{
+				influenceBones[i] = glm::uvec4(getBone(jointIndices[meshNode.second], glm::mat4(1.0f)));
+				influenceWeights[i] = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+			}
+			if (!quantizeInfluences(influenceBones[i], influenceWeights[i], vertex))
+			{
+				std::cerr << "[Error: SkinnedModel] More than " << maxBones << " bones are not supported." << std::endl;
+				return false;
+			}
+		}
+
+		std::vector<unsigned int> indices;
+		indices.reserve(mesh->mNumFaces * 3);
+		for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+			if (mesh->mFaces[i].mNumIndices == 3)
+				indices.insert(indices.end(), mesh->mFaces[i].mIndices, mesh->mFaces[i].mIndices + 3);
+
+		meshes.emplace_back();
+		SkinnedMesh& skinnedMesh = meshes.back();
+		skinnedMesh.indexCount = (GLsizei)indices.size();
+
+		const std::vector<unsigned char> packed = SkinnedVertexLayout::Pack(vertices);
+		glCreateBuffers(1, &skinnedMesh.vbo);
+		glNamedBufferStorage(skinnedMesh.vbo, packed.size(), packed.data(), 0);
+		glCreateBuffers(1, &skinnedMesh.ebo);
+		glNamedBufferStorage(skinnedMesh.ebo, indices.size() * sizeof(unsigned int), indices.data(), 0);
+
+		glCreateVertexArrays(1, &skinnedMesh.vao);
+		SkinnedVertexLayout::Setup(skinnedMesh.vao, skinnedMesh.vbo);
+		glVertexArrayElementBuffer(skinnedMesh.vao, skinnedMesh.ebo);
+
+		// diffuse map; embedded textures ("*0") are not supported
+		aiString texName;
+		const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+		if (material->GetTexture(aiTextureType_DIFFUSE, 0, &texName) == AI_SUCCESS && texName.C_Str()[0] != '*')
+		{
+			const std::string name = texName.C_Str();
+			const bool hasAlpha = name.substr(name.find_last_of('.') + 1) == "png";
+			skinnedMesh.textures.emplace_back(TextureType::DIFFUSE, 0, directory + "/" + name, hasAlpha);
+		}
+	}
+
+	return true;
+}
+
+void SkinnedModel::loadClips(const aiScene* scene)
+{
+	std::unordered_map<std::string, unsigned int> jointIndices;
+	for (unsigned int joint = 0; joint < skeleton.jointNames.size(); joint++)
+		jointIndices.emplace(skeleton.jointNames[joint], joint);
+
+	for (unsigned int a = 0; a < scene->mNumAnimations; a++)
+	{
+		const aiAnimation* animation = scene->mAnimations[a];
+		const double ticksPerSecond = animation->mTicksPerSecond > 0.0 ? animation->mTicksPerSecond : 25.0;
+
+		AnimationClip clip;
+		clip.name = animation->mName.C_Str();
+		clip.duration = (float)(animation->mDuration / ticksPerSecond);
+
+		for (unsigned int c = 0; c < animation->mNumChannels; c++)
+		{
+			const aiNodeAnim* channel = animation->mChannels[c];
+			auto joint = jointIndices.find(channel->mNodeName.C_Str());
+			if (joint == jointIndices.end())
+				continue;
+
+			std::vector<float> translationTimes(channel->mNumPositionKeys), rotationTimes(channel->mNumRotationKeys), scaleTimes(channel->mNumScalingKeys);
+			std::vector<glm::vec3> translations(channel->mNumPositionKeys), scales(channel->mNumScalingKeys);
+			std::vector<glm::quat> rotations(channel->mNumRotationKeys);
+
+			for (unsigned int k = 0; k < channel->mNumPositionKeys; k++)
+			{
+				const aiVectorKey& key = channel->mPositionKeys[k];
+				translationTimes[k] = (float)(key.mTime / ticksPerSecond);
+				translations[k] = glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z);
+			}
+
+			for (unsigned int k = 0; k < channel->mNumRotationKeys; k++)
+			{
+				const aiQuatKey& key = channel->mRotationKeys[k];
+				rotationTimes[k] = (float)(key.mTime / ticksPerSecond);
+				rotations[k] = glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z);
+			}
+
+			for (unsigned int k = 0; k < channel->mNumScalingKeys; k++)
+			{
+				const aiVectorKey& key = channel->mScalingKeys[k];
+				scaleTimes[k] = (float)(key.mTime / ticksPerSecond);
+				scales[k] = glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z);
+			}
+
+			clip.AddTrack(joint->second, translationTimes, translations, rotationTimes, rotations, scaleTimes, scales);
+		}
+
+		clips.push_back(std::move(clip));
+	}
+}
+
+void SkinnedModel::computePalette(const AnimationClip* clip, float time, std::vector<JointPose>& poses, std::vector<glm::mat4>& worlds, glm::mat4* outPalette) const
+{
+	poses = skeleton.bindPoses;
+	if (clip)
+		clip->Sample(time, poses.data());
+
+	// parents come first
+	for (size_t joint = 0; joint < poses.size(); joint++)
+	{
+		const glm::mat4 local = compose(poses[joint]);
+		const int parent = skeleton.parents[joint];
+		worlds[joint] = parent < 0 ? local : worlds[parent] * local;
+	}
+
+	for (size_t bone = 0; bone < skeleton.boneJoints.size(); bone++)
+		outPalette[bone] = skeleton.globalInverse * worlds[skeleton.boneJoints[bone]] * skeleton.inverseBinds[bone];
+}
+
+void SkinnedModel::UpdatePalettes(unsigned int clip, const float* times, size_t instanceCount)
+{
+	const size_t boneCount = GetBoneCount();
+	const AnimationClip* animation = clip < clips.size() ? &clips[clip] : nullptr;
+	palettes.resize(instanceCount * boneCount);
+
+	ThreadPool::Global().ParallelFor(instanceCount, paletteGrainSize, [&](size_t begin, size_t end)
+	{
+		// scratch shared by the instances of this chunk
+		std::vector<JointPose> poses;
+		std::vector<glm::mat4> worlds(skeleton.parents.size());
+
+		for (size_t instance = begin; instance < end; instance++)
+			computePalette(animation, times[instance], poses, worlds, palettes.data() + instance * boneCount);
+	});
+}
+
+void SkinnedModel::Draw(GLuint shader, const glm::mat4* models, size_t instanceCount)
+{
+	const size_t boneCount = GetBoneCount();
+	if (!boneCount)
+		return;
+
+	instanceCount = std::min(instanceCount, palettes.size() / boneCount);
+	if (!instanceCount)
+		return;
+
+	// storage only grows
+	if (palettes.size() > paletteCapacity)
+	{
+		glDeleteBuffers(1, &paletteBuffer);
+		paletteCapacity = palettes.size();
+		glCreateBuffers(1, &paletteBuffer);
+		glNamedBufferStorage(paletteBuffer, paletteCapacity * sizeof(glm::mat4), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+
+	if (instanceCount > instanceCapacity)
+	{
+		glDeleteBuffers(1, &instanceBuffer);
+		instanceCapacity = instanceCount;
+		glCreateBuffers(1, &instanceBuffer);
+		glNamedBufferStorage(instanceBuffer, instanceCapacity * sizeof(glm::mat4), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+
+	glNamedBufferSubData(paletteBuffer, 0, instanceCount * boneCount * sizeof(glm::mat4), palettes.data());
+	glNamedBufferSubData(instanceBuffer, 0, instanceCount * sizeof(glm::mat4), models);
+
+	glUseProgram(shader);
+	glUniform1i(glGetUniformLocation(shader, "boneCount"), (GLint)boneCount);
+	glUniform1i(glGetUniformLocation(shader, "material.diffuse"), 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, paletteBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, instanceBuffer);
+
+	for (SkinnedMesh& mesh : meshes)
+	{
+		for (Texture& texture : mesh.textures)
+			texture.changeUnit(0);
+
+		glBindVertexArray(mesh.vao);
+		glDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0, (GLsizei)instanceCount);
+	}
+
+	glBindVertexArray(0);
+}
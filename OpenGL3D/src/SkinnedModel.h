@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mat4x4.hpp>
+
+#include "Animation.h"
+#include "Texture.h"
+
+struct aiNode;
+struct aiScene;
+
+struct SkinnedVertex
+{
+	glm::vec3 pos;
+	glm::vec3 normal;
+	glm::vec2 texCoords;
+	// palette indices of the four strongest influences
+	uint8_t joints[4];
+	// unorm8 weights, summing to 255
+	uint8_t weights[4];
+};
+
+struct SkinnedMesh
+{
+	GLuint vao = 0;
+	GLuint vbo = 0;
+	GLuint ebo = 0;
+	GLsizei indexCount = 0;
+	std::vector<Texture> textures;
+};
+
+struct Skeleton
+{
+	// joints in topological order: parents[i] < i, -1 for roots
+	std::vector<std::string> jointNames;
+	std::vector<int> parents;
+	std::vector<JointPose> bindPoses;
+
+	// one entry per palette matrix (bone): its joint and the mesh to bone space transform
+	std::vector<unsigned int> boneJoints;
+	std::vector<glm::mat4> inverseBinds;
+
+	glm::mat4 globalInverse = glm::mat4(1.0f);
+};
+
+/*
+	Skinned model imported through Assimp (aiMesh::mBones, aiScene::mAnimations). Vertices
+	carry four uint8 palette indices and unorm8 weights, so a skeleton may have at most 256
+	bones, and are uploaded in 32 bytes with an octahedral normal. Meshes without bones are bound rigidly to their node, so props move with the
+	hierarchy as well.
+
+	UpdatePalettes samples one clip per instance and builds the palettes on the thread pool;
+	Draw uploads them together with the instance matrices into shader storage buffers and
+	skins in res/shaders/Skinning/VertexSkinned.glsl (palettes at binding 0, instance
+	matrices at binding 1).
+*/
+class SkinnedModel
+{
+public:
+	SkinnedModel(const std::string& path);
+	~SkinnedModel();
+
+	SkinnedModel(const SkinnedModel&) = delete;
+	SkinnedModel& operator=(const SkinnedModel&) = delete;
+
+	bool IsLoaded() const;
+	size_t GetBoneCount() const;
+
+	// Vertex inputs of the packed GPU vertex, for Shader::loadLayoutProgram.
+	static std::string GetVertexInputs();
+
+	// times[i] is the clip time of instance i in seconds.
+	void UpdatePalettes(unsigned int clip, const float* times, size_t instanceCount);
+	// Draws the instances of the last UpdatePalettes call.
+	void Draw(GLuint shader, const glm::mat4* models, size_t instanceCount);
+
+	std::string directory;
+	Skeleton skeleton;
+	std::vector<AnimationClip> clips;
+	std::vector<SkinnedMesh> meshes;
+
+private:
+	bool loaded = false;
+
+	// boneCount matrices per instance
+	std::vector<glm::mat4> palettes;
+	GLuint paletteBuffer = 0;
+	GLuint instanceBuffer = 0;
+	size_t paletteCapacity = 0;
+	size_t instanceCapacity = 0;
+
+	bool load(const std::string& path);
+	void addJoints(const aiNode* node, int parent);
+	unsigned int getBone(unsigned int joint, const glm::mat4& inverseBind);
+	bool loadMeshes(const aiScene* scene);
+	void loadClips(const aiScene* scene);
+	void computePalette(const AnimationClip* clip, float time, std::vector<JointPose>& poses, std::vector<glm::mat4>& worlds, glm::mat4* outPalette) const;
+};
@@ -0,0 +1,194 @@
+#include "pch.h"
+#include "StaticBatcher.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <iostream>
+#include <glm.hpp>
+
+// instances per transform task
+static const size_t batchGrainSize = 16;
+
+StaticBatcher::~StaticBatcher()
+{
+	release();
+}
+
+unsigned int StaticBatcher::AddMesh(const float* vertices, size_t floatCount, const unsigned int* indices, size_t indexCount)
+{
+	meshes.emplace_back();
+	SourceMesh& mesh = meshes.back();
+	mesh.vertices.assign(vertices, vertices + floatCount);
+	mesh.indices.assign(indices, indices + indexCount);
+
+	return (unsigned int)meshes.size() - 1;
+}
+
+void StaticBatcher::AddInstance(unsigned int mesh, unsigned int material, const glm::mat4& model)
+{
+	if (mesh >= meshes.size())
+	{
+		std::cerr << "[Error: StaticBatcher] Unknown mesh " << mesh << "." << std::endl;
+		return;
+	}
+
+	instances.push_back({ mesh, material, model });
+}
+
+const std::vector<StaticBatch>& StaticBatcher::GetBatches() const
+{
+	return batches;
+}
+
+bool StaticBatcher::Draw(unsigned int material, const Frustum& frustum) const
+{
+	for (const StaticBatch& batch : batches)
+	{
+		if (batch.material != material)
+			continue;
+		if (!frustum.IntersectsBox(batch.boundsMin, batch.boundsMax))
+			return false;
+
+		glBindVertexArray(batch.vao);
+		glDrawElements(GL_TRIANGLES, batch.indexCount, GL_UNSIGNED_INT, 0);
+		return true;
+	}
+
+	return false;
+}
+
+void StaticBatcher::build(size_t floatsPerVertex, int normalOffset)
+{
+	release();
+
+	// group by material, keeping the order instances were added in within a group
+	std::vector<unsigned int> order(instances.size());
+	for (unsigned int i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b)
+	{
+		return instances[a].material < instances[b].material;
+	});
+
+	// where every instance lands in the merged buffers of its batch
+	struct Placement
+	{
+		size_t batch;
+		size_t firstVertex;
+		size_t firstIndex;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+	std::vector<Placement> placements(order.size());
+	std::vector<size_t> vertexCounts, indexCounts;
+
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		const Instance& instance = instances[order[i]];
+		if (batches.empty() || batches.back().material != instance.material)
+		{
+			batches.emplace_back();
+			batches.back().material = instance.material;
+			vertexCounts.push_back(0);
+			indexCounts.push_back(0);
+		}
+
+		const SourceMesh& mesh = meshes[instance.mesh];
+		placements[i].batch = batches.size() - 1;
+		placements[i].firstVertex = vertexCounts.back();
+		placements[i].firstIndex = indexCounts.back();
+		vertexCounts.back() += mesh.vertices.size() / floatsPerVertex;
+		indexCounts.back() += mesh.indices.size();
+		batches.back().instanceCount++;
+	}
+
+	std::vector<std::vector<float>> vertices(batches.size());
+	std::vector<std::vector<unsigned int>> indices(batches.size());
+	for (size_t b = 0; b < batches.size(); b++)
+	{
+		vertices[b].resize(vertexCounts[b] * floatsPerVertex);
+		indices[b].resize(indexCounts[b]);
+	}
+
+	// pre-transform: every instance writes its own range, so the tasks never overlap
+	ThreadPool::Global().ParallelFor(order.size(), batchGrainSize, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const Instance& instance = instances[order[i]];
+			const SourceMesh& mesh = meshes[instance.mesh];
+			Placement& placement = placements[i];
+			const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(instance.model)));
+			const size_t vertexCount = mesh.vertices.size() / floatsPerVertex;
+
+			placement.boundsMin = glm::vec3(FLT_MAX);
+			placement.boundsMax = glm::vec3(-FLT_MAX);
+
+			float* out = vertices[placement.batch].data() + placement.firstVertex * floatsPerVertex;
+			for (size_t v = 0; v < vertexCount; v++)
+			{
+				const float* in = mesh.vertices.data() + v * floatsPerVertex;
+				float* vertex = out + v * floatsPerVertex;
+				std::copy(in, in + floatsPerVertex, vertex);
+
+				const glm::vec3 position(instance.model * glm::vec4(in[0], in[1], in[2], 1.0f));
+				vertex[0] = position.x;
+				vertex[1] = position.y;
+				vertex[2] = position.z;
+				placement.boundsMin = glm::min(placement.boundsMin, position);
+				placement.boundsMax = glm::max(placement.boundsMax, position);
+
+				if (normalOffset >= 0)
+				{
+					const glm::vec3 normal = glm::normalize(normalMatrix * glm::vec3(in[normalOffset], in[normalOffset + 1], in[normalOffset + 2]));
+					vertex[normalOffset] = normal.x;
+					vertex[normalOffset + 1] = normal.y;
+					vertex[normalOffset + 2] = normal.z;
+				}
+			}
+
+			unsigned int* outIndices = indices[placement.batch].data() + placement.firstIndex;
+			for (size_t j = 0; j < mesh.indices.size(); j++)
+				outIndices[j] = mesh.indices[j] + (unsigned int)placement.firstVertex;
+		}
+	});
+
+	for (StaticBatch& batch : batches)
+	{
+		batch.boundsMin = glm::vec3(FLT_MAX);
+		batch.boundsMax = glm::vec3(-FLT_MAX);
+	}
+	for (const Placement& placement : placements)
+	{
+		StaticBatch& batch = batches[placement.batch];
+		batch.boundsMin = glm::min(batch.boundsMin, placement.boundsMin);
+		batch.boundsMax = glm::max(batch.boundsMax, placement.boundsMax);
+	}
+
+	for (size_t b = 0; b < batches.size(); b++)
+	{
+		StaticBatch& batch = batches[b];
+		batch.indexCount = (GLsizei)indices[b].size();
+
+		glCreateBuffers(1, &batch.vbo);
+		glNamedBufferStorage(batch.vbo, vertices[b].size() * sizeof(float), vertices[b].data(), 0);
+		glCreateBuffers(1, &batch.ebo);
+		glNamedBufferStorage(batch.ebo, indices[b].size() * sizeof(unsigned int), indices[b].data(), 0);
+
+		glCreateVertexArrays(1, &batch.vao);
+		glVertexArrayElementBuffer(batch.vao, batch.ebo);
+	}
+}
+
+void StaticBatcher::release()
+{
+	for (StaticBatch& batch : batches)
+	{
+		glDeleteVertexArrays(1, &batch.vao);
+		glDeleteBuffers(1, &batch.vbo);
+		glDeleteBuffers(1, &batch.ebo);
+	}
+
+	batches.clear();
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+#include <vec3.hpp>
+#include <mat4x4.hpp>
+
+#include "Frustum.h"
+
+// one merged draw: every instance of one material, in world space
+struct StaticBatch
+{
+	unsigned int material;
+	GLuint vao = 0;
+	GLuint vbo = 0;
+	GLuint ebo = 0;
+	GLsizei indexCount = 0;
+	unsigned int instanceCount = 0;
+	// world space bounds of all instances
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+};
+
+/*
+	Merges static geometry at load time. Meshes are registered once as interleaved floats with
+	the position first; instances place a mesh with a model matrix under a material id chosen
+	by the caller (a texture set, a shader, ...). Build groups the instances by material,
+	transforms their vertices and normals into world space on the thread pool and uploads one
+	vertex and element buffer per material, so each material draws in a single call with an
+	identity model matrix. Batches keep their bounds for frustum culling.
+
+	The vertex format is given by the VertexLayout passed to Build, which must describe the
+	registered floats; normalOffset is the float offset of the normal, or -1 when there is none.
+	Instances cannot move after Build; call Build again to rebuild every batch.
+*/
+class StaticBatcher
+{
+public:
+	StaticBatcher() = default;
+	~StaticBatcher();
+
+	StaticBatcher(const StaticBatcher&) = delete;
+	StaticBatcher& operator=(const StaticBatcher&) = delete;
+
+	// Copies the mesh and returns its id for AddInstance. The vertex stride is given at Build.
+	unsigned int AddMesh(const float* vertices, size_t floatCount, const unsigned int* indices, size_t indexCount);
+	void AddInstance(unsigned int mesh, unsigned int material, const glm::mat4& model);
+
+	template<typename Layout>
+	void Build(int normalOffset = -1)
+	{
+		build(Layout::GetStride() / sizeof(float), normalOffset);
+		for (StaticBatch& batch : batches)
+			Layout::Setup(batch.vao, batch.vbo);
+	}
+
+	const std::vector<StaticBatch>& GetBatches() const;
+	// Draws the batch of material unless its bounds are outside frustum; false if nothing was drawn.
+	bool Draw(unsigned int material, const Frustum& frustum = Frustum()) const;
+
+private:
+	struct SourceMesh
+	{
+		std::vector<float> vertices;
+		std::vector<unsigned int> indices;
+	};
+
+	struct Instance
+	{
+		unsigned int mesh;
+		unsigned int material;
+		glm::mat4 model;
+	};
+
+	std::vector<SourceMesh> meshes;
+	std::vector<Instance> instances;
+	std::vector<StaticBatch> batches;
+
+	void build(size_t floatsPerVertex, int normalOffset);
+	void release();
+};
@@ -0,0 +1,142 @@
+#include "pch.h"
+#include "TangentSpace.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <glm.hpp>
+
+// triangles or vertices per task
+static const size_t tangentGrainSize = 4096;
+
+// UV-space tangent and bitangent of one triangle, not normalised
+struct TriangleFrame
+{
+	glm::vec3 tangent;
+	glm::vec3 bitangent;
+	bool valid;
+};
+
+static const glm::vec3& readVec3(const char* vertices, size_t vertexSize, size_t offset, unsigned int index)
+{
+	return *(const glm::vec3*)(vertices + index * vertexSize + offset);
+}
+
+static const glm::vec2& readVec2(const char* vertices, size_t vertexSize, size_t offset, unsigned int index)
+{
+	return *(const glm::vec2*)(vertices + index * vertexSize + offset);
+}
+
+static glm::vec3 projectOnPlane(const glm::vec3& v, const glm::vec3& normal)
+{
+	return v - normal * glm::dot(normal, v);
+}
+
+static float cornerAngle(const glm::vec3& corner, const glm::vec3& a, const glm::vec3& b)
+{
+	const glm::vec3 edgeA = a - corner, edgeB = b - corner;
+	const float lengths = std::sqrt(glm::dot(edgeA, edgeA) * glm::dot(edgeB, edgeB));
+	if (lengths <= 0.0f)
+		return 0.0f;
+
+	return std::acos(glm::clamp(glm::dot(edgeA, edgeB) / lengths, -1.0f, 1.0f));
+}
+
+void TangentSpace::generate(void* vertices, size_t vertexCount, size_t vertexSize, size_t positionOffset, size_t normalOffset,
+	size_t texCoordOffset, size_t tangentOffset, const unsigned int* indices, size_t indexCount)
+{
+	char* bytes = (char*)vertices;
+	const size_t triangleCount = indexCount / 3;
+
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		if (indices[i] >= vertexCount)
+		{
+			std::cerr << "[Error: TangentSpace] Index " << indices[i] << " out of range." << std::endl;
+			return;
+		}
+
+	// triangle frames
+	std::vector<TriangleFrame> frames(triangleCount);
+	ThreadPool::Global().ParallelFor(triangleCount, tangentGrainSize, [&](size_t begin, size_t end)
+	{
+		for (size_t triangle = begin; triangle < end; triangle++)
+		{
+			const unsigned int* corners = indices + triangle * 3;
+			const glm::vec3& p0 = readVec3(bytes, vertexSize, positionOffset, corners[0]);
+			const glm::vec2& uv0 = readVec2(bytes, vertexSize, texCoordOffset, corners[0]);
+
+			const glm::vec3 edge1 = readVec3(bytes, vertexSize, positionOffset, corners[1]) - p0;
+			const glm::vec3 edge2 = readVec3(bytes, vertexSize, positionOffset, corners[2]) - p0;
+			const glm::vec2 deltaUV1 = readVec2(bytes, vertexSize, texCoordOffset, corners[1]) - uv0;
+			const glm::vec2 deltaUV2 = readVec2(bytes, vertexSize, texCoordOffset, corners[2]) - uv0;
+
+			const float determinant = deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x;
+			TriangleFrame& frame = frames[triangle];
+			frame.valid = std::abs(determinant) > 1e-20f;
+			if (!frame.valid)
+				continue;
+
+			// the sign of the determinant carries the handedness, so only the magnitude is normalised away
+			const float f = 1.0f / determinant;
+			frame.tangent = f * (edge1 * deltaUV2.y - edge2 * deltaUV1.y);
+			frame.bitangent = f * (edge2 * deltaUV1.x - edge1 * deltaUV2.x);
+		}
+	});
+
+	// vertex -> triangle adjacency
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacencyOffsets[indices[i] + 1]++;
+	for (size_t i = 0; i < vertexCount; i++)
+		adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacency[fill[indices[i]]++] = (unsigned int)i;
+
+	// per vertex: angle weighted sum of the projected frames, then Gram-Schmidt
+	ThreadPool::Global().ParallelFor(vertexCount, tangentGrainSize, [&](size_t begin, size_t end)
+	{
+		for (size_t vertex = begin; vertex < end; vertex++)
+		{
+			const glm::vec3& position = readVec3(bytes, vertexSize, positionOffset, (unsigned int)vertex);
+			glm::vec3 normal = readVec3(bytes, vertexSize, normalOffset, (unsigned int)vertex);
+			normal = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f, 0.0f, 1.0f);
+
+			glm::vec3 tangentSum(0.0f), bitangentSum(0.0f);
+			for (unsigned int a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++)
+			{
+				const unsigned int corner = adjacency[a];
+				const TriangleFrame& frame = frames[corner / 3];
+				if (!frame.valid)
+					continue;
+
+				const unsigned int* triangle = indices + corner / 3 * 3;
+				const unsigned int next = triangle[(corner + 1) % 3], previous = triangle[(corner + 2) % 3];
+				const float angle = cornerAngle(position, readVec3(bytes, vertexSize, positionOffset, next),
+					readVec3(bytes, vertexSize, positionOffset, previous));
+
+				const glm::vec3 tangent = projectOnPlane(frame.tangent, normal);
+				const glm::vec3 bitangent = projectOnPlane(frame.bitangent, normal);
+				if (glm::dot(tangent, tangent) > 0.0f)
+					tangentSum += glm::normalize(tangent) * angle;
+				if (glm::dot(bitangent, bitangent) > 0.0f)
+					bitangentSum += glm::normalize(bitangent) * angle;
+			}
+
+			glm::vec3 tangent = projectOnPlane(tangentSum, normal);
+			if (glm::dot(tangent, tangent) < 1e-12f)
+			{
+				// no UVs to follow: any direction in the tangent plane
+				tangent = glm::cross(std::abs(normal.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f), normal);
+				bitangentSum = glm::cross(normal, tangent);
+			}
+			tangent = glm::normalize(tangent);
+			const float sign = glm::dot(glm::cross(normal, tangent), bitangentSum) < 0.0f ? -1.0f : 1.0f;
+
+			*(glm::vec4*)(bytes + vertex * vertexSize + tangentOffset) = glm::vec4(tangent, sign);
+		}
+	});
+}
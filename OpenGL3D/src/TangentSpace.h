@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+
+/*
+	Per-vertex tangent frames for normal and parallax mapping, following the MikkTSpace rules:
+	every triangle's UV-space tangent and bitangent are projected onto the tangent plane of each
+	corner's normal and accumulated with the corner angle as weight, so the result does not
+	depend on how a surface happens to be triangulated. The sum is orthonormalised against the
+	normal and stored as a float4: xyz the unit tangent, w the handedness (+1 or -1) with
+	bitangent = cross(normal, tangent) * w, instead of a separate bitangent.
+
+	Triangles are processed in parallel, then every vertex gathers its triangles through an
+	adjacency table, so no two threads write the same vertex. Vertices without usable UVs get
+	an arbitrary frame around their normal. Vertices are opaque blocks of vertexSize bytes with
+	float3 position and normal, float2 texCoords and a float4 tangent at the given offsets.
+	Unlike MikkTSpace, vertices shared by triangles of opposite handedness are not split;
+	mirrored UV seams already come with separate vertices in practice.
+*/
+namespace TangentSpace
+{
+	void generate(void* vertices, size_t vertexCount, size_t vertexSize, size_t positionOffset, size_t normalOffset,
+		size_t texCoordOffset, size_t tangentOffset, const unsigned int* indices, size_t indexCount);
+
+	template<typename V>
+	void generate(std::vector<V>& vertices, const std::vector<unsigned int>& indices)
+	{
+		if (vertices.empty() || indices.empty())
+			return;
+
+		const char* base = (const char*)&vertices[0];
+		generate(vertices.data(), vertices.size(), sizeof(V), (const char*)&vertices[0].pos - base, (const char*)&vertices[0].normal - base,
+			(const char*)&vertices[0].texCoords - base, (const char*)&vertices[0].tangent - base, indices.data(), indices.size());
+	}
+}
@@ -1,6 +1,6 @@
 #include "pch.h"
 
-#include <map>
+#include <iostream>
 
 #include "Utility.h"
 #include "Camera.h"
@@ -10,74 +10,77 @@
 
 #include "StencilData.h"
 #include "BlendData.h"
+#include "DrawDataBuffer.h"
+#include "RenderQueue.h"
+#include "StaticBatcher.h"
+#include "VertexLayout.h"
 
-static GLuint createVertexArray()
+static GLuint createVertexArray(GLuint vbo)
 {
 	GLuint vao;
 	glCreateVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-	glBindVertexArray(0);
+	QuadVertexLayout::Setup(vao, vbo);
 	return vao;
 }
 
-static void drawWindows(GLuint shader, GLuint vao, const Camera& camera)
+// windows are translucent, so the queue draws them after everything else and back to front
+static void queueWindows(RenderQueue& queue, GLuint shader, GLuint vao, unsigned int material)
 {
-
-	std::map<float, glm::vec3> sorted;
-
-	for (unsigned int i = 0; i < BlendData::windowPos.size(); i++)
-	{
-		float distance = glm::length(camera.pos - BlendData::windowPos[i]);
-		sorted[distance] = BlendData::windowPos[i];
-	}
-
-	glUseProgram(shader);
-	glUniform1i(glGetUniformLocation(shader, "aTex"), 0);
-	glBindVertexArray(vao);
-
-	for (std::map<float, glm::vec3>::reverse_iterator it = sorted.rbegin(); it != sorted.rend(); ++it)
+	RenderPacket packet;
+	packet.program = shader;
+	packet.vao = vao;
+	packet.material = material;
+	packet.indexCount = sizeof(StencilData::planeIndices) / sizeof(unsigned int);
+	packet.translucent = true;
+
+	for (const glm::vec3& pos : BlendData::windowPos)
 	{
-		glm::mat4 model(1.0f);
-		model = glm::translate(model, it->second);
-		model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		model = glm::scale(model, glm::vec3(0.1f));
-		glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		packet.model = glm::translate(glm::mat4(1.0f), pos);
+		packet.model = glm::rotate(packet.model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+		packet.model = glm::scale(packet.model, glm::vec3(0.1f));
+		queue.Add(packet);
 	}
 }
 
-static void drawCubes(GLuint shader, GLuint vao)
+static void buildCubes(StaticBatcher& outCubes)
 {
-	glUseProgram(shader);
-	glUniform1i(glGetUniformLocation(shader, "aTex"), 2);
+	const unsigned int cube = outCubes.AddMesh(StencilData::cubeVertices, sizeof(StencilData::cubeVertices) / sizeof(float),
+		StencilData::cubeIndices, sizeof(StencilData::cubeIndices) / sizeof(unsigned int));
 
-	glBindVertexArray(vao);
 	for (const glm::vec3& pos : StencilData::cubePositions)
 	{
 		glm::mat4 model(1.0f);
 		model = glm::translate(model, pos);
 		model = glm::translate(model, glm::vec3(2.5f, 0, -7.5f));
-		glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		outCubes.AddInstance(cube, 0, model);
 	}
 
+	outCubes.Build<QuadVertexLayout>();
 }
-static void drawPlane(GLuint shader, GLuint vao)
+
+static void queueCubes(RenderQueue& queue, GLuint shader, const StaticBatcher& cubes, unsigned int material)
 {
-	glUseProgram(shader);
-	glm::mat4 model(1.0f);
-	model = glm::translate(model, glm::vec3(2.5f, 0, -2.5f));
-	glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-	glUniform1i(glGetUniformLocation(shader, "aTex"), 1);
-
-	glBindVertexArray(vao);
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	for (const StaticBatch& batch : cubes.GetBatches())
+	{
+		RenderPacket packet;
+		packet.program = shader;
+		packet.vao = batch.vao;
+		packet.material = material;
+		packet.indexCount = batch.indexCount;
+		queue.Add(packet);
+	}
 }
 
+static void queuePlane(RenderQueue& queue, GLuint shader, GLuint vao, unsigned int material)
+{
+	RenderPacket packet;
+	packet.program = shader;
+	packet.vao = vao;
+	packet.material = material;
+	packet.indexCount = sizeof(StencilData::planeIndices) / sizeof(unsigned int);
+	packet.model = glm::translate(glm::mat4(1.0f), glm::vec3(2.5f, 0, -2.5f));
+	queue.Add(packet);
+}
 
 void TestBlend()
 
@@ -94,89 +97,112 @@ void TestBlend()
 
 	// Initialise shaders and load programs.
 	GLuint coreProgram;
-	if (!Shader::loadProgram(coreProgram, "res/shaders/stencil/VertexCore.glsl", "res/shaders/stencil/FragmentCore.glsl"))
+	if (!Shader::loadProgram(coreProgram, "res/shaders/DrawData/VertexCore.glsl", "res/shaders/stencil/FragmentCore.glsl"))
 		std::cerr << "[Error: main.cpp] Failed to load core program." << std::endl;
 
-	// cube
-	GLuint cubeVBO;
-	glGenBuffers(1, &cubeVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(StencilData::cubeVertices), StencilData::cubeVertices, GL_STATIC_DRAW);
-
-	GLuint cubeVAO = createVertexArray();
-	glBindVertexArray(cubeVAO);
-
-	GLuint cubeEBO;
-	glGenBuffers(1, &cubeEBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(StencilData::cubeIndices), StencilData::cubeIndices, GL_STATIC_DRAW);
-
-	glBindVertexArray(0);
-
-	// plane 
-	GLuint planeVBO;
-	glGenBuffers(1, &planeVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(StencilData::planeVertices), StencilData::planeVertices, GL_STATIC_DRAW);
-
-	GLuint planeVAO = createVertexArray();
-	glBindVertexArray(planeVAO);
-
-	GLuint planeEBO;
-	glGenBuffers(1, &planeEBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, planeEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(StencilData::planeIndices), StencilData::planeIndices, GL_STATIC_DRAW);
-
-	glBindVertexArray(0);
-
-	// Initialise textures and materials.
-	stbi_set_flip_vertically_on_load(true);
-
-	Texture windowTexture(TextureType::DIFFUSE, 0, "res/textures/rose_window.png", true);
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-
-	Texture floorTexture(TextureType::DIFFUSE, 1, "res/textures/tile.png", true);
-	Texture cubeTexture(TextureType::DIFFUSE, 2, "res/textures/cobble.png", true);
-
-	// Initialise window state.
-	Camera camera(
-		glm::vec3(0.0f, 0.0f, 6.0f),
-		glm::vec3(0.0f, 1.0f, 0.0f),
-		-90.0f,
-		0.0f
-	);
-
-	bool spotlightOn = true;
-
-	Handler handler(window, camera, spotlightOn);
-
-	while (!glfwWindowShouldClose(window))
+	// scoped so the batches and the draw data release their GL objects while the context is alive
 	{
-		glfwPollEvents();
-		Handler::MaintainKeyboard(window);
+		// cubes, merged into one draw
+		StaticBatcher cubes;
+		buildCubes(cubes);
+
+		// plane 
+		GLuint planeVBO;
+		glGenBuffers(1, &planeVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(StencilData::planeVertices), StencilData::planeVertices, GL_STATIC_DRAW);
+
+		GLuint planeVAO = createVertexArray(planeVBO);
+		glBindVertexArray(planeVAO);
+
+		GLuint planeEBO;
+		glGenBuffers(1, &planeEBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, planeEBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(StencilData::planeIndices), StencilData::planeIndices, GL_STATIC_DRAW);
+
+		glBindVertexArray(0);
+
+		// Initialise textures and materials.
+		stbi_set_flip_vertically_on_load(true);
+
+		Texture windowTexture(TextureType::DIFFUSE, 0, "res/textures/rose_window.png", true);
+		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+
+		Texture floorTexture(TextureType::DIFFUSE, 1, "res/textures/tile.png", true);
+		Texture cubeTexture(TextureType::DIFFUSE, 2, "res/textures/cobble.png", true);
+
+		// every draw goes through the queue, which binds a material's texture on unit 0
+		RenderQueue queue;
+		RenderMaterial material;
+		material.textures[0] = windowTexture.id;
+		const unsigned int windowMaterial = queue.AddMaterial(material);
+		material.textures[0] = floorTexture.id;
+		const unsigned int floorMaterial = queue.AddMaterial(material);
+		material.textures[0] = cubeTexture.id;
+		const unsigned int cubeMaterial = queue.AddMaterial(material);
+
+		DrawDataBuffer draws(BlendData::windowPos.size() + cubes.GetBatches().size() + 1);
+		draws.Attach(planeVAO);
+		for (const StaticBatch& batch : cubes.GetBatches())
+			draws.Attach(batch.vao);
 
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-		
+		glUseProgram(coreProgram);
+		glUniform1i(glGetUniformLocation(coreProgram, "aTex"), 0);
 
-		glm::mat4 view = std::move(camera.GetViewMatrix());
-		glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.1f, 100.0f);
+		// Initialise window state.
+		Camera camera(
+			glm::vec3(0.0f, 0.0f, 6.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f),
+			-90.0f,
+			0.0f
+		);
 
-		glUseProgram(coreProgram);
-		glUniformMatrix4fv(glGetUniformLocation(coreProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(glGetUniformLocation(coreProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+		bool spotlightOn = true;
+
+		Handler handler(window, camera, spotlightOn);
+		double lastReport = glfwGetTime();
 
-		glEnable(GL_CULL_FACE);
-		drawCubes(coreProgram, cubeVAO);
-		drawPlane(coreProgram, planeVAO);
+		while (!glfwWindowShouldClose(window))
+		{
+			glfwPollEvents();
+			Handler::MaintainKeyboard(window);
 
-		glDisable(GL_CULL_FACE);
-		drawWindows(coreProgram, planeVAO, camera);
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 		
 
-		glfwSwapBuffers(window);
-		glFlush();
+			glm::mat4 view = std::move(camera.GetViewMatrix());
+			glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.1f, 100.0f);
+
+			glUseProgram(coreProgram);
+			glUniformMatrix4fv(glGetUniformLocation(coreProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+			glUniformMatrix4fv(glGetUniformLocation(coreProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+
+			// the windows are added first and interleave with the opaque draws only until sorted
+			queue.Begin(camera.pos);
+			queueWindows(queue, coreProgram, planeVAO, windowMaterial);
+			queueCubes(queue, coreProgram, cubes, cubeMaterial);
+			queuePlane(queue, coreProgram, planeVAO, floorMaterial);
+
+			glEnable(GL_CULL_FACE);
+			draws.Begin();
+			queue.Flush(draws);
+			draws.End();
+
+			glfwSwapBuffers(window);
+			glFlush();
+
+			const double time = glfwGetTime();
+			if (time - lastReport >= 1.0)
+			{
+				const RenderQueueStats& stats = queue.GetStats();
+				std::cout << "[Info: TestBlend] " << stats.packets << " packets in " << stats.drawCalls << " draw calls and "
+					<< stats.materialBinds << " material binds, sorting saved " << stats.GetSavedDrawCalls() << " and "
+					<< stats.GetSavedMaterialBinds() << " in " << stats.sortMs << " ms." << std::endl;
+				lastReport = time;
+			}
+		}
 	}
 
 	glfwDestroyWindow(window);
@@ -7,6 +7,7 @@
 #include "Shader.h"
 
 #include "CubeData.h"
+#include "VertexLayout.h"
 
 static float exposure = 0.5f;
 
@@ -58,17 +59,12 @@ static void createFramebuffer(unsigned int textureCount, bool depthBuffer, GLuin
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-static GLuint createVertexArray()
+static GLuint createVertexArray(GLuint vbo)
 {
 	GLuint vao;
 	glCreateVertexArrays(1, &vao);
+	CubeVertexLayout::Setup(vao, vbo);
 	glBindVertexArray(vao);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), 0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
 	return vao;
 }
 
@@ -79,7 +75,7 @@ static GLuint createCubeVertexArray()
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(CubeData::vertices), CubeData::vertices, GL_STATIC_DRAW);
 
-	GLuint vao = createVertexArray();
+	GLuint vao = createVertexArray(vbo);
 
 	GLuint ebo;
 	glGenBuffers(1, &ebo);
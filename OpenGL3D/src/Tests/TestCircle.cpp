@@ -2,6 +2,7 @@
 
 #include <math.h>
 #include <iostream>
+#include <map>
 #include "Utility.h"
 
 #include "Camera.h"
@@ -10,11 +11,11 @@
 #include "Shader.h"
 
 
-#include "CubeData.h"
+#include "Primitives.h"
 
-static const float pi = 3.1415926f;
+static const unsigned int maxCircleResolution = 256;
 
-static void drawLights(GLuint lightShader, GLuint cubeVAO, glm::mat4& view, glm::mat4& projection)
+static void drawLights(GLuint lightShader, const PrimitiveGeometry& cube, GLuint cubeVAO, glm::mat4& view, glm::mat4& projection)
 {
 	for (int i = 0; i < COUNT_POINT_LIGHT; i++)
 	{
@@ -30,8 +31,7 @@ static void drawLights(GLuint lightShader, GLuint cubeVAO, glm::mat4& view, glm:
 
 		glUniform3fv(glGetUniformLocation(lightShader, "lightColor"), 1, glm::value_ptr(pointLight.specular));
 
-		glBindVertexArray(cubeVAO);
-		glDrawElements(GL_TRIANGLES, CubeData::indexCount, GL_UNSIGNED_INT, 0);
+		Primitives::draw(cube, cubeVAO);
 	}
 }
 
@@ -86,112 +86,6 @@ static void setUniforms(GLuint shader, Camera& camera, bool spotlightOn, glm::ma
 	glUniform1i(glGetUniformLocation(shader, ("spotlight.on")), spotlightOn);
 }
 
-static void emplaceCirclePoints(unsigned int uSample, unsigned int vSample, float* outVertices)
-{
-	const unsigned int vertexCount = vSample * (uSample - 2) + 2;
-	const unsigned int floatCount = 3 * vertexCount;
-
-	// top centre
-	outVertices[0] = 0.0f;
-	outVertices[1] = 0.0f;
-	outVertices[2] = 1.0f;
-
-	// bottom centre
-	outVertices[floatCount - 3] = 0.0f;
-	outVertices[floatCount - 2] = 0.0f;
-	outVertices[floatCount - 1] = -1.0f;
-
-	const float uInc = pi / (uSample - 1);
-	const float vInc = 2 * pi / vSample;
-
-	// Start at second u layer and stop at second to last.
-	float u = uInc;
-	float v = 0.0f;
-
-	unsigned int idx = 3;
-
-	for (unsigned int uIdx = 0; uIdx < uSample - 2; uIdx++)
-	{
-		for (unsigned int vIdx = 0; vIdx < vSample; vIdx++)
-		{
-			outVertices[idx++] = sin(u) * cos(v);
-			outVertices[idx++] = sin(u) * sin(v);
-			outVertices[idx++] = cos(u);
-			v += vInc;
-		}
-		u += uInc;
-		v = 0.0f;
-	}
-}
-
-static void emplaceCircleIndices(unsigned int uSample, unsigned int vSample, unsigned int* outIndices)
-{
-	/* 
-		uIntCount explanation: 
-		3 indices per trianles
-		{2 * vSample} triangles in {uSample - 3} rows (as not including top and bottom) + {2 * vSample} triangles at top and bottom.
-		6 * vSample * (uSample - 3) + 6 * vSample;
-	 */
-
-	unsigned int arrIdx = 0;
-
-	for (unsigned int i = 1; i <= vSample; i++)
-	{
-		// 0 is index of top centre, 1 is first vertex of first layer
-		outIndices[arrIdx++] = 0;
-		outIndices[arrIdx++] = i;
-		//accounts for joining
-		outIndices[arrIdx++] = (i == vSample) ? 1 : (i + 1);
-	}
-
-	// swap 2nd and 3rd for originals
-	for (unsigned int uIdx = 0; uIdx < uSample - 3; uIdx++)
-	{
-		// add 1 due to top centre vertex
-		const unsigned int lowerStart = uIdx * vSample + 1;
-		const unsigned int upperStart = lowerStart + vSample;
-
-		for (unsigned int vIdx = 0; vIdx < vSample - 1; vIdx++)
-		{
-
-			/* 
-			   up triangle	 |  down triangle 
-					1		 |	  0		  1
-							 |
-				0		2    |		  2
-			*/
-			outIndices[arrIdx++] = lowerStart + vIdx;  
-			outIndices[arrIdx++] = upperStart + vIdx;     
-			outIndices[arrIdx++] = lowerStart + vIdx + 1;
-
-			outIndices[arrIdx++] = upperStart + vIdx;
-			outIndices[arrIdx++] = upperStart + vIdx + 1;
-			outIndices[arrIdx++] = lowerStart + vIdx + 1;
-		}
-
-		// edge case triangles
-		outIndices[arrIdx++] = upperStart - 1;
-		outIndices[arrIdx++] = upperStart + vSample - 1;
-		outIndices[arrIdx++] = lowerStart;
-
-		outIndices[arrIdx++] = upperStart + vSample - 1;
-		outIndices[arrIdx++] = upperStart;
-		outIndices[arrIdx++] = lowerStart;
-	}
-
-	// index of bottom centre is vertex count - 1
-	const unsigned int bottomIdx = vSample * (uSample - 2) + 1;
-	// start of penultimate layer (act as if bottomIdx is first vertex of next layer)
-	const unsigned int penStart  = bottomIdx - vSample;
-
-	for (unsigned int i = 0; i < vSample; i++)
-	{
-		outIndices[arrIdx++] = bottomIdx;
-		outIndices[arrIdx++] = (i == vSample - 1) ? penStart : penStart + i + 1;
-		outIndices[arrIdx++] = penStart + i;
-	}
-}
-
 void TestCircle()
 {
 	GLFWwindow* window = Utility::setupGLFW();
@@ -213,62 +107,12 @@ void TestCircle()
 	GLuint lightProgram;
 	Shader::loadProgram(lightProgram, "res/shaders/circle/VertexCore.glsl", "res/shaders/circle/FragmentLight.glsl");
 
-	//circle
-	const unsigned int uSample = 256;
-	const unsigned int vSample = 256;
-
-	const unsigned int vertexCount = vSample * (uSample - 2) + 2;
-	const unsigned int floatCount = 3 * vertexCount;
-
-	const unsigned int uIntCount = 6 * vSample * (uSample - 2);
-
-	float* circleVertices = new float[floatCount];
-	emplaceCirclePoints(uSample, vSample, circleVertices);
-
-	unsigned int* circleIndices = new unsigned int[uIntCount];
-	emplaceCircleIndices(uSample, vSample, circleIndices);
-
-	GLuint circleVBO;
-	glGenBuffers(1, &circleVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, circleVBO);
-	glBufferData(GL_ARRAY_BUFFER, floatCount * sizeof(float), circleVertices, GL_STATIC_DRAW);
-
-	GLuint circleVAO;
-	glCreateVertexArrays(1, &circleVAO);
-	glBindVertexArray(circleVAO);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
-	
-	GLuint circleEBO;
-	glGenBuffers(1, &circleEBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, circleEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, uIntCount * sizeof(unsigned int), circleIndices, GL_STATIC_DRAW);
-
-	glBindVertexArray(0);
+	// circle, one vertex array per tessellation the camera distance has asked for
+	std::map<unsigned int, GLuint> circleVAOs;
 
 	// cube
-	GLuint cubeVBO;
-	glGenBuffers(1, &cubeVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(CubeData::vertices), CubeData::vertices, GL_STATIC_DRAW);
-
-	GLuint cubeVAO;
-	glCreateVertexArrays(1, &cubeVAO);
-	glBindVertexArray(cubeVAO);
-
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), 0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	
-	GLuint cubeEBO;
-	glGenBuffers(1, &cubeEBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(CubeData::indices), CubeData::indices, GL_STATIC_DRAW);
-
-	glBindVertexArray(0);
+	const PrimitiveGeometry& cube = Primitives::get(PRIMITIVE_CUBE, 1);
+	GLuint cubeVAO = Primitives::createVertexArray(cube, PRIMITIVE_LAYOUT_MESH);
 
 	// Initialise window state.
 	Camera camera(
@@ -294,16 +138,25 @@ void TestCircle()
 		glm::mat4 view = std::move(camera.GetViewMatrix());
 		glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.1f, 100.0f);
 
-		drawLights(lightProgram, cubeVAO, view, projection);
+		drawLights(lightProgram, cube, cubeVAO, view, projection);
 		setUniforms(coreProgram, camera, spotlightOn, model, view, projection);
 
-		glBindVertexArray(circleVAO);
-		glDrawElements(GL_TRIANGLES, uIntCount, GL_UNSIGNED_INT, 0);
+		const unsigned int resolution = Primitives::selectResolution(PRIMITIVE_UV_SPHERE, maxCircleResolution, 1.0f, glm::length(camera.pos),
+			glm::radians(camera.fov), 600.0f);
+		const PrimitiveGeometry& circle = Primitives::get(PRIMITIVE_UV_SPHERE, resolution);
+		if (!circleVAOs.count(resolution))
+			circleVAOs[resolution] = Primitives::createVertexArray(circle, PRIMITIVE_LAYOUT_MESH);
+		Primitives::draw(circle, circleVAOs[resolution]);
 
 		glfwSwapBuffers(window);
 		glFlush();
 	}
 
+	for (auto& vao : circleVAOs)
+		glDeleteVertexArrays(1, &vao.second);
+	glDeleteVertexArrays(1, &cubeVAO);
+	Primitives::release();
+
 	glfwDestroyWindow(window);
 	glfwTerminate();
 
@@ -6,6 +6,8 @@
 #include "Texture.h"
 #include "Model.h"
 #include "Shader.h"
+#include "StaticBatcher.h"
+#include "VertexLayout.h"
 
 #include "CubeData.h"
 #include "LightData.h"
@@ -57,115 +59,126 @@ void TestContainers()
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(CubeData::indices), CubeData::indices, GL_STATIC_DRAW);
 
-	// Initialise textures and materials.
-	stbi_set_flip_vertically_on_load(true);
+	// scoped so the batches release their GL objects while the context is alive
+	{
+		// containers, merged into one draw
+		StaticBatcher containers;
+		const unsigned int cube = containers.AddMesh(CubeData::vertices, sizeof(CubeData::vertices) / sizeof(float),
+			CubeData::indices, CubeData::indexCount);
+		for (unsigned int i = 0; i < 7; i++)
+		{
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), CubeData::cubePositions[i]);
+			float angle = 20.0f * i;
+			model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+			containers.AddInstance(cube, 0, model);
+		}
+		containers.Build<CubeVertexLayout>(3);
 
-	glUseProgram(coreProgram);
+		// Initialise textures and materials.
+		stbi_set_flip_vertically_on_load(true);
 
-	Texture diffuseMap(TextureType::DIFFUSE, 0, "res/textures/container2.png", true);
-	Texture specularMap(TextureType::SPECULAR, 1, "res/textures/specular.png", true);
+		glUseProgram(coreProgram);
 
-	glUniform1f(glGetUniformLocation(coreProgram, "material.shininess"), 32.0f);
+		Texture diffuseMap(TextureType::DIFFUSE, 0, "res/textures/container2.png", true);
+		Texture specularMap(TextureType::SPECULAR, 1, "res/textures/specular.png", true);
 
-	// Initialise window state.
-	Camera camera(
-		glm::vec3(0.0f, 0.0f, 3.0f),
-		glm::vec3(0.0f, 1.0f, 0.0f),
-		-90.0f,
-		0.0f
-	);
+		glUniform1f(glGetUniformLocation(coreProgram, "material.shininess"), 32.0f);
 
-	bool spotlightOn = true;
+		// Initialise window state.
+		Camera camera(
+			glm::vec3(0.0f, 0.0f, 3.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f),
+			-90.0f,
+			0.0f
+		);
 
-	Handler handler(window, camera, spotlightOn);
+		bool spotlightOn = true;
 
-	while (!glfwWindowShouldClose(window))
-	{
-		glfwPollEvents();
-		Handler::MaintainKeyboard(window);
+		Handler handler(window, camera, spotlightOn);
 
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+		while (!glfwWindowShouldClose(window))
+		{
+			glfwPollEvents();
+			Handler::MaintainKeyboard(window);
 
-		glBindVertexArray(vao);
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-		glm::mat4 view = std::move(camera.GetViewMatrix());
-		glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.1f, 100.0f);
+			glBindVertexArray(vao);
 
-		for (int i = 0; i < COUNT_POINT_LIGHT; i++)
-		{
-			const PointLight& pointLight = LightData::pointLights[i];
+			glm::mat4 view = std::move(camera.GetViewMatrix());
+			glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.1f, 100.0f);
 
-			// ************ LIGHT ************ //
-			glUseProgram(lightProgram);
+			for (int i = 0; i < COUNT_POINT_LIGHT; i++)
+			{
+				const PointLight& pointLight = LightData::pointLights[i];
 
-			glm::mat4 model = glm::translate(glm::mat4(1.0f), pointLight.position);
-			model = glm::scale(model, glm::vec3(0.2f));
-			glUniformMatrix4fv(glGetUniformLocation(lightProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-			glUniformMatrix4fv(glGetUniformLocation(lightProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-			glUniformMatrix4fv(glGetUniformLocation(lightProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+				// ************ LIGHT ************ //
+				glUseProgram(lightProgram);
 
-			glUniform3fv(glGetUniformLocation(lightProgram, "lightColor"), 1, glm::value_ptr(pointLight.specular));
+				glm::mat4 model = glm::translate(glm::mat4(1.0f), pointLight.position);
+				model = glm::scale(model, glm::vec3(0.2f));
+				glUniformMatrix4fv(glGetUniformLocation(lightProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
+				glUniformMatrix4fv(glGetUniformLocation(lightProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+				glUniformMatrix4fv(glGetUniformLocation(lightProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
-			glDrawElements(GL_TRIANGLES, CubeData::indexCount, GL_UNSIGNED_INT, 0);
+				glUniform3fv(glGetUniformLocation(lightProgram, "lightColor"), 1, glm::value_ptr(pointLight.specular));
 
-			// ************ CORE ************ //
-			glUseProgram(coreProgram);
+				glDrawElements(GL_TRIANGLES, CubeData::indexCount, GL_UNSIGNED_INT, 0);
 
-			std::string number = std::to_string(i);
-			glUniform3fv(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].position").c_str()), 1, glm::value_ptr(pointLight.position));
-			glUniform1f(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].constant").c_str()), pointLight.constant);
-			glUniform1f(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].linear").c_str()), pointLight.linear);
-			glUniform1f(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].quadratic").c_str()), pointLight.quadratic);
-			glUniform3fv(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].ambient").c_str()), 1, glm::value_ptr(pointLight.ambient));
-			glUniform3fv(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].diffuse").c_str()), 1, glm::value_ptr(pointLight.diffuse));
-			glUniform3fv(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].specular").c_str()), 1, glm::value_ptr(pointLight.specular));
-		}
+				// ************ CORE ************ //
+				glUseProgram(coreProgram);
 
-		glUseProgram(coreProgram);
+				std::string number = std::to_string(i);
+				glUniform3fv(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].position").c_str()), 1, glm::value_ptr(pointLight.position));
+				glUniform1f(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].constant").c_str()), pointLight.constant);
+				glUniform1f(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].linear").c_str()), pointLight.linear);
+				glUniform1f(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].quadratic").c_str()), pointLight.quadratic);
+				glUniform3fv(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].ambient").c_str()), 1, glm::value_ptr(pointLight.ambient));
+				glUniform3fv(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].diffuse").c_str()), 1, glm::value_ptr(pointLight.diffuse));
+				glUniform3fv(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].specular").c_str()), 1, glm::value_ptr(pointLight.specular));
+			}
 
-		diffuseMap.changeUnit(0);
-		glUniform1i(glGetUniformLocation(coreProgram, "material.diffuse"), 0);
-		specularMap.changeUnit(1);
-		glUniform1i(glGetUniformLocation(coreProgram, "material.specular"), 1);
+			glUseProgram(coreProgram);
 
-		glUniform3fv(glGetUniformLocation(coreProgram, "viewPos"), 1, glm::value_ptr(camera.pos));
+			diffuseMap.changeUnit(0);
+			glUniform1i(glGetUniformLocation(coreProgram, "material.diffuse"), 0);
+			specularMap.changeUnit(1);
+			glUniform1i(glGetUniformLocation(coreProgram, "material.specular"), 1);
 
-		glUniform3f(glGetUniformLocation(coreProgram, ("dirLight.direction")), -1.0f, -1.0f, -1.0f);
-		glUniform3f(glGetUniformLocation(coreProgram, ("dirLight.ambient")), 0.06f, 0.02f, 0.2f);
-		glUniform3f(glGetUniformLocation(coreProgram, ("dirLight.diffuse")), 0.15f, 0.05f, 0.5f);
-		glUniform3f(glGetUniformLocation(coreProgram, ("dirLight.specular")), 0.21f, 0.07f, 0.7f);
+			glUniform3fv(glGetUniformLocation(coreProgram, "viewPos"), 1, glm::value_ptr(camera.pos));
 
-		glUniform3fv(glGetUniformLocation(coreProgram, ("spotlight.position")), 1, glm::value_ptr(camera.pos));
-		glUniform3fv(glGetUniformLocation(coreProgram, ("spotlight.direction")), 1, glm::value_ptr(camera.front));
+			glUniform3f(glGetUniformLocation(coreProgram, ("dirLight.direction")), -1.0f, -1.0f, -1.0f);
+			glUniform3f(glGetUniformLocation(coreProgram, ("dirLight.ambient")), 0.06f, 0.02f, 0.2f);
+			glUniform3f(glGetUniformLocation(coreProgram, ("dirLight.diffuse")), 0.15f, 0.05f, 0.5f);
+			glUniform3f(glGetUniformLocation(coreProgram, ("dirLight.specular")), 0.21f, 0.07f, 0.7f);
 
-		glUniform3f(glGetUniformLocation(coreProgram, ("spotlight.ambient")), 0.05f, 0.05f, 0.05f);
-		glUniform3f(glGetUniformLocation(coreProgram, ("spotlight.diffuse")), 0.5f, 0.5f, 0.5f);
-		glUniform3f(glGetUniformLocation(coreProgram, ("spotlight.specular")), 0.9f, 0.9f, 0.9f);
+			glUniform3fv(glGetUniformLocation(coreProgram, ("spotlight.position")), 1, glm::value_ptr(camera.pos));
+			glUniform3fv(glGetUniformLocation(coreProgram, ("spotlight.direction")), 1, glm::value_ptr(camera.front));
 
-		glUniform1f(glGetUniformLocation(coreProgram, ("spotlight.constant")), 1.0f);
-		glUniform1f(glGetUniformLocation(coreProgram, ("spotlight.linear")), 0.09f);
-		glUniform1f(glGetUniformLocation(coreProgram, ("spotlight.quadratic")), 0.032f);
+			glUniform3f(glGetUniformLocation(coreProgram, ("spotlight.ambient")), 0.05f, 0.05f, 0.05f);
+			glUniform3f(glGetUniformLocation(coreProgram, ("spotlight.diffuse")), 0.5f, 0.5f, 0.5f);
+			glUniform3f(glGetUniformLocation(coreProgram, ("spotlight.specular")), 0.9f, 0.9f, 0.9f);
 
-		glUniform1f(glGetUniformLocation(coreProgram, ("spotlight.cutOff")), glm::cos(glm::radians(12.5f)));
-		glUniform1f(glGetUniformLocation(coreProgram, ("spotlight.outerCutOff")), glm::cos(glm::radians(17.5f)));
+			glUniform1f(glGetUniformLocation(coreProgram, ("spotlight.constant")), 1.0f);
+			glUniform1f(glGetUniformLocation(coreProgram, ("spotlight.linear")), 0.09f);
+			glUniform1f(glGetUniformLocation(coreProgram, ("spotlight.quadratic")), 0.032f);
 
-		glUniform1i(glGetUniformLocation(coreProgram, ("spotlight.on")), spotlightOn);
+			glUniform1f(glGetUniformLocation(coreProgram, ("spotlight.cutOff")), glm::cos(glm::radians(12.5f)));
+			glUniform1f(glGetUniformLocation(coreProgram, ("spotlight.outerCutOff")), glm::cos(glm::radians(17.5f)));
 
-		glUniformMatrix4fv(glGetUniformLocation(coreProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(glGetUniformLocation(coreProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+			glUniform1i(glGetUniformLocation(coreProgram, ("spotlight.on")), spotlightOn);
 
-		for (unsigned int i = 0; i < 7; i++)
-		{
-			glm::mat4 model = glm::translate(glm::mat4(1.0f), CubeData::cubePositions[i]);
-			float angle = 20.0f * i;
-			model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-			glUniformMatrix4fv(glGetUniformLocation(coreProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-			glDrawElements(GL_TRIANGLES, CubeData::indexCount, GL_UNSIGNED_INT, 0);
-		}
+			glUniformMatrix4fv(glGetUniformLocation(coreProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+			glUniformMatrix4fv(glGetUniformLocation(coreProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
-		glfwSwapBuffers(window);
-		glFlush();
+			// the containers never move, so they are one pre-transformed draw
+			glUniformMatrix4fv(glGetUniformLocation(coreProgram, "model"), 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+			containers.Draw(0, Frustum(projection * view));
+
+			glfwSwapBuffers(window);
+			glFlush();
+		}
 	}
 
 	glfwDestroyWindow(window);
@@ -9,6 +9,7 @@
 #include "Model.h"
 
 #include "CubeData.h"
+#include "VertexLayout.h"
 
 static GLuint loadCubeMap(std::string* faces, unsigned int textureUnit)
 {
@@ -43,16 +44,11 @@ static GLuint loadCubeMap(std::string* faces, unsigned int textureUnit)
 }
 
 
-static GLuint createVertexArray()
+static GLuint createVertexArray(GLuint vbo)
 {
 	GLuint vao;
 	glCreateVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), 0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glBindVertexArray(0);
+	CubeVertexLayout::Setup(vao, vbo);
 	return vao;
 }
 
@@ -81,7 +77,7 @@ void TestCubeMap()
 	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(CubeData::vertices), CubeData::vertices, GL_STATIC_DRAW);
 
-	GLuint cubeVAO = createVertexArray();
+	GLuint cubeVAO = createVertexArray(cubeVBO);
 	glBindVertexArray(cubeVAO);
 
 	GLuint cubeEBO;
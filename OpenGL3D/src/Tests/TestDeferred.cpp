@@ -1,13 +1,19 @@
 #include "pch.h"
 
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
 #include "Utility.h"
 #include "Camera.h"
 #include "Handler.h"
 #include "Texture.h"
 #include "Shader.h"
 
-#include "CubeData.h"
+#include "AabbTree.h"
+#include "InstanceBuffer.h"
 #include "LightData.h"
+#include "Primitives.h"
 
 struct pointLight
 {
@@ -25,6 +31,22 @@ struct pointLight
 static const unsigned int xDim = 10;
 static const unsigned int yDim = 10;
 static const unsigned int count = 100;
+// must match COUNT_POUNT_LIGHT in res/shaders/Deferred/FragmentQuad.glsl
+static const unsigned int maxQuadLights = 20;
+
+// categories in the scene's AabbTree
+static const unsigned int categoryCube = 1;
+static const unsigned int categoryLight = 2;
+
+// light cubes: position, scale and colour, interleaved in one instance buffer
+struct LightInstance
+{
+	glm::vec3 position;
+	glm::vec3 scale;
+	glm::vec3 color;
+};
+
+using LightInstanceLayout = VertexLayout<InstancePosition<float3>, InstanceScale<float3, 4>, InstanceColor<float3, 5>>;
 
 static float randFloat(float a, float b) {
 	float random = ((float)rand()) / (float)RAND_MAX;
@@ -33,12 +55,11 @@ static float randFloat(float a, float b) {
 	return a + r;
 }
 
-static void setupModelMatrices(unsigned int xDim, unsigned int zDim, GLuint vao)
+static std::vector<InstanceTransform> createCubeTransforms(unsigned int xDim, unsigned int zDim)
 {
-	const unsigned int count = xDim * yDim;
-	glm::mat4* modelMatrices = new glm::mat4[count];
+	std::vector<InstanceTransform> transforms;
+	transforms.reserve(xDim * zDim);
 
-	unsigned int idx = 0;
 	for (unsigned int i = 0; i < xDim; i++)
 	{
 		float xOffset = (float)i - (float)(xDim) / 2.0f;
@@ -47,26 +68,12 @@ static void setupModelMatrices(unsigned int xDim, unsigned int zDim, GLuint vao)
 			float zOffset = (float)j - (float)(zDim) / 2.0f;
 			glm::vec3 offset = xOffset * glm::vec3(2.0f, 0.0f, 0.0f) 
 				+ (float)zOffset * glm::vec3(0.0f, 0.0f, -2.0f);
-			modelMatrices[idx++] = glm::translate(glm::mat4(1.0f), offset);
+			transforms.push_back(InstanceTransform());
+			transforms.back().position = offset;
 		}
 	}
 
-	GLuint modelVBO;
-	glGenBuffers(1, &modelVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, modelVBO);
-	glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
-
-	glBindVertexArray(vao);
-
-	const unsigned int vecSize = sizeof(glm::vec4);
-	for (unsigned int i = 0; i < 4; i++)
-	{
-		glEnableVertexAttribArray(i + 3);
-		glVertexAttribPointer(i + 3, 4, GL_FLOAT, GL_FALSE, 4 * vecSize, (void*)(i * vecSize));
-		glVertexAttribDivisor(i + 3, 1);
-	}
-
-	glBindVertexArray(0);
+	return transforms;
 }
 
 static void emplacePointLights(unsigned int count, unsigned int xDim, unsigned int zDim, PointLight* outLights)
@@ -90,14 +97,27 @@ static void emplacePointLights(unsigned int count, unsigned int xDim, unsigned i
 	}
 }
 
-static void setupQuadLightUniforms(unsigned int count, GLuint shader, PointLight* lights)
+// distance at which the light falls below limit
+static float getLightRadius(const PointLight& light)
 {
 	const float limit = 5.0f / 265.0f;
 
+	float lightMax = std::fmaxf(std::fmaxf(light.diffuse.r, light.diffuse.g), light.diffuse.b);
+	return (-light.linear + std::sqrtf(light.linear * light.linear - 4 * light.quadratic * (light.constant - lightMax / limit)))
+		/ (2 * light.quadratic);
+}
+
+// uploads the given lights, at most maxQuadLights of them
+static void setupQuadLightUniforms(const std::vector<unsigned int>& indices, GLuint shader, const PointLight* lights, const float* radii)
+{
+	const unsigned int lightCount = std::min((unsigned int)indices.size(), maxQuadLights);
+
 	glUseProgram(shader);
-	for (unsigned int i = 0; i < count; i++)
+	glUniform1i(glGetUniformLocation(shader, "pointLightCount"), lightCount);
+	for (unsigned int slot = 0; slot < lightCount; slot++)
 	{
-		std::string number = std::to_string(i);
+		const unsigned int i = indices[slot];
+		std::string number = std::to_string(slot);
 		glUniform3fv(glGetUniformLocation(shader, ("pointLights[" + number + "].position").c_str()), 1, glm::value_ptr(lights[i].position));
 		glUniform1f(glGetUniformLocation(shader, ("pointLights[" + number + "].constant").c_str()), lights[i].constant);
 		glUniform1f(glGetUniformLocation(shader, ("pointLights[" + number + "].linear").c_str()), lights[i].linear);
@@ -105,54 +125,22 @@ static void setupQuadLightUniforms(unsigned int count, GLuint shader, PointLight
 		glUniform3fv(glGetUniformLocation(shader, ("pointLights[" + number + "].ambient").c_str()), 1, glm::value_ptr(lights[i].ambient));
 		glUniform3fv(glGetUniformLocation(shader, ("pointLights[" + number + "].diffuse").c_str()), 1, glm::value_ptr(lights[i].diffuse));
 		glUniform3fv(glGetUniformLocation(shader, ("pointLights[" + number + "].specular").c_str()), 1, glm::value_ptr(lights[i].specular));
-
-		float lightMax = std::fmaxf(std::fmaxf(lights[i].diffuse.r, lights[i].diffuse.g), lights[i].diffuse.b);
-		float radius = (-lights[i].linear + std::sqrtf(lights[i].linear * lights[i].linear - 4 * lights[i].quadratic * (lights[i].constant - lightMax / limit)))
-			/ (2 * lights[i].quadratic);
-		glUniform1f(glGetUniformLocation(shader, ("pointLights[" + number + "].radius").c_str()), radius);
+		glUniform1f(glGetUniformLocation(shader, ("pointLights[" + number + "].radius").c_str()), radii[i]);
 	}
 }
 
-static void setupLightAttributes(unsigned int count, GLuint vao, PointLight* lights)
+static void setupLightInstances(unsigned int count, const PointLight* lights, InstanceBuffer& outInstances)
 {
-	glm::mat4* modelMatrices = new glm::mat4[count];
+	std::vector<LightInstance> instances(count);
 	for (unsigned int i = 0; i < count; i++)
 	{
-		modelMatrices[i] = glm::translate(glm::mat4(1.0f), lights[i].position);
-		modelMatrices[i] = glm::scale(modelMatrices[i], glm::vec3(0.2f));
+		instances[i].position = lights[i].position;
+		instances[i].scale = glm::vec3(0.2f);
+		instances[i].color = lights[i].specular;
 	}
 
-	glm::vec3* colors = new glm::vec3[count];
-	for (unsigned int i = 0; i < count; i++)
-		colors[i] = lights[i].specular;
-
-	GLuint modelVBO;
-	glGenBuffers(1, &modelVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, modelVBO);
-	glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
-
-	GLuint colorVBO;
-	glGenBuffers(1, &colorVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
-	glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::vec3), &colors[0], GL_STATIC_DRAW);
-
-	glBindVertexArray(vao);
-
-	glBindBuffer(GL_ARRAY_BUFFER, modelVBO);
-	const unsigned int vecSize = sizeof(glm::vec4);
-	for (unsigned int i = 0; i < 4; i++)
-	{
-		glEnableVertexAttribArray(i + 3);
-		glVertexAttribPointer(i + 3, 4, GL_FLOAT, GL_FALSE, 4 * vecSize, (void*)(i * vecSize));
-		glVertexAttribDivisor(i + 3, 1);
-	}
-
-	glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
-	glEnableVertexAttribArray(7);
-	glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), 0);
-	glVertexAttribDivisor(7, 1);
-
-	glBindVertexArray(0);
+	const std::vector<unsigned char> packed = LightInstanceLayout::Pack(instances);
+	outInstances.Update(packed.data(), 0, count);
 }
 
 static void createGBuffer(GLuint* outFrame, GLuint* outPos, GLuint* outNormal, GLuint* outDiff, GLuint* outSpec)
@@ -189,88 +177,10 @@ static void createGBuffer(GLuint* outFrame, GLuint* outPos, GLuint* outNormal, G
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-static GLuint createVertexArray()
-{
-	GLuint vao;
-	glCreateVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), 0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	return vao;
-}
-
-static GLuint createCubeVertexArray()
-{
-	GLuint vbo;
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(CubeData::vertices), CubeData::vertices, GL_STATIC_DRAW);
-
-	GLuint vao = createVertexArray();
-
-	GLuint ebo;
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(CubeData::indices), CubeData::indices, GL_STATIC_DRAW);
-
-	return vao;
-}
-
-static GLuint createQuadVertexArray()
-{
-	static const float quadVertices[] =
-	{
-		-1.0f, -1.0f, 1.0f, 0.0f, 0.0f,
-		 1.0f, -1.0f, 1.0f, 1.0f, 0.0f,
-		 1.0f,  1.0f, 1.0f, 1.0f, 1.0f,
-		-1.0f,  1.0f, 1.0f, 0.0f, 1.0f,
-	};
-
-	static const unsigned int quadIndices[] =
-	{
-		0, 1, 2,
-		2, 3, 0
-	};
-
-	GLuint vbo;
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-
-	GLuint vao;
-	glCreateVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-
-	GLuint ebo;
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quadIndices), quadIndices, GL_STATIC_DRAW);
-
-	glBindVertexArray(0);
-
-	return vao;
-}
-
-static void drawCube(GLuint shader, GLuint vao)
-{
-	glUseProgram(shader);
-	glBindVertexArray(vao);
-	glDrawElements(GL_TRIANGLES, CubeData::indexCount, GL_UNSIGNED_INT, 0);
-}
-
-static void drawQuad(GLuint shader, GLuint vao)
+static void drawQuad(GLuint shader, const PrimitiveGeometry& quad, GLuint vao)
 {
 	glUseProgram(shader);
-	glBindVertexArray(vao);
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	Primitives::draw(quad, vao);
 }
 
 void TestDeferred()
@@ -291,7 +201,8 @@ void TestDeferred()
 
 	// Initialise shaders and load programs.
 	GLuint lightProgram;
-	Shader::loadProgram(lightProgram, "res/shaders/Deferred/VertexLight.glsl", "res/shaders/Deferred/FragmentLight.glsl");
+	Shader::loadLayoutProgram(lightProgram, "res/shaders/Deferred/VertexLight.glsl", "res/shaders/Deferred/FragmentLight.glsl",
+		LightInstanceLayout::GetGlslInputs());
 
 	GLuint deferProgram;
 	Shader::loadProgram(deferProgram, "res/shaders/VertexCore.glsl", "res/shaders/Deferred/FragmentDeferred.glsl");
@@ -299,9 +210,12 @@ void TestDeferred()
 	GLuint quadProgram;
 	Shader::loadProgram(quadProgram, "res/shaders/Frame/VertexQuad.glsl", "res/shaders/Deferred/FragmentQuad.glsl");
 
-	GLuint cubeVAO = createCubeVertexArray();
-	GLuint lightVAO = createCubeVertexArray();
-	GLuint quadVAO = createQuadVertexArray();
+	// both cube arrays share the cached cube buffers and differ in their instance attributes
+	const PrimitiveGeometry& cube = Primitives::get(PRIMITIVE_CUBE, 1);
+	GLuint cubeVAO = Primitives::createVertexArray(cube, PRIMITIVE_LAYOUT_MESH);
+	GLuint lightVAO = Primitives::createVertexArray(cube, PRIMITIVE_LAYOUT_MESH);
+	const PrimitiveGeometry& quad = Primitives::get(PRIMITIVE_QUAD, 1);
+	GLuint quadVAO = Primitives::createVertexArray(quad, PRIMITIVE_LAYOUT_PBR);
 
 	Camera camera(
 		glm::vec3(0.0f, 3.0f, 0.0f),
@@ -339,55 +253,110 @@ void TestDeferred()
 
 	PointLight* pointLights = new PointLight[count];
 	emplacePointLights(count, xDim, yDim, pointLights);
-	setupQuadLightUniforms(count, quadProgram, pointLights);
-	setupLightAttributes(count, lightVAO, pointLights);
-
-	setupModelMatrices(xDim, yDim, cubeVAO);
 
-	while (!glfwWindowShouldClose(window))
+	// scoped so the instance buffers release their GL objects while the context is alive
 	{
-		glfwPollEvents();
-		Handler::MaintainKeyboard(window);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, deferFBO);
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glEnable(GL_DEPTH_TEST);
-		glDisable(GL_FRAMEBUFFER_SRGB);
-
-		glm::mat4 view = std::move(camera.GetViewMatrix());
-		glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.2f, 50.0f);
-
-		glUseProgram(deferProgram);
-		glUniformMatrix4fv(glGetUniformLocation(deferProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(glGetUniformLocation(deferProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-
-		glBindVertexArray(cubeVAO);
-		glDrawElementsInstanced(GL_TRIANGLES, CubeData::indexCount, GL_UNSIGNED_INT, 0, xDim * yDim);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glEnable(GL_FRAMEBUFFER_SRGB);
-
-		glBindVertexArray(cubeVAO);
-		glDrawElementsInstanced(GL_TRIANGLES, CubeData::indexCount, GL_UNSIGNED_INT, 0, xDim * yDim);
-
-		glDisable(GL_DEPTH_TEST);
-		glUseProgram(quadProgram);
-		glUniform3fv(glGetUniformLocation(quadProgram, "viewPos"), 1, glm::value_ptr(camera.pos));
-		drawQuad(quadProgram, quadVAO);
+		InstanceBuffer lightInstances(LightInstanceLayout(), count);
+		setupLightInstances(count, pointLights, lightInstances);
+		lightInstances.Attach(lightVAO);
+
+		const std::vector<InstanceTransform> cubeTransforms = createCubeTransforms(xDim, yDim);
+		const std::vector<unsigned char> packedCubes = ModelInstanceLayout::Pack(cubeTransforms);
+		const size_t cubeStride = ModelInstanceLayout::GetStride();
+		InstanceBuffer cubeInstances(ModelInstanceLayout(), xDim * yDim);
+		cubeInstances.Attach(cubeVAO);
+
+		// One tree answers the frustum queries for the cubes and the lights' spheres of influence,
+		// and the picking ray.
+		AabbTree scene;
+		for (unsigned int i = 0; i < cubeTransforms.size(); i++)
+			scene.Insert(cubeTransforms[i].position - glm::vec3(0.5f), cubeTransforms[i].position + glm::vec3(0.5f), i, categoryCube);
+
+		std::vector<float> lightRadii(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			lightRadii[i] = getLightRadius(pointLights[i]);
+			scene.Insert(pointLights[i].position - glm::vec3(lightRadii[i]), pointLights[i].position + glm::vec3(lightRadii[i]), i, categoryLight);
+		}
 
-		glEnable(GL_DEPTH_TEST);
-		glUseProgram(lightProgram);
-		glUniformMatrix4fv(glGetUniformLocation(lightProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(glGetUniformLocation(lightProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+		std::vector<unsigned int> visibleCubes;
+		std::vector<unsigned int> visibleLights;
+		std::vector<unsigned char> visibleCubeData;
+		bool wasPressed = false;
 
-		glBindVertexArray(lightVAO);
-		glDrawElementsInstanced(GL_TRIANGLES, CubeData::indexCount, GL_UNSIGNED_INT, 0, count);
+		while (!glfwWindowShouldClose(window))
+		{
+			glfwPollEvents();
+			Handler::MaintainKeyboard(window);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, deferFBO);
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glEnable(GL_DEPTH_TEST);
+			glDisable(GL_FRAMEBUFFER_SRGB);
+
+			glm::mat4 view = std::move(camera.GetViewMatrix());
+			glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.2f, 50.0f);
+			const Frustum frustum(projection * view);
+
+			// visible cubes, packed into the start of the instance buffer
+			visibleCubes.clear();
+			scene.QueryFrustum(frustum, visibleCubes, categoryCube);
+			visibleCubeData.resize(visibleCubes.size() * cubeStride);
+			for (size_t i = 0; i < visibleCubes.size(); i++)
+				std::copy_n(&packedCubes[visibleCubes[i] * cubeStride], cubeStride, &visibleCubeData[i * cubeStride]);
+			cubeInstances.Update(visibleCubeData.data(), 0, visibleCubes.size());
+			const GLsizei cubeCount = (GLsizei)visibleCubes.size();
+
+			// lights whose sphere reaches into the view, the nearest ones if there are too many
+			visibleLights.clear();
+			scene.QueryFrustum(frustum, visibleLights, categoryLight);
+			std::sort(visibleLights.begin(), visibleLights.end(), [&](unsigned int a, unsigned int b)
+			{
+				return glm::length(pointLights[a].position - camera.pos) < glm::length(pointLights[b].position - camera.pos);
+			});
+			setupQuadLightUniforms(visibleLights, quadProgram, pointLights, lightRadii.data());
+
+			// pick the cube under the crosshair on click
+			const bool pressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+			RayHit hit;
+			if (pressed && !wasPressed && scene.RayCast(camera.pos, camera.front, 50.0f, hit, categoryCube))
+				std::cout << "[Info: TestDeferred] Picked cube " << hit.userData << " at " << hit.distance << "." << std::endl;
+			wasPressed = pressed;
+
+			glUseProgram(deferProgram);
+			glUniformMatrix4fv(glGetUniformLocation(deferProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+			glUniformMatrix4fv(glGetUniformLocation(deferProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+
+			Primitives::draw(cube, cubeVAO, cubeCount);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glEnable(GL_FRAMEBUFFER_SRGB);
+
+			Primitives::draw(cube, cubeVAO, cubeCount);
+
+			glDisable(GL_DEPTH_TEST);
+			glUseProgram(quadProgram);
+			glUniform3fv(glGetUniformLocation(quadProgram, "viewPos"), 1, glm::value_ptr(camera.pos));
+			drawQuad(quadProgram, quad, quadVAO);
+
+			glEnable(GL_DEPTH_TEST);
+			glUseProgram(lightProgram);
+			glUniformMatrix4fv(glGetUniformLocation(lightProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+			glUniformMatrix4fv(glGetUniformLocation(lightProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+
+			Primitives::draw(cube, lightVAO, count);
+
+			glfwSwapBuffers(window);
+			glFlush();
+		}
 
-		glfwSwapBuffers(window);
-		glFlush();
+		glDeleteVertexArrays(1, &cubeVAO);
+		glDeleteVertexArrays(1, &lightVAO);
+		glDeleteVertexArrays(1, &quadVAO);
+		Primitives::release();
 	}
 
 	glfwDestroyWindow(window);
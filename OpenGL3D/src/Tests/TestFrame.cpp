@@ -7,6 +7,8 @@
 #include "Shader.h"
 
 #include "StencilData.h"
+#include "StaticBatcher.h"
+#include "VertexLayout.h"
 
 static void createFrameBuffer(GLuint& framebuffer, GLuint& texColorBuffer)
 {
@@ -38,33 +40,38 @@ static void createFrameBuffer(GLuint& framebuffer, GLuint& texColorBuffer)
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-static GLuint createVertexArray()
+static GLuint createVertexArray(GLuint vbo)
 {
 	GLuint vao;
 	glCreateVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-	glBindVertexArray(0);
+	QuadVertexLayout::Setup(vao, vbo);
 	return vao;
 }
 
-static void drawCubes(GLuint shader, GLuint vao)
+static void buildCubes(StaticBatcher& outCubes)
 {
-	glUseProgram(shader);
-	glUniform1i(glGetUniformLocation(shader, "aTex"), 0);
+	const unsigned int cube = outCubes.AddMesh(StencilData::cubeVertices, sizeof(StencilData::cubeVertices) / sizeof(float),
+		StencilData::cubeIndices, sizeof(StencilData::cubeIndices) / sizeof(unsigned int));
 
-	glBindVertexArray(vao);
 	for (const glm::vec3& pos : StencilData::cubePositions)
 	{
 		glm::mat4 model(1.0f);
 		model = glm::translate(model, pos);
 		model = glm::translate(model, glm::vec3(2.5f, 0.0f, -5.0f));
-		glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		outCubes.AddInstance(cube, 0, model);
 	}
+
+	outCubes.Build<QuadVertexLayout>();
+}
+
+static void drawCubes(GLuint shader, const StaticBatcher& cubes)
+{
+	glm::mat4 model(1.0f);
+
+	glUseProgram(shader);
+	glUniform1i(glGetUniformLocation(shader, "aTex"), 0);
+	glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
+	cubes.Draw(0);
 }
 
 static void drawPlane(GLuint shader, GLuint vao)
@@ -119,123 +126,114 @@ void TestFrame()
 	GLuint quadProgram;
 	Shader::loadProgram(quadProgram, "res/shaders/frame/VertexQuad.glsl", "res/shaders/frame/FragmentQuad.glsl");
 
-	// cube
-	GLuint cubeVBO;
-	glGenBuffers(1, &cubeVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(StencilData::cubeVertices), StencilData::cubeVertices, GL_STATIC_DRAW);
-
-	GLuint cubeVAO = createVertexArray();
-	glBindVertexArray(cubeVAO);
-
-	GLuint cubeEBO;
-	glGenBuffers(1, &cubeEBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(StencilData::cubeIndices), StencilData::cubeIndices, GL_STATIC_DRAW);
-
-	glBindVertexArray(0);
-
-	// plane 
-	GLuint planeVBO;
-	glGenBuffers(1, &planeVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(StencilData::planeVertices), StencilData::planeVertices, GL_STATIC_DRAW);
-
-	GLuint planeVAO = createVertexArray();
-	glBindVertexArray(planeVAO);
-
-	GLuint planeEBO;
-	glGenBuffers(1, &planeEBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, planeEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(StencilData::planeIndices), StencilData::planeIndices, GL_STATIC_DRAW);
-
-	// quad
-	float quadVertices[] =
+	// scoped so the batches release their GL objects while the context is alive
 	{
-		-1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-		 1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-		 1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-		-1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-	};
+		// cubes, merged into one draw
+		StaticBatcher cubes;
+		buildCubes(cubes);
+
+		// plane 
+		GLuint planeVBO;
+		glGenBuffers(1, &planeVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(StencilData::planeVertices), StencilData::planeVertices, GL_STATIC_DRAW);
+
+		GLuint planeVAO = createVertexArray(planeVBO);
+		glBindVertexArray(planeVAO);
+
+		GLuint planeEBO;
+		glGenBuffers(1, &planeEBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, planeEBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(StencilData::planeIndices), StencilData::planeIndices, GL_STATIC_DRAW);
+
+		// quad
+		float quadVertices[] =
+		{
+			-1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+			 1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+			 1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+			-1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+		};
 
-	unsigned int quadIndices[] =
-	{
-		0, 1, 2,
-		2, 3, 0
-	};
+		unsigned int quadIndices[] =
+		{
+			0, 1, 2,
+			2, 3, 0
+		};
 
-	GLuint quadVBO;
-	glGenBuffers(1, &quadVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+		GLuint quadVBO;
+		glGenBuffers(1, &quadVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
 
-	GLuint quadVAO = createVertexArray();
-	glBindVertexArray(quadVAO);
+		GLuint quadVAO = createVertexArray(quadVBO);
+		glBindVertexArray(quadVAO);
 
-	GLuint quadEBO;
-	glGenBuffers(1, &quadEBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quadIndices), quadIndices, GL_STATIC_DRAW);
+		GLuint quadEBO;
+		glGenBuffers(1, &quadEBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quadIndices), quadIndices, GL_STATIC_DRAW);
 
-	glBindVertexArray(0);
+		glBindVertexArray(0);
 
-	// Initialise textures and materials.
-	stbi_set_flip_vertically_on_load(true);
+		// Initialise textures and materials.
+		stbi_set_flip_vertically_on_load(true);
 
-	Texture cubeTexture(TextureType::DIFFUSE, 0, "res/textures/container.jpg", false);
-	Texture floorTexture(TextureType::DIFFUSE, 1, "res/textures/tile.png", true);
+		Texture cubeTexture(TextureType::DIFFUSE, 0, "res/textures/container.jpg", false);
+		Texture floorTexture(TextureType::DIFFUSE, 1, "res/textures/tile.png", true);
 
-	// Initialise window state.
-	Camera camera(
-		glm::vec3(0.0f, 0.0f, 3.0f),
-		glm::vec3(0.0f, 1.0f, 0.0f),
-		-90.0f,
-		0.0f
-	);
+		// Initialise window state.
+		Camera camera(
+			glm::vec3(0.0f, 0.0f, 3.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f),
+			-90.0f,
+			0.0f
+		);
 
-	bool spotlightOn = true;
+		bool spotlightOn = true;
 
-	Handler handler(window, camera, spotlightOn);
+		Handler handler(window, camera, spotlightOn);
 
-	while (!glfwWindowShouldClose(window))
-	{
-		glfwPollEvents();
-		Handler::MaintainKeyboard(window);
+		while (!glfwWindowShouldClose(window))
+		{
+			glfwPollEvents();
+			Handler::MaintainKeyboard(window);
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT);
 
-		glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.1f, 100.0f);
+			glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.1f, 100.0f);
 
-		for (unsigned int i = 0; i < 2; i++)
-		{
-			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			glEnable(GL_DEPTH_TEST);
+			for (unsigned int i = 0; i < 2; i++)
+			{
+				glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+				glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				glEnable(GL_DEPTH_TEST);
 
-			glm::mat4 view = std::move(camera.GetViewMatrix());
+				glm::mat4 view = std::move(camera.GetViewMatrix());
 			
-			glUseProgram(coreProgram);
-			glUniformMatrix4fv(glGetUniformLocation(coreProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-			glUniformMatrix4fv(glGetUniformLocation(coreProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+				glUseProgram(coreProgram);
+				glUniformMatrix4fv(glGetUniformLocation(coreProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+				glUniformMatrix4fv(glGetUniformLocation(coreProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
-			drawCubes(coreProgram, cubeVAO);
-			drawPlane(coreProgram, planeVAO);
+				drawCubes(coreProgram, cubes);
+				drawPlane(coreProgram, planeVAO);
 
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
-			glDisable(GL_DEPTH_TEST);
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+				glDisable(GL_DEPTH_TEST);
 
-			glActiveTexture(GL_TEXTURE2);
-			glBindTexture(GL_TEXTURE_2D, colorbuffer);
-			drawQuad(quadProgram, quadVAO, modes[i], scales[i]);
+				glActiveTexture(GL_TEXTURE2);
+				glBindTexture(GL_TEXTURE_2D, colorbuffer);
+				drawQuad(quadProgram, quadVAO, modes[i], scales[i]);
 
-			camera.front *= -1.0f;
-		}
+				camera.front *= -1.0f;
+			}
 
-		glfwSwapBuffers(window);
-		glFlush();
+			glfwSwapBuffers(window);
+			glFlush();
+		}
 	}
 
 	glfwDestroyWindow(window);
@@ -0,0 +1,90 @@
+#include "pch.h"
+
+#include <iostream>
+#include "Utility.h"
+
+#include "Camera.h"
+#include "Handler.h"
+#include "Shader.h"
+#include "GltfModel.h"
+#include "LightData.h"
+
+static void setLightUniforms(GLuint shader)
+{
+	glUseProgram(shader);
+
+	for (unsigned int i = 0; i < COUNT_POINT_LIGHT; i++)
+	{
+		glUniform3fv(glGetUniformLocation(shader, ("lights[" + std::to_string(i) + "].color").c_str()),
+			1, glm::value_ptr(2.0f * LightData::pointLights[i].specular));
+		glUniform3fv(glGetUniformLocation(shader, ("lights[" + std::to_string(i) + "].pos").c_str()),
+			1, glm::value_ptr(LightData::pointLights[i].position));
+	}
+}
+
+void TestGltf()
+{
+	GLFWwindow* window = Utility::setupGLFW();
+	Utility::setupGLEW();
+
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_BACK);
+	glFrontFace(GL_CCW);
+	glEnable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	// same PBR fragment stage as TestPBR, vertex stage reads glTF's vec4 tangents
+	GLuint coreProgram;
+	Shader::loadProgram(coreProgram, "res/shaders/PBR/VertexGltf.glsl", "res/shaders/PBR/FragmentCore.glsl");
+	setLightUniforms(coreProgram);
+
+	// scoped so the model releases its GL objects while the context is alive
+	{
+		GltfModel model("res/models/DamagedHelmet/DamagedHelmet.glb");
+		if (!model.IsLoaded())
+			std::cerr << "[Error: TestGltf] Could not load the model." << std::endl;
+
+		Camera camera(
+			glm::vec3(0.0f, 0.0f, 3.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f),
+			-90.0f,
+			0.0f
+		);
+
+		bool spotlightOn = true;
+
+		Handler handler(window, camera, spotlightOn);
+
+		while (!glfwWindowShouldClose(window))
+		{
+			glfwPollEvents();
+			Handler::MaintainKeyboard(window);
+
+			// textures stream in while the geometry is already drawn with the material factors
+			model.Update();
+
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			glm::mat4 view = camera.GetViewMatrix();
+			glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.1f, 50.0f);
+
+			glUseProgram(coreProgram);
+			glUniform1i(glGetUniformLocation(coreProgram, "showNormal"), glfwGetKey(window, GLFW_KEY_0) == GLFW_PRESS);
+			glUniform1i(glGetUniformLocation(coreProgram, "normalMapping"), !(glfwGetKey(window, GLFW_KEY_9) == GLFW_PRESS));
+			glUniform3fv(glGetUniformLocation(coreProgram, "camPos"), 1, glm::value_ptr(camera.pos));
+			glUniformMatrix4fv(glGetUniformLocation(coreProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+			glUniformMatrix4fv(glGetUniformLocation(coreProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+
+			model.Draw(coreProgram);
+
+			glfwSwapBuffers(window);
+			glFlush();
+		}
+	}
+
+	glDeleteProgram(coreProgram);
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+}
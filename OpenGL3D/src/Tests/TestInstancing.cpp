@@ -1,16 +1,59 @@
 #include "pch.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
 #include "Utility.h"
 #include "Camera.h"
 #include "Handler.h"
 #include "Texture.h"
 #include "Model.h"
+#include "InstanceCuller.h"
+#include "BeltSimulation.h"
+#include "DrawDataBuffer.h"
+#include "HiZPyramid.h"
+#include "Impostor.h"
+#include "FrustumCuller.h"
+#include "OcclusionRasterizer.h"
+#include "MappedInstanceBuffer.h"
+#include "Primitives.h"
+#include "RenderQueue.h"
 #include "Shader.h"
 
 #include "CubeData.h"
 #include "LightData.h"
 
 
+// color and a sampleable depth texture, for the occlusion pyramid
+static void createSceneFramebuffer(GLuint& framebuffer, GLuint& colorTexture, GLuint& depthTexture)
+{
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	glGenTextures(1, &colorTexture);
+	glBindTexture(GL_TEXTURE_2D, colorTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 800, 600, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+
+	glGenTextures(1, &depthTexture);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, 800, 600, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "[Error: createSceneFramebuffer] Framebuffer is not complete!" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
 static GLuint loadCubeMap(unsigned int textureUnit)
 {
 	static const std::string faces[] =
@@ -76,6 +119,75 @@ static GLuint createCubeVertexArray()
 	return vao;
 }
 
+static void queueLights(RenderQueue& queue, GLuint shader, GLuint vao)
+{
+	RenderPacket packet;
+	packet.program = shader;
+	packet.vao = vao;
+	packet.indexCount = CubeData::indexCount;
+
+	for (int i = 0; i < COUNT_POINT_LIGHT; i++)
+	{
+		const PointLight& pointLight = LightData::pointLights[i];
+		packet.model = glm::translate(glm::mat4(1.0f), pointLight.position);
+		packet.model = glm::scale(packet.model, glm::vec3(0.2f));
+		packet.color = glm::vec4(pointLight.specular, 1.0f);
+		queue.Add(packet);
+	}
+}
+
+// point, directional and spot lights of the scene, shared by the mesh and impostor programs
+static void setLightUniforms(GLuint program, const Camera& camera, bool spotlightOn)
+{
+	glUseProgram(program);
+
+	for (int i = 0; i < COUNT_POINT_LIGHT; i++)
+	{
+		const PointLight& pointLight = LightData::pointLights[i];
+
+		std::string number = std::to_string(i);
+		glUniform3fv(glGetUniformLocation(program, ("pointLights[" + number + "].position").c_str()), 1, glm::value_ptr(pointLight.position));
+		glUniform1f(glGetUniformLocation(program, ("pointLights[" + number + "].constant").c_str()), pointLight.constant);
+		glUniform1f(glGetUniformLocation(program, ("pointLights[" + number + "].linear").c_str()), pointLight.linear);
+		glUniform1f(glGetUniformLocation(program, ("pointLights[" + number + "].quadratic").c_str()), pointLight.quadratic);
+		glUniform3fv(glGetUniformLocation(program, ("pointLights[" + number + "].ambient").c_str()), 1, glm::value_ptr(pointLight.ambient));
+		glUniform3fv(glGetUniformLocation(program, ("pointLights[" + number + "].diffuse").c_str()), 1, glm::value_ptr(pointLight.diffuse));
+		glUniform3fv(glGetUniformLocation(program, ("pointLights[" + number + "].specular").c_str()), 1, glm::value_ptr(pointLight.specular));
+	}
+
+	glUniform3f(glGetUniformLocation(program, "pointLights[0].ambient"), 0.2f, 0.03f, 0.03f);
+	glUniform1f(glGetUniformLocation(program, "pointLights[0].constant"), 0.8f);
+	glUniform1f(glGetUniformLocation(program, "pointLights[0].linear"), 0.001f);
+	glUniform1f(glGetUniformLocation(program, "pointLights[0].quadratic"), 0.0f);
+
+	glUniform3fv(glGetUniformLocation(program, "viewPos"), 1, glm::value_ptr(camera.pos));
+
+	glUniform3f(glGetUniformLocation(program, ("dirLight.direction")), -1.0f, -1.0f, -1.0f);
+	//glUniform3f(glGetUniformLocation(program, ("dirLight.ambient")), 0.06f, 0.02f, 0.2f);
+	//glUniform3f(glGetUniformLocation(program, ("dirLight.diffuse")), 0.15f, 0.05f, 0.5f);
+	//glUniform3f(glGetUniformLocation(program, ("dirLight.specular")), 0.21f, 0.07f, 0.7f);
+
+	glUniform3f(glGetUniformLocation(program, ("dirLight.ambient")), 0.0f, 0.0f, 0.0f);
+	glUniform3f(glGetUniformLocation(program, ("dirLight.diffuse")), 0.0f, 0.0f, 0.0f);
+	glUniform3f(glGetUniformLocation(program, ("dirLight.specular")), 0.0f, 0.0f, 0.0f);
+
+	glUniform3fv(glGetUniformLocation(program, ("spotlight.position")), 1, glm::value_ptr(camera.pos));
+	glUniform3fv(glGetUniformLocation(program, ("spotlight.direction")), 1, glm::value_ptr(camera.front));
+
+	glUniform3f(glGetUniformLocation(program, ("spotlight.ambient")), 0.05f, 0.05f, 0.05f);
+	glUniform3f(glGetUniformLocation(program, ("spotlight.diffuse")), 0.5f, 0.5f, 0.5f);
+	glUniform3f(glGetUniformLocation(program, ("spotlight.specular")), 0.9f, 0.9f, 0.9f);
+
+	glUniform1f(glGetUniformLocation(program, ("spotlight.constant")), 1.0f);
+	glUniform1f(glGetUniformLocation(program, ("spotlight.linear")), 0.09f);
+	glUniform1f(glGetUniformLocation(program, ("spotlight.quadratic")), 0.032f);
+
+	glUniform1f(glGetUniformLocation(program, ("spotlight.cutOff")), glm::cos(glm::radians(12.5f)));
+	glUniform1f(glGetUniformLocation(program, ("spotlight.outerCutOff")), glm::cos(glm::radians(17.5f)));
+
+	glUniform1i(glGetUniformLocation(program, ("spotlight.on")), spotlightOn);
+}
+
 static float getDisplacement()
 {
 	// [0 -> 200a] / 100 - a => [-a, a] 
@@ -102,214 +214,355 @@ void TestInstancing()
 	Shader::loadProgram(coreProgram, "res/shaders/VertexCore.glsl", "res/shaders/FragmentCore.glsl");
 
 	GLuint lightProgram;
-	Shader::loadProgram(lightProgram, "res/shaders/VertexCore.glsl", "res/shaders/FragmentLight.glsl");
+	Shader::loadProgram(lightProgram, "res/shaders/DrawData/VertexLight.glsl", "res/shaders/DrawData/FragmentLight.glsl");
 
 	GLuint skyProgram;
 	Shader::loadProgram(skyProgram, "res/shaders/CubeMap/VertexCubeMap.glsl", "res/shaders/CubeMap/FragmentCubeMap.glsl");
 
 	GLuint vao = createCubeVertexArray();
 
-	// Initialise textures and materials.
-	stbi_set_flip_vertically_on_load(false);
-
-	// Initialise window state.
-	Camera camera(
-		glm::vec3(0.0f, 0.0f, 30.0f),
-		glm::vec3(0.0f, 1.0f, 0.0f),
-		-90.0f,
-		0.0f
-	);
-
-	bool spotlightOn = false;
-
-	Handler handler(window, camera, spotlightOn);
-
-	// model matrices
-	const unsigned int count = 60000;
-	glm::mat4* modelMatrices = new glm::mat4[count];
-	srand(glfwGetTime());
-	const float radius = 100.0f;
-	for (unsigned int i = 0; i < count; i++)
+	// scoped so the buffers, cullers, simulation and impostor release their GL objects while the context is alive
 	{
-		glm::mat4 model(1.0f);
-
-		float angle = (float)i / (float)count * 360.0f;
-		glm::vec3 position(
-			sin(angle) * radius + getDisplacement(),
-			0.4f * getDisplacement(),
-			cos(angle) * radius + getDisplacement()
+		// the light cubes, sorted into as few draws as their state allows
+		RenderQueue queue;
+		DrawDataBuffer draws(COUNT_POINT_LIGHT);
+		draws.Attach(vao);
+
+		// Initialise textures and materials.
+		stbi_set_flip_vertically_on_load(false);
+
+		// Initialise window state.
+		Camera camera(
+			glm::vec3(0.0f, 0.0f, 30.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f),
+			-90.0f,
+			0.0f
 		);
-		model = glm::translate(model, position);
-
-		// [0, 20] / 100 + 0.05 => [0.05, 0.25]
-		float scale = (rand() % 20 / 100.0f + 0.05f);
-		model = glm::scale(model, glm::vec3(scale));
-
-		float rotAngle = (rand() % 360);
-		model = glm::rotate(model, glm::radians(rotAngle), glm::vec3(0.4f, 0.6f, 0.8f));
-
-		modelMatrices[i] = model;
-	}
-	
-	Model planetObj("C:/Users/binma/Downloads/planet/planet.obj");
-
-
-	// rock
-	Model rockObj("C:/Users/binma/Downloads/rock/rock.obj");
-	Texture rockDiff(TextureType::DIFFUSE, 0, "C:/Users/binma/Downloads/rock/rock.png", false);
-	Texture rockSpec(TextureType::SPECULAR, 1, "C:/Users/binma/Downloads/rock/rock.png", false);
-
-	GLuint modelVBO;
-	glGenBuffers(1, &modelVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, modelVBO);
-	glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
-
-	// skybox
-	unsigned int cubeMapTexture = loadCubeMap(2);
 
-	for (unsigned int i = 0; i < rockObj.meshes.size(); i++)
-	{
-		GLuint modelVAO = rockObj.meshes[i].vao;
-		glBindVertexArray(modelVAO);
-
-		std::size_t vec4Size = sizeof(glm::vec4);
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)0);
-		glEnableVertexAttribArray(4);
-		glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(1 * vec4Size));
-		glEnableVertexAttribArray(5);
-		glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(2 * vec4Size));
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(3 * vec4Size));
-
-		glVertexAttribDivisor(3, 1);
-		glVertexAttribDivisor(4, 1);
-		glVertexAttribDivisor(5, 1);
-		glVertexAttribDivisor(6, 1);
-
-		glBindVertexArray(0);
-	}
-
-	while (!glfwWindowShouldClose(window))
-	{
-		glfwPollEvents();
-		Handler::MaintainKeyboard(window);
-
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-		glCullFace(GL_BACK);
+		bool spotlightOn = false;
 
-		glBindVertexArray(vao);
+		Handler handler(window, camera, spotlightOn);
 
-		glm::mat4 view = std::move(camera.GetViewMatrix());
-		glm::mat4 skyView = glm::mat4(glm::mat3(view));
-		glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.1f, 200.0f);
-
-		for (int i = 0; i < COUNT_POINT_LIGHT; i++)
+		// rock transforms
+		const unsigned int count = 60000;
+		const unsigned int rockLodCount = 4;
+		const float lodPixelError = 1.0f;
+		std::vector<InstanceTransform> rockTransforms(count);
+		srand(glfwGetTime());
+		const float radius = 100.0f;
+		for (unsigned int i = 0; i < count; i++)
 		{
-			const PointLight& pointLight = LightData::pointLights[i];
-
-			// ************ LIGHT ************ //
-			glUseProgram(lightProgram);
-
-			glm::mat4 model = glm::translate(glm::mat4(1.0f), pointLight.position);
-			model = glm::scale(model, glm::vec3(0.2f));
-			glUniformMatrix4fv(glGetUniformLocation(lightProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-			glUniformMatrix4fv(glGetUniformLocation(lightProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-			glUniformMatrix4fv(glGetUniformLocation(lightProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-
-			glUniform3fv(glGetUniformLocation(lightProgram, "lightColor"), 1, glm::value_ptr(pointLight.specular));
-
-			glDrawElements(GL_TRIANGLES, CubeData::indexCount, GL_UNSIGNED_INT, 0);
+			float angle = (float)i / (float)count * 360.0f;
+			rockTransforms[i].position = glm::vec3(
+				sin(angle) * radius + getDisplacement(),
+				0.4f * getDisplacement(),
+				cos(angle) * radius + getDisplacement()
+			);
 
-			// ************ CORE ************ //
-			glUseProgram(coreProgram);
+			// [0, 20] / 100 + 0.05 => [0.05, 0.25]
+			float scale = (rand() % 20 / 100.0f + 0.05f);
+			rockTransforms[i].scale = glm::vec3(scale);
 
-			std::string number = std::to_string(i);
-			glUniform3fv(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].position").c_str()), 1, glm::value_ptr(pointLight.position));
-			glUniform1f(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].constant").c_str()), pointLight.constant);
-			glUniform1f(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].linear").c_str()), pointLight.linear);
-			glUniform1f(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].quadratic").c_str()), pointLight.quadratic);
-			glUniform3fv(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].ambient").c_str()), 1, glm::value_ptr(pointLight.ambient));
-			glUniform3fv(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].diffuse").c_str()), 1, glm::value_ptr(pointLight.diffuse));
-			glUniform3fv(glGetUniformLocation(coreProgram, ("pointLights[" + number + "].specular").c_str()), 1, glm::value_ptr(pointLight.specular));
+			float rotAngle = (rand() % 360);
+			rockTransforms[i].rotation = glm::angleAxis(glm::radians(rotAngle), glm::normalize(glm::vec3(0.4f, 0.6f, 0.8f)));
 		}
+	
+		Model planetObj("C:/Users/binma/Downloads/planet/planet.obj");
+		const glm::mat4 planetModel = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -6.0f)), glm::vec3(3.0f));
+		const glm::vec4 planetBounds = planetObj.meshes[0].boundingSphere;
+
+
+		// rock
+		Model rockObj("C:/Users/binma/Downloads/rock/rock.obj", rockLodCount);
+		Texture rockDiff(TextureType::DIFFUSE, 0, "C:/Users/binma/Downloads/rock/rock.png", false);
+		Texture rockSpec(TextureType::SPECULAR, 1, "C:/Users/binma/Downloads/rock/rock.png", false);
+
+		Mesh& rockMesh = rockObj.meshes[0];
+
+		// The rocks take one of two paths, switched at runtime with G. With compute shaders the belt
+		// is in orbit, simulated and culled on the GPU. The CPU path culls on the worker threads and
+		// draws the far rocks as impostors, which the GPU culler has no level for. It draws the static
+		// belt of rockTransforms rather than the simulated one, which is seeded with its own orbits
+		// and whose transforms never leave the GPU.
+		const float impostorFadeStart = 56.0f;
+		const float impostorFadeEnd = 64.0f;
+		const bool computeAvailable = GLEW_VERSION_4_3 != 0;
+		const bool simulateBelt = computeAvailable;
+		bool computeCulling = computeAvailable;
+		if (computeAvailable)
+			handler.SetToggle(computeCulling);
+
+		// Static rocks are uploaded once; the culler picks the visible ones and their levels on the
+		// GPU every frame. Simulated rocks are written by the simulation and never uploaded.
+		const std::vector<unsigned char> packedRocks = ModelInstanceLayout::Pack(rockTransforms);
+		InstanceBuffer rocks(ModelInstanceLayout(), count);
+		BeltSimulation belt;
+		if (simulateBelt)
+		{
+			BeltParameters parameters;
+			parameters.center = glm::vec3(planetModel * glm::vec4(glm::vec3(planetBounds), 1.0f));
+			parameters.innerRadius = radius - 30.0f;
+			parameters.outerRadius = radius + 30.0f;
+			// the planet is scaled by 3
+			parameters.collider = glm::vec4(parameters.center, 3.0f * planetBounds.w);
+			parameters.bodyRadius = rockMesh.boundingSphere.w;
+			parameters.seed = (unsigned int)rand();
+			belt.Setup(rocks, count, parameters);
+		}
+		else
+			rocks.Update(packedRocks.data(), 0, count);
 
-		glUniform3f(glGetUniformLocation(coreProgram, "pointLights[0].ambient"), 0.2f, 0.03f, 0.03f);
-		glUniform1f(glGetUniformLocation(coreProgram, "pointLights[0].constant"), 0.8f);
-		glUniform1f(glGetUniformLocation(coreProgram, "pointLights[0].linear"), 0.001f);
-		glUniform1f(glGetUniformLocation(coreProgram, "pointLights[0].quadratic"), 0.0f);
-
-		glUseProgram(coreProgram);
+		InstanceCuller rockCuller;
+		if (computeAvailable)
+			rockCuller.Setup(rockMesh, rocks, lodPixelError);
 
-		glUniform3fv(glGetUniformLocation(coreProgram, "viewPos"), 1, glm::value_ptr(camera.pos));
+		// The planet and the rocks drawn early (visible last frame) occlude the rest: the scene goes
+		// to its own framebuffer so that its depth can be reduced into the pyramid mid-frame.
+		GLuint sceneFBO = 0, sceneColor = 0, sceneDepth = 0;
+		HiZPyramid pyramid;
+		if (computeAvailable)
+		{
+			createSceneFramebuffer(sceneFBO, sceneColor, sceneDepth);
+			pyramid.Create(800, 600);
+		}
 
-		glUniform3f(glGetUniformLocation(coreProgram, ("dirLight.direction")), -1.0f, -1.0f, -1.0f);
-		//glUniform3f(glGetUniformLocation(coreProgram, ("dirLight.ambient")), 0.06f, 0.02f, 0.2f);
-		//glUniform3f(glGetUniformLocation(coreProgram, ("dirLight.diffuse")), 0.15f, 0.05f, 0.5f);
-		//glUniform3f(glGetUniformLocation(coreProgram, ("dirLight.specular")), 0.21f, 0.07f, 0.7f);
+		// On the CPU path the rocks are culled on the worker threads, and the visible ones are copied
+		// into a mapped buffer grouped by level, impostors last. Rocks within the fade range are in a
+		// level and among the impostors, hence the room for twice the count.
+		SphereBounds rockBounds;
+		for (const InstanceTransform& transform : rockTransforms)
+		{
+			const glm::vec3 center = transform.position + transform.rotation * (glm::vec3(rockMesh.boundingSphere) * transform.scale);
+			rockBounds.Add(center, rockMesh.boundingSphere.w * std::max(transform.scale.x, std::max(transform.scale.y, transform.scale.z)));
+		}
 
-		glUniform3f(glGetUniformLocation(coreProgram, ("dirLight.ambient")), 0.0f, 0.0f, 0.0f);
-		glUniform3f(glGetUniformLocation(coreProgram, ("dirLight.diffuse")), 0.0f, 0.0f, 0.0f);
-		glUniform3f(glGetUniformLocation(coreProgram, ("dirLight.specular")), 0.0f, 0.0f, 0.0f);
+		// The planet hides the rocks behind it: an icosphere a little inside its bounding sphere is
+		// rasterized on the CPU and the rocks that pass the frustum are tested against it as boxes.
+		BoxBounds rockBoxes;
+		for (size_t i = 0; i < rockBounds.GetCount(); i++)
+		{
+			const glm::vec3 center(rockBounds.x[i], rockBounds.y[i], rockBounds.z[i]);
+			rockBoxes.Add(center - glm::vec3(rockBounds.radius[i]), center + glm::vec3(rockBounds.radius[i]));
+		}
 
-		glUniform3fv(glGetUniformLocation(coreProgram, ("spotlight.position")), 1, glm::value_ptr(camera.pos));
-		glUniform3fv(glGetUniformLocation(coreProgram, ("spotlight.direction")), 1, glm::value_ptr(camera.front));
+		PrimitiveMesh planetSphere;
+		Primitives::generate(PRIMITIVE_ICOSPHERE, 2, planetSphere);
+		std::vector<glm::vec3> planetOccluder;
+		for (const PrimitiveVertex& vertex : planetSphere.vertices)
+			planetOccluder.push_back(vertex.pos);
+		const glm::mat4 planetOccluderModel = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(planetBounds)), glm::vec3(planetBounds.w * 0.95f));
+
+		FrustumCuller frustumCuller;
+		OcclusionRasterizer occlusionRasterizer;
+		std::vector<unsigned int> visibleRocks(count);
+		std::vector<unsigned int> rockLods(count);
+		std::vector<unsigned char> rockImpostors(count);
+		MappedInstanceBuffer mappedRocks(ModelInstanceLayout(), 2 * count);
+		Impostor rockImpostor;
+		if (rockImpostor.Bake(rockMesh, rockDiff.id))
+			mappedRocks.Attach(rockImpostor.GetVertexArray());
+		const bool impostorsReady = rockImpostor.GetProgram() != 0;
+
+		size_t cpuFrustumCount = 0;
+		size_t cpuVisibleCount = 0;
+		unsigned int cpuImpostorCount = 0;
+		double cpuCullMs = 0.0;
+		double lastReport = glfwGetTime();
+		double lastFrame = lastReport;
 
-		glUniform3f(glGetUniformLocation(coreProgram, ("spotlight.ambient")), 0.05f, 0.05f, 0.05f);
-		glUniform3f(glGetUniformLocation(coreProgram, ("spotlight.diffuse")), 0.5f, 0.5f, 0.5f);
-		glUniform3f(glGetUniformLocation(coreProgram, ("spotlight.specular")), 0.9f, 0.9f, 0.9f);
+		// skybox
+		unsigned int cubeMapTexture = loadCubeMap(2);
 
-		glUniform1f(glGetUniformLocation(coreProgram, ("spotlight.constant")), 1.0f);
-		glUniform1f(glGetUniformLocation(coreProgram, ("spotlight.linear")), 0.09f);
-		glUniform1f(glGetUniformLocation(coreProgram, ("spotlight.quadratic")), 0.032f);
+		while (!glfwWindowShouldClose(window))
+		{
+			glfwPollEvents();
+			Handler::MaintainKeyboard(window);
 
-		glUniform1f(glGetUniformLocation(coreProgram, ("spotlight.cutOff")), glm::cos(glm::radians(12.5f)));
-		glUniform1f(glGetUniformLocation(coreProgram, ("spotlight.outerCutOff")), glm::cos(glm::radians(17.5f)));
+			glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+			glCullFace(GL_BACK);
 
-		glUniform1i(glGetUniformLocation(coreProgram, ("spotlight.on")), spotlightOn);
+			glBindVertexArray(vao);
 
-		glm::mat4 model(1.0f);
-		model = glm::translate(model, glm::vec3(0.0f, 0.0f, -6.0f));
-		model = glm::scale(model, glm::vec3(3.0f, 3.0f, 3.0f));
+			glm::mat4 view = std::move(camera.GetViewMatrix());
+			glm::mat4 skyView = glm::mat4(glm::mat3(view));
+			glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.1f, 200.0f);
 
-		glUseProgram(coreProgram);
-		glUniformMatrix4fv(glGetUniformLocation(coreProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-		glUniformMatrix4fv(glGetUniformLocation(coreProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(glGetUniformLocation(coreProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-		glUniform1i(glGetUniformLocation(coreProgram, "instanced"), 0);
+			// ************ LIGHTS ************ //
+			glUseProgram(lightProgram);
+			glUniformMatrix4fv(glGetUniformLocation(lightProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+			glUniformMatrix4fv(glGetUniformLocation(lightProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
-		planetObj.Draw(coreProgram);
+			queue.Begin(camera.pos);
+			queueLights(queue, lightProgram, vao);
+			draws.Begin();
+			queue.Flush(draws);
+			draws.End();
 
-		rockDiff.changeUnit(0);
-		glUniform1i(glGetUniformLocation(coreProgram, "material.diffuse"), 0);
-		rockSpec.changeUnit(1);
-		glUniform1i(glGetUniformLocation(coreProgram, "material.specular"), 1);
+			setLightUniforms(coreProgram, camera, spotlightOn);
+			glUniform2f(glGetUniformLocation(coreProgram, "fadeRange"), 0.0f, 0.0f);
 
-		glUniform1i(glGetUniformLocation(coreProgram, "instanced"), 1);
+			const glm::mat4 model = planetModel;
 
-		for (unsigned int i = 0; i < rockObj.meshes.size(); i++)
-		{
-			glBindVertexArray(rockObj.meshes[i].vao);
-			glDrawElementsInstanced(
-				GL_TRIANGLES, rockObj.meshes[i].indices.size(), GL_UNSIGNED_INT, 0, count
-			);
+			glUseProgram(coreProgram);
+			glUniformMatrix4fv(glGetUniformLocation(coreProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
+			glUniformMatrix4fv(glGetUniformLocation(coreProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+			glUniformMatrix4fv(glGetUniformLocation(coreProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+			glUniform1i(glGetUniformLocation(coreProgram, "instanced"), 0);
+
+			planetObj.Draw(coreProgram);
+
+			rockDiff.changeUnit(0);
+			glUniform1i(glGetUniformLocation(coreProgram, "material.diffuse"), 0);
+			rockSpec.changeUnit(1);
+			glUniform1i(glGetUniformLocation(coreProgram, "material.specular"), 1);
+
+			glUniform1i(glGetUniformLocation(coreProgram, "instanced"), 1);
+
+			const double frameTime = glfwGetTime();
+			const float deltaTime = (float)(frameTime - lastFrame);
+			lastFrame = frameTime;
+
+			if (computeCulling)
+			{
+				if (simulateBelt)
+					belt.Step(deltaTime);
+
+				rockCuller.CullEarly(projection * view, camera.pos, glm::radians(camera.fov), 600.0f);
+				rockCuller.Draw(coreProgram);
+
+				pyramid.Build(sceneDepth);
+				rockCuller.CullLate(pyramid);
+				rockCuller.Draw(coreProgram);
+			}
+			else
+			{
+				const auto cullStart = std::chrono::high_resolution_clock::now();
+				cpuFrustumCount = frustumCuller.CullSpheres(camera.GetFrustum(800.0f / 600.0f, 0.1f, 200.0f), rockBounds, visibleRocks.data());
+
+				occlusionRasterizer.Begin(projection * view);
+				occlusionRasterizer.AddOccluder(planetOccluder, planetSphere.indices, model * planetOccluderModel);
+				occlusionRasterizer.Rasterize();
+				cpuVisibleCount = occlusionRasterizer.CullBoxes(rockBoxes, visibleRocks.data(), cpuFrustumCount, visibleRocks.data());
+
+				// rocks whose fragments may lie nearer than the end of the fade keep their mesh, those
+				// that may lie beyond its start get an impostor; within the band they get both
+				const float fovY = glm::radians(camera.fov);
+				const float meshDistance = impostorsReady ? impostorFadeEnd : FLT_MAX;
+				const float impostorDistance = impostorsReady ? impostorFadeStart : FLT_MAX;
+				const unsigned int noLod = ~0u;
+				unsigned int lodCounts[rockLodCount] = {};
+				unsigned int lodOffsets[rockLodCount];
+				for (size_t v = 0; v < cpuVisibleCount; v++)
+				{
+					const unsigned int i = visibleRocks[v];
+					const float distance = glm::length(glm::vec3(rockBounds.x[i], rockBounds.y[i], rockBounds.z[i]) - camera.pos);
+					rockLods[i] = noLod;
+					if (distance - rockBounds.radius[i] < meshDistance)
+					{
+						rockLods[i] = rockMesh.SelectLod(distance, fovY, 600.0f, lodPixelError, rockTransforms[i].scale.x);
+						lodCounts[rockLods[i]]++;
+					}
+					rockImpostors[i] = distance + rockBounds.radius[i] > impostorDistance;
+				}
+
+				unsigned int offset = 0;
+				for (unsigned int l = 0; l < rockLodCount; l++)
+				{
+					lodOffsets[l] = offset;
+					offset += lodCounts[l];
+					lodCounts[l] = 0;
+				}
+				const unsigned int impostorOffset = offset;
+				unsigned int impostorCount = 0;
+
+				const size_t stride = mappedRocks.GetStride();
+				unsigned char* out = mappedRocks.Map();
+				for (size_t v = 0; v < cpuVisibleCount; v++)
+				{
+					const unsigned int i = visibleRocks[v];
+					if (rockLods[i] != noLod)
+					{
+						const size_t slot = lodOffsets[rockLods[i]] + lodCounts[rockLods[i]]++;
+						std::memcpy(out + slot * stride, &packedRocks[i * stride], stride);
+					}
+					if (rockImpostors[i])
+					{
+						const size_t slot = impostorOffset + impostorCount++;
+						std::memcpy(out + slot * stride, &packedRocks[i * stride], stride);
+					}
+				}
+				cpuCullMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - cullStart).count();
+				cpuImpostorCount = impostorCount;
+
+				// the GPU culler attaches its own instances to the rock's vertex array when it draws
+				mappedRocks.Attach(rockMesh.vao);
+				if (impostorsReady)
+					glUniform2f(glGetUniformLocation(coreProgram, "fadeRange"), impostorFadeStart, impostorFadeEnd);
+				for (unsigned int l = 0; l < rockLodCount; l++)
+					rockMesh.DrawInstanced(coreProgram, lodCounts[l], mappedRocks.GetBaseInstance() + lodOffsets[l], l);
+
+				if (impostorCount)
+				{
+					const GLuint impostorProgram = rockImpostor.GetProgram();
+					setLightUniforms(impostorProgram, camera, spotlightOn);
+					glUniform1f(glGetUniformLocation(impostorProgram, "shininess"), 32.0f);
+					glUniform2f(glGetUniformLocation(impostorProgram, "fadeRange"), impostorFadeStart, impostorFadeEnd);
+					rockImpostor.Draw(view, projection, camera.pos, impostorCount, mappedRocks.GetBaseInstance() + impostorOffset);
+				}
+				mappedRocks.Fence();
+			}
+
+			// skybox
+			glCullFace(GL_FRONT);
+
+			glUseProgram(skyProgram);
+			glUniformMatrix4fv(glGetUniformLocation(skyProgram, "view"), 1, GL_FALSE, glm::value_ptr(skyView));
+			glUniformMatrix4fv(glGetUniformLocation(skyProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+
+			glUniform1i(glGetUniformLocation(skyProgram, "skybox"), 2);
+
+			glBindVertexArray(vao);
+			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+
+			if (sceneFBO)
+			{
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+				glBlitFramebuffer(0, 0, 800, 600, 0, 0, 800, 600, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			}
+
+			glfwSwapBuffers(window);
+			glFlush();
+
+			const double time = glfwGetTime();
+			if (time - lastReport >= 1.0)
+			{
+				if (computeCulling)
+				{
+					std::cout << "[Info: TestInstancing] " << rockCuller.GetVisibleCount() << "/" << count << " rocks visible, per level:";
+					for (unsigned int levelCount : rockCuller.GetVisibleCounts())
+						std::cout << " " << levelCount;
+
+					const OcclusionStats& stats = rockCuller.GetStats();
+					std::cout << "; " << stats.frustumCulled << " outside the frustum, " << stats.occluded << " occluded, "
+						<< stats.drawnEarly << " drawn early, " << stats.drawnLate << " drawn late." << std::endl;
+				}
+				else
+				{
+					std::cout << "[Info: TestInstancing] " << cpuVisibleCount << "/" << count << " rocks visible ("
+						<< cpuFrustumCount - cpuVisibleCount << " behind the planet, " << cpuImpostorCount << " as impostors), culled and grouped in "
+						<< cpuCullMs << " ms (" << (FrustumCuller::HasAvx2() ? "AVX2" : "SSE") << ")." << std::endl;
+				}
+				lastReport = time;
+			}
 		}
 
-		// skybox
-		glCullFace(GL_FRONT);
-
-		glUseProgram(skyProgram);
-		glUniformMatrix4fv(glGetUniformLocation(skyProgram, "view"), 1, GL_FALSE, glm::value_ptr(skyView));
-		glUniformMatrix4fv(glGetUniformLocation(skyProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-
-		glUniform1i(glGetUniformLocation(skyProgram, "skybox"), 2);
-
-		glBindVertexArray(vao);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		glfwSwapBuffers(window);
-		glFlush();
+		glDeleteFramebuffers(1, &sceneFBO);
+		glDeleteTextures(1, &sceneColor);
+		glDeleteTextures(1, &sceneDepth);
 	}
 
 	glfwDestroyWindow(window);
@@ -6,6 +6,7 @@
 #include "Handler.h"
 #include "Texture.h"
 #include "Model.h"
+#include "SceneGraph.h"
 #include "Shader.h"
 
 #include "CubeData.h"
@@ -98,6 +99,13 @@ void TestModel()
 	//Model modelObj("C:/Users/binma/Downloads/backpack/backpack.obj");
 	//Model modelObj("C:/Users/binma/Downloads/bgvwoubymcqo-ThrowingCube/WAVEFRONT.obj");
 
+	// The light cubes never move, so their matrices are built once.
+	SceneGraph lightGraph;
+	SceneNode lightNodes[COUNT_POINT_LIGHT];
+	for (int i = 0; i < COUNT_POINT_LIGHT; i++)
+		lightNodes[i] = lightGraph.CreateNode(invalidSceneNode,
+			glm::scale(glm::translate(glm::mat4(1.0f), LightData::pointLights[i].position), glm::vec3(0.2f)));
+	lightGraph.Update();
 
 	while (!glfwWindowShouldClose(window))
 	{
@@ -120,9 +128,7 @@ void TestModel()
 			// ************ LIGHT ************ //
 			glUseProgram(lightProgram);
 
-			glm::mat4 model = glm::translate(glm::mat4(1.0f), pointLight.position);
-			model = glm::scale(model, glm::vec3(0.2f));
-			glUniformMatrix4fv(glGetUniformLocation(lightProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
+			glUniformMatrix4fv(glGetUniformLocation(lightProgram, "model"), 1, GL_FALSE, glm::value_ptr(lightGraph.GetWorld(lightNodes[i])));
 			glUniformMatrix4fv(glGetUniformLocation(lightProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
 			glUniformMatrix4fv(glGetUniformLocation(lightProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
@@ -173,23 +179,22 @@ void TestModel()
 		//model = glm::rotate(model, glm::radians((float)glfwGetTime() * 5.0f), glm::vec3(1.0f, 0.3f, 0.5f));
 
 		glUseProgram(coreProgram);
-		glUniformMatrix4fv(glGetUniformLocation(coreProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
 		glUniformMatrix4fv(glGetUniformLocation(coreProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
 		glUniformMatrix4fv(glGetUniformLocation(coreProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
 		if (explode)
 			glUniform1f(glGetUniformLocation(coreProgram, "time"), glfwGetTime());
 
-		modelObj.Draw(coreProgram);
+		// keeps the imported node hierarchy
+		modelObj.Draw(coreProgram, model);
 
 		if (drawNormals)
 		{
 			glUseProgram(normalProgram);
-			glUniformMatrix4fv(glGetUniformLocation(normalProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
 			glUniformMatrix4fv(glGetUniformLocation(normalProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
 			glUniformMatrix4fv(glGetUniformLocation(normalProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
-			modelObj.Draw(normalProgram);
+			modelObj.Draw(normalProgram, model);
 		}
 
 		glfwSwapBuffers(window);
@@ -7,77 +7,38 @@
 #include "Shader.h"
 
 #include "CubeData.h"
+#include "Mesh.h"
+#include "TangentSpace.h"
+#include "VertexLayout.h"
 
-static void calcTangents(const glm::vec3* pos, const glm::vec2* uv, glm::vec3& outTangent, glm::vec3& outBitangent)
-{
-	const glm::vec3 edge1 = pos[1] - pos[0];
-	const glm::vec3 edge2 = pos[2] - pos[0];
-	const glm::vec2 deltaUV1 = uv[1] - uv[0];
-	const glm::vec2 deltaUV2 = uv[2] - uv[0];
-
-	const float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x);
-
-	const glm::mat2 uvMatrix(
-		 deltaUV2.y, -deltaUV2.x,
-		-deltaUV1.y,  deltaUV1.x
-	);
-
-	const glm::mat3x2 edgeMatrix(
-		edge1.x, edge2.x,
-		edge1.y, edge2.y,
-		edge1.z, edge2.z
-	);
-
-	const glm::mat3x2 tangentMatrix = f * uvMatrix * edgeMatrix;
-
-	outTangent = glm::vec3(tangentMatrix[0][0], tangentMatrix[1][0], tangentMatrix[2][0]);
-	outBitangent = glm::vec3(tangentMatrix[0][1], tangentMatrix[1][1], tangentMatrix[2][1]);
-}
-
-static GLuint createVertexArray()
+static GLuint createVertexArray(GLuint vbo)
 {
 	GLuint vao;
 	glCreateVertexArrays(1, &vao);
+	CubeVertexLayout::Setup(vao, vbo);
 	glBindVertexArray(vao);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), 0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
 	return vao;
 }
 
-static GLuint createPlaneVertexArray()
+static Mesh createPlaneMesh()
 {
-
-	static const float vertices[] = {
-		// positions        normals		       texCoords
-		 5.0f, 0.0f,  5.0f, 0.0f, 1.0f, 0.0f, 2.0f, 2.0f,
-		-5.0f, 0.0f,  5.0f, 0.0f, 1.0f, 0.0f, 0.0f, 2.0f,
-		-5.0f, 0.0f, -5.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-		 5.0f, 0.0f, -5.0f, 0.0f, 1.0f, 0.0f, 2.0f, 0.0f
+	const float uvScale = 2.0f;
+	std::vector<Vertex> vertices =
+	{
+		Vertex(glm::vec3( 5.0f, 0.0f,  5.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(uvScale, uvScale)),
+		Vertex(glm::vec3(-5.0f, 0.0f,  5.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(0.0f, uvScale)),
+		Vertex(glm::vec3(-5.0f, 0.0f, -5.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(0.0f, 0.0f)),
+		Vertex(glm::vec3( 5.0f, 0.0f, -5.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(uvScale, 0.0f))
 	};
 
-	static const unsigned int indices[] =
+	std::vector<unsigned int> indices =
 	{
 		2, 1, 0,
 		3, 2, 0
 	};
 
-	GLuint vbo;
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-	GLuint vao = createVertexArray();
-
-	GLuint ebo;
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	return vao;
+	TangentSpace::generate(vertices, indices);
+	return Mesh(vertices, indices, {});
 }
 
 static GLuint createCubeVertexArray()
@@ -87,7 +48,7 @@ static GLuint createCubeVertexArray()
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(CubeData::vertices), CubeData::vertices, GL_STATIC_DRAW);
 
-	GLuint vao = createVertexArray();
+	GLuint vao = createVertexArray(vbo);
 
 	GLuint ebo;
 	glGenBuffers(1, &ebo);
@@ -98,19 +59,22 @@ static GLuint createCubeVertexArray()
 }
 
 
-static void drawPlane(GLuint shader, GLuint vao)
+static void drawPlane(GLuint shader, const Mesh& plane)
 {
 	glm::mat4 model(1.0f);
 	model = glm::translate(model, glm::vec3(0.0f, -2.0f, -2.0f));
 	model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
 	//model = glm::scale(model, glm::vec3(100.5f, 105.0f, 105.5f));
 
+	const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+
 	glUseProgram(shader);
 	glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
+	glUniformMatrix3fv(glGetUniformLocation(shader, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
 	glUniform1i(glGetUniformLocation(shader, "material.diffuse"), 0);
 	glUniform1i(glGetUniformLocation(shader, "material.specular"), 1);
-	glBindVertexArray(vao);
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	glBindVertexArray(plane.vao);
+	glDrawElements(GL_TRIANGLES, (GLsizei)plane.indices.size(), GL_UNSIGNED_INT, 0);
 }
 
 static void drawLightCube(GLuint shader, GLuint vao)
@@ -142,23 +106,6 @@ void TestNormal()
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-	const glm::vec3 pos[] = {
-		{ 5.0f, 0.0f,  5.0f},
-		{-5.0f, 0.0f,  5.0f},
-		{-5.0f, 0.0f, -5.0f},
-	};
-
-	const glm::vec2 texCoords[] = {
-		{2.0f, 2.0f},
-		{0.0f, 2.0f},
-		{0.0f, 0.0f},
-	};
-
-	const glm::vec3 normal(0.0f, 1.0f, 0.0f);
-
-	glm::vec3 tangent, bitangent;
-	calcTangents(pos, texCoords, tangent, bitangent);
-
 	// Initialise shaders and load programs.
 	GLuint coreProgram;
 	Shader::loadProgram(coreProgram, "res/shaders/Normal/VertexCore.glsl", "res/shaders/Normal/FragmentCore.glsl");
@@ -166,7 +113,7 @@ void TestNormal()
 	GLuint lightProgram;
 	Shader::loadProgram(lightProgram, "res/shaders/VertexCore.glsl", "res/shaders/FragmentLight.glsl");
 
-	GLuint planeVAO = createPlaneVertexArray();
+	Mesh plane = createPlaneMesh();
 	GLuint cubeVAO = createCubeVertexArray();
 
 	// Initialise textures and materials.
@@ -191,10 +138,6 @@ void TestNormal()
 	glUniform3fv(glGetUniformLocation(coreProgram, "pointLight.diffuse"), 1, glm::value_ptr(0.7f * LightData::pointLights[0].diffuse));
 	glUniform3fv(glGetUniformLocation(coreProgram, "pointLight.specular"), 1, glm::value_ptr(1.1f * LightData::pointLights[0].specular));
 
-	glUniform3fv(glGetUniformLocation(coreProgram, "tangent"), 1, glm::value_ptr(tangent));
-	glUniform3fv(glGetUniformLocation(coreProgram, "bitangent"), 1, glm::value_ptr(bitangent));
-	glUniform3fv(glGetUniformLocation(coreProgram, "normal"), 1, glm::value_ptr(normal));
-
 	// Initialise window state.
 	Camera camera(
 		glm::vec3(0.0f, 0.0f, 6.0f),
@@ -235,7 +178,7 @@ void TestNormal()
 
 		glUniform1i(glGetUniformLocation(coreProgram, "mapNormals"), !(glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS));
 
-		drawPlane(coreProgram, planeVAO);
+		drawPlane(coreProgram, plane);
 
 		glfwSwapBuffers(window);
 		glFlush();
@@ -1,35 +1,36 @@
 #include "pch.h"
 
 #include <math.h>
+#include <algorithm>
+#include <cfloat>
 #include <iostream>
+#include <map>
 #include "Utility.h"
 
 #include "Camera.h"
 #include "Handler.h"
 #include "Texture.h"
 #include "Shader.h"
-#include "CubeData.h"
+#include "InstanceBuffer.h"
+#include "DrawDataBuffer.h"
+#include "MeshletCuller.h"
+#include "Primitives.h"
 
-static struct Vertex
+static struct Light
 {
 	glm::vec3 pos;
-	glm::vec2 texCoords;
-	glm::vec3 tangent;
-	glm::vec3 bitangent;
-	glm::vec3 normal;
+	glm::vec3 color;
 };
 
+static const unsigned int maxSphereResolution = 256;
 
-static struct Light
+// the sphere grid at one tessellation, set up the first time the camera distance asks for it
+struct SphereLod
 {
-	glm::vec3 pos;
-	glm::vec3 color;
+	GLuint vao = 0;
+	MeshletCuller culler;
 };
 
-static const float pi = 3.1415926f;
-static const unsigned int uSample = 256;
-static const unsigned int vSample = 256;
-
 static void setPermSphereUniforms(unsigned int lightCount, GLuint shader)
 {
 	glUseProgram(shader);
@@ -64,13 +65,18 @@ static void setVarSphereUniforms(unsigned int lightCount, //Light* lights,
 			1, glm::value_ptr(LightData::pointLights[i].position));
 }
 
-static void drawSpheres(unsigned int sphereCount, GLuint shader, GLuint vao)
+static void drawSpheres(GLuint shader, GLuint vao, MeshletCuller& culler)
 {
-	const unsigned int uIntCount = 6 * vSample * (uSample - 2);
+	glUseProgram(shader);
+	culler.Draw(vao);
+}
 
+// one quad per instance, ray cast against the sphere in the fragment shader
+static void drawSphereImpostors(GLuint shader, GLuint vao, unsigned int sphereCount)
+{
 	glUseProgram(shader);
 	glBindVertexArray(vao);
-	glDrawElementsInstanced(GL_TRIANGLES, uIntCount, GL_UNSIGNED_INT, 0, sphereCount);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, sphereCount);
 }
 
 static float getDirOffset(unsigned int pos, unsigned int dim)
@@ -87,170 +93,10 @@ static float getDirOffset(unsigned int pos, unsigned int dim)
 	}
 }
 
-static void calcTangents(const Vertex* vertices, glm::vec3& outTangent, glm::vec3& outBitangent)
-{
-	const glm::vec3 edge1 = vertices[1].pos - vertices[0].pos;
-	const glm::vec3 edge2 = vertices[2].pos - vertices[0].pos;
-	const glm::vec2 deltaUV1 = vertices[1].texCoords - vertices[0].texCoords;
-	const glm::vec2 deltaUV2 = vertices[2].texCoords - vertices[0].texCoords;
-
-	const float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x);
-
-	const glm::mat2 uvMatrix(
-		deltaUV2.y, -deltaUV2.x,
-		-deltaUV1.y, deltaUV1.x
-	);
-
-	const glm::mat3x2 edgeMatrix(
-		edge1.x, edge2.x,
-		edge1.y, edge2.y,
-		edge1.z, edge2.z
-	);
-
-	const glm::mat3x2 tangentMatrix = f * uvMatrix * edgeMatrix;
-
-	outTangent = glm::vec3(tangentMatrix[0][0], tangentMatrix[1][0], tangentMatrix[2][0]);
-	outBitangent = glm::vec3(tangentMatrix[0][1], tangentMatrix[1][1], tangentMatrix[2][1]);
-}
-
-static void emplaceSpherePoints(unsigned int uSample, unsigned int vSample, Vertex* outVertices)
-{
-	const unsigned int vertexCount = vSample * (uSample - 2) + 2;
-
-	outVertices[0].pos = glm::vec3(0.0f, 1.0f, 0.0f);
-	outVertices[0].texCoords = glm::vec2(0.0f, 0.0f);
-	outVertices[0].tangent = glm::vec3(0.0f, 0.0f, 1.0f);
-	outVertices[0].bitangent = glm::vec3(-1.0f, 0.0, 0.0f);
-	outVertices[0].normal = outVertices[0].pos;
-
-	outVertices[vertexCount - 1].pos = glm::vec3(0.0f, -1.0f, 0.0f);
-	outVertices[vertexCount - 1].texCoords = glm::vec2(0.0f, 1.0f);
-	outVertices[vertexCount - 1].tangent = glm::vec3(0.0f, 0.0f, -1.0f);
-	outVertices[vertexCount - 1].bitangent = glm::vec3(-1.0f, 0.0f, 0.0f);
-	outVertices[vertexCount - 1].normal = outVertices[vertexCount - 1].pos;
-
-	const float uInc = pi / (uSample - 1);
-	const float vInc = 2 * pi / vSample;
-
-	float u = uInc;
-	float v = 0.0f;
-
-	unsigned int idx = 1;
-
-	for (unsigned int uIdx = 0; uIdx < uSample - 2; uIdx++)
-	{
-		for (unsigned int vIdx = 0; vIdx < vSample; vIdx++)
-		{
-			outVertices[idx].pos = glm::vec3(sin(u) * sin(v), cos(u), sin(u) * cos(v));
-			outVertices[idx].texCoords = glm::vec2((float)uIdx / (float)uSample,
-				fmodf((float)vIdx / (float)vSample + 0.5f, 1.0f));
-
-			Vertex vertices[3] =
-			{
-				outVertices[idx],
-				idx >= 1 ? outVertices[idx - 1] : outVertices[vertexCount - 1],
-				idx >= vSample ? outVertices[idx - vSample] : outVertices[0]
-			};
-
-			calcTangents(vertices, outVertices[idx].tangent, outVertices[idx].bitangent);
-			outVertices[idx].normal = outVertices[idx].pos;
-
-			v += vInc;
-			idx += 1;
-		}
-		u += uInc;
-		v = 0.0f;
-	}
-}
-
-static void emplaceSphereIndices(unsigned int uSample, unsigned int vSample, unsigned int* outIndices)
+static void createModelInstances(unsigned int xDim, unsigned int yDim, InstanceBuffer& outInstances, std::vector<glm::vec3>& outCenters)
 {
-	unsigned int arrIdx = 0;
-
-	for (unsigned int i = 1; i <= vSample; i++)
-	{
-		outIndices[arrIdx++] = 0;
-		outIndices[arrIdx++] = i;
-		outIndices[arrIdx++] = (i == vSample) ? 1 : (i + 1);
-	}
-
-	for (unsigned int uIdx = 0; uIdx < uSample - 3; uIdx++)
-	{
-		const unsigned int lowerStart = uIdx * vSample + 1;
-		const unsigned int upperStart = lowerStart + vSample;
-
-		for (unsigned int vIdx = 0; vIdx < vSample - 1; vIdx++)
-		{
-			outIndices[arrIdx++] = lowerStart + vIdx;
-			outIndices[arrIdx++] = upperStart + vIdx;
-			outIndices[arrIdx++] = lowerStart + vIdx + 1;
-
-			outIndices[arrIdx++] = upperStart + vIdx;
-			outIndices[arrIdx++] = upperStart + vIdx + 1;
-			outIndices[arrIdx++] = lowerStart + vIdx + 1;
-		}
-
-		outIndices[arrIdx++] = upperStart - 1;
-		outIndices[arrIdx++] = upperStart + vSample - 1;
-		outIndices[arrIdx++] = lowerStart;
-
-		outIndices[arrIdx++] = upperStart + vSample - 1;
-		outIndices[arrIdx++] = upperStart;
-		outIndices[arrIdx++] = lowerStart;
-	}
-
-	const unsigned int bottomIdx = vSample * (uSample - 2) + 1;
-	const unsigned int penStart = bottomIdx - vSample;
-
-	for (unsigned int i = 0; i < vSample; i++)
-	{
-		outIndices[arrIdx++] = bottomIdx;
-		outIndices[arrIdx++] = (i == vSample - 1) ? penStart : penStart + i + 1;
-		outIndices[arrIdx++] = penStart + i;
-	}
-}
-
-
-static GLuint createSphereVAO(unsigned int xDim, unsigned int yDim)
-{
-	// sphere vertices and indices
-
-	const unsigned int vertexCount = vSample * (uSample - 2) + 2;
-	const unsigned int uIntCount = 6 * vSample * (uSample - 2);
-
-	Vertex* sphereVertices = new Vertex[vertexCount];
-	emplaceSpherePoints(uSample, vSample, sphereVertices);
-
-	unsigned int* sphereIndices = new unsigned int[uIntCount];
-	emplaceSphereIndices(uSample, vSample, sphereIndices);
-
-	GLuint sphereVBO;
-	glGenBuffers(1, &sphereVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
-	glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), sphereVertices, GL_STATIC_DRAW);
-	
-	GLuint sphereVAO;
-	glCreateVertexArrays(1, &sphereVAO);
-	glBindVertexArray(sphereVAO);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, pos));
-	glEnableVertexAttribArray(1);					
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
-	glEnableVertexAttribArray(2);					
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
-	glEnableVertexAttribArray(3);					
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, bitangent));
-	glEnableVertexAttribArray(4);
-	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-
-	GLuint sphereEBO;
-	glGenBuffers(1, &sphereEBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, uIntCount * sizeof(unsigned int), sphereIndices, GL_STATIC_DRAW);
-
-	// model matrices 
 	const unsigned int sphereCount = xDim * yDim;
-	glm::mat4* modelMatrices = new glm::mat4[sphereCount];
+	std::vector<InstanceTransform> transforms(sphereCount);
 
 	const float spacing = 1.5f;
 	unsigned int idx = 0;
@@ -260,58 +106,46 @@ static GLuint createSphereVAO(unsigned int xDim, unsigned int yDim)
 		for (unsigned int j = 0; j < yDim; j++)
 		{
 			float yOffset = getDirOffset(j, yDim);
-			modelMatrices[idx] = glm::translate(glm::mat4(1.0f),
-				spacing * glm::vec3(xOffset, yOffset, 0.0f) + glm::vec3(0.0f, 0.0f, -1.0f));
-			modelMatrices[idx] = glm::rotate(modelMatrices[idx], (float)rand() / (float)RAND_MAX, glm::vec3(0.2f, 0.5f, 0.8f));
+			transforms[idx].position = spacing * glm::vec3(xOffset, yOffset, 0.0f) + glm::vec3(0.0f, 0.0f, -1.0f);
+			transforms[idx].rotation = glm::angleAxis((float)rand() / (float)RAND_MAX, glm::normalize(glm::vec3(0.2f, 0.5f, 0.8f)));
+			outCenters.push_back(transforms[idx].position);
 
 			idx += 1;
 		}
 	}
 
-	GLuint modelVBO;
-	glGenBuffers(1, &modelVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, modelVBO);
-	glBufferData(GL_ARRAY_BUFFER, sphereCount * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
-
-	glBindVertexArray(sphereVAO);
-
-	const unsigned int startAttrib = 5;
-	const unsigned int vecSize = sizeof(glm::vec4);
-	for (unsigned int i = 0; i < 4; i++)
-	{
-		glEnableVertexAttribArray(i + startAttrib);
-		glVertexAttribPointer(i + startAttrib, 4, GL_FLOAT, GL_FALSE, 4 * vecSize, (void*)(i * vecSize));
-		glVertexAttribDivisor(i + startAttrib, 1);
-	}
-
-	return sphereVAO;
+	outInstances.Update(PbrInstanceLayout::Pack(transforms).data(), 0, sphereCount);
 }
 
-static GLuint createCubeVAO()
+static SphereLod& getSphereLod(std::map<unsigned int, SphereLod>& lods, unsigned int resolution, InstanceBuffer& instances, unsigned int sphereCount)
 {
-	GLuint vbo;
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(CubeData::vertices), CubeData::vertices, GL_STATIC_DRAW);
+	auto found = lods.find(resolution);
+	if (found != lods.end())
+		return found->second;
 
-	GLuint vao;
-	glCreateVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), 0);
+	const PrimitiveGeometry& sphere = Primitives::get(PRIMITIVE_UV_SPHERE, resolution);
+	SphereLod& lod = lods[resolution];
+	lod.vao = Primitives::createVertexArray(sphere, PRIMITIVE_LAYOUT_PBR);
+
+	// model matrices
+	instances.Attach(lod.vao);
 
-	GLuint ebo;
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(CubeData::indices), CubeData::indices, GL_STATIC_DRAW);
+	// meshlets for per-frame culling of the instances
+	const PrimitiveMesh& mesh = sphere.mesh;
+	std::vector<Meshlet> meshlets;
+	Meshlets::build(mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertices.size(),
+		sizeof(PrimitiveVertex), offsetof(PrimitiveVertex, pos), meshlets);
+	lod.culler.Setup(meshlets, mesh.indices.data(), mesh.indices.size(), instances.GetBuffer(), sphereCount);
 
-	return vao;
+	return lod;
 }
 
-static void drawLights(GLuint lightShader, GLuint cubeVAO, glm::mat4& view, glm::mat4& projection)
+// every light in one multi-draw, its model matrix and colour in the frame's draw data
+static void drawLights(DrawDataBuffer& draws, GLuint lightShader, const PrimitiveGeometry& cube, GLuint cubeVAO, glm::mat4& view, glm::mat4& projection)
 {
 	glUseProgram(lightShader);
-	glBindVertexArray(cubeVAO);
+	glUniformMatrix4fv(glGetUniformLocation(lightShader, "view"), 1, GL_FALSE, glm::value_ptr(view));
+	glUniformMatrix4fv(glGetUniformLocation(lightShader, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
 	for (int i = 0; i < COUNT_POINT_LIGHT; i++)
 	{
@@ -319,16 +153,11 @@ static void drawLights(GLuint lightShader, GLuint cubeVAO, glm::mat4& view, glm:
 
 		glm::mat4 model = glm::translate(glm::mat4(1.0f), pointLight.position);
 		model = glm::scale(model, glm::vec3(0.15f));
-		glUniformMatrix4fv(glGetUniformLocation(lightShader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-		glUniformMatrix4fv(glGetUniformLocation(lightShader, "view"), 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(glGetUniformLocation(lightShader, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-
-		glUniform3fv(glGetUniformLocation(lightShader, "lightColor"), 1, glm::value_ptr(pointLight.specular));
-		//glUniform3f(glGetUniformLocation(lightShader, "lightColor"), 0.9f, 0.9f, 0.9f);
-
-		glDrawElements(GL_TRIANGLES, CubeData::indexCount, GL_UNSIGNED_INT, 0);
+		draws.Add((GLsizei)cube.mesh.indices.size(), 0, 0, model, glm::vec4(pointLight.specular, 1.0f));
 	}
 
+	draws.Submit(lightShader, cubeVAO);
+
 }
 
 void TestPBR()
@@ -349,12 +178,18 @@ void TestPBR()
 	glDisable(GL_FRAMEBUFFER_SRGB);
 
 
-	// shaders
+	// shaders; ray cast spheres are exact at any distance for four vertices each, the meshes are
+	// tessellated for the nearest one
+	const bool raycastSpheres = true;
 	GLuint coreProgram;
-	Shader::loadProgram(coreProgram, "res/shaders/PBR/VertexCore.glsl", "res/shaders/PBR/FragmentCore.glsl");
+	if (raycastSpheres)
+		Shader::loadPreludeProgram(coreProgram, "res/shaders/Impostor/VertexSphere.glsl", "res/shaders/PBR/FragmentCore.glsl",
+			"res/shaders/Impostor/FragmentSphere.glsl");
+	else
+		Shader::loadProgram(coreProgram, "res/shaders/PBR/VertexCore.glsl", "res/shaders/PBR/FragmentCore.glsl");
 
 	GLuint lightProgram;
-	Shader::loadProgram(lightProgram, "res/shaders/PBR/VertexLight.glsl", "res/shaders/PBR/FragmentLight.glsl");
+	Shader::loadProgram(lightProgram, "res/shaders/DrawData/VertexLight.glsl", "res/shaders/DrawData/FragmentLight.glsl");
 
 	// material textures
 	Texture rustAlbedo(TextureType::OTHER, 0, "res/textures/rusty_ball/rustediron2_basecolor.png", true, true);
@@ -362,63 +197,98 @@ void TestPBR()
 	Texture rustNormal(TextureType::OTHER, 2, "res/textures/rusty_ball/rustediron2_normal.png", false, false);
 	Texture rustRoughness(TextureType::FLOAT, 3, "res/textures/rusty_ball/rustediron2_roughness.png", false, false);
 
-	// VAOs
-	const unsigned int xDim = 3;
-	const unsigned int yDim = 3;
-	const unsigned int sphereCount = xDim * yDim;
-	GLuint sphereVAO = createSphereVAO(xDim, yDim);
-	GLuint cubeVAO = createCubeVAO();
-
-	// camera and handler
-	Camera camera(
-		glm::vec3(0.0f, 0.0f, 2.0f),
-		glm::vec3(0.0f, 1.0f, 0.0f),
-		-90.0f,
-		0.0f
-	);
+	// scoped so the instance and draw data buffers release their GL objects while the context is alive
+	{
+		// VAOs
+		const unsigned int xDim = 3;
+		const unsigned int yDim = 3;
+		std::vector<glm::vec3> sphereCenters;
+		InstanceBuffer sphereInstances(PbrInstanceLayout(), xDim * yDim);
+		createModelInstances(xDim, yDim, sphereInstances, sphereCenters);
+		std::map<unsigned int, SphereLod> sphereLods;
+		GLuint sphereQuadVAO;
+		glCreateVertexArrays(1, &sphereQuadVAO);
+		sphereInstances.Attach(sphereQuadVAO);
+
+		const PrimitiveGeometry& cube = Primitives::get(PRIMITIVE_CUBE, 1);
+		GLuint cubeVAO = Primitives::createVertexArray(cube, PRIMITIVE_LAYOUT_PBR);
+		DrawDataBuffer draws(COUNT_POINT_LIGHT);
+		draws.Attach(cubeVAO);
+
+		// camera and handler
+		Camera camera(
+			glm::vec3(0.0f, 0.0f, 2.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f),
+			-90.0f,
+			0.0f
+		);
+
+		bool spotlightOn = true;
+
+		Handler handler(window, camera, spotlightOn);
+
+		setPermSphereUniforms(COUNT_POINT_LIGHT, coreProgram);
+
+		while (!glfwWindowShouldClose(window))
+		{
+			glfwPollEvents();
+			Handler::MaintainKeyboard(window);
 
-	bool spotlightOn = true;
+			// imgui
+			//ImGui_ImplOpenGL3_NewFrame();
+			//ImGui_ImplGlfw_NewFrame();
+			//ImGui::NewFrame();
+		
+			//ImGui::Begin("alert");
+			//ImGui::SliderFloat("metallic", &material.metallic, 0.0f, 1.0f);
+			//ImGui::SliderFloat("roughness", &material.roughness, 0.0f, 1.0f);
+			//ImGui::End();
 
-	Handler handler(window, camera, spotlightOn);
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	setPermSphereUniforms(COUNT_POINT_LIGHT, coreProgram);
+			glUseProgram(coreProgram);
+			glUniform1i(glGetUniformLocation(coreProgram, "showNormal"), glfwGetKey(window, GLFW_KEY_0) == GLFW_PRESS);
+			glUniform1i(glGetUniformLocation(coreProgram, "normalMapping"), !(glfwGetKey(window, GLFW_KEY_9) == GLFW_PRESS));
 
-	while (!glfwWindowShouldClose(window))
-	{
-		glfwPollEvents();
-		Handler::MaintainKeyboard(window);
+			glm::mat4 view = std::move(camera.GetViewMatrix());
+			glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.1f, 50.0f);
 
-		// imgui
-		//ImGui_ImplOpenGL3_NewFrame();
-		//ImGui_ImplGlfw_NewFrame();
-		//ImGui::NewFrame();
-		
-		//ImGui::Begin("alert");
-		//ImGui::SliderFloat("metallic", &material.metallic, 0.0f, 1.0f);
-		//ImGui::SliderFloat("roughness", &material.roughness, 0.0f, 1.0f);
-		//ImGui::End();
-
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			setVarSphereUniforms(COUNT_POINT_LIGHT, camera.pos, view, projection, coreProgram);
 
-		glUseProgram(coreProgram);
-		glUniform1i(glGetUniformLocation(coreProgram, "showNormal"), glfwGetKey(window, GLFW_KEY_0) == GLFW_PRESS);
-		glUniform1i(glGetUniformLocation(coreProgram, "normalMapping"), !(glfwGetKey(window, GLFW_KEY_9) == GLFW_PRESS));
+			if (raycastSpheres)
+				drawSphereImpostors(coreProgram, sphereQuadVAO, (unsigned int)sphereCenters.size());
+			else
+			{
+				// tessellate for the nearest sphere, the one whose silhouette shows facets first
+				float nearest = FLT_MAX;
+				for (const glm::vec3& center : sphereCenters)
+					nearest = std::min(nearest, glm::length(center - camera.pos));
+				const unsigned int resolution = Primitives::selectResolution(PRIMITIVE_UV_SPHERE, maxSphereResolution, 1.0f, nearest,
+					glm::radians(camera.fov), 600.0f);
 
-		glm::mat4 view = std::move(camera.GetViewMatrix());
-		glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.1f, 50.0f);
+				SphereLod& sphereLod = getSphereLod(sphereLods, resolution, sphereInstances, (unsigned int)sphereCenters.size());
+				sphereLod.culler.Cull(projection * view, camera.pos);
+				drawSpheres(coreProgram, sphereLod.vao, sphereLod.culler);
+			}
 
-		setVarSphereUniforms(COUNT_POINT_LIGHT, camera.pos, view, projection, coreProgram);
-		drawSpheres(sphereCount, coreProgram, sphereVAO);
 
+			draws.Begin();
+			drawLights(draws, lightProgram, cube, cubeVAO, view, projection);
+			draws.End();
 
-		drawLights(lightProgram, cubeVAO, view, projection);
+			//ImGui::Render();
+			//ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
-		//ImGui::Render();
-		//ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+			glfwSwapBuffers(window);
+			glFlush();
+		}
 
-		glfwSwapBuffers(window);
-		glFlush();
+		for (auto& lod : sphereLods)
+			glDeleteVertexArrays(1, &lod.second.vao);
+		glDeleteVertexArrays(1, &sphereQuadVAO);
+		glDeleteVertexArrays(1, &cubeVAO);
+		Primitives::release();
 	}
 
 	glfwDestroyWindow(window);
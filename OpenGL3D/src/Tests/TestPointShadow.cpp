@@ -10,6 +10,8 @@
 
 #include "CubeData.h"
 #include "StencilData.h"
+#include "StaticBatcher.h"
+#include "VertexLayout.h"
 
 static const float near = 1.0f;
 static const float far = 25.0f;
@@ -30,21 +32,31 @@ static void drawPlane(GLuint shader, GLuint vao)
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 }
 
-static void drawCube(GLuint shader, GLuint vao)
+static void buildCubes(StaticBatcher& outCubes)
 {
-	glUseProgram(shader);
-	glUniform1i(glGetUniformLocation(shader, "material.diffuse"), 2);
-	glUniform1i(glGetUniformLocation(shader, "material.specular"), 3);
-	glBindVertexArray(vao);
+	const unsigned int cube = outCubes.AddMesh(CubeData::vertices, sizeof(CubeData::vertices) / sizeof(float),
+		CubeData::indices, CubeData::indexCount);
 
 	for (const glm::vec3& pos : StencilData::cubePositions)
 	{
 		glm::mat4 model(1.0f);
 		model = glm::translate(model, pos);
 		model = glm::translate(model, glm::vec3(3.0f, 0.0f, -3.0f));
-		glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		outCubes.AddInstance(cube, 0, model);
 	}
+
+	outCubes.Build<CubeVertexLayout>(3);
+}
+
+static void drawCubes(GLuint shader, const StaticBatcher& cubes)
+{
+	glm::mat4 model(1.0f);
+
+	glUseProgram(shader);
+	glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
+	glUniform1i(glGetUniformLocation(shader, "material.diffuse"), 2);
+	glUniform1i(glGetUniformLocation(shader, "material.specular"), 3);
+	cubes.Draw(0);
 }
 
 static void emplaceShadowTransforms(std::vector<glm::mat4>& outTransforms, const glm::vec3& lightPos)
@@ -92,17 +104,12 @@ static void createDepthMap(GLuint& outFrameBuffer, GLuint& outCubeMap, unsigned
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-static GLuint createVertexArray()
+static GLuint createVertexArray(GLuint vbo)
 {
 	GLuint vao;
 	glCreateVertexArrays(1, &vao);
+	CubeVertexLayout::Setup(vao, vbo);
 	glBindVertexArray(vao);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), 0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
 	return vao;
 }
 
@@ -113,7 +120,7 @@ static GLuint createCubeVertexArray()
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(CubeData::vertices), CubeData::vertices, GL_STATIC_DRAW);
 
-	GLuint vao = createVertexArray();
+	GLuint vao = createVertexArray(vbo);
 
 	GLuint ebo;
 	glGenBuffers(1, &ebo);
@@ -146,7 +153,7 @@ static GLuint createPlaneVertexArray()
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-	GLuint vao = createVertexArray();
+	GLuint vao = createVertexArray(vbo);
 
 	GLuint ebo;
 	glGenBuffers(1, &ebo);
@@ -188,110 +195,116 @@ void TestPointShadow()
 	GLuint planeVAO = createPlaneVertexArray();
 	GLuint cubeVAO = createCubeVertexArray();
 
-	// initialise window state
-	Camera camera(
-		glm::vec3(0.0f, 0.0f, 3.0f),
-		glm::vec3(0.0f, 1.0f, 0.0f),
-		-90.0f,
-		0.0f
-	);
-
-	bool spotlightOn = false;
-
-	Handler handler(window, camera, spotlightOn);
-
-	Texture planeDiff(TextureType::DIFFUSE, 0, "res/textures/wood.png", true, true);
-	Texture planeSpec(TextureType::SPECULAR, 1, "res/textures/Solid_grey.png", false, true);
-
-	Texture cubeDiff(TextureType::DIFFUSE, 2, "res/textures/container2.png", true, true);
-	Texture cubeSpec(TextureType::SPECULAR, 3, "res/textures/specular.png", true, true);
+	// scoped so the batches release their GL objects while the context is alive
+	{
+		StaticBatcher cubes;
+		buildCubes(cubes);
 
-	// point light
+		// initialise window state
+		Camera camera(
+			glm::vec3(0.0f, 0.0f, 3.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f),
+			-90.0f,
+			0.0f
+		);
 
-	glUseProgram(depthProgram);
-	glUniform1f(glGetUniformLocation(depthProgram, "farPlane"), far);
+		bool spotlightOn = false;
 
-	glUseProgram(coreProgram);
-	glUniform1i(glGetUniformLocation(coreProgram, "depthMap"), 4);
-	glUniform1f(glGetUniformLocation(coreProgram, "farPlane"), far);
+		Handler handler(window, camera, spotlightOn);
 
-	while (!glfwWindowShouldClose(window))
-	{
-		glfwPollEvents();
-		Handler::MaintainKeyboard(window);
+		Texture planeDiff(TextureType::DIFFUSE, 0, "res/textures/wood.png", true, true);
+		Texture planeSpec(TextureType::SPECULAR, 1, "res/textures/Solid_grey.png", false, true);
 
-		int viewportParams[4];
-		glGetIntegerv(GL_VIEWPORT, viewportParams);
+		Texture cubeDiff(TextureType::DIFFUSE, 2, "res/textures/container2.png", true, true);
+		Texture cubeSpec(TextureType::SPECULAR, 3, "res/textures/specular.png", true, true);
 
-		// depth map
-		glCullFace(GL_FRONT);
-		glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-		glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-		glClear(GL_DEPTH_BUFFER_BIT);
+		// point light
 
 		glUseProgram(depthProgram);
+		glUniform1f(glGetUniformLocation(depthProgram, "farPlane"), far);
 
-		glUniform3fv(glGetUniformLocation(depthProgram, "lightPos"), 1, glm::value_ptr(LightData::pointLights[0].position));
-
-		std::vector<glm::mat4> shadowTransforms;
-		emplaceShadowTransforms(shadowTransforms, LightData::pointLights[0].position);
+		glUseProgram(coreProgram);
+		glUniform1i(glGetUniformLocation(coreProgram, "depthMap"), 4);
+		glUniform1f(glGetUniformLocation(coreProgram, "farPlane"), far);
 
-		for (unsigned int i = 0; i < 6; i++)
+		while (!glfwWindowShouldClose(window))
 		{
-			const std::string number = std::to_string(i);
-			glUniformMatrix4fv(glGetUniformLocation(depthProgram,
-				("shadowTransforms[" + number + "]").c_str()), 1, GL_FALSE, glm::value_ptr(shadowTransforms[i]));
-		}
-		
-		drawCube(depthProgram, cubeVAO);
-		drawPlane(depthProgram, planeVAO);
+			glfwPollEvents();
+			Handler::MaintainKeyboard(window);
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glCullFace(GL_BACK);
-		glViewport(0, 0, viewportParams[2], viewportParams[3]);
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			int viewportParams[4];
+			glGetIntegerv(GL_VIEWPORT, viewportParams);
 
-		glm::mat4 view = std::move(camera.GetViewMatrix());
-		glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, near, far);
+			// depth map
+			glCullFace(GL_FRONT);
+			glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+			glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+			glClear(GL_DEPTH_BUFFER_BIT);
 
-		// light
-		glm::mat4 model = glm::translate(glm::mat4(1.0f), LightData::pointLights[0].position);
-		model = glm::scale(model, glm::vec3(0.2f));
+			glUseProgram(depthProgram);
 
-		glUseProgram(lightProgram);
-		glUniformMatrix4fv(glGetUniformLocation(lightProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-		glUniformMatrix4fv(glGetUniformLocation(lightProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(glGetUniformLocation(lightProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-		glUniform3fv(glGetUniformLocation(lightProgram, "lightColor"), 1, glm::value_ptr(LightData::pointLights[0].specular));
+			glUniform3fv(glGetUniformLocation(depthProgram, "lightPos"), 1, glm::value_ptr(LightData::pointLights[0].position));
 
-		glBindVertexArray(cubeVAO);
-		glDrawElements(GL_TRIANGLES, CubeData::indexCount, GL_UNSIGNED_INT, 0);
+			std::vector<glm::mat4> shadowTransforms;
+			emplaceShadowTransforms(shadowTransforms, LightData::pointLights[0].position);
 
-		// rest of scene
-		glUseProgram(coreProgram);
-		glUniformMatrix4fv(glGetUniformLocation(coreProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(glGetUniformLocation(coreProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-		glUniform3fv(glGetUniformLocation(coreProgram, "pointLight.position"), 1, glm::value_ptr(LightData::pointLights[0].position));
-		glUniform1f(glGetUniformLocation(coreProgram, "pointLight.constant"), LightData::pointLights[0].constant);
-		glUniform1f(glGetUniformLocation(coreProgram, "pointLight.linear"), LightData::pointLights[0].linear);
-		glUniform1f(glGetUniformLocation(coreProgram, "pointLight.quadratic"), LightData::pointLights[0].quadratic);
-		glUniform3fv(glGetUniformLocation(coreProgram, "pointLight.ambient"), 1, glm::value_ptr(0.5f * LightData::pointLights[0].ambient));
-		glUniform3fv(glGetUniformLocation(coreProgram, "pointLight.diffuse"), 1, glm::value_ptr(LightData::pointLights[0].diffuse));
-		glUniform3fv(glGetUniformLocation(coreProgram, "pointLight.specular"), 1, glm::value_ptr(LightData::pointLights[0].specular));
-
-		glUniform1f(glGetUniformLocation(coreProgram, "material.shininess"), 32.0f);
-
-		glUniform1i(glGetUniformLocation(coreProgram, "material.diffuse"), 0);
-		glUniform1i(glGetUniformLocation(coreProgram, "material.specular"), 1);
-		drawPlane(coreProgram, planeVAO);
-
-		glUniform1i(glGetUniformLocation(coreProgram, "material.diffuse"), 2);
-		glUniform1i(glGetUniformLocation(coreProgram, "material.specular"), 3);
-		drawCube(coreProgram, cubeVAO);
-
-		glfwSwapBuffers(window);
-		glFlush();
+			for (unsigned int i = 0; i < 6; i++)
+			{
+				const std::string number = std::to_string(i);
+				glUniformMatrix4fv(glGetUniformLocation(depthProgram,
+					("shadowTransforms[" + number + "]").c_str()), 1, GL_FALSE, glm::value_ptr(shadowTransforms[i]));
+			}
+		
+			drawCubes(depthProgram, cubes);
+			drawPlane(depthProgram, planeVAO);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glCullFace(GL_BACK);
+			glViewport(0, 0, viewportParams[2], viewportParams[3]);
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			glm::mat4 view = std::move(camera.GetViewMatrix());
+			glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, near, far);
+
+			// light
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), LightData::pointLights[0].position);
+			model = glm::scale(model, glm::vec3(0.2f));
+
+			glUseProgram(lightProgram);
+			glUniformMatrix4fv(glGetUniformLocation(lightProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
+			glUniformMatrix4fv(glGetUniformLocation(lightProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+			glUniformMatrix4fv(glGetUniformLocation(lightProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+			glUniform3fv(glGetUniformLocation(lightProgram, "lightColor"), 1, glm::value_ptr(LightData::pointLights[0].specular));
+
+			glBindVertexArray(cubeVAO);
+			glDrawElements(GL_TRIANGLES, CubeData::indexCount, GL_UNSIGNED_INT, 0);
+
+			// rest of scene
+			glUseProgram(coreProgram);
+			glUniformMatrix4fv(glGetUniformLocation(coreProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+			glUniformMatrix4fv(glGetUniformLocation(coreProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+			glUniform3fv(glGetUniformLocation(coreProgram, "pointLight.position"), 1, glm::value_ptr(LightData::pointLights[0].position));
+			glUniform1f(glGetUniformLocation(coreProgram, "pointLight.constant"), LightData::pointLights[0].constant);
+			glUniform1f(glGetUniformLocation(coreProgram, "pointLight.linear"), LightData::pointLights[0].linear);
+			glUniform1f(glGetUniformLocation(coreProgram, "pointLight.quadratic"), LightData::pointLights[0].quadratic);
+			glUniform3fv(glGetUniformLocation(coreProgram, "pointLight.ambient"), 1, glm::value_ptr(0.5f * LightData::pointLights[0].ambient));
+			glUniform3fv(glGetUniformLocation(coreProgram, "pointLight.diffuse"), 1, glm::value_ptr(LightData::pointLights[0].diffuse));
+			glUniform3fv(glGetUniformLocation(coreProgram, "pointLight.specular"), 1, glm::value_ptr(LightData::pointLights[0].specular));
+
+			glUniform1f(glGetUniformLocation(coreProgram, "material.shininess"), 32.0f);
+
+			glUniform1i(glGetUniformLocation(coreProgram, "material.diffuse"), 0);
+			glUniform1i(glGetUniformLocation(coreProgram, "material.specular"), 1);
+			drawPlane(coreProgram, planeVAO);
+
+			glUniform1i(glGetUniformLocation(coreProgram, "material.diffuse"), 2);
+			glUniform1i(glGetUniformLocation(coreProgram, "material.specular"), 3);
+			drawCubes(coreProgram, cubes);
+
+			glfwSwapBuffers(window);
+			glFlush();
+		}
 	}
 
 	glfwDestroyWindow(window);
@@ -0,0 +1,127 @@
+#include "pch.h"
+
+#include <iostream>
+#include "Utility.h"
+
+#include "Camera.h"
+#include "Handler.h"
+#include "Shader.h"
+#include "SkinnedModel.h"
+
+// instances per side of the grid in benchmark mode
+static const int benchmarkGridSize = 20;
+static const float benchmarkSpacing = 2.0f;
+
+void TestSkinning()
+{
+	GLFWwindow* window = Utility::setupGLFW();
+	Utility::setupGLEW();
+
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_BACK);
+	glFrontFace(GL_CCW);
+	glEnable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	GLuint skinnedProgram;
+	Shader::loadLayoutProgram(skinnedProgram, "res/shaders/Skinning/VertexSkinned.glsl", "res/shaders/Skinning/FragmentSkinned.glsl",
+		SkinnedModel::GetVertexInputs());
+
+	// one character, or a grid of them each at its own point of the clip
+	const bool benchmark = false;
+
+	// scoped so the model releases its GL objects while the context is alive
+	{
+		SkinnedModel model("res/models/CesiumMan/CesiumMan.gltf");
+		if (!model.IsLoaded())
+			std::cerr << "[Error: TestSkinning] Could not load the model." << std::endl;
+		else
+		{
+			size_t keyBytes = 0;
+			for (const AnimationClip& clip : model.clips)
+				keyBytes += clip.GetKeyBytes();
+			std::cout << "[Info: TestSkinning] " << model.GetBoneCount() << " bones, " << model.clips.size()
+				<< " clips, " << keyBytes << " bytes of keys." << std::endl;
+		}
+
+		std::vector<glm::mat4> models;
+		std::vector<float> timeOffsets;
+		if (benchmark)
+		{
+			for (int z = 0; z < benchmarkGridSize; z++)
+				for (int x = 0; x < benchmarkGridSize; x++)
+				{
+					const float half = (benchmarkGridSize - 1) * benchmarkSpacing * 0.5f;
+					models.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(x * benchmarkSpacing - half, 0.0f, -z * benchmarkSpacing)));
+					timeOffsets.push_back((rand() % 1000) / 1000.0f * 2.0f);
+				}
+		}
+		else
+		{
+			models.push_back(glm::mat4(1.0f));
+			timeOffsets.push_back(0.0f);
+		}
+		std::vector<float> times(models.size());
+
+		Camera camera(
+			glm::vec3(0.0f, 1.0f, benchmark ? 8.0f : 3.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f),
+			-90.0f,
+			0.0f
+		);
+
+		bool spotlightOn = true;
+
+		Handler handler(window, camera, spotlightOn);
+
+		double statsStart = glfwGetTime(), paletteSeconds = 0.0;
+		unsigned int statsFrames = 0;
+
+		while (!glfwWindowShouldClose(window))
+		{
+			glfwPollEvents();
+			Handler::MaintainKeyboard(window);
+
+			const double frameStart = glfwGetTime();
+			for (size_t i = 0; i < times.size(); i++)
+				times[i] = (float)frameStart + timeOffsets[i];
+
+			model.UpdatePalettes(0, times.data(), times.size());
+			paletteSeconds += glfwGetTime() - frameStart;
+
+			glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			glm::mat4 view = camera.GetViewMatrix();
+			glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.1f, 100.0f);
+
+			glUseProgram(skinnedProgram);
+			glUniformMatrix4fv(glGetUniformLocation(skinnedProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+			glUniformMatrix4fv(glGetUniformLocation(skinnedProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+			glUniform3f(glGetUniformLocation(skinnedProgram, "lightDirection"), -0.3f, -1.0f, -0.5f);
+
+			model.Draw(skinnedProgram, models.data(), models.size());
+
+			glfwSwapBuffers(window);
+			glFlush();
+
+			// averages over roughly a second
+			statsFrames++;
+			const double now = glfwGetTime();
+			if (now - statsStart >= 1.0)
+			{
+				std::cout << "[Info: TestSkinning] " << models.size() << " instances: palettes "
+					<< paletteSeconds * 1000.0 / statsFrames << " ms, frame "
+					<< (now - statsStart) * 1000.0 / statsFrames << " ms." << std::endl;
+				statsStart = now;
+				paletteSeconds = 0.0;
+				statsFrames = 0;
+			}
+		}
+	}
+
+	glDeleteProgram(skinnedProgram);
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+}
@@ -5,48 +5,44 @@
 #include "Handler.h"
 #include "Texture.h"
 #include "Shader.h"
+#include "DrawDataBuffer.h"
 
 #include "StencilData.h"
+#include "VertexLayout.h"
 
-static GLuint createVertexArray()
+static GLuint createVertexArray(GLuint vbo)
 {
 	GLuint vao;
 	glCreateVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-	glBindVertexArray(0);
+	QuadVertexLayout::Setup(vao, vbo);
 	return vao;
 }
 
-static void drawCubes(GLuint shader, GLuint vao, bool border)
+// model matrices go to the frame's draw data; the cubes are one multi-draw
+static void drawCubes(DrawDataBuffer& draws, GLuint shader, GLuint vao, bool border)
 {
 	glUseProgram(shader);
 	glUniform1i(glGetUniformLocation(shader, "aTex"), 0);
 
-	glBindVertexArray(vao);
 	for (const glm::vec3& pos : StencilData::cubePositions)
 	{
 		glm::mat4 model(1.0f);
 		model = glm::translate(model, pos);
 		if (border)
 			model = glm::scale(model, glm::vec3(1.1f, 1.1f, 1.1f));
-		glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		draws.Add(36, 0, 0, model);
 	}
+
+	draws.Submit(shader, vao);
 }
 
-static void drawPlane(GLuint shader, GLuint vao)
+static void drawPlane(DrawDataBuffer& draws, GLuint shader, GLuint vao)
 {
 	glUseProgram(shader);
-	glm::mat4 model(1.0f);
-	glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
 	glUniform1i(glGetUniformLocation(shader, "aTex"), 1);
 
-	glBindVertexArray(vao);
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	draws.Add(6, 0, 0, glm::mat4(1.0f));
+	draws.Submit(shader, vao);
 }
 
 void TestStencil()
@@ -63,11 +59,11 @@ void TestStencil()
 
 	// Initialise shaders and load programs.
 	GLuint coreProgram;
-	if (!Shader::loadProgram(coreProgram, "res/shaders/stencil/VertexCore.glsl", "res/shaders/stencil/FragmentCore.glsl"))
+	if (!Shader::loadProgram(coreProgram, "res/shaders/DrawData/VertexCore.glsl", "res/shaders/stencil/FragmentCore.glsl"))
 		std::cerr << "[Error: main.cpp] Failed to load core program." << std::endl;
 
 	GLuint solidProgram;
-	if (!Shader::loadProgram(solidProgram, "res/shaders/stencil/VertexCore.glsl", "res/shaders/stencil/FragmentSolid.glsl"))
+	if (!Shader::loadProgram(solidProgram, "res/shaders/DrawData/VertexCore.glsl", "res/shaders/stencil/FragmentSolid.glsl"))
 		std::cerr << "[Error: main.cpp] Failed to load border program." << std::endl;
 
 	// cube
@@ -76,7 +72,7 @@ void TestStencil()
 	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(StencilData::cubeVertices), StencilData::cubeVertices, GL_STATIC_DRAW);
 
-	GLuint cubeVAO = createVertexArray();
+	GLuint cubeVAO = createVertexArray(cubeVBO);
 	glBindVertexArray(cubeVAO);
 
 	GLuint cubeEBO;
@@ -92,7 +88,7 @@ void TestStencil()
 	glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(StencilData::planeVertices), StencilData::planeVertices, GL_STATIC_DRAW);
 
-	GLuint planeVAO = createVertexArray();
+	GLuint planeVAO = createVertexArray(planeVBO);
 	glBindVertexArray(planeVAO);
 
 	GLuint planeEBO;
@@ -102,60 +98,70 @@ void TestStencil()
 
 	glBindVertexArray(0);
 
-	// Initialise textures and materials.
-	stbi_set_flip_vertically_on_load(true);
+	// scoped so the draw data buffer releases its fences and mapped buffers while the context is alive
+	{
+		// per-draw model matrices: the cubes twice and the plane, every frame
+		DrawDataBuffer draws(2 * sizeof(StencilData::cubePositions) / sizeof(glm::vec3) + 1);
+		draws.Attach(cubeVAO);
+		draws.Attach(planeVAO);
 
-	Texture cubeTexture(TextureType::DIFFUSE, 0, "res/textures/cobble.png", true);
-	Texture floorTexture(TextureType::DIFFUSE, 1, "res/textures/tile.png", true);
+		// Initialise textures and materials.
+		stbi_set_flip_vertically_on_load(true);
 
-	// Initialise window state.
-	Camera camera(
-		glm::vec3(0.0f, 0.0f, 3.0f),
-		glm::vec3(0.0f, 1.0f, 0.0f),
-		-90.0f,
-		0.0f
-	);
+		Texture cubeTexture(TextureType::DIFFUSE, 0, "res/textures/cobble.png", true);
+		Texture floorTexture(TextureType::DIFFUSE, 1, "res/textures/tile.png", true);
 
-	bool spotlightOn = true;
+		// Initialise window state.
+		Camera camera(
+			glm::vec3(0.0f, 0.0f, 3.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f),
+			-90.0f,
+			0.0f
+		);
 
-	Handler handler(window, camera, spotlightOn);
+		bool spotlightOn = true;
 
-	while (!glfwWindowShouldClose(window))
-	{
-		glfwPollEvents();
-		Handler::MaintainKeyboard(window);
+		Handler handler(window, camera, spotlightOn);
+
+		while (!glfwWindowShouldClose(window))
+		{
+			glfwPollEvents();
+			Handler::MaintainKeyboard(window);
 
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glStencilMask(0xFF);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-		glEnable(GL_DEPTH_TEST);
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glStencilMask(0xFF);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+			glEnable(GL_DEPTH_TEST);
 
-		glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-		glStencilFunc(GL_ALWAYS, 1, 0xFF);
+			glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+			glStencilFunc(GL_ALWAYS, 1, 0xFF);
 
-		glm::mat4 view = std::move(camera.GetViewMatrix());
-		glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.1f, 100.0f);
+			glm::mat4 view = std::move(camera.GetViewMatrix());
+			glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.1f, 100.0f);
 
-		glUseProgram(coreProgram);
-		glUniformMatrix4fv(glGetUniformLocation(coreProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(glGetUniformLocation(coreProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+			glUseProgram(coreProgram);
+			glUniformMatrix4fv(glGetUniformLocation(coreProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+			glUniformMatrix4fv(glGetUniformLocation(coreProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
-		drawCubes(coreProgram, cubeVAO, false);
+			draws.Begin();
+			drawCubes(draws, coreProgram, cubeVAO, false);
 		
-		glStencilMask(0x00);
-		drawPlane(coreProgram, planeVAO);
+			glStencilMask(0x00);
+			drawPlane(draws, coreProgram, planeVAO);
 
-		glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-		glDisable(GL_DEPTH_TEST);
+			glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
+			glDisable(GL_DEPTH_TEST);
 
-		glUseProgram(solidProgram);
-		glUniformMatrix4fv(glGetUniformLocation(solidProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(glGetUniformLocation(solidProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+			glUseProgram(solidProgram);
+			glUniformMatrix4fv(glGetUniformLocation(solidProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+			glUniformMatrix4fv(glGetUniformLocation(solidProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
-		drawCubes(solidProgram, cubeVAO, true);
+			drawCubes(draws, solidProgram, cubeVAO, true);
+			draws.End();
 
-		glfwSwapBuffers(window);
-		glFlush();
+			glfwSwapBuffers(window);
+			glFlush();
+		}
 	}
 
 	glfwDestroyWindow(window);
@@ -0,0 +1,160 @@
+#include "pch.h"
+
+#include <cmath>
+#include <iostream>
+#include "Utility.h"
+
+#include "Camera.h"
+#include "CellStreamer.h"
+#include "Frustum.h"
+#include "Handler.h"
+#include "MappedFile.h"
+#include "Shader.h"
+
+static const char* worldDirectory = "res/streaming";
+static const float worldSize = 2048.0f;
+static const float worldCellSize = 32.0f;
+// terrain vertices per side of one texture tile mesh
+static const int tileResolution = 256;
+
+static float terrainHeight(float x, float z)
+{
+	return 6.0f * std::sin(x * 0.02f) * std::cos(z * 0.017f) + 2.0f * std::sin(x * 0.11f + z * 0.07f);
+}
+
+// Cooks a terrain far larger than what the budget lets stay resident, alternating two ground textures per tile.
+static bool cookWorld()
+{
+	const int tileCount = 8;
+	const float tileSize = worldSize / tileCount;
+	const float step = tileSize / tileResolution;
+
+	std::vector<CellMesh> meshes;
+	for (int tileZ = 0; tileZ < tileCount; tileZ++)
+		for (int tileX = 0; tileX < tileCount; tileX++)
+		{
+			CellMesh mesh;
+			mesh.diffusePath = (tileX + tileZ) % 2 ? "res/textures/grass_ground.jpg" : "res/textures/cobble.png";
+
+			for (int z = 0; z <= tileResolution; z++)
+				for (int x = 0; x <= tileResolution; x++)
+				{
+					const float worldX = tileX * tileSize + x * step - worldSize * 0.5f;
+					const float worldZ = tileZ * tileSize + z * step - worldSize * 0.5f;
+					const glm::vec3 normal = glm::normalize(glm::vec3(
+						terrainHeight(worldX - step, worldZ) - terrainHeight(worldX + step, worldZ),
+						2.0f * step,
+						terrainHeight(worldX, worldZ - step) - terrainHeight(worldX, worldZ + step)));
+
+					mesh.vertices.emplace_back(glm::vec3(worldX, terrainHeight(worldX, worldZ), worldZ), normal, glm::vec2(worldX, worldZ) * 0.25f);
+				}
+
+			for (int z = 0; z < tileResolution; z++)
+				for (int x = 0; x < tileResolution; x++)
+				{
+					const unsigned int corner = z * (tileResolution + 1) + x;
+					const unsigned int quad[6] = { corner, corner + tileResolution + 1, corner + 1, corner + 1, corner + tileResolution + 1, corner + tileResolution + 2 };
+					mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+				}
+
+			meshes.push_back(std::move(mesh));
+		}
+
+	return CellStreamer::Cook(worldDirectory, worldCellSize, meshes);
+}
+
+void TestStreaming()
+{
+	GLFWwindow* window = Utility::setupGLFW();
+	Utility::setupGLEW();
+
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_BACK);
+	glFrontFace(GL_CCW);
+	glEnable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	GLuint cellProgram;
+	Shader::loadProgram(cellProgram, "res/shaders/VertexCore.glsl", "res/shaders/Streaming/FragmentCell.glsl");
+
+	// the world is cooked once and streamed from disk afterwards, and again when the cell format changed
+	if (!MappedFile(std::string(worldDirectory) + "/world.cells").IsOpen() || !CellStreamer(worldDirectory, 0).IsLoaded())
+	{
+		std::cout << "[Info: TestStreaming] Cooking the world to " << worldDirectory << "." << std::endl;
+		cookWorld();
+	}
+
+	// scoped so the streamer releases its GL objects while the context is alive
+	{
+		// a few hundred MB on disk, of which the budget keeps a small neighbourhood
+		CellStreamer streamer(worldDirectory, 16 * 1024 * 1024);
+		if (!streamer.IsLoaded())
+			std::cerr << "[Error: TestStreaming] Could not load the world." << std::endl;
+		streamer.loadRadius = 150.0f;
+		streamer.hysteresis = 30.0f;
+
+		Camera camera(
+			glm::vec3(0.0f, 20.0f, 0.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f),
+			-90.0f,
+			-10.0f
+		);
+		camera.movementSpeed = 40.0f;
+
+		bool spotlightOn = true;
+
+		Handler handler(window, camera, spotlightOn);
+
+		glm::vec3 lastPos = camera.pos;
+		double lastTime = glfwGetTime(), lastReport = lastTime;
+
+		while (!glfwWindowShouldClose(window))
+		{
+			glfwPollEvents();
+			Handler::MaintainKeyboard(window);
+
+			const double time = glfwGetTime();
+			const float deltaTime = (float)(time - lastTime);
+			const glm::vec3 velocity = deltaTime > 0.0f ? (camera.pos - lastPos) / deltaTime : glm::vec3(0.0f);
+			lastPos = camera.pos;
+			lastTime = time;
+
+			streamer.Update(camera.pos, velocity, time);
+
+			glClearColor(0.6f, 0.7f, 0.8f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			glm::mat4 view = camera.GetViewMatrix();
+			glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 800.0f / 600.0f, 0.1f, streamer.loadRadius + streamer.hysteresis);
+
+			glUseProgram(cellProgram);
+			glUniform1i(glGetUniformLocation(cellProgram, "instanced"), GL_FALSE);
+			glUniformMatrix4fv(glGetUniformLocation(cellProgram, "model"), 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+			glUniformMatrix4fv(glGetUniformLocation(cellProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+			glUniformMatrix4fv(glGetUniformLocation(cellProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+			glUniform3fv(glGetUniformLocation(cellProgram, "camPos"), 1, glm::value_ptr(camera.pos));
+			glUniform3f(glGetUniformLocation(cellProgram, "lightDirection"), -0.3f, -1.0f, -0.5f);
+			glUniform1f(glGetUniformLocation(cellProgram, "fogDistance"), streamer.loadRadius);
+
+			streamer.Draw(cellProgram, Frustum(projection * view));
+
+			glfwSwapBuffers(window);
+			glFlush();
+
+			if (time - lastReport >= 1.0)
+			{
+				const StreamingStats& stats = streamer.GetStats();
+				std::cout << "[Info: TestStreaming] " << stats.residentCells << " cells resident, " << stats.loadingCells << " loading, "
+					<< stats.residentBytes / (1024 * 1024) << "/" << stats.budgetBytes / (1024 * 1024) << " MB; read "
+					<< stats.readBandwidthMBs << " MB/s, latency " << stats.averageLatencyMs << " ms (max " << stats.maxLatencyMs << "); "
+					<< stats.loads << " loads, " << stats.evictions << " evictions, " << stats.discardedLoads << " discarded, " << stats.failedLoads << " failed." << std::endl;
+				lastReport = time;
+			}
+		}
+	}
+
+	glDeleteProgram(cellProgram);
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+}
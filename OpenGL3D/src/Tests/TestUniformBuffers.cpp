@@ -6,6 +6,7 @@
 #include "Shader.h"
 
 #include "CubeData.h"
+#include "VertexLayout.h"
 
 static void drawCube(GLuint shader, GLuint vao, const glm::vec3& pos, const glm::vec3& color)
 {
@@ -21,14 +22,11 @@ static void drawCube(GLuint shader, GLuint vao, const glm::vec3& pos, const glm:
 	glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
 }
 
-static GLuint createVertexArray()
+static GLuint createVertexArray(GLuint vbo)
 {
 	GLuint vao;
 	glCreateVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), 0);
-	glBindVertexArray(0);
+	CubeVertexLayout::Setup(vao, vbo);
 	return vao;
 }
 
@@ -51,7 +49,7 @@ void TestUniformBuffers()
 	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(CubeData::vertices), CubeData::vertices, GL_STATIC_DRAW);
 
-	GLuint cubeVAO = createVertexArray();
+	GLuint cubeVAO = createVertexArray(cubeVBO);
 	glBindVertexArray(cubeVAO);
 
 	GLuint cubeEBO;
@@ -20,4 +20,7 @@ void TestBloom();
 void TestDeferred();
 void TestOcclusion();
 void TestPBR();
-void TestIBL();
\ No newline at end of file
+void TestIBL();
+void TestGltf();
+void TestSkinning();
+void TestStreaming();
\ No newline at end of file
@@ -0,0 +1,268 @@
+#include "pch.h"
+#include "TextureLoader.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+static const unsigned char ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// byte offsets in the KTX2 header
+static const size_t ktx2LevelIndexOffset = 80;
+
+struct Ktx2Format
+{
+	unsigned int vkFormat;
+	GLenum internalFormat;
+	GLenum format;
+	bool compressed;
+	// bytes per pixel, or per 4x4 block when compressed
+	unsigned int size;
+};
+
+static const Ktx2Format ktx2Formats[] =
+{
+	{ 9, GL_R8, GL_RED, false, 1 },
+	{ 16, GL_RG8, GL_RG, false, 2 },
+	{ 23, GL_RGB8, GL_RGB, false, 3 },
+	{ 29, GL_SRGB8, GL_RGB, false, 3 },
+	{ 37, GL_RGBA8, GL_RGBA, false, 4 },
+	{ 43, GL_SRGB8_ALPHA8, GL_RGBA, false, 4 },
+	{ 131, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 0, true, 8 },
+	{ 132, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, 0, true, 8 },
+	{ 133, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, true, 8 },
+	{ 134, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 0, true, 8 },
+	{ 137, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, true, 16 },
+	{ 138, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 0, true, 16 },
+	{ 139, GL_COMPRESSED_RED_RGTC1, 0, true, 8 },
+	{ 141, GL_COMPRESSED_RG_RGTC2, 0, true, 16 },
+	{ 145, GL_COMPRESSED_RGBA_BPTC_UNORM, 0, true, 16 },
+	{ 146, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 0, true, 16 }
+};
+
+template<typename T>
+static T readValue(const unsigned char* data)
+{
+	T value;
+	memcpy(&value, data, sizeof(T));
+	return value;
+}
+
+static bool decodeKtx2(const unsigned char* data, size_t size, DecodedImage& outImage)
+{
+	if (size < ktx2LevelIndexOffset)
+	{
+		outImage.error = "truncated KTX2 header";
+		return false;
+	}
+
+	const unsigned int vkFormat = readValue<uint32_t>(data + 12);
+	const unsigned int width = readValue<uint32_t>(data + 20);
+	const unsigned int height = readValue<uint32_t>(data + 24);
+	const unsigned int depth = readValue<uint32_t>(data + 28);
+	const unsigned int layerCount = readValue<uint32_t>(data + 32);
+	const unsigned int faceCount = readValue<uint32_t>(data + 36);
+	const unsigned int levelCount = std::max(1u, (unsigned int)readValue<uint32_t>(data + 40));
+	const unsigned int supercompression = readValue<uint32_t>(data + 44);
+
+	if (supercompression != 0 || vkFormat == 0)
+	{
+		outImage.error = "supercompressed (Basis) KTX2 is not supported";
+		return false;
+	}
+
+	if (depth > 1 || layerCount > 1 || faceCount != 1)
+	{
+		outImage.error = "only single 2D KTX2 images are supported";
+		return false;
+	}
+
+	const Ktx2Format* format = nullptr;
+	for (const Ktx2Format& candidate : ktx2Formats)
+		if (candidate.vkFormat == vkFormat)
+			format = &candidate;
+
+	if (!format)
+	{
+		outImage.error = "unsupported KTX2 vkFormat " + std::to_string(vkFormat);
+		return false;
+	}
+
+	if (size < ktx2LevelIndexOffset + levelCount * 24)
+	{
+		outImage.error = "truncated KTX2 level index";
+		return false;
+	}
+
+	outImage.width = (int)width;
+	outImage.height = (int)height;
+	outImage.internalFormat = format->internalFormat;
+	outImage.format = format->format;
+	outImage.compressed = format->compressed;
+	outImage.levels.resize(levelCount);
+
+	for (unsigned int level = 0; level < levelCount; level++)
+	{
+		const unsigned char* entry = data + ktx2LevelIndexOffset + level * 24;
+		const uint64_t offset = readValue<uint64_t>(entry);
+		const uint64_t length = readValue<uint64_t>(entry + 8);
+
+		const unsigned int levelWidth = std::max(1u, width >> level);
+		const unsigned int levelHeight = std::max(1u, height >> level);
+		const uint64_t expected = format->compressed
+			? (uint64_t)((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * format->size
+			: (uint64_t)levelWidth * levelHeight * format->size;
+
+		if (offset + length > size || length < expected)
+		{
+			outImage.error = "KTX2 level " + std::to_string(level) + " is out of range";
+			return false;
+		}
+
+		outImage.levels[level].assign(data + offset, data + offset + expected);
+	}
+
+	return true;
+}
+
+bool TextureLoader::decode(const unsigned char* data, size_t size, bool srgb, DecodedImage& outImage)
+{
+	if (size >= sizeof(ktx2Identifier) && memcmp(data, ktx2Identifier, sizeof(ktx2Identifier)) == 0)
+		return decodeKtx2(data, size, outImage);
+
+	// glTF and KTX put the first row at the top, which is what GL samples at v = 0
+	stbi_set_flip_vertically_on_load_thread(0);
+
+	int width, height, channelCount;
+	unsigned char* pixels = stbi_load_from_memory(data, (int)size, &width, &height, &channelCount, 4);
+	if (!pixels)
+	{
+		outImage.error = stbi_failure_reason();
+		return false;
+	}
+
+	outImage.width = width;
+	outImage.height = height;
+	outImage.internalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+	outImage.format = GL_RGBA;
+	outImage.compressed = false;
+	outImage.levels.emplace_back(pixels, pixels + (size_t)width * height * 4);
+
+	stbi_image_free(pixels);
+	return true;
+}
+
+GLuint TextureLoader::upload(const DecodedImage& image)
+{
+	if (image.levels.empty())
+		return 0;
+
+	// Uncompressed images without their own chain get a full set of generated mipmaps.
+	const bool generateMips = !image.compressed && image.levels.size() == 1;
+	GLsizei levelCount = (GLsizei)image.levels.size();
+	if (generateMips)
+	{
+		levelCount = 1;
+		for (int extent = std::max(image.width, image.height); extent > 1; extent >>= 1)
+			levelCount++;
+	}
+
+	GLuint texture;
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureStorage2D(texture, levelCount, image.internalFormat, image.width, image.height);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (size_t level = 0; level < image.levels.size(); level++)
+	{
+		const GLsizei width = std::max(1, image.width >> level);
+		const GLsizei height = std::max(1, image.height >> level);
+
+		if (image.compressed)
+			glCompressedTextureSubImage2D(texture, (GLint)level, 0, 0, width, height, image.internalFormat,
+				(GLsizei)image.levels[level].size(), image.levels[level].data());
+		else
+			glTextureSubImage2D(texture, (GLint)level, 0, 0, width, height, image.format, image.type, image.levels[level].data());
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	if (generateMips)
+		glGenerateTextureMipmap(texture);
+
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	return texture;
+}
+
+void TextureLoader::Load(const std::string& path, bool srgb, Callback onReady)
+{
+	std::shared_ptr<DecodedImage> image = std::make_shared<DecodedImage>();
+
+	std::future<void> decoding = ThreadPool::Global().Submit([image, path, srgb]()
+	{
+		MappedFile file(path);
+		if (!file.IsOpen())
+		{
+			image->error = "could not open file";
+			return;
+		}
+
+		decode((const unsigned char*)file.GetData(), file.GetSize(), srgb, *image);
+	});
+
+	requests.push_back({ image, std::move(decoding), path, std::move(onReady) });
+}
+
+void TextureLoader::Load(std::vector<unsigned char>&& encoded, bool srgb, Callback onReady)
+{
+	std::shared_ptr<DecodedImage> image = std::make_shared<DecodedImage>();
+	std::shared_ptr<std::vector<unsigned char>> data = std::make_shared<std::vector<unsigned char>>(std::move(encoded));
+
+	std::future<void> decoding = ThreadPool::Global().Submit([image, data, srgb]()
+	{
+		decode(data->data(), data->size(), srgb, *image);
+	});
+
+	requests.push_back({ image, std::move(decoding), "embedded image", std::move(onReady) });
+}
+
+unsigned int TextureLoader::Update(unsigned int maxUploads)
+{
+	unsigned int uploads = 0;
+
+	for (size_t i = 0; i < requests.size() && uploads < maxUploads;)
+	{
+		Request& request = requests[i];
+		if (request.decoding.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			i++;
+			continue;
+		}
+
+		if (!request.image->error.empty())
+			std::cerr << "[Error: TextureLoader::Update] Could not decode " << request.label << ": " << request.image->error << "." << std::endl;
+		else
+		{
+			const GLuint texture = upload(*request.image);
+			if (request.onReady)
+				request.onReady(texture);
+			uploads++;
+		}
+
+		requests.erase(requests.begin() + i);
+	}
+
+	return uploads;
+}
+
+size_t TextureLoader::GetPendingCount() const
+{
+	return requests.size();
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct DecodedImage
+{
+	int width = 0;
+	int height = 0;
+
+	// sized internal format; format/type are only used for uncompressed data
+	GLenum internalFormat = 0;
+	GLenum format = 0;
+	GLenum type = GL_UNSIGNED_BYTE;
+	bool compressed = false;
+
+	// level 0 first
+	std::vector<std::vector<unsigned char>> levels;
+	std::string error;
+};
+
+/*
+	Decodes images on the thread pool and creates the GL textures on the calling (GL) thread.
+	PNG/JPEG/... go through stb_image; KTX2 is read natively for uncompressed 8-bit and BCn
+	formats (Basis supercompressed files are rejected). Load returns immediately; the
+	callback runs from Update once the texture exists.
+*/
+class TextureLoader
+{
+public:
+	typedef std::function<void(GLuint texture)> Callback;
+
+	TextureLoader() = default;
+	TextureLoader(const TextureLoader&) = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+
+	void Load(const std::string& path, bool srgb, Callback onReady);
+	void Load(std::vector<unsigned char>&& encoded, bool srgb, Callback onReady);
+
+	// Creates the textures whose decode has finished, at most maxUploads per call. Returns the number created.
+	unsigned int Update(unsigned int maxUploads = ~0u);
+	size_t GetPendingCount() const;
+
+	static bool decode(const unsigned char* data, size_t size, bool srgb, DecodedImage& outImage);
+	static GLuint upload(const DecodedImage& image);
+
+private:
+	struct Request
+	{
+		std::shared_ptr<DecodedImage> image;
+		std::future<void> decoding;
+		std::string label;
+		Callback onReady;
+	};
+
+	std::vector<Request> requests;
+};
@@ -0,0 +1,135 @@
+#include "pch.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+// chunks handed out per thread so that uneven chunks still balance
+static const size_t chunksPerThread = 4;
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	for (unsigned int i = 0; i < threadCount; i++)
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+ThreadPool& ThreadPool::Global()
+{
+	static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+	return pool;
+}
+
+std::future<void> ThreadPool::Submit(std::function<void()> task)
+{
+	std::packaged_task<void()> packaged(std::move(task));
+	std::future<void> future = packaged.get_future();
+
+	// without workers the task runs straight away
+	if (workers.empty())
+	{
+		packaged();
+		return future;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push(std::move(packaged));
+	}
+	condition.notify_one();
+
+	return future;
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body)
+{
+	if (!count)
+		return;
+
+	grainSize = std::max<size_t>(grainSize, 1);
+	const size_t maxChunks = (workers.size() + 1) * chunksPerThread;
+	const size_t chunkLimit = std::min(maxChunks, (count + grainSize - 1) / grainSize);
+
+	if (chunkLimit <= 1)
+	{
+		body(0, count);
+		return;
+	}
+
+	// Shared with the helper tasks, which may start after this call has returned.
+	struct State
+	{
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> done{ 0 };
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+	std::shared_ptr<State> state = std::make_shared<State>();
+
+	// The size is rounded up, so fewer chunks may cover count; recounting them keeps every
+	// chunk's begin below count.
+	const size_t chunkSize = (count + chunkLimit - 1) / chunkLimit;
+	const size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+	const std::function<void(size_t, size_t)>* bodyPtr = &body;
+
+	auto run = [state, chunkCount, chunkSize, count, bodyPtr]()
+	{
+		for (size_t chunk = state->next++; chunk < chunkCount; chunk = state->next++)
+		{
+			const size_t begin = chunk * chunkSize;
+			(*bodyPtr)(begin, std::min(count, begin + chunkSize));
+
+			if (++state->done == chunkCount)
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->finished.notify_all();
+			}
+		}
+	};
+
+	const size_t helperCount = std::min<size_t>(workers.size(), chunkCount - 1);
+	for (size_t i = 0; i < helperCount; i++)
+		Submit(run);
+
+	run();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished.wait(lock, [&state, chunkCount]() { return state->done == chunkCount; });
+}
+
+unsigned int ThreadPool::GetThreadCount() const
+{
+	return (unsigned int)workers.size() + 1;
+}
+
+void ThreadPool::workerLoop()
+{
+	while (true)
+	{
+		std::packaged_task<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+			if (stopping && tasks.empty())
+				return;
+
+			task = std::move(tasks.front());
+			tasks.pop();
+		}
+
+		task();
+	}
+}
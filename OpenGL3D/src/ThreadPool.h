@@ -0,0 +1,42 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/*
+	Fixed set of worker threads shared by the loaders and per-frame jobs.
+	ParallelFor lets the calling thread take part and only waits for chunks that
+	were actually started, so it can be nested inside pool tasks without deadlocking.
+*/
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned int threadCount);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// pool with one worker per hardware thread except the main one
+	static ThreadPool& Global();
+
+	std::future<void> Submit(std::function<void()> task);
+
+	// Runs body(begin, end) over [0, count) in chunks of at least grainSize and blocks until done.
+	void ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body);
+
+	unsigned int GetThreadCount() const;
+
+private:
+	std::vector<std::thread> workers;
+	std::queue<std::packaged_task<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping = false;
+
+	void workerLoop();
+};
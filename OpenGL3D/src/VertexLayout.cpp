@@ -0,0 +1,40 @@
+#include "pch.h"
+#include "VertexLayout.h"
+
+#include <cmath>
+
+glm::vec2 VertexEncoding::octEncode(const glm::vec3& normal)
+{
+	const glm::vec3 n = normal / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+	if (n.z >= 0.0f)
+		return glm::vec2(n.x, n.y);
+
+	// fold the lower hemisphere over the diagonals
+	return glm::vec2((1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+		(1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+void VertexEncoding::setupAttribute(GLuint vao, const VertexAttribute& attribute, GLuint binding)
+{
+	const GLuint columnSize = attribute.size / attribute.columns;
+	for (GLuint column = 0; column < attribute.columns; column++)
+	{
+		const GLuint location = attribute.location + column;
+		const GLuint offset = attribute.offset + column * columnSize;
+		if (attribute.integer)
+			glVertexArrayAttribIFormat(vao, location, attribute.components, attribute.type, offset);
+		else
+			glVertexArrayAttribFormat(vao, location, attribute.components, attribute.type, attribute.normalized, offset);
+		glVertexArrayAttribBinding(vao, location, binding);
+		glEnableVertexArrayAttrib(vao, location);
+	}
+}
+
+const char* VertexEncoding::octDecodeSource =
+	"vec3 octDecode(vec2 e)\n"
+	"{\n"
+	"\tvec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+	"\tfloat t = max(-n.z, 0.0);\n"
+	"\tn.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);\n"
+	"\treturn normalize(n);\n"
+	"}\n";
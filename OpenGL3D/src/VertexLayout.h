@@ -0,0 +1,471 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <glm.hpp>
+#include <packing.hpp>
+#include <gtc\packing.hpp>
+#include <gtc\quaternion.hpp>
+
+#include "ThreadPool.h"
+
+// one attribute as glVertexArrayAttrib(I)Format sees it, plus its GLSL declaration
+struct VertexAttribute
+{
+	GLuint location;
+	GLint components;
+	GLenum type;
+	GLboolean normalized;
+	// read through glVertexArrayAttribIFormat into an integer GLSL type
+	bool integer;
+	// matrices take one location per column, each of components values
+	GLuint columns;
+	// bytes in the vertex, all columns together
+	GLuint size;
+	GLuint offset;
+
+	const char* glslType;
+	const char* name;
+	// GLSL function turning the stored value into the type the shader uses, or nullptr
+	const char* decode;
+};
+
+namespace VertexEncoding
+{
+	// octahedral mapping of a unit vector onto [-1, 1]^2
+	glm::vec2 octEncode(const glm::vec3& normal);
+
+	// GLSL source of the decode functions named in VertexAttribute::decode
+	extern const char* octDecodeSource;
+
+	// Format, binding and enable calls for every location of attribute.
+	void setupAttribute(GLuint vao, const VertexAttribute& attribute, GLuint binding);
+}
+
+/*
+	Storage formats. Each one knows its GL type, its size in bytes and how to encode the
+	CPU value it is fed: glm vectors, or raw bytes for the 8-bit formats.
+	- float2/3/4: unchanged.
+	- half2/4: GL_HALF_FLOAT, for texture coordinates within a few units of zero.
+	- snorm1010102: GL_INT_2_10_10_10_REV normalised, xyz at 10 bits and a 2-bit w. Holds unit
+	  normals (read as vec3) and tangents with their sign (read as vec4) in 4 bytes.
+	- oct16: a unit vector octahedrally mapped onto two snorm16, decoded in the vertex shader.
+	- unorm8x4: four normalised bytes (weights, colours).
+	- uint8x4: four integer bytes (joint indices).
+	- quat16: a unit quaternion as four snorm16 (x, y, z, w), renormalised in the vertex shader.
+	- float4x4: a column major mat4 over four consecutive locations (instance transforms).
+*/
+struct float2
+{
+	static constexpr GLint components = 2;
+	static constexpr GLenum type = GL_FLOAT;
+	static constexpr GLboolean normalized = GL_FALSE;
+	static constexpr bool integer = false;
+	static constexpr GLuint columns = 1;
+	static constexpr size_t size = 8;
+	static constexpr const char* glslType() { return "vec2"; }
+	static constexpr const char* decode() { return nullptr; }
+	static void encode(const glm::vec2& value, unsigned char* out) { std::memcpy(out, &value, size); }
+};
+
+struct float3
+{
+	static constexpr GLint components = 3;
+	static constexpr GLenum type = GL_FLOAT;
+	static constexpr GLboolean normalized = GL_FALSE;
+	static constexpr bool integer = false;
+	static constexpr GLuint columns = 1;
+	static constexpr size_t size = 12;
+	static constexpr const char* glslType() { return "vec3"; }
+	static constexpr const char* decode() { return nullptr; }
+	static void encode(const glm::vec3& value, unsigned char* out) { std::memcpy(out, &value, size); }
+};
+
+struct float4
+{
+	static constexpr GLint components = 4;
+	static constexpr GLenum type = GL_FLOAT;
+	static constexpr GLboolean normalized = GL_FALSE;
+	static constexpr bool integer = false;
+	static constexpr GLuint columns = 1;
+	static constexpr size_t size = 16;
+	static constexpr const char* glslType() { return "vec4"; }
+	static constexpr const char* decode() { return nullptr; }
+	static void encode(const glm::vec4& value, unsigned char* out) { std::memcpy(out, &value, size); }
+};
+
+struct half2
+{
+	static constexpr GLint components = 2;
+	static constexpr GLenum type = GL_HALF_FLOAT;
+	static constexpr GLboolean normalized = GL_FALSE;
+	static constexpr bool integer = false;
+	static constexpr GLuint columns = 1;
+	static constexpr size_t size = 4;
+	static constexpr const char* glslType() { return "vec2"; }
+	static constexpr const char* decode() { return nullptr; }
+	static void encode(const glm::vec2& value, unsigned char* out)
+	{
+		const glm::uint packed = glm::packHalf2x16(value);
+		std::memcpy(out, &packed, size);
+	}
+};
+
+struct half4
+{
+	static constexpr GLint components = 4;
+	static constexpr GLenum type = GL_HALF_FLOAT;
+	static constexpr GLboolean normalized = GL_FALSE;
+	static constexpr bool integer = false;
+	static constexpr GLuint columns = 1;
+	static constexpr size_t size = 8;
+	static constexpr const char* glslType() { return "vec4"; }
+	static constexpr const char* decode() { return nullptr; }
+	static void encode(const glm::vec4& value, unsigned char* out)
+	{
+		const glm::uint64 packed = glm::packHalf4x16(value);
+		std::memcpy(out, &packed, size);
+	}
+};
+
+struct snorm1010102
+{
+	static constexpr GLint components = 4;
+	static constexpr GLenum type = GL_INT_2_10_10_10_REV;
+	static constexpr GLboolean normalized = GL_TRUE;
+	static constexpr bool integer = false;
+	static constexpr GLuint columns = 1;
+	static constexpr size_t size = 4;
+	static constexpr const char* glslType() { return "vec4"; }
+	static constexpr const char* decode() { return nullptr; }
+	static void encode(const glm::vec4& value, unsigned char* out)
+	{
+		const glm::uint32 packed = glm::packSnorm3x10_1x2(value);
+		std::memcpy(out, &packed, size);
+	}
+	static void encode(const glm::vec3& value, unsigned char* out) { encode(glm::vec4(value, 0.0f), out); }
+};
+
+struct oct16
+{
+	static constexpr GLint components = 2;
+	static constexpr GLenum type = GL_SHORT;
+	static constexpr GLboolean normalized = GL_TRUE;
+	static constexpr bool integer = false;
+	static constexpr GLuint columns = 1;
+	static constexpr size_t size = 4;
+	static constexpr const char* glslType() { return "vec2"; }
+	static constexpr const char* decode() { return "octDecode"; }
+	static void encode(const glm::vec3& value, unsigned char* out)
+	{
+		const glm::uint packed = glm::packSnorm2x16(VertexEncoding::octEncode(value));
+		std::memcpy(out, &packed, size);
+	}
+};
+
+struct unorm8x4
+{
+	static constexpr GLint components = 4;
+	static constexpr GLenum type = GL_UNSIGNED_BYTE;
+	static constexpr GLboolean normalized = GL_TRUE;
+	static constexpr bool integer = false;
+	static constexpr GLuint columns = 1;
+	static constexpr size_t size = 4;
+	static constexpr const char* glslType() { return "vec4"; }
+	static constexpr const char* decode() { return nullptr; }
+	static void encode(const glm::vec4& value, unsigned char* out)
+	{
+		const glm::uint packed = glm::packUnorm4x8(value);
+		std::memcpy(out, &packed, size);
+	}
+	static void encode(const uint8_t (&value)[4], unsigned char* out) { std::memcpy(out, value, size); }
+};
+
+struct uint8x4
+{
+	static constexpr GLint components = 4;
+	static constexpr GLenum type = GL_UNSIGNED_BYTE;
+	static constexpr GLboolean normalized = GL_FALSE;
+	static constexpr bool integer = true;
+	static constexpr GLuint columns = 1;
+	static constexpr size_t size = 4;
+	static constexpr const char* glslType() { return "uvec4"; }
+	static constexpr const char* decode() { return nullptr; }
+	static void encode(const uint8_t (&value)[4], unsigned char* out) { std::memcpy(out, value, size); }
+};
+
+struct quat16
+{
+	static constexpr GLint components = 4;
+	static constexpr GLenum type = GL_SHORT;
+	static constexpr GLboolean normalized = GL_TRUE;
+	static constexpr bool integer = false;
+	static constexpr GLuint columns = 1;
+	static constexpr size_t size = 8;
+	static constexpr const char* glslType() { return "vec4"; }
+	static constexpr const char* decode() { return "normalize"; }
+	static void encode(const glm::quat& value, unsigned char* out)
+	{
+		const glm::uint64 packed = glm::packSnorm4x16(glm::vec4(value.x, value.y, value.z, value.w));
+		std::memcpy(out, &packed, size);
+	}
+};
+
+struct float4x4
+{
+	static constexpr GLint components = 4;
+	static constexpr GLenum type = GL_FLOAT;
+	static constexpr GLboolean normalized = GL_FALSE;
+	static constexpr bool integer = false;
+	static constexpr GLuint columns = 4;
+	static constexpr size_t size = 64;
+	static constexpr const char* glslType() { return "mat4"; }
+	static constexpr const char* decode() { return nullptr; }
+	static void encode(const glm::mat4& value, unsigned char* out) { std::memcpy(out, &value, size); }
+};
+
+/*
+	Semantics: the default location and GLSL name used across res/shaders, the GLSL type the
+	shaders declare, and the member of a CPU vertex struct the value is read from.
+	Every one takes the storage format and optionally another location.
+*/
+template<typename F, GLuint L = 0>
+struct Position
+{
+	using Format = F;
+	static constexpr GLuint location = L;
+	static constexpr const char* name() { return "aPos"; }
+	static constexpr const char* glslType() { return "vec3"; }
+	template<typename V> static const auto& read(const V& vertex) { return vertex.pos; }
+};
+
+template<typename F, GLuint L = 1>
+struct Normal
+{
+	using Format = F;
+	static constexpr GLuint location = L;
+	static constexpr const char* name() { return "aNormal"; }
+	static constexpr const char* glslType() { return "vec3"; }
+	template<typename V> static const auto& read(const V& vertex) { return vertex.normal; }
+};
+
+template<typename F, GLuint L = 2>
+struct TexCoords
+{
+	using Format = F;
+	static constexpr GLuint location = L;
+	static constexpr const char* name() { return "aTexCoords"; }
+	static constexpr const char* glslType() { return "vec2"; }
+	template<typename V> static const auto& read(const V& vertex) { return vertex.texCoords; }
+};
+
+// after the instance matrix slots (3-6) of VertexCore.glsl
+template<typename F, GLuint L = 7>
+struct Tangent
+{
+	using Format = F;
+	static constexpr GLuint location = L;
+	static constexpr const char* name() { return "aTangent"; }
+	static constexpr const char* glslType() { return "vec4"; }
+	template<typename V> static const auto& read(const V& vertex) { return vertex.tangent; }
+};
+
+template<typename F, GLuint L = 3>
+struct Joints
+{
+	using Format = F;
+	static constexpr GLuint location = L;
+	static constexpr const char* name() { return "aJoints"; }
+	static constexpr const char* glslType() { return "uvec4"; }
+	template<typename V> static const auto& read(const V& vertex) { return vertex.joints; }
+};
+
+template<typename F, GLuint L = 4>
+struct Weights
+{
+	using Format = F;
+	static constexpr GLuint location = L;
+	static constexpr const char* name() { return "aWeights"; }
+	static constexpr const char* glslType() { return "vec4"; }
+	template<typename V> static const auto& read(const V& vertex) { return vertex.weights; }
+};
+
+/*
+	Compact per-instance transform (see InstanceTransform): translation, rotation and scale at
+	locations 3-5 of VertexCore.glsl; the PBR shaders take them at 5-7.
+*/
+template<typename F, GLuint L = 3>
+struct InstancePosition
+{
+	using Format = F;
+	static constexpr GLuint location = L;
+	static constexpr const char* name() { return "aInstancePosition"; }
+	static constexpr const char* glslType() { return "vec3"; }
+	template<typename V> static const auto& read(const V& instance) { return instance.position; }
+};
+
+template<typename F, GLuint L = 4>
+struct InstanceRotation
+{
+	using Format = F;
+	static constexpr GLuint location = L;
+	static constexpr const char* name() { return "aInstanceRotation"; }
+	static constexpr const char* glslType() { return "vec4"; }
+	template<typename V> static const auto& read(const V& instance) { return instance.rotation; }
+};
+
+template<typename F, GLuint L = 5>
+struct InstanceScale
+{
+	using Format = F;
+	static constexpr GLuint location = L;
+	static constexpr const char* name() { return "aInstanceScale"; }
+	static constexpr const char* glslType() { return "vec3"; }
+	template<typename V> static const auto& read(const V& instance) { return instance.scale; }
+};
+
+// full per-instance matrix, for transforms that are not scale, rotation and translation
+template<typename F, GLuint L = 3>
+struct InstanceModel
+{
+	using Format = F;
+	static constexpr GLuint location = L;
+	static constexpr const char* name() { return "aModel"; }
+	static constexpr const char* glslType() { return "mat4"; }
+	template<typename V> static const auto& read(const V& instance) { return instance.model; }
+};
+
+template<typename F, GLuint L = 7>
+struct InstanceColor
+{
+	using Format = F;
+	static constexpr GLuint location = L;
+	static constexpr const char* name() { return "aColor"; }
+	static constexpr const char* glslType() { return "vec3"; }
+	template<typename V> static const auto& read(const V& instance) { return instance.color; }
+};
+
+/*
+	Tightly packed interleaved vertex, described once by its attributes in memory order:
+
+		using Layout = VertexLayout<Position<float3>, Normal<oct16>, TexCoords<half2>>;
+
+	Offsets, stride and attribute formats are constexpr, so layouts can be checked with
+	static_assert where they must match a struct. Setup emits the DSA format and binding
+	calls, Pack converts CPU vertices into the stored formats in parallel, and
+	GetGlslInputs writes the matching input declarations (see Shader::loadLayoutProgram).
+	Inputs with a decoded format are declared as <name>Packed and #defined to the decoded
+	value, so shader code keeps using the plain name.
+*/
+template<typename... A>
+class VertexLayout
+{
+public:
+	static constexpr size_t GetAttributeCount() { return sizeof...(A); }
+
+	static constexpr GLuint GetOffset(size_t index)
+	{
+		const size_t sizes[] = { A::Format::size... };
+		size_t offset = 0;
+		for (size_t i = 0; i < index && i < sizeof...(A); i++)
+			offset += sizes[i];
+		return (GLuint)offset;
+	}
+
+	static constexpr GLsizei GetStride() { return (GLsizei)GetOffset(sizeof...(A)); }
+
+	static constexpr VertexAttribute GetAttribute(size_t index)
+	{
+		VertexAttribute attributes[] = { describe<A>()... };
+		attributes[index].offset = GetOffset(index);
+		return attributes[index];
+	}
+
+	static constexpr bool HasUniqueLocations()
+	{
+		const GLuint locations[] = { A::location... };
+		const GLuint columns[] = { A::Format::columns... };
+		for (size_t i = 0; i < sizeof...(A); i++)
+			for (size_t j = i + 1; j < sizeof...(A); j++)
+				if (locations[i] < locations[j] + columns[j] && locations[j] < locations[i] + columns[i])
+					return false;
+		return true;
+	}
+
+	// Points the attributes of vao at vbo through binding; a divisor of 1 steps them per instance.
+	static void Setup(GLuint vao, GLuint vbo, GLuint binding = 0, GLuint divisor = 0)
+	{
+		static_assert(GetStride() % 4 == 0, "vertex stride must be a multiple of 4 bytes");
+		static_assert(HasUniqueLocations(), "two attributes share a location");
+
+		glVertexArrayVertexBuffer(vao, binding, vbo, 0, GetStride());
+		glVertexArrayBindingDivisor(vao, binding, divisor);
+		for (size_t i = 0; i < sizeof...(A); i++)
+			VertexEncoding::setupAttribute(vao, GetAttribute(i), binding);
+	}
+
+	template<typename V>
+	static void Pack(const V* vertices, size_t vertexCount, unsigned char* out)
+	{
+		ThreadPool::Global().ParallelFor(vertexCount, 4096, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+				packVertex(vertices[i], out + i * GetStride(), std::index_sequence_for<A...>());
+		});
+	}
+
+	template<typename V>
+	static std::vector<unsigned char> Pack(const std::vector<V>& vertices)
+	{
+		std::vector<unsigned char> packed(vertices.size() * GetStride());
+		Pack(vertices.data(), vertices.size(), packed.data());
+		return packed;
+	}
+
+	static std::string GetGlslInputs()
+	{
+		std::string declarations, defines;
+		bool octDecode = false;
+
+		for (size_t i = 0; i < sizeof...(A); i++)
+		{
+			const VertexAttribute attribute = GetAttribute(i);
+			const std::string location = "layout (location = " + std::to_string(attribute.location) + ") in ";
+			if (!attribute.decode)
+			{
+				declarations += location + attribute.glslType + " " + attribute.name + ";\n";
+				continue;
+			}
+
+			declarations += location + attribute.glslType + " " + attribute.name + "Packed;\n";
+			defines += std::string("#define ") + attribute.name + " " + attribute.decode + "(" + attribute.name + "Packed)\n";
+			octDecode |= std::string(attribute.decode) == "octDecode";
+		}
+
+		return declarations + (octDecode ? VertexEncoding::octDecodeSource : "") + defines;
+	}
+
+private:
+	template<typename S>
+	static constexpr VertexAttribute describe()
+	{
+		using F = typename S::Format;
+		return { S::location, F::components, F::type, F::normalized, F::integer, F::columns, (GLuint)F::size, 0,
+			F::decode() ? F::glslType() : S::glslType(), S::name(), F::decode() };
+	}
+
+	template<typename V, size_t... I>
+	static void packVertex(const V& vertex, unsigned char* out, std::index_sequence<I...>)
+	{
+		const int expand[] = { 0, (A::Format::encode(A::read(vertex), out + std::integral_constant<GLuint, GetOffset(I)>::value), 0)... };
+		(void)expand;
+	}
+};
+
+// the interleaved float arrays in Data/ and the tests: position, normal, texture coordinates
+using CubeVertexLayout = VertexLayout<Position<float3>, Normal<float3>, TexCoords<float2>>;
+// full screen and billboard quads: position and texture coordinates at location 1
+using QuadVertexLayout = VertexLayout<Position<float3>, TexCoords<float2, 1>>;
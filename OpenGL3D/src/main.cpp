@@ -24,5 +24,8 @@ int main()
 	//TestOcclusion();
 	//TestPBR();
 	TestIBL();
+	//TestGltf();
+	//TestSkinning();
+	//TestStreaming();
 
 }
\ No newline at end of file